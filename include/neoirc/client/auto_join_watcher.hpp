@@ -57,7 +57,7 @@ namespace irc
 		// operations
 		void startup_connect();
 		bool join_pending(connection& aConnection, const std::string& aChannelName) const;
-		bool is_auto_join() const { return iIsAutoJoin; }
+		bool is_auto_join(const buffer& aBuffer) const; // true if the buffer is for a channel being auto-joined or rejoined
 
 	private:
 		// implementation
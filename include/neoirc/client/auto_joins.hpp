@@ -137,6 +137,7 @@ namespace irc
 	};
 
 	void read_auto_joins(model& aModel, std::function<bool()> aErrorFunction = std::function<bool()>());
+	void read_auto_joins(model& aModel, const neolib::xml& aXml, std::function<bool()> aErrorFunction = std::function<bool()>());
 	void write_auto_joins(const model& aModel);
 }
 
@@ -37,9 +37,12 @@
 #define IRC_CLIENT_AUTO_MODE
 
 #include <neolib/observable.hpp>
+#include <cstdint>
+#include <unordered_map>
 #include <neoirc/client/server.hpp>
 #include <neoirc/client/user.hpp>
 #include <neoirc/client/message.hpp>
+#include <neoirc/client/mask.hpp>
 
 namespace irc
 {
@@ -98,15 +101,37 @@ namespace irc
 	public:
 		// types
 		typedef std::list<auto_mode_entry> container_type;
+		typedef std::vector<container_type::const_iterator> entry_list;
+	private:
+		struct compiled_entry
+		{
+			container_type::const_iterator iEntry;
+			mask iNickName;
+			mask iUserName;
+			mask iHostName;
+		};
+		typedef std::vector<std::size_t> entry_indices;
+		typedef std::unordered_map<std::string, entry_indices> entry_buckets;
+		struct index
+		{
+			index() : iGeneration(static_cast<uint64_t>(-1)) {}
+			uint64_t iGeneration;
+			std::vector<compiled_entry> iEntries;
+			entry_buckets iByChannel; // network and folded channel name ("*" for entries covering every channel)
+			entry_buckets iByNetwork;
+		};
+		enum { CasemappingCount = casemapping::strict_rfc1459 + 1 };
 
 	public:
 		// construction
-		auto_mode() : iLoading(false) {}
+		auto_mode() : iLoading(false), iGeneration(0) {}
 
 	public:
 		// operations
 		const container_type& entries() const { return iEntries; }
-		container_type& entries() { return iEntries; }
+		container_type& entries() { return iEntries; } // call invalidate() after changing entries directly
+		void invalidate() { ++iGeneration; }
+		std::size_t matching(casemapping::type aCasemapping, const server_key& aServer, const user& aUser, const std::string& aChannel, entry_list& aEntries) const; // matching entries in list order
 		bool has_auto_mode(casemapping::type aCasemapping, const server_key& aServer, const user& aUser, const std::string& aChannel) const;
 		bool has_auto_mode(casemapping::type aCasemapping, const server_key& aServer, const user& aUser, const std::string& aChannel, auto_mode_entry::type_e aType) const;
 		bool add(const server_key& aServer, const user& aUser, const std::string& aChannel, auto_mode_entry::type_e aType, const std::string& aData);
@@ -124,6 +149,9 @@ namespace irc
 
 	private:
 		// implementation
+		const index& compiled(casemapping::type aCasemapping) const;
+		static std::string bucket_key(const std::string& aNetwork, const std::string& aChannel) { return aNetwork + '\0' + aChannel; }
+		static bool matches(const compiled_entry& aEntry, const std::string& aNickName, const std::string& aUserName, const std::string& aHostName);
 		// from neolib::observable<auto_mode_list_observer>
 		virtual void notify_observer(auto_mode_list_observer& aObserver, auto_mode_list_observer::notify_type aType, const void* aParameter = 0, const void* aParameter2 = 0);
 
@@ -131,9 +159,12 @@ namespace irc
 		// attributes
 		container_type iEntries;
 		bool iLoading;
+		uint64_t iGeneration;
+		mutable index iIndex[CasemappingCount];
 	};
 
 	void read_auto_mode_list(model& aModel, std::function<bool()> aErrorFunction = std::function<bool()>());
+	void read_auto_mode_list(model& aModel, const neolib::xml& aXml, std::function<bool()> aErrorFunction = std::function<bool()>());
 	void write_auto_mode_list(const model& aModel);
 }
 
@@ -36,6 +36,7 @@
 #ifndef IRC_CLIENT_AUTO_MODE_WATCHER
 #define IRC_CLIENT_AUTO_MODE_WATCHER
 
+#include <set>
 #include <neoirc/client/auto_mode.hpp>
 #include <neoirc/client/connection_manager.hpp>
 #include <neoirc/client/connection.hpp>
@@ -77,17 +78,17 @@ namespace irc
 		virtual void incoming_message(connection& aConnection, const message& aMessage) {}
 		virtual void outgoing_message(connection& aConnection, const message& aMessage) {}
 		virtual void connection_quitting(connection& aConnection) {}
-		virtual void connection_disconnected(connection& aConnection) {}
+		virtual void connection_disconnected(connection& aConnection);
 		virtual void connection_giveup(connection& aConnection) {}
 		// from channel_buffer_observer
 		virtual void joining_channel(channel_buffer& aBuffer) {}
 		virtual void user_added(channel_buffer& aBuffer, channel_user_list::iterator aUser);
 		virtual void user_updated(channel_buffer& aBuffer, channel_user_list::iterator aOldUser, channel_user_list::iterator aNewUser);
-		virtual void user_removed(channel_buffer& aBuffer, channel_user_list::iterator aUser) {}
+		virtual void user_removed(channel_buffer& aBuffer, channel_user_list::iterator aUser);
 		virtual void user_host_info(channel_buffer& aBuffer, channel_user_list::iterator aUser);
 		virtual void user_away_status(channel_buffer& aBuffer, channel_user_list::iterator aUser) {}
 		virtual void user_list_updating(channel_buffer& aBuffer) {}
-		virtual void user_list_updated(channel_buffer& aBuffer) {}
+		virtual void user_list_updated(channel_buffer& aBuffer);
 
 
 	private:
@@ -98,6 +99,8 @@ namespace irc
 		watched_connections iWatchedConnections;
 		typedef std::list<channel_buffer*> watched_channels;
 		watched_channels iWatchedChannels;
+		typedef std::set<const channel_buffer*> populated_channels;
+		populated_channels iPopulatedChannels; // channels whose membership has been evaluated since we joined
 	};
 }
 
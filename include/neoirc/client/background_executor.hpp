@@ -0,0 +1,152 @@
+// background_executor.h
+/*
+ *  Copyright (c) 2010 Leigh Johnston.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ *     * Neither the name of Leigh Johnston nor the names of any
+ *       other contributors to this software may be used to endorse or
+ *       promote products derived from this software without specific prior
+ *       written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ *  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef IRC_CLIENT_BACKGROUND_EXECUTOR
+#define IRC_CLIENT_BACKGROUND_EXECUTOR
+
+#include <memory>
+#include <deque>
+#include <vector>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <neolib/timer.hpp>
+#include <neolib/io_task.hpp>
+
+namespace irc
+{
+	class background_executor;
+
+	class background_job : public std::enable_shared_from_this<background_job>
+	{
+		friend class background_executor;
+	public:
+		// types
+		enum state_e { Idle, Queued, Running, Finished, Cancelled };
+
+	public:
+		// construction
+		background_job() : iExecutor(0), iState(Idle), iCancelled(false) {}
+		virtual ~background_job() {}
+
+	public:
+		// operations
+		state_e state() const;
+		bool cancelled() const { return iCancelled; }
+		bool finished() const { return state() == Finished; }
+		void cancel(); // a queued job will not be run; a running job should poll cancelled()
+		void wait() const; // wait for a running job to return
+		void wait_done() const; // wait for a posted job to finish or be cancelled
+
+	protected:
+		// implementation
+		void progress(); // called from run() to have progressed() called on the owner thread
+	private:
+		void set_state(state_e aState); // never leaves Cancelled
+		bool try_start(); // Running unless already cancelled, in one step
+		virtual void run() = 0; // called on a worker thread
+		virtual void progressed() {} // called on the owner thread unless cancelled; before completed()
+		virtual void completed() {} // called on the owner thread unless cancelled
+
+	private:
+		// attributes
+		background_executor* iExecutor;
+		mutable std::mutex iMutex;
+		mutable std::condition_variable iStateChanged;
+		state_e iState;
+		std::atomic<bool> iCancelled;
+	};
+
+	typedef std::shared_ptr<background_job> background_job_pointer;
+
+	class background_executor
+	{
+		friend class background_job;
+	public:
+		// types
+		enum lane_e { High, Normal, Low, LaneCount };
+
+	private:
+		// types
+		class function_job : public background_job
+		{
+		public:
+			function_job(const std::function<void()>& aWork, const std::function<void()>& aCompletion) : iWork(aWork), iCompletion(aCompletion) {}
+		private:
+			virtual void run() { iWork(); }
+			virtual void completed() { if (iCompletion) iCompletion(); }
+		private:
+			std::function<void()> iWork;
+			std::function<void()> iCompletion;
+		};
+		typedef std::deque<background_job_pointer> lane;
+
+	public:
+		// construction
+		background_executor(neolib::io_task& aOwnerTask, std::size_t aWorkerCount);
+		~background_executor();
+
+	public:
+		// operations
+		std::size_t worker_count() const { return iWorkers.size(); }
+		void post(background_job_pointer aJob, lane_e aLane = Normal); // owner thread only
+		background_job_pointer post(const std::function<void()>& aWork, const std::function<void()>& aCompletion = std::function<void()>(), lane_e aLane = Normal);
+		void prioritise(background_job& aJob, lane_e aLane);
+		std::size_t pending() const;
+
+	private:
+		// implementation
+		void worker();
+		void job_progressed(background_job_pointer aJob);
+		void process_completed();
+		bool outstanding() const;
+
+	private:
+		// attributes
+		mutable std::mutex iMutex;
+		std::condition_variable iWorkAvailable;
+		lane iLanes[LaneCount];
+		bool iStopping;
+		std::size_t iRunning;
+		std::vector<std::thread> iWorkers;
+		std::vector<background_job_pointer> iProgressed;
+		std::vector<background_job_pointer> iCompleted;
+		neolib::callback_timer iCompletionTimer;
+	};
+}
+
+#endif //IRC_CLIENT_BACKGROUND_EXECUTOR
@@ -0,0 +1,155 @@
+// ban_evaluator.h
+/*
+ *  Copyright (c) 2010 Leigh Johnston.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ *     * Neither the name of Leigh Johnston nor the names of any
+ *       other contributors to this software may be used to endorse or
+ *       promote products derived from this software without specific prior
+ *       written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ *  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef IRC_CLIENT_BAN_EVALUATOR
+#define IRC_CLIENT_BAN_EVALUATOR
+
+#include <set>
+#include <unordered_map>
+#include <vector>
+#include <neoirc/client/channel_buffer.hpp>
+#include <neoirc/client/channel_modes.hpp>
+#include <neoirc/client/mask.hpp>
+#include <neoirc/client/ban_evaluator_observer.hpp>
+
+namespace irc
+{
+	// Evaluates a channel's ban and ban exception lists against its membership.  Each mask is 
+	// compiled once into nick, user and host masks and each user's folded nick!user@host is kept 
+	// with a count of the bans and exceptions covering it, so adding or removing a mask only visits 
+	// the users it can match (the users on its host when the host part is literal) and observers 
+	// are told just which users became banned or unbanned.  A whole RPL_BANLIST is evaluated once 
+	// when it has been received, and a NAMES refresh only reports members whose state it changed.
+	class ban_evaluator : public neolib::observable<ban_evaluator_observer>, private channel_modes_observer, private channel_buffer_observer
+	{
+	public:
+		// types
+		typedef ban_evaluator_observer::user_list user_list;
+		typedef std::vector<std::string> mask_list;
+
+	public:
+		// construction
+		ban_evaluator(channel_modes& aModes);
+		~ban_evaluator();
+
+	public:
+		// operations
+		bool is_banned(const channel_user& aUser) const;
+		std::size_t banned_users(user_list& aUsers) const;
+		std::size_t affected_users(const std::string& aMask, user_list& aUsers) const; // current users a prospective ban would match
+		std::size_t covering_bans(const user& aUser, mask_list& aBans) const; // bans that would match a (joining) user
+
+	private:
+		// types
+		enum list_e { Bans, Excepts };
+		struct user_state
+		{
+			user_state() : iBans(0), iExcepts(0) {}
+			bool banned() const { return iBans != 0 && iExcepts == 0; }
+			std::string iNickName; // folded
+			std::string iUserName; // folded
+			std::string iHostName; // folded
+			std::size_t iBans;
+			std::size_t iExcepts;
+		};
+		struct compiled_mask
+		{
+			compiled_mask(casemapping::type aCasemapping, const std::string& aMask);
+			bool matches(const user_state& aUser) const;
+			std::string iMask;
+			bool iExtended; // extban ("$a:account", "~q:mask"); not evaluated
+			mask iNickName;
+			mask iUserName;
+			mask iHostName;
+			std::size_t iCount; // occurrences in the list
+		};
+		typedef std::unordered_map<std::string, compiled_mask> compiled_masks; // folded mask
+		typedef std::unordered_map<const channel_user*, user_state> user_states;
+		typedef std::unordered_map<std::string, user_list> host_index; // folded host name
+
+	private:
+		// implementation
+		casemapping::type casemapping() const;
+		compiled_masks& masks(list_e aList) { return aList == Bans ? iBans : iExcepts; }
+		void fold_user(const user& aUser, user_state& aState) const;
+		void matching(const compiled_mask& aMask, user_list& aUsers) const;
+		void adjust(list_e aList, const user_list& aUsers, bool aIncrement);
+		const user_state& add_user(const channel_user& aUser);
+		void remove_user(const channel_user& aUser);
+		const compiled_mask* insert_mask(list_e aList, const std::string& aMask);
+		void add_mask(list_e aList, const std::string& aMask);
+		void remove_mask(list_e aList, const std::string& aMask);
+		void load(list_e aList, const channel_modes::container_type& aEntries);
+		void changed(const user_list& aUsers, const std::vector<bool>& aWasBanned);
+		// from neolib::observable<ban_evaluator_observer>
+		virtual void notify_observer(ban_evaluator_observer& aObserver, ban_evaluator_observer::notify_type aType, const void* aParameter = 0, const void* aParameter2 = 0);
+		// from channel_modes_observer
+		virtual void channel_modes_ban_list_entry_added(const channel_modes& aModes, const channel_modes_entry& aEntry);
+		virtual void channel_modes_ban_list_entry_removed(const channel_modes& aModes, const channel_modes_entry& aEntry);
+		virtual void channel_modes_ban_list_reset(const channel_modes& aModes) {} // the old list stands until the new one is loaded
+		virtual void channel_modes_ban_list_loaded(const channel_modes& aModes) { load(Bans, aModes.ban_list()); }
+		virtual void channel_modes_except_list_entry_added(const channel_modes& aModes, const channel_modes_entry& aEntry);
+		virtual void channel_modes_except_list_entry_removed(const channel_modes& aModes, const channel_modes_entry& aEntry);
+		virtual void channel_modes_except_list_reset(const channel_modes& aModes) {}
+		virtual void channel_modes_except_list_loaded(const channel_modes& aModes) { load(Excepts, aModes.except_list()); }
+		virtual void channel_modes_invite_list_entry_added(const channel_modes& aModes, const channel_modes_entry& aEntry) {}
+		virtual void channel_modes_invite_list_entry_removed(const channel_modes& aModes, const channel_modes_entry& aEntry) {}
+		virtual void channel_modes_invite_list_reset(const channel_modes& aModes) {}
+		virtual void channel_modes_invite_list_loaded(const channel_modes& aModes) {}
+		virtual void channel_modes_list_done(const channel_modes& aModes) {}
+		virtual void channel_modes_modes_updated(const channel_modes& aModes) {}
+		// from channel_buffer_observer
+		virtual void joining_channel(channel_buffer& aBuffer) {}
+		virtual void user_added(channel_buffer& aBuffer, channel_user_list::iterator aUser);
+		virtual void user_updated(channel_buffer& aBuffer, channel_user_list::iterator aOldUser, channel_user_list::iterator aNewUser);
+		virtual void user_removed(channel_buffer& aBuffer, channel_user_list::iterator aUser);
+		virtual void user_host_info(channel_buffer& aBuffer, channel_user_list::iterator aUser);
+		virtual void user_away_status(channel_buffer& aBuffer, channel_user_list::iterator aUser) {}
+		virtual void user_list_updating(channel_buffer& aBuffer);
+		virtual void user_list_updated(channel_buffer& aBuffer);
+
+	private:
+		// attributes
+		channel_modes& iModes;
+		channel_buffer& iChannel;
+		compiled_masks iBans;
+		compiled_masks iExcepts;
+		user_states iUsers;
+		host_index iHosts;
+		std::set<std::string> iBannedBeforeUpdate; // folded nicks banned when a NAMES list started
+	};
+}
+
+#endif //IRC_CLIENT_BAN_EVALUATOR
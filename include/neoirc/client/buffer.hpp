@@ -213,7 +213,8 @@ namespace irc
 			DELAY,
 			ECHO, XYZZY,
 			FINDUSER,
-			TIMER
+			TIMER,
+			SCROLLBACK
 		};
 		const char* iString;
 		command_e iCommand;
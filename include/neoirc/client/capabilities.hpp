@@ -0,0 +1,117 @@
+// capabilities.h
+/*
+ *  Copyright (c) 2010 Leigh Johnston.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ *     * Neither the name of Leigh Johnston nor the names of any
+ *       other contributors to this software may be used to endorse or
+ *       promote products derived from this software without specific prior
+ *       written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ *  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef IRC_CLIENT_CAPABILITIES
+#define IRC_CLIENT_CAPABILITIES
+
+#include <map>
+#include <set>
+#include <neolib/observable.hpp>
+#include <neoirc/client/connection.hpp>
+#include <neoirc/client/message.hpp>
+
+namespace irc
+{
+	class capabilities;
+
+	class capabilities_observer
+	{
+		friend class capabilities;
+	private:
+		virtual void capability_enabled(connection& aConnection, const std::string& aCapability) = 0;
+		virtual void capability_disabled(connection& aConnection, const std::string& aCapability) = 0;
+	public:
+		enum notify_type { NotifyCapabilityEnabled, NotifyCapabilityDisabled };
+	};
+
+	// IRCv3 client capability negotiation (CAP LS 302) for a connection.  Subsystems register the 
+	// capabilities they can use with want() and observe them being enabled or disabled.  "CAP LS 302" 
+	// is sent ahead of registration; whichever wanted capabilities the server offers are requested 
+	// and registration is released with "CAP END" once they have been acknowledged or refused.  
+	// Capabilities the server offers later (CAP NEW) or wanted later are requested as they appear.  
+	// A server that does not know CAP simply registers us without it.
+	class capabilities : public neolib::observable<capabilities_observer>, private connection_observer
+	{
+	public:
+		// types
+		typedef std::set<std::string> capability_list;
+		typedef std::map<std::string, std::string> capability_values; // capability to its LS 302 value, if any
+
+	public:
+		// construction
+		capabilities(connection& aConnection);
+		virtual ~capabilities();
+
+	public:
+		// operations
+		void want(const std::string& aCapability);
+		bool offered(const std::string& aCapability) const { return iOffered.find(aCapability) != iOffered.end(); }
+		const std::string& value(const std::string& aCapability) const;
+		bool enabled(const std::string& aCapability) const { return iEnabled.find(aCapability) != iEnabled.end(); }
+		bool negotiating() const { return iNegotiating; }
+		void begin();
+		bool new_message(const message& aMessage);
+
+	private:
+		// implementation
+		void request();
+		void send(const std::string& aSubcommand, const std::string& aParameter = std::string());
+		void end();
+		static void parse(const std::string& aList, capability_values& aCapabilities);
+		// from neolib::observable<capabilities_observer>
+		virtual void notify_observer(capabilities_observer& aObserver, capabilities_observer::notify_type aType, const void* aParameter = 0, const void* aParameter2 = 0);
+		// from connection_observer
+		virtual void connection_connecting(connection& aConnection) {}
+		virtual void connection_registered(connection& aConnection) { iNegotiating = false; }
+		virtual void buffer_added(buffer& aBuffer) {}
+		virtual void buffer_removed(buffer& aBuffer) {}
+		virtual void incoming_message(connection& aConnection, const message& aMessage) {}
+		virtual void outgoing_message(connection& aConnection, const message& aMessage) {}
+		virtual void connection_quitting(connection& aConnection) {}
+		virtual void connection_disconnected(connection& aConnection);
+		virtual void connection_giveup(connection& aConnection) {}
+
+	private:
+		// attributes
+		connection& iConnection;
+		capability_list iWanted;
+		capability_values iOffered;
+		capability_list iRequested;
+		capability_list iEnabled;
+		bool iNegotiating;
+	};
+}
+
+#endif //IRC_CLIENT_CAPABILITIES
@@ -36,15 +36,16 @@
 #ifndef IRC_CLIENT_CHANNEL_MODES
 #define IRC_CLIENT_CHANNEL_MODES
 
-#include <array>
 #include <ctime>
-#include <clocale>
+#include <memory>
 #include <neoirc/client/connection.hpp>
 #include <neoirc/client/channel_buffer.hpp>
+#include <neoirc/client/timestamp.hpp>
 
 namespace irc
 {
 	class channel_modes;
+	class ban_evaluator;
 
 	struct channel_modes_entry
 	{
@@ -57,12 +58,7 @@ namespace irc
 				return "";
 			else
 			{
-				std::time_t ttTime = *iDate;
-				std::tm* tmTime = std::localtime(&ttTime);
-				std::tr1::array<char, 256> strTime;
-				std::setlocale(LC_TIME, "");
-				std::strftime(&strTime[0], strTime.size(), "%a %b %#d %H:%M:%S %Y", tmTime);
-				return std::string(&strTime[0]);
+				return timestamp_formatter::instance().format(*iDate, "%a %b %#d %H:%M:%S %Y");
 			}
 		}
 		string iUser;
@@ -77,16 +73,19 @@ namespace irc
 		virtual void channel_modes_ban_list_entry_added(const channel_modes& aModes, const channel_modes_entry& aEntry) = 0;
 		virtual void channel_modes_ban_list_entry_removed(const channel_modes& aModes, const channel_modes_entry& aEntry) = 0;
 		virtual void channel_modes_ban_list_reset(const channel_modes& aModes) = 0;
+		virtual void channel_modes_ban_list_loaded(const channel_modes& aModes) = 0; // whole list received; its entries are not notified individually
 		virtual void channel_modes_except_list_entry_added(const channel_modes& aModes, const channel_modes_entry& aEntry) = 0;
 		virtual void channel_modes_except_list_entry_removed(const channel_modes& aModes, const channel_modes_entry& aEntry) = 0;
 		virtual void channel_modes_except_list_reset(const channel_modes& aModes) = 0;
+		virtual void channel_modes_except_list_loaded(const channel_modes& aModes) = 0; // whole list received; its entries are not notified individually
 		virtual void channel_modes_invite_list_entry_added(const channel_modes& aModes, const channel_modes_entry& aEntry) = 0;
 		virtual void channel_modes_invite_list_entry_removed(const channel_modes& aModes, const channel_modes_entry& aEntry) = 0;
 		virtual void channel_modes_invite_list_reset(const channel_modes& aModes) = 0;
+		virtual void channel_modes_invite_list_loaded(const channel_modes& aModes) = 0; // whole list received; its entries are not notified individually
 		virtual void channel_modes_list_done(const channel_modes& aModes) = 0;
 		virtual void channel_modes_modes_updated(const channel_modes& aModes) = 0;
 	public:
-		enum notify_type { NotifyBanListEntryAdded, NotifyBanListEntryRemoved, NotifyBanListReset, NotifyExceptListEntryAdded, NotifyExceptListEntryRemoved, NotifyExceptListReset, NotifyInviteListEntryAdded, NotifyInviteListEntryRemoved, NotifyInviteListReset, NotifyListDone, NotifyModesUpdated };
+		enum notify_type { NotifyBanListEntryAdded, NotifyBanListEntryRemoved, NotifyBanListReset, NotifyBanListLoaded, NotifyExceptListEntryAdded, NotifyExceptListEntryRemoved, NotifyExceptListReset, NotifyExceptListLoaded, NotifyInviteListEntryAdded, NotifyInviteListEntryRemoved, NotifyInviteListReset, NotifyInviteListLoaded, NotifyListDone, NotifyModesUpdated };
 	};
 
 	class channel_modes : public neolib::observable<channel_modes_observer>, private connection_observer
@@ -119,6 +118,8 @@ namespace irc
 
 	public:
 		// operations
+		const channel_buffer& channel() const { return iParent; }
+		channel_buffer& channel() { return iParent; }
 		container_type& ban_list() { return iBanList; }
 		const container_type& ban_list() const { return iBanList; }
 		container_type& except_list() { return iExceptList; }
@@ -133,6 +134,8 @@ namespace irc
 		const std::string& channel_key() const {return iChannelKey; }
 		const std::string& user_limit() const { return iUserLimit; }
 		bool got_modes() const { return iGotModes; }
+		const ban_evaluator& bans() const { return *iBanEvaluator; } // observe it to be told which members become banned or unbanned
+		ban_evaluator& bans() { return *iBanEvaluator; }
 
 	private:
 		// implementation
@@ -162,6 +165,7 @@ namespace irc
 		std::string iChannelKey;
 		std::string iUserLimit;
 		bool iGotModes;
+		std::unique_ptr<ban_evaluator> iBanEvaluator;
 	};
 }
 
@@ -0,0 +1,98 @@
+// config_writer.h
+/*
+ *  Copyright (c) 2010 Leigh Johnston.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ *     * Neither the name of Leigh Johnston nor the names of any
+ *       other contributors to this software may be used to endorse or
+ *       promote products derived from this software without specific prior
+ *       written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ *  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef IRC_CLIENT_CONFIG_WRITER
+#define IRC_CLIENT_CONFIG_WRITER
+
+#include <string>
+#include <map>
+#include <set>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <neolib/timer.hpp>
+#include <neoirc/client/background_executor.hpp>
+
+namespace irc
+{
+	// Writes configuration files on the background executor.  Saves of the same file are
+	// serialised and coalesced: only the most recent contents are written.  Files are written
+	// to a temporary file which then replaces the original so a failed write never leaves a
+	// truncated file behind.
+	//
+	// Stores can also be marked dirty rather than saved directly; a dirty store is serialised 
+	// once, on the owner thread, when the save window following the first change expires.
+	class config_writer
+	{
+	public:
+		// types
+		typedef std::function<void()> serialiser;
+		enum { DefaultWindow_ms = 500 };
+
+	public:
+		// construction
+		config_writer(neolib::io_task& aOwnerTask, background_executor& aExecutor, uint32_t aWindow_ms = DefaultWindow_ms);
+		~config_writer();
+
+	public:
+		// operations
+		void save(const std::string& aFileName, const std::string& aContents);
+		void mark_dirty(const std::string& aStore, const serialiser& aSerialiser);
+		uint32_t window() const { return iWindow_ms; }
+		void set_window(uint32_t aWindow_ms);
+		void flush();
+		void wait();
+
+	private:
+		// implementation
+		void serialise_dirty();
+		void write_pending(const std::string& aFileName);
+
+	private:
+		// attributes
+		neolib::io_task& iOwnerTask;
+		background_executor& iExecutor;
+		uint32_t iWindow_ms;
+		std::map<std::string, serialiser> iDirty; // owner thread only
+		std::unique_ptr<neolib::callback_timer> iWindowTimer;
+		std::mutex iMutex;
+		std::condition_variable iIdle;
+		std::map<std::string, std::string> iPending;
+		std::set<std::string> iInFlight;
+	};
+}
+
+#endif //IRC_CLIENT_CONFIG_WRITER
@@ -39,6 +39,7 @@
 #include <neolib/manager_of.hpp>
 #include <neolib/optional.hpp>
 #include <neolib/packet_stream.hpp>
+#include <neoirc/client/shard_stream.hpp>
 #include <neoirc/client/server.hpp>
 #include <neoirc/client/identity.hpp>
 #include <neoirc/client/connection_manager_observer.hpp>
@@ -55,6 +56,11 @@ namespace irc
 	class who_requester;
 	class dns_requester;
 	class channel_list;
+	class capabilities;
+	class flood_scheduler;
+	class mode_aggregator;
+	class target_packer;
+	class join_scheduler;
 	class message;
 
 	class connection_observer
@@ -75,12 +81,13 @@ namespace irc
 	};
 
 	// todo: refactor this god class into more manageable smaller classes...
-	class connection : public neolib::observable<connection_observer>, public neolib::manager_of<connection, connection_observer, buffer>, private neolib::i_tcp_string_packet_stream_observer, private connection_manager_observer, private ignore_list_observer, private neolib::tcp_resolver::requester
+	class connection : public neolib::observable<connection_observer>, public neolib::manager_of<connection, connection_observer, buffer>, private neolib::i_tcp_string_packet_stream_observer, private parsed_message_observer, private connection_manager_observer, private ignore_list_observer, private neolib::tcp_resolver::requester
 	{
 		// types
 	private:
 		friend class buffer;
 		friend class connection_manager;
+		friend class flood_scheduler;
 		struct reconnect_data
 		{
 			reconnect_data(const connection& aConnection, const neolib::optional<irc::server>& aNewServer);
@@ -130,7 +137,11 @@ namespace irc
 			virtual void ready()
 			{
 				if (iParent.registered() && !iParent.iServerBuffer.empty())
+				{
+					iParent.iBackgroundOutput = true;
 					iParent.server_buffer().new_message(iCommand);
+					iParent.iBackgroundOutput = false;
+				}
 				again();
 				if (iRepeat && --(*iRepeat) == 0)
 					for (list::iterator i = iParent.iCommandTimers.begin(); i != iParent.iCommandTimers.end(); ++i)
@@ -183,7 +194,7 @@ namespace irc
 		void check_close();
 		bool close(bool aSendQuit = false);
 		void change_server(const std::string& aServer);
-		neolib::tcp_string_packet_stream& stream() { return iPacketStream; }
+		shard_stream& stream() { return iPacketStream; }
 		bool connected() const { return iPacketStream.connected(); }
 		bool have_local_address() const { return iHaveLocalAddress; }
 		void local_address_warning();
@@ -220,11 +231,18 @@ namespace irc
 		bool has_user(const irc::user& aUser) const;
 		bool has_user(const irc::user& aUser, const buffer& aBufferToExclude) const;
 		const irc::user& user(const irc::user& aUser) const;
+		irc::ignore_cache& ignore_cache() const { return iIgnoreCache; }
 		whois_requester& whois() { return *iWhoisRequester; }
 		who_requester& who() { return *iWhoRequester; }
 		dns_requester& dns() { return *iDnsRequester; }
 		irc::channel_list& channel_list() { return *iChannelList; }
+		irc::capabilities& capabilities() { return *iCapabilities; }
+		const irc::capabilities& capabilities() const { return *iCapabilities; }
+		join_scheduler& joins() { return *iJoinScheduler; }
+		const join_scheduler& joins() const { return *iJoinScheduler; }
 		const std::pair<std::string, std::string>& prefixes() const { return iPrefixes; }
+		std::size_t max_modes() const { return iMaxModes; }
+		std::size_t max_targets(const std::string& aCommand, std::size_t aDefault = 1) const;
 		bool is_prefix(char aPrefix) const;
 		bool is_prefix_mode(char aMode) const;
 		char mode_from_prefix(char aPrefix) const;
@@ -249,7 +267,9 @@ namespace irc
 		bool reconnect(const neolib::optional<irc::server>& aNewServer = neolib::optional<irc::server>(), bool aUserChangeServer = false);
 		void send_ping();
 		void timeout();
-		void bump_flood_buffer();
+		void write_message(const message& aMessage);
+		void cork();
+		void uncork();
 		bool any_buffers() const;
 		bool find_message(model::id aMessageId, buffer*& aBuffer, message*& aMessage);
 		void query_host();
@@ -269,6 +289,8 @@ namespace irc
 		void packet_arrived(neolib::tcp_string_packet_stream& aStream, const neolib::string_packet& aPacket) override;
 		void transfer_failure(neolib::tcp_string_packet_stream& aStream, const boost::system::error_code& aError) override;
 		void connection_closed(neolib::tcp_string_packet_stream& aStream) override;
+		// from parsed_message_observer
+		void messages_parsed(std::vector<message>& aMessages) override;
 		// from connection_manager_observer
 		void connection_added(connection& aConnection) override {}
 		void connection_removed(connection& aConnection) override {}
@@ -335,7 +357,7 @@ namespace irc
 		std::string iNickName;
 		std::string iPassword;
 		irc::user iUser;
-		neolib::tcp_string_packet_stream iPacketStream;
+		shard_stream iPacketStream;
 		neolib::tcp_resolver iResolver;
 		bool iGotConnection;
 		bool iConsole;
@@ -353,13 +375,21 @@ namespace irc
 		std::unique_ptr<who_requester> iWhoRequester;
 		std::unique_ptr<dns_requester> iDnsRequester;
 		std::unique_ptr<irc::channel_list> iChannelList;
-		uint64_t iTimeLastMessageSent;
-		typedef std::deque<message> flood_prevention_buffer;
-		flood_prevention_buffer iFloodPreventionBuffer;
+		std::unique_ptr<irc::capabilities> iCapabilities;
+		std::unique_ptr<join_scheduler> iJoinScheduler;
+		std::unique_ptr<flood_scheduler> iFloodScheduler;
+		std::unique_ptr<mode_aggregator> iModeAggregator;
+		std::unique_ptr<target_packer> iTargetPacker;
+		bool iBackgroundOutput; // set while command timers send, so their lines queue as bulk
+		bool iCorked; // messages are collected in iCorkedMessages and written together by uncork()
+		std::string iCorkedMessages;
 		neolib::optional<reconnect_data> iReconnectData;
 		neolib::optional<identity::alternate_nick_names_t> iAlternateNickNames;
 		casemapping::type iCasemapping;
 		std::pair<std::string, std::string> iPrefixes;
+		std::size_t iMaxModes;
+		typedef std::map<std::string, std::size_t> target_limits;
+		target_limits iTargetLimits; // from TARGMAX/MAXTARGETS, upper case command
 		std::string iChantypes;
 		neolib::callback_timer iPinger;
 		bool iWaitingForPong;
@@ -372,17 +402,31 @@ namespace irc
 		u_long iLocalAddress;
 		struct away_updater : neolib::timer
 		{
+			// fallback for servers without away-notify: one channel WHO per tick, the active channel 
+			// refreshed most often and channels too big for a cheap WHO not at all
+			enum 
+			{ 
+				ActiveInterval = 30 * 1000, 
+				RecentInterval = 2 * 60 * 1000, 
+				IdleInterval = 10 * 60 * 1000,
+				RecentlyViewedPeriod = 10 * 60 * 1000,
+				MaxPolledChannelSize = 250
+			};
+			typedef std::map<const channel_buffer*, uint64_t> channel_times;
 			away_updater(model& aModel, connection& aParent) : 
 				neolib::timer(aModel.io_task(), 30 * 1000), 
-				iParent(aParent), 
-				iNextChannel(aParent.iChannelBuffers.begin())
+				iParent(aParent)
 			{
 			}
 			void ready() override;
+			void channel_removed(const channel_buffer& aChannel) { iLastUpdated.erase(&aChannel); iLastViewed.erase(&aChannel); }
+			void clear() { iLastUpdated.clear(); iLastViewed.clear(); }
 			connection& iParent;
-			channel_buffer_list::iterator iNextChannel;
+			channel_times iLastUpdated;
+			channel_times iLastViewed;
 		} iAwayUpdater;
 		command_timer_list iCommandTimers;
+		mutable irc::ignore_cache iIgnoreCache;
 	public:
 		static std::string sConsolesTitle;
 		static std::string sConsoleTitle;
@@ -37,6 +37,8 @@
 #define IRC_CLIENT_CONNECTION_MANAGER
 
 #include <neolib/resolver.hpp>
+#include <neoirc/client/resolver_cache.hpp>
+#include <neoirc/client/io_shards.hpp>
 #include <neoirc/client/connection.hpp>
 #include <neoirc/client/server.hpp>
 #include <neoirc/client/identity.hpp>
@@ -63,33 +65,6 @@ namespace irc
 		typedef std::list<connection_ptr> connection_list;
 		typedef std::map<std::pair<std::string, string>, std::string> key_list;
 		struct error {};
-		class flood_preventor : public neolib::timer
-		{
-		public:
-			flood_preventor(neolib::io_task& aIoTask, unsigned long aFloodPreventionDelay, connection_manager& aConnectionManager) :
-				neolib::timer(aIoTask, aFloodPreventionDelay, true), iConnectionManager(aConnectionManager)
-			{
-			}
-			flood_preventor(const flood_preventor& aOther) : neolib::timer(aOther), iConnectionManager(aOther.iConnectionManager)
-			{
-			}
-			flood_preventor& operator=(const flood_preventor& aOther)
-			{
-				neolib::timer::operator=(aOther);
-				return *this;
-			}
-			bool operator==(const flood_preventor& aRhs) const { return false; }
-		private:
-			// implementation
-			virtual void ready()
-			{
-				again();
-				iConnectionManager.bump_flood_buffers();
-			}
-		private:
-			// attributes
-			connection_manager& iConnectionManager;
-		};
 
 		// construction
 	public:
@@ -116,6 +91,9 @@ namespace irc
 		const auto_mode& auto_mode_list() const { return iAutoModeList; }
 		neolib::tcp_resolver& resolver() { return iResolver; }
 		const neolib::tcp_resolver& resolver() const { return iResolver; }
+		irc::resolver_cache& resolver_cache() { return iResolverCache; }
+		const irc::resolver_cache& resolver_cache() const { return iResolverCache; }
+		irc::io_shards& io_shards() { return iIoShards; }
 		neolib::optional<server> server_from_string(const std::string& aServer);
 		connection* add_connection(const std::string& aServer, const identity& aIdentity, const std::string& aPassword = std::string(), bool aManualConnectionRequest = false);
 		connection* add_connection(const server& aServer, const identity& aIdentity, const std::string& aPassword = std::string(), bool aManualConnectionRequest = false);
@@ -147,6 +125,8 @@ namespace irc
 		void set_flood_prevention(bool aFloodPrevention);
 		void set_flood_prevention_delay(long aFloodPreventionDelay);
 		bool flood_prevention() const { return iFloodPrevention; }
+		void set_network_threads(std::size_t aNetworkThreads); // connections created afterwards do socket I/O on this many threads
+		std::size_t network_threads() const { return iIoShards.worker_count(); }
 		unsigned long flood_prevention_delay() const { return iFloodPreventionDelay; }
 		void set_use_notice_buffer(bool aUseNoticeBuffer) { iUseNoticeBuffer = aUseNoticeBuffer; }
 		bool use_notice_buffer() const { return iUseNoticeBuffer; }
@@ -162,7 +142,6 @@ namespace irc
 		void remove_key(const connection& aConnection, const std::string& aChannelName);
 		bool has_key(const connection& aConnection, const std::string& aChannelName) const;
 		const std::string& key(const connection& aConnection, const std::string& aChannelName) const;
-		void bump_flood_buffers();
 		model::id next_connection_id() { return iNextConnectionId++; }
 		model::id next_buffer_id() { return iNextBufferId++; }
 		model::id next_message_id() { return iNextMessageId++; }
@@ -196,6 +175,8 @@ namespace irc
 		irc::notify& iNotifyList;
 		irc::auto_mode& iAutoModeList;
 		neolib::tcp_resolver iResolver;
+		irc::resolver_cache iResolverCache;
+		irc::io_shards iIoShards;
 		connection_list iConnections;
 		bool iAutoReconnect;
 		bool iReconnectAnyServer;
@@ -204,7 +185,6 @@ namespace irc
 		unsigned int iDisconnectTimeout;
 		buffer* iActiveBuffer;
 		bool iFloodPrevention;
-		neolib::optional<flood_preventor> iFloodPreventor;
 		unsigned long iFloodPreventionDelay;
 		bool iUseNoticeBuffer;
 		bool iAutoWho;
@@ -135,6 +135,7 @@ namespace irc
 	};
 
 	void read_connection_scripts(model& aModel, std::function<bool()> aErrorFunction = std::function<bool()>());
+	void read_connection_scripts(model& aModel, const neolib::xml& aXml, std::function<bool()> aErrorFunction = std::function<bool()>());
 	void write_connection_scripts(const model& aModel);
 }
 
@@ -143,6 +143,7 @@ namespace irc
 	};
 
 	void read_contacts_list(model& aModel, std::function<bool()> aErrorFunction = std::function<bool()>());
+	void read_contacts_list(model& aModel, const neolib::xml& aXml, std::function<bool()> aErrorFunction = std::function<bool()>());
 	void write_contacts_list(const model& aModel);
 }
 
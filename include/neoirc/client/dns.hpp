@@ -36,7 +36,7 @@
 #ifndef IRC_CLIENT_DNS
 #define IRC_CLIENT_DNS
 
-#include <neolib/resolver.hpp>
+#include <neoirc/client/resolver_cache.hpp>
 #include <neoirc/client/connection.hpp>
 #include <neoirc/client/whois.hpp>
 #include <neoirc/client/buffer.hpp>
@@ -44,7 +44,7 @@
 
 namespace irc
 {
-	class dns_requester : private connection_observer, private whois_requester::requester, private neolib::tcp_resolver::requester
+	class dns_requester : private connection_observer, private whois_requester::requester, private resolver_cache::requester
 	{
 		// types
 	public:
@@ -74,13 +74,14 @@ namespace irc
 		virtual void connection_giveup(connection& aConnection) {}
 		// from whois_requester::requester
 		virtual void whois_result(const message& aMessage);
-		// from neolib::tcp_resolver::requester
+		// from resolver_cache::requester
 		virtual void host_resolved(const std::string& aHostName, neolib::tcp_resolver::iterator aHost);
-		virtual void host_not_resolved(const std::string& aHostName, const boost::system::error_code& aError) {}
+		virtual void host_not_resolved(const std::string& aHostName, const boost::system::error_code& aError);
+		void report(const std::string& aHostName, const std::string& aResult);
 
 		// attributes
 	private:
-		neolib::tcp_resolver& iResolver;
+		resolver_cache& iResolver;
 		connection& iConnection;
 		typedef std::pair<user, buffer*> request;
 		typedef std::list<request> request_list;
@@ -0,0 +1,105 @@
+// flood_scheduler.h
+/*
+ *  Copyright (c) 2010 Leigh Johnston.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ *     * Neither the name of Leigh Johnston nor the names of any
+ *       other contributors to this software may be used to endorse or
+ *       promote products derived from this software without specific prior
+ *       written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ *  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef IRC_CLIENT_FLOOD_SCHEDULER
+#define IRC_CLIENT_FLOOD_SCHEDULER
+
+#include <deque>
+#include <neolib/timer.hpp>
+#include <neoirc/client/message.hpp>
+
+namespace irc
+{
+	class connection;
+	class buffer;
+
+	// Outgoing flood control for one connection.  The server's penalty rule (each line costs a 
+	// fixed delay plus a little more per byte, and a client may run a few lines ahead of real time) 
+	// is modelled as a penalty clock, which is a token bucket expressed in time: a line may be 
+	// written while the clock, once charged for it, stays within the burst window of now.  Lines 
+	// that must wait are queued by lane and the highest lane with anything queued goes first; 
+	// the scheduler wakes itself when the next line becomes affordable.
+	class flood_scheduler : private neolib::timer
+	{
+	public:
+		// types
+		enum lane
+		{
+			Urgent, // PING/PONG, PART and QUIT: never queued, only charged
+			Interactive, // lines the user typed
+			Reply, // automatic replies such as CTCP responses
+			Bulk, // background traffic: automatic WHO/WHOIS, auto-modes, presence polling, timers; all ISON and WHO
+			LaneCount
+		};
+		enum
+		{
+			BurstLines = 5,
+			BytesPerPenalty = 120
+		};
+
+	public:
+		// construction
+		flood_scheduler(connection& aConnection, neolib::io_task& aIoTask);
+
+	public:
+		// operations
+		static lane classify(const message& aMessage);
+		void send(const message& aMessage, lane aLane);
+		bool empty() const;
+		std::size_t queued(lane aLane) const { return iLanes[aLane].size(); }
+		void remove_messages_to(const buffer& aBuffer);
+		void settings_changed();
+		void clear();
+
+	private:
+		// implementation
+		uint64_t cost(const message& aMessage) const;
+		bool affordable(uint64_t aCost, uint64_t aNow) const;
+		void charge(uint64_t aCost, uint64_t aNow);
+		void pump();
+		void schedule();
+		// from neolib::timer
+		virtual void ready();
+
+	private:
+		// attributes
+		connection& iConnection;
+		std::deque<message> iLanes[LaneCount];
+		uint64_t iPenaltyClock_ms;
+		uint64_t iChargedDelay_ms; // flood prevention delay the penalty clock was charged at
+	};
+}
+
+#endif //IRC_CLIENT_FLOOD_SCHEDULER
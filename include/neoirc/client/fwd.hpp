@@ -54,6 +54,7 @@ namespace irc
 	class connection_script_watcher;
 	class notify_watcher;
 	class auto_mode_watcher;
+	class presence_watcher;
 	class connection_manager;
 	class dcc_connection_manager;
 	class dcc_connection;
@@ -63,6 +64,9 @@ namespace irc
 	class macros;
 	class plugins;
 	class model;
+	class background_executor;
+	class config_writer;
+	class startup_loader;
 }
 
 #endif // IRC_CLIENT_FWD
\ No newline at end of file
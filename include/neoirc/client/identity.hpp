@@ -121,6 +121,7 @@ namespace irc
 		container_type::iterator find_item(const std::string& aNickName);
 		container_type::iterator find_item(const identity& aIdentity);
 		void read(const model& aModel, std::string& aDefaultIdentity, std::function<bool()> aErrorFunction = std::function<bool()>());
+		void read(const model& aModel, const neolib::xml& aXml, std::string& aDefaultIdentity, std::function<bool()> aErrorFunction = std::function<bool()>());
 		void write(const model& aModel, const std::string& aDefaultIdentity) const;
 
 	private:
@@ -135,6 +136,7 @@ namespace irc
 	typedef identities::container_type identity_list;
 
 	void read_identity_list(model& aModel, std::string& aDefaultIdentity, std::function<bool()> aErrorFunction = std::function<bool()>());
+	void read_identity_list(model& aModel, const neolib::xml& aXml, std::string& aDefaultIdentity, std::function<bool()> aErrorFunction = std::function<bool()>());
 	void write_identity_list(const model& aModel, const std::string& aDefaultIdentity);
 }
 
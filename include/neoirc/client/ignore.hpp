@@ -36,11 +36,18 @@
 #ifndef IRC_CLIENT_IGNORE
 #define IRC_CLIENT_IGNORE
 
+#include <cstdint>
+#include <list>
+#include <map>
+#include <unordered_map>
 #include <neoirc/client/server.hpp>
 #include <neoirc/client/user.hpp>
+#include <neoirc/client/mask.hpp>
 
 namespace irc
 {
+	class connection;
+
 	class ignore_entry
 	{
 	public:
@@ -71,21 +78,88 @@ namespace irc
 		enum notify_type { NotifyAdded, NotifyUpdated, NotifyRemoved };
 	};
 
+	// Recent ignore decisions for one connection keyed by message prefix; least recently used 
+	// decisions are dropped once full and the whole cache is dropped when the list changes.
+	class ignore_cache
+	{
+		friend class ignore_list;
+	public:
+		// types
+		enum { DefaultCapacity = 256 };
+	private:
+		typedef std::list<std::pair<std::string, bool> > decisions;
+		typedef std::unordered_map<std::string, decisions::iterator> decision_lookup;
+
+	public:
+		// construction
+		ignore_cache(std::size_t aCapacity = DefaultCapacity) : iCapacity(aCapacity), iGeneration(0), iCasemapping(casemapping::rfc1459) {}
+
+	public:
+		// operations
+		void clear() { iDecisions.clear(); iLookup.clear(); }
+		std::size_t size() const { return iDecisions.size(); }
+
+	private:
+		// implementation
+		const bool* find(const std::string& aPrefix);
+		void insert(const std::string& aPrefix, bool aIgnored);
+
+	private:
+		// attributes
+		std::size_t iCapacity;
+		uint64_t iGeneration;
+		casemapping::type iCasemapping;
+		server_key iServer;
+		decisions iDecisions;
+		decision_lookup iLookup;
+	};
+
 	class ignore_list : public neolib::observable<ignore_list_observer>
 	{
 	public:
 		// types
 		typedef std::list<ignore_entry> container_type;
+	private:
+		struct compiled_entry
+		{
+			container_type::const_iterator iEntry;
+			mask iNickName;
+			mask iUserName;
+			mask iHostName;
+		};
+		typedef std::vector<std::size_t> entry_indices;
+		typedef std::unordered_map<std::string, entry_indices> entry_buckets;
+		struct suffix_node
+		{
+			std::map<char, std::size_t> iChildren;
+			entry_indices iEntries;
+		};
+		struct index
+		{
+			index() : iGeneration(static_cast<uint64_t>(-1)) {}
+			uint64_t iGeneration;
+			std::vector<compiled_entry> iEntries;
+			entry_buckets iByNickName; // literal nick name masks
+			entry_indices iNickNameGlobs; // any other nick name masks
+			entry_buckets iByHostName; // user@host masks with a literal host name
+			std::vector<suffix_node> iHostNameSuffixes; // trie of reversed "*suffix" host name masks
+			entry_indices iHostNameGlobs; // any other user@host masks
+			entry_indices iEveryone; // masks that match every user
+		};
+		enum { CasemappingCount = casemapping::strict_rfc1459 + 1 };
 
 	public:
 		// construction
-		ignore_list() : iLoading(false) {}
+		ignore_list() : iLoading(false), iGeneration(0) {}
 
 	public:
 		// operations
 		const container_type& entries() const { return iEntries; }
-		container_type& entries() { return iEntries; }
+		container_type& entries() { return iEntries; } // call invalidate() after changing entries directly
+		uint64_t generation() const { return iGeneration; }
+		void invalidate() { ++iGeneration; }
 		bool ignored(casemapping::type aCasemapping, const server_key& aServer, const user& aUser) const;
+		bool ignored(const connection& aConnection, const server_key& aServer, const user& aUser) const;
 		bool add(const server_key& aServer, const user& aUser);
 		bool add(const ignore_entry& aEntry);
 		void update(ignore_entry& aExistingEntry, const ignore_entry& aNewEntry);
@@ -100,6 +174,8 @@ namespace irc
 
 	private:
 		// implementation
+		const index& compiled(casemapping::type aCasemapping) const;
+		static bool matches(const compiled_entry& aEntry, const server_key& aServer, const std::string& aNickName, const std::string& aUserName, const std::string& aHostName);
 		// from neolib::observable<ignore_list_observer>
 		virtual void notify_observer(ignore_list_observer& aObserver, ignore_list_observer::notify_type aType, const void* aParameter = 0, const void* aParameter2 = 0);
 
@@ -107,9 +183,12 @@ namespace irc
 		// attributes
 		container_type iEntries;
 		bool iLoading;
+		uint64_t iGeneration;
+		mutable index iIndex[CasemappingCount];
 	};
 
 	void read_ignore_list(model& aModel, std::function<bool()> aErrorFunction = std::function<bool()>());
+	void read_ignore_list(model& aModel, const neolib::xml& aXml, std::function<bool()> aErrorFunction = std::function<bool()>());
 	void write_ignore_list(const model& aModel);
 }
 
@@ -0,0 +1,149 @@
+// io_shards.h
+/*
+ *  Copyright (c) 2010 Leigh Johnston.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ *     * Neither the name of Leigh Johnston nor the names of any
+ *       other contributors to this software may be used to endorse or
+ *       promote products derived from this software without specific prior
+ *       written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ *  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef IRC_CLIENT_IO_SHARDS
+#define IRC_CLIENT_IO_SHARDS
+
+#include <memory>
+#include <vector>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <neolib/timer.hpp>
+#include <neolib/io_task.hpp>
+#include <neolib/io_thread.hpp>
+
+namespace irc
+{
+	class io_shards;
+
+	class io_shards_drain
+	{
+		friend class io_shards;
+	private:
+		virtual void drain() = 0; // owner thread; on every delivery pass, after the delivered work
+	};
+
+	// A pool of network threads ("shards"), each with its own io_task, across which the server streams 
+	// of new connections are spread (see shard_stream).  A shard does socket I/O, TLS, line framing and 
+	// message parsing; the owner thread keeps everything that touches client state (buffers, ignore 
+	// and notify lists, auto-modes, logging, GUI notifications) and is handed the shard's results 
+	// through deliver() and io_shards_drain.  Moving that state off the owner thread (snapshots of the 
+	// ignore and notify lists, a logging queue) is separate, later work.
+	class io_shards
+	{
+	public:
+		// types
+		class shard
+		{
+			friend class io_shards;
+		private:
+			// types
+			class worker_thread : public neolib::io_thread
+			{
+			public:
+				worker_thread(const std::string& aName) : neolib::io_thread(aName, true) {}
+			public:
+				virtual void task() {}
+			};
+
+		public:
+			// construction
+			shard(const std::string& aName);
+			~shard();
+
+		public:
+			// operations
+			neolib::io_task& io_task() { return *iIoTask; }
+			void post(std::function<void()> aWork); // aWork is run, and destroyed, on the shard's thread
+			std::size_t load() const { return iLoad; }
+
+		private:
+			// implementation
+			void run(const std::string& aName);
+			bool run_posted();
+
+		private:
+			// attributes
+			std::mutex iMutex;
+			std::condition_variable iStarted;
+			std::unique_ptr<worker_thread> iThread;
+			std::unique_ptr<neolib::io_task> iIoTask;
+			std::vector<std::function<void()>> iPosted;
+			std::atomic<bool> iStopping;
+			std::size_t iLoad; // owner thread only
+			std::thread iWorker;
+		};
+		typedef std::shared_ptr<shard> shard_pointer;
+
+	private:
+		// types
+		enum { DeliveryInterval_ms = 5 }; // the owner thread polls for deliveries and drains at this interval while a connection is on a shard
+
+	public:
+		// construction
+		io_shards(neolib::io_task& aOwnerTask);
+		~io_shards();
+
+	public:
+		// operations
+		std::size_t worker_count() const { return iShards.size(); }
+		void set_worker_count(std::size_t aWorkerCount); // applies to connections created afterwards
+		shard_pointer assign(); // least loaded shard; null if sockets stay on the owner thread
+		void release(shard& aShard);
+		void deliver(std::function<void()> aWork); // called from a shard; aWork is run on the owner thread
+		void add_drain(io_shards_drain& aDrain); // owner thread; for lock-free hand-overs that need no wake-up
+		void remove_drain(io_shards_drain& aDrain);
+
+	private:
+		// implementation
+		void process_delivered();
+		bool delivering() const;
+
+	private:
+		// attributes
+		std::vector<shard_pointer> iShards;
+		std::size_t iNextShardId;
+		std::size_t iAssigned; // owner thread only
+		mutable std::mutex iMutex;
+		std::vector<std::function<void()>> iDelivered;
+		std::vector<io_shards_drain*> iDrains; // owner thread only
+		neolib::callback_timer iDeliveryTimer;
+	};
+}
+
+#endif //IRC_CLIENT_IO_SHARDS
@@ -0,0 +1,142 @@
+// join_scheduler.h
+/*
+ *  Copyright (c) 2010 Leigh Johnston.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ *     * Neither the name of Leigh Johnston nor the names of any
+ *       other contributors to this software may be used to endorse or
+ *       promote products derived from this software without specific prior
+ *       written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ *  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef IRC_CLIENT_JOIN_SCHEDULER
+#define IRC_CLIENT_JOIN_SCHEDULER
+
+#include <deque>
+#include <map>
+#include <neolib/observable.hpp>
+#include <neolib/timer.hpp>
+#include <neoirc/client/connection.hpp>
+#include <neoirc/client/message.hpp>
+
+namespace irc
+{
+	class join_scheduler;
+
+	class join_scheduler_observer
+	{
+		friend class join_scheduler;
+	private:
+		virtual void channel_joined(connection& aConnection, const std::string& aChannel, uint64_t aLatency_ms) = 0;
+	public:
+		enum notify_type { NotifyChannelJoined };
+	};
+
+	// Joins many channels (auto-join, rejoin after reconnect) with as few JOIN lines as the line 
+	// length and TARGMAX allow, keyed channels first as keys are matched by position.  Only one 
+	// batch is outstanding at a time: the next is sent once the server has answered every channel 
+	// in the last one, which paces joins to whatever the server's join throttle allows.  A JOIN 
+	// echo or any error numeric naming the channel is an answer; ERR_LINKCHANNEL moves the entry to 
+	// the channel the server forwards to.  Channels time out on their own: once the server has 
+	// answered part of a batch, the rest only hold up the next batch for StragglerTimeout_ms, and 
+	// are forgotten after ChannelTimeout_ms.  ERR_TOOMANYTARGETS halves the batch size and retries 
+	// the channel.
+	class join_scheduler : public neolib::observable<join_scheduler_observer>, private connection_observer, private neolib::timer
+	{
+	public:
+		// types
+		enum
+		{
+			ChannelTimeout_ms = 15 * 1000,
+			StragglerTimeout_ms = 3 * 1000
+		};
+
+	public:
+		// construction
+		join_scheduler(connection& aConnection, neolib::io_task& aIoTask);
+		virtual ~join_scheduler();
+
+	public:
+		// operations
+		void join(const std::string& aChannel, const std::string& aKey = std::string());
+		bool pending(const std::string& aChannel) const;
+		bool scheduled(const std::string& aChannel) const; // pending, or joined by the message being received
+		std::size_t queued() const { return iQueue.size(); }
+		bool busy() const { return !iQueue.empty() || !iInFlight.empty(); }
+		void clear();
+
+	private:
+		// types
+		struct entry
+		{
+			std::string iChannel;
+			std::string iKey;
+		};
+		typedef std::deque<entry> entry_queue;
+		struct in_flight
+		{
+			entry iEntry;
+			uint64_t iSent_ms;
+			bool iBlocking; // holds up the next batch
+		};
+		typedef std::map<std::string, in_flight> in_flight_list; // keyed by folded channel
+
+	private:
+		// implementation
+		void send_batch();
+		void answered(const std::string& aChannel, bool aJoined);
+		void forwarded(const std::string& aChannel, const std::string& aTarget);
+		bool blocked() const;
+		void schedule();
+		// from neolib::observable<join_scheduler_observer>
+		virtual void notify_observer(join_scheduler_observer& aObserver, join_scheduler_observer::notify_type aType, const void* aParameter = 0, const void* aParameter2 = 0);
+		// from connection_observer
+		virtual void connection_connecting(connection& aConnection) {}
+		virtual void connection_registered(connection& aConnection) {}
+		virtual void buffer_added(buffer& aBuffer) {}
+		virtual void buffer_removed(buffer& aBuffer) {}
+		virtual void incoming_message(connection& aConnection, const message& aMessage);
+		virtual void outgoing_message(connection& aConnection, const message& aMessage) {}
+		virtual void connection_quitting(connection& aConnection) {}
+		virtual void connection_disconnected(connection& aConnection) { clear(); }
+		virtual void connection_giveup(connection& aConnection) {}
+		// from neolib::timer
+		virtual void ready();
+
+	private:
+		// attributes
+		connection& iConnection;
+		entry_queue iQueue;
+		in_flight_list iInFlight;
+		uint64_t iLastAnswer_ms;
+		bool iBatchAnswered;
+		std::string iJustJoined;
+		std::size_t iMaxBatch;
+	};
+}
+
+#endif //IRC_CLIENT_JOIN_SCHEDULER
@@ -0,0 +1,122 @@
+// log_index.h
+/*
+ *  Copyright (c) 2010 Leigh Johnston.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ *     * Neither the name of Leigh Johnston nor the names of any
+ *       other contributors to this software may be used to endorse or
+ *       promote products derived from this software without specific prior
+ *       written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ *  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef IRC_CLIENT_LOG_INDEX
+#define IRC_CLIENT_LOG_INDEX
+
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <map>
+#include <limits>
+#include <neoirc/common/string.hpp>
+
+namespace irc
+{
+	struct log_query
+	{
+		log_query() : iFrom(0), iTo(std::numeric_limits<time_t>::max()), iMaxResults(1000) {}
+		std::vector<std::string> iTerms; // all terms must match
+		std::string iNick; // empty for any
+		time_t iFrom;
+		time_t iTo;
+		std::size_t iMaxResults; // most recent results are kept
+	};
+
+	struct log_hit
+	{
+		std::string iFileName;
+		uint64_t iOffset; // offset of the entry in the log file
+		time_t iTime;
+		std::string iNick;
+	};
+	typedef std::vector<log_hit> log_hits;
+
+	// Inverted index over a single log file kept in a sidecar file (log file name + ".idx").
+	//
+	// New entries go into an in-memory segment which is appended to the sidecar as an
+	// immutable segment once it is large enough (or on flush()).  A segment consists of:
+	//   documents:  uint64 offset, uint64 time, uint8 nick length, nick
+	//   postings:   uint32 document number[]
+	//   dictionary: uint8 term length, term, uint32 posting count, uint64 postings offset (sorted by term)
+	//   trailer:    uint64 segment size, uint64 dictionary offset, uint32 document count, uint32 term count,
+	//               uint64 first time, uint64 last time, "NEOIRCFT"
+	// Segments are found by walking the trailers backwards from the end of the file.
+	class log_index
+	{
+	public:
+		// types
+		enum { SegmentSize = 4096 };
+		struct document
+		{
+			uint64_t iOffset;
+			uint64_t iTime;
+			std::string iNick; // folded
+		};
+		typedef std::vector<document> documents;
+		typedef std::map<std::string, std::vector<uint32_t> > postings;
+
+	public:
+		// construction
+		log_index(const std::string& aLogFileName, casemapping::type aCasemapping = casemapping::rfc1459);
+		~log_index();
+
+	public:
+		// operations
+		const std::string& log_file_name() const { return iLogFileName; }
+		std::string index_file_name() const { return iLogFileName + ".idx"; }
+		void add(uint64_t aOffset, time_t aTime, const std::string& aNick, const std::string& aContent);
+		void flush();
+		void search(const log_query& aQuery, log_hits& aHits) const;
+		static void tokenise(const std::string& aText, std::vector<std::string>& aTerms);
+		static bool stale(const std::string& aLogFileName); // no index, or the log was written after it
+		static bool build(const std::string& aLogFileName, casemapping::type aCasemapping = casemapping::rfc1459);
+		static std::size_t build_directory(const std::string& aDirectory, casemapping::type aCasemapping = casemapping::rfc1459); // stale indices only
+
+	private:
+		// implementation
+		void search_segment(const documents& aDocuments, const postings& aPostings, const std::vector<std::string>& aTerms, const log_query& aQuery, log_hits& aHits) const;
+
+	private:
+		// attributes
+		std::string iLogFileName;
+		casemapping::type iCasemapping;
+		documents iDocuments;
+		postings iPostings;
+	};
+}
+
+#endif //IRC_CLIENT_LOG_INDEX
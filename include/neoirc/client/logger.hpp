@@ -36,6 +36,8 @@
 #ifndef IRC_CLIENT_LOGGER
 #define IRC_CLIENT_LOGGER
 
+#include <map>
+#include <set>
 #include <neolib/variant.hpp>
 #include <neolib/timer.hpp>
 #include <neoirc/client/connection_manager.hpp>
@@ -43,6 +45,9 @@
 #include <neoirc/client/dcc_connection_manager.hpp>
 #include <neoirc/client/dcc_chat_connection.hpp>
 #include <neoirc/client/buffer.hpp>
+#include <neoirc/client/scrollback_file.hpp>
+#include <neoirc/client/log_index.hpp>
+#include <neoirc/client/background_executor.hpp>
 
 namespace irc
 {
@@ -58,7 +63,7 @@ namespace irc
 
 	private:
 		// types
-		class scrollbacker : public neolib::thread
+		class scrollbacker : public background_job
 		{
 		public:
 			typedef std::deque<message> buffer_messages;
@@ -67,9 +72,8 @@ namespace irc
 			typedef neolib::variant<buffer_messages, dcc_messages> messages_t;
 		public:
 			// construction
-			scrollbacker(logger& aParent, irc::buffer& aBuffer) : iParent(aParent), iBuffer(&aBuffer), iNewMessages(buffer_messages()), iBufferSize(aParent.iModel.buffer_size()) {}
-			scrollbacker(logger& aParent, dcc_buffer& aBuffer) : iParent(aParent), iBuffer(&aBuffer), iNewMessages(dcc_messages()), iBufferSize(aParent.iModel.buffer_size()) {}
-			~scrollbacker() { abort(); }
+			scrollbacker(logger& aParent, irc::buffer& aBuffer, time_t aFrom = 0) : iParent(aParent), iBuffer(&aBuffer), iNewMessages(buffer_messages()), iBufferSize(aParent.iModel.buffer_size()), iFrom(aFrom) {}
+			scrollbacker(logger& aParent, dcc_buffer& aBuffer) : iParent(aParent), iBuffer(&aBuffer), iNewMessages(dcc_messages()), iBufferSize(aParent.iModel.buffer_size()), iFrom(0) {}
 		public:
 			// operations
 			bool is(buffer& aBuffer) const;
@@ -77,10 +81,10 @@ namespace irc
 			buffer_t& buffer() { return iBuffer; }
 			messages_t& messages() { return iMessages; }
 			messages_t& new_messages() { return iNewMessages; }
+			time_t from() const { return iFrom; } // 0 for the most recent lines
 		private:
 			// implementation
-			virtual void task();
-			virtual bool soft_abort() const { return true; }
+			virtual void run();
 		private:
 			// attributes
 			logger& iParent;
@@ -88,10 +92,25 @@ namespace irc
 			messages_t iMessages;
 			messages_t iNewMessages;
 			std::size_t iBufferSize;
+			time_t iFrom;
 		};
 		typedef std::shared_ptr<scrollbacker> scrollbacker_pointer;
 		friend class scrollbacker;
 		typedef std::vector<scrollbacker_pointer> scrollbackers;
+		typedef std::shared_ptr<scrollback_file> scrollback_file_pointer;
+		typedef std::map<std::string, scrollback_file_pointer> scrollback_files;
+		typedef std::shared_ptr<log_index> log_index_pointer;
+		typedef std::map<std::string, log_index_pointer> log_indices;
+		typedef std::map<std::string, uint64_t> log_sizes;
+		typedef std::map<std::string, std::size_t> archive_counters;
+		typedef std::set<std::string> archive_directories;
+		struct search_entry
+		{
+			time_t iTime;
+			std::string iNick;
+			std::string iContent;
+			casemapping::type iCasemapping;
+		};
 
 	public:
 		// construction
@@ -120,6 +139,13 @@ namespace irc
 		bool& archive() { return iArchive; }
 		std::size_t archive_size() const { return iArchiveSize; }
 		std::size_t& archive_size() { return iArchiveSize; }
+		bool compress_archives() const { return iCompressArchives; }
+		bool& compress_archives() { return iCompressArchives; }
+		bool search_index() const { return iSearchIndex; }
+		void set_search_index(bool aSearchIndex); // switching it on rebuilds stale indices under the log directory
+		bool scrollback_from(buffer& aBuffer, time_t aTime); // replaces the buffer's messages with its scrollback from aTime on
+		void search(const buffer& aBuffer, const log_query& aQuery, log_hits& aHits);
+		void search(const std::string& aLogFileName, const log_query& aQuery, log_hits& aHits, casemapping::type aCasemapping = casemapping::rfc1459);
 		void create_directories() const;
 		enum filename_type_e { Normal, Scrollback };
 		std::string filename(const buffer& aBuffer, filename_type_e aType = Normal);
@@ -128,11 +154,20 @@ namespace irc
 	private:
 		// implementation
 		static void get_timestamp(std::string& aTimeStamp, bool aContinuation = false);
-		void new_entry(buffer& aBuffer, const std::string& aText);
+		void new_entry(buffer& aBuffer, const std::string& aText, const search_entry* aSearchEntry = 0);
 		void new_entry(dcc_buffer& aBuffer, const std::string& aText);
-		void new_entry(const std::string& aFileName, const std::string& aText, filename_type_e aType = Normal);
+		void new_entry(const std::string& aFileName, const std::string& aText, filename_type_e aType = Normal, const search_entry* aSearchEntry = 0);
+		void new_scrollback_entry(const std::string& aFileName, time_t aTime, const std::string& aLine);
+		void close_scrollback_file(const std::string& aFileName);
+		log_index& search_index_for(const std::string& aFileName, casemapping::type aCasemapping);
+		void close_search_index(const std::string& aFileName);
+		void archive(const std::string& aFileName);
+		std::size_t& archive_counter(const std::string& aFileName);
+		static std::string archive_file_name(const std::string& aFileName, std::size_t aNumber);
+		static bool compress_archive(const std::string& aArchiveFileName);
 		scrollbackers::iterator scrollbacker_for_buffer(buffer& aBuffer);
 		scrollbackers::iterator scrollbacker_for_buffer(dcc_buffer& aBuffer);
+		void remove_scrollbacker(scrollbackers::iterator aScrollbacker);
 		// from connection_manager_observer
 		void connection_added(connection& aConnection) override;
 		void connection_removed(connection& aConnection) override;
@@ -141,7 +176,7 @@ namespace irc
 		void query_nickname(connection& aConnection) override {}
 		void disconnect_timeout_changed() override {}
 		void retry_network_delay_changed() override {}
-		void buffer_activated(buffer& aActiveBuffer) override {}
+		void buffer_activated(buffer& aActiveBuffer) override;
 		void buffer_deactivated(buffer& aDeactivatedBuffer) override {}
 		// from connection_observer
 		void connection_connecting(connection& aConnection) override {}
@@ -203,7 +238,15 @@ namespace irc
 		std::size_t iScrollbackSize; // KB
 		bool iArchive;
 		std::size_t iArchiveSize; // KB
+		bool iCompressArchives;
+		bool iSearchIndex;
 		scrollbackers iScrollbackers;
+		scrollback_files iScrollbackFiles;
+		log_indices iSearchIndices;
+		log_sizes iLogSizes;
+		archive_counters iArchiveCounters;
+		log_sizes iArchiveRetrySizes; // after a failed archive, the size at which to try again
+		archive_directories iArchiveDirectories;
 		neolib::callback_timer iUpdateTimer;
 	};
 }
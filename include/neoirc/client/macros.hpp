@@ -39,6 +39,7 @@
 #include <neolib/neolib.hpp>
 #include <neolib/string_utils.hpp>
 #include <neolib/mutable_set.hpp>
+#include <neolib/xml.hpp>
 
 namespace irc
 {
@@ -140,6 +141,7 @@ namespace irc
 	};
 
 	void read_macros(model& aModel, std::function<bool()> aErrorFunction = std::function<bool()>());
+	void read_macros(model& aModel, const neolib::xml& aXml, std::function<bool()> aErrorFunction = std::function<bool()>());
 	void write_macros(const model& aModel);
 }
 
@@ -0,0 +1,81 @@
+// mask.h
+/*
+ *  Copyright (c) 2010 Leigh Johnston.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ *     * Neither the name of Leigh Johnston nor the names of any
+ *       other contributors to this software may be used to endorse or
+ *       promote products derived from this software without specific prior
+ *       written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ *  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef IRC_CLIENT_MASK
+#define IRC_CLIENT_MASK
+
+#include <neolib/neolib.hpp>
+#include <string>
+#include <neoirc/common/string.hpp>
+
+namespace irc
+{
+	// A wildcard pattern ('*' and '?') compiled for one casemapping.  The pattern is case folded 
+	// once and classified so that the common shapes (anything, a literal, "*suffix", "prefix*") 
+	// never reach the general matcher; the literal head and tail of a general pattern reject most 
+	// candidates before it is run.  Text passed to matches() must already be folded with fold_case().
+	class mask
+	{
+	public:
+		// types
+		enum kind_e { Empty, Any, Literal, Prefix, Suffix, Glob };
+
+	public:
+		// construction
+		mask() : iKind(Empty), iMinimumLength(0) {}
+		mask(casemapping::type aCasemapping, const std::string& aPattern);
+
+	public:
+		// operations
+		kind_e kind() const { return iKind; }
+		bool any() const { return iKind == Empty || iKind == Any; } // empty or "*"
+		const std::string& pattern() const { return iPattern; }
+		const std::string& literal() const { return iLiteral; } // the whole literal, the prefix or the suffix depending on kind
+		bool matches(const std::string& aFoldedText) const;
+		static bool equivalent(casemapping::type aCasemapping, const std::string& aLeft, const std::string& aRight); // equal once folded
+		static bool wildcard_match(const char* aText, std::size_t aTextLength, const char* aPattern, std::size_t aPatternLength);
+
+	private:
+		// attributes
+		kind_e iKind;
+		std::string iPattern;
+		std::string iLiteral;
+		std::string iHead;
+		std::string iTail;
+		std::size_t iMinimumLength;
+	};
+}
+
+#endif //IRC_CLIENT_MASK
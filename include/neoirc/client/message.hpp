@@ -79,6 +79,11 @@ namespace irc
 			LIST,
 			INVITE,
 			AWAY,
+			ISON,
+			MONITOR,
+			CAP,
+			BATCH,
+			TAGMSG,
 			RPL_UNKNOWN = 1000,
 			RPL_WELCOME, RPL_YOURHOST, RPL_CREATED, RPL_MYINFO, RPL_BOUNCE, RPL_ISUPPORT = RPL_BOUNCE,
 			RPL_USERHOST, RPL_ISON, RPL_AWAY, RPL_UNAWAY, RPL_NOWAWAY, RPL_WHOISUSER,
@@ -121,6 +126,9 @@ namespace irc
 			// NON-STANDARD-STANDARD
 			RPL_TOPICAUTHOR,
 			RPL_WHOISEXTRA,
+			RPL_WHOSPCRPL,
+			RPL_MONONLINE, RPL_MONOFFLINE, RPL_MONLIST, RPL_ENDOFMONLIST, ERR_MONLISTFULL,
+			ERR_LINKCHANNEL,
 		};
 		enum 
 		{
@@ -139,6 +147,7 @@ namespace irc
 		message(connection_manager& aConnectionManager, direction_e aDirection, bool aFromLog = false);
 		message(connection& aConnection, direction_e aDirection, bool aFromLog = false);
 		message(buffer& aBuffer, direction_e aDirection, bool aFromLog = false);
+		message(direction_e aDirection); // no id; for parsing off the owner thread, set_id() before use
 
 		// operations
 	public:
@@ -148,10 +157,14 @@ namespace irc
 		bool from_log() const { return iFromLog; }
 		bool buffer_required() const { return iBufferRequired; }
 		void set_buffer_required(bool aBufferRequired) { iBufferRequired = aBufferRequired; }
+		bool background() const { return iBackground; }
+		void set_background(bool aBackground) { iBackground = aBackground; }
 		time_t time() const { return iTime; }
+		void parse_tags(const std::string& aTags);
 		void parse_command(const std::string& aMessage);
 		void parse_parameters(const std::string& aMessage, bool aHasTarget = false, bool aFromServer = false);
 		bool parse_log(const std::string& aLogEntry);
+		void parse_incoming(const std::string& aLine); // a line from the server, CRLF stripped; safe on any thread
 		const std::string& content() const;
 		std::size_t content_param() const;
 		std::string to_string(const message_strings& aMessageStrings, bool aAddPrefix = false, bool aAddTarget = false) const;
@@ -186,6 +199,7 @@ namespace irc
 		model::id iId;
 		bool iFromLog;
 		bool iBufferRequired;
+		bool iBackground; // automatic traffic, sent behind lines the user typed
 		time_t iTime;
 		direction_e iDirection;
 		std::string iOrigin;
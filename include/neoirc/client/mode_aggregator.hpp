@@ -0,0 +1,106 @@
+// mode_aggregator.h
+/*
+ *  Copyright (c) 2010 Leigh Johnston.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ *     * Neither the name of Leigh Johnston nor the names of any
+ *       other contributors to this software may be used to endorse or
+ *       promote products derived from this software without specific prior
+ *       written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ *  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef IRC_CLIENT_MODE_AGGREGATOR
+#define IRC_CLIENT_MODE_AGGREGATOR
+
+#include <map>
+#include <vector>
+#include <neolib/timer.hpp>
+#include <neoirc/client/message.hpp>
+
+namespace irc
+{
+	class connection;
+
+	// Collects outgoing single user mode changes (MODE #channel +o nick) for a short window and 
+	// sends them as few lines as MODES= and the line length allow, e.g. MODE #channel +ooo a b c.  
+	// Changes the user already has (or lacks) are dropped and a later change for the same user 
+	// and mode replaces an earlier one.  Only prefix modes are collected: other channel modes and 
+	// any other line to the same channel flush the channel first so ordering is kept.
+	class mode_aggregator : private neolib::timer
+	{
+	public:
+		// types
+		enum
+		{
+			Window_ms = 150
+		};
+
+	public:
+		// construction
+		mode_aggregator(connection& aConnection, neolib::io_task& aIoTask);
+
+	public:
+		// operations
+		bool add(const message& aMessage);
+		void flush();
+		void flush(const std::string& aChannel);
+		void discard(const std::string& aChannel);
+		void clear();
+
+	private:
+		// types
+		struct change
+		{
+			bool iAdd;
+			char iMode;
+			std::string iNickName;
+		};
+		struct pending
+		{
+			pending() : iBackground(true) {}
+			std::string iChannel;
+			std::vector<change> iChanges;
+			bool iBackground; // all contributing messages were automatic
+		};
+		typedef std::map<std::string, pending> pending_list; // folded channel name
+
+	private:
+		// implementation
+		bool redundant(const std::string& aChannel, const change& aChange) const;
+		void send(pending_list::iterator aPending);
+		// from neolib::timer
+		virtual void ready();
+
+	private:
+		// attributes
+		connection& iConnection;
+		pending_list iPending;
+		bool iSending;
+	};
+}
+
+#endif //IRC_CLIENT_MODE_AGGREGATOR
@@ -86,6 +86,13 @@ namespace irc
 		neolib::thread& owner_thread() const { return iOwnerThread; }
 		neolib::io_task& io_task() const { return iIoTask; }
 		neolib::random& random();
+		irc::background_executor& background_executor() const;
+		void save_config(const std::string& aFileName, const std::string& aContents) const;
+		uint32_t config_save_window() const;
+		void set_config_save_window(uint32_t aWindow_ms);
+		void flush_config();
+		irc::startup_loader& startup_loader();
+		const irc::startup_loader& startup_loader() const;
 		irc::identities& identities();
 		const irc::identities& identities() const;
 		irc::identity_list& identity_list();
@@ -109,6 +116,7 @@ namespace irc
 		irc::auto_join_watcher& auto_join_watcher();
 		irc::connection_script_watcher& connection_script_watcher();
 		irc::notify_watcher& notify_watcher();
+		irc::presence_watcher& presence_watcher();
 		irc::auto_mode& auto_mode_list();
 		const irc::auto_mode& auto_mode_list() const;
 		irc::connection_manager& connection_manager();
@@ -36,10 +36,13 @@
 #ifndef IRC_CLIENT_NOTIFY
 #define IRC_CLIENT_NOTIFY
 
+#include <cstdint>
+#include <unordered_map>
 #include <neoirc/client/server.hpp>
 #include <neoirc/client/user.hpp>
 #include <neoirc/client/message.hpp>
 #include <neoirc/client/connection.hpp>
+#include <neoirc/client/mask.hpp>
 
 namespace irc
 {
@@ -104,17 +107,43 @@ namespace irc
 	public:
 		// types
 		typedef std::list<notify_entry_ptr> container_type;
+		typedef std::vector<notify_entry_ptr> entry_list;
+	private:
+		struct compiled_entry
+		{
+			notify_entry_ptr iEntry;
+			mask iNickName;
+			mask iUserName;
+			mask iHostName;
+			std::string iChannel;
+		};
+		typedef std::vector<std::size_t> entry_indices;
+		typedef std::unordered_map<std::string, entry_indices> entry_buckets;
+		struct index
+		{
+			index() : iGeneration(static_cast<uint64_t>(-1)), iEvents(0) {}
+			uint64_t iGeneration;
+			uint32_t iEvents; // every event any entry is interested in
+			std::vector<compiled_entry> iEntries;
+			entry_buckets iByNickName; // network and literal nick name
+			entry_buckets iByHostName; // literal host name of entries that can also match by user@host
+			entry_indices iWildcards; // everything else
+		};
+		enum { CasemappingCount = casemapping::strict_rfc1459 + 1 };
 
 	public:
 		// construction
-		notify(model& aModel) : iModel(aModel), iLoading(false) {}
+		notify(model& aModel) : iModel(aModel), iLoading(false), iGeneration(0) {}
 
 	public:
 		// operations
 		const container_type& entries() const { return iEntries; }
-		container_type& entries() { return iEntries; }
+		container_type& entries() { return iEntries; } // call invalidate() after changing entries directly
+		void invalidate() { ++iGeneration; }
 		bool notified(const connection& aConnection, const server_key& aServer, const user& aUser, const std::string& aChannel) const;
 		bool notified(const connection& aConnection, const server_key& aServer, const user& aUser, const std::string& aChannel, message::command_e aMessage) const;
+		std::size_t matching(const connection& aConnection, const server_key& aServer, const user& aUser, const std::string& aChannel, message::command_e aCommand, entry_list& aEntries) const; // entries, in list order, wanting to hear about this event
+		static uint32_t events(message::command_e aCommand);
 		bool add(const notify_entry& aEntry);
 		void update(notify_entry& aExistingEntry, const notify_entry& aNewEntry);
 		void update_user(const connection& aConnection, const server_key& aServer, const user& aOldUser, const user& aNewUser);
@@ -129,6 +158,9 @@ namespace irc
 
 	private:
 		// implementation
+		const index& compiled(casemapping::type aCasemapping) const;
+		static std::string bucket_key(const std::string& aNetwork, const std::string& aNickName) { return aNetwork + '\0' + aNickName; }
+		static bool matches(const connection& aConnection, const compiled_entry& aEntry, const server_key& aServer, const std::string& aNickName, const std::string& aUserName, const std::string& aHostName, const std::string& aChannel, const std::string& aFoldedChannel);
 		// from neolib::observable<notify_list_observer>
 		virtual void notify_observer(notify_list_observer& aObserver, notify_list_observer::notify_type aType, const void* aParameter = 0, const void* aParameter2 = 0);
 
@@ -137,9 +169,12 @@ namespace irc
 		model& iModel;
 		container_type iEntries;
 		bool iLoading;
+		uint64_t iGeneration;
+		mutable index iIndex[CasemappingCount];
 	};
 
 	void read_notify_list(model& aModel, std::function<bool()> aErrorFunction = std::function<bool()>());
+	void read_notify_list(model& aModel, const neolib::xml& aXml, std::function<bool()> aErrorFunction = std::function<bool()>());
 	void write_notify_list(const model& aModel);
 }
 
@@ -0,0 +1,168 @@
+// presence_watcher.h
+/*
+ *  Copyright (c) 2010 Leigh Johnston.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ *     * Neither the name of Leigh Johnston nor the names of any
+ *       other contributors to this software may be used to endorse or
+ *       promote products derived from this software without specific prior
+ *       written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ *  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef IRC_CLIENT_PRESENCE_WATCHER
+#define IRC_CLIENT_PRESENCE_WATCHER
+
+#include <deque>
+#include <map>
+#include <set>
+#include <neolib/timer.hpp>
+#include <neoirc/client/connection_manager.hpp>
+#include <neoirc/client/connection.hpp>
+#include <neoirc/client/contacts.hpp>
+#include <neoirc/client/notify.hpp>
+#include <neoirc/client/message.hpp>
+
+namespace irc
+{
+	class presence_watcher_observer
+	{
+		friend class presence_watcher;
+	private:
+		virtual void user_online(connection& aConnection, const user& aUser) = 0;
+		virtual void user_offline(connection& aConnection, const user& aUser) = 0;
+	public:
+		enum notify_type { NotifyOnline, NotifyOffline };
+	};
+
+	// Tracks whether the contacts and notify list nick names of each connection's network are online.  
+	// The nick names are subscribed with MONITOR when the server advertises it; whatever MONITOR 
+	// cannot hold is polled with ISON.  Either way requests are packed as many nick names to a line 
+	// as fit in a message.
+	class presence_watcher : public neolib::observable<presence_watcher_observer>, private connection_manager_observer, private connection_observer, private contacts_observer, private notify_list_observer
+	{
+	public:
+		// types
+		enum { IsonPollInterval = 60 * 1000 };
+
+	public:
+		// construction
+		presence_watcher(connection_manager& aConnectionManager, contacts& aContacts);
+		~presence_watcher();
+
+	public:
+		// operations
+		bool is_online(const connection& aConnection, const std::string& aNickName) const;
+		bool is_watched(const connection& aConnection, const std::string& aNickName) const;
+
+	private:
+		// types
+		typedef std::map<std::string, std::string> nick_names; // folded nick name to nick name
+		typedef std::vector<std::string> nick_name_list;
+		struct ison_batch
+		{
+			ison_batch(bool aOurs) : iOurs(aOurs) {}
+			bool iOurs;
+			nick_name_list iNickNames; // folded
+		};
+		class tracker : public neolib::timer
+		{
+		public:
+			// construction
+			tracker(presence_watcher& aParent, connection& aConnection);
+		public:
+			// operations
+			void reset();
+		private:
+			// from neolib::timer
+			void ready() override;
+		public:
+			// attributes
+			presence_watcher& iParent;
+			connection& iConnection;
+			bool iStarted;
+			bool iMonitor;
+			std::size_t iMonitorLimit; // 0 if the server set no limit
+			bool iSending;
+			nick_names iWatched;
+			std::set<std::string> iMonitored;
+			std::set<std::string> iOnline;
+			std::deque<ison_batch> iIsonBatches;
+		};
+		typedef std::shared_ptr<tracker> tracker_ptr;
+		typedef std::map<const connection*, tracker_ptr> trackers;
+
+	private:
+		// implementation
+		tracker* find_tracker(const connection& aConnection) const;
+		void refresh();
+		void refresh(tracker& aTracker);
+		void poll(tracker& aTracker);
+		void send(tracker& aTracker, message::command_e aCommand, const std::string& aOperation, const nick_name_list& aNickNames, char aSeparator);
+		bool set_online(tracker& aTracker, const user& aUser);
+		bool set_offline(tracker& aTracker, const std::string& aNickName);
+		static void pack(std::size_t aLeadLength, const nick_name_list& aNickNames, std::vector<nick_name_list>& aLines);
+		// from neolib::observable<presence_watcher_observer>
+		virtual void notify_observer(presence_watcher_observer& aObserver, presence_watcher_observer::notify_type aType, const void* aParameter = 0, const void* aParameter2 = 0);
+		// from connection_manager_observer
+		virtual void connection_added(connection& aConnection);
+		virtual void connection_removed(connection& aConnection);
+		virtual void filter_message(connection& aConnection, const message& aMessage, bool& aFiltered);
+		virtual bool query_disconnect(const connection& aConnection) { return false; }
+		virtual void query_nickname(connection& aConnection) {}
+		virtual void disconnect_timeout_changed() {}
+		virtual void retry_network_delay_changed() {}
+		virtual void buffer_activated(buffer& aActiveBuffer) {}
+		virtual void buffer_deactivated(buffer& aDeactivatedBuffer) {}
+		// from connection_observer
+		virtual void connection_connecting(connection& aConnection) {}
+		virtual void connection_registered(connection& aConnection) {}
+		virtual void buffer_added(buffer& aBuffer) {}
+		virtual void buffer_removed(buffer& aBuffer) {}
+		virtual void incoming_message(connection& aConnection, const message& aMessage) {}
+		virtual void outgoing_message(connection& aConnection, const message& aMessage);
+		virtual void connection_quitting(connection& aConnection) {}
+		virtual void connection_disconnected(connection& aConnection);
+		virtual void connection_giveup(connection& aConnection) {}
+		// from contacts_observer
+		virtual void contact_added(const contact& aEntry) { refresh(); }
+		virtual void contact_updated(const contact& aEntry, const contact& aOldEntry) { refresh(); }
+		virtual void contact_removed(const contact& aEntry) { refresh(); }
+		// from notify_list_observer
+		virtual void notify_added(const notify_entry& aEntry) { refresh(); }
+		virtual void notify_updated(const notify_entry& aEntry) { refresh(); }
+		virtual void notify_removed(const notify_entry& aEntry) { refresh(); }
+
+	private:
+		// attributes
+		connection_manager& iConnectionManager;
+		contacts& iContacts;
+		notify& iNotifyList;
+		trackers iTrackers;
+	};
+}
+
+#endif //IRC_CLIENT_PRESENCE_WATCHER
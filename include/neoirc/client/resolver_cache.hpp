@@ -0,0 +1,124 @@
+// resolver_cache.h
+/*
+ *  Copyright (c) 2010 Leigh Johnston.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ *     * Neither the name of Leigh Johnston nor the names of any
+ *       other contributors to this software may be used to endorse or
+ *       promote products derived from this software without specific prior
+ *       written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ *  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef IRC_CLIENT_RESOLVER_CACHE
+#define IRC_CLIENT_RESOLVER_CACHE
+
+#include <list>
+#include <unordered_map>
+#include <vector>
+#include <neolib/resolver.hpp>
+
+namespace irc
+{
+	// Host name resolution shared by all connections.  Answers (and failures, for a shorter time) 
+	// are remembered so that the same cloaked or ISP host seen again and again during a join flood 
+	// costs one resolver round trip; requests for a host already being resolved wait for that 
+	// answer.  The least recently used entries are dropped beyond MaxEntries.  Cached answers are 
+	// given to the requester before resolve() returns.
+	class resolver_cache : private neolib::tcp_resolver::requester
+	{
+	public:
+		// types
+		class requester
+		{
+			friend class resolver_cache;
+		private:
+			virtual void host_resolved(const std::string& aHostName, neolib::tcp_resolver::iterator aHost) = 0;
+			virtual void host_not_resolved(const std::string& aHostName, const boost::system::error_code& aError) = 0;
+		};
+		struct statistics
+		{
+			statistics() : iHits(0), iNegativeHits(0), iMisses(0), iCoalesced(0), iEvictions(0) {}
+			unsigned long iHits;
+			unsigned long iNegativeHits;
+			unsigned long iMisses;
+			unsigned long iCoalesced;
+			unsigned long iEvictions;
+		};
+		enum
+		{
+			PositiveLifetime_ms = 5 * 60 * 1000,
+			NegativeLifetime_ms = 30 * 1000,
+			MaxEntries = 1024
+		};
+
+	public:
+		// construction
+		resolver_cache(neolib::tcp_resolver& aResolver);
+		~resolver_cache();
+
+	public:
+		// operations
+		void resolve(requester& aRequester, const std::string& aHostName);
+		void remove_requester(requester& aRequester);
+		void clear();
+		std::size_t size() const { return iEntries.size(); }
+		const statistics& stats() const { return iStatistics; }
+
+	private:
+		// types
+		typedef std::list<std::string> lru_list; // keys, most recently used first
+		struct entry
+		{
+			bool iResolved;
+			neolib::tcp_resolver::iterator iHost;
+			boost::system::error_code iError;
+			uint64_t iExpiry_ms;
+			lru_list::iterator iUse;
+		};
+		typedef std::unordered_map<std::string, entry> entries; // lower case host name
+		typedef std::vector<std::pair<requester*, std::string> > waiters; // requester and the host name it asked for
+		typedef std::unordered_map<std::string, waiters> pending_list; // lower case host name
+
+	private:
+		// implementation
+		static std::string key(const std::string& aHostName);
+		entry& store(const std::string& aKey);
+		// from neolib::tcp_resolver::requester
+		virtual void host_resolved(const std::string& aHostName, neolib::tcp_resolver::iterator aHost);
+		virtual void host_not_resolved(const std::string& aHostName, const boost::system::error_code& aError);
+
+	private:
+		// attributes
+		neolib::tcp_resolver& iResolver;
+		entries iEntries;
+		lru_list iUses;
+		pending_list iPending;
+		statistics iStatistics;
+	};
+}
+
+#endif //IRC_CLIENT_RESOLVER_CACHE
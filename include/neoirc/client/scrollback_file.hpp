@@ -0,0 +1,123 @@
+// scrollback_file.h
+/*
+ *  Copyright (c) 2010 Leigh Johnston.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ *     * Neither the name of Leigh Johnston nor the names of any
+ *       other contributors to this software may be used to endorse or
+ *       promote products derived from this software without specific prior
+ *       written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ *  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef IRC_CLIENT_SCROLLBACK_FILE
+#define IRC_CLIENT_SCROLLBACK_FILE
+
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <deque>
+#include <fstream>
+#include <stdexcept>
+
+namespace irc
+{
+	// Indexed scrollback container.
+	//
+	// header:  "NEOIRCSB" uint32 version
+	// records: uint32 length, uint64 time, char[length] (log line as written by the logger, without CRLF)
+	// footer:  index_entry[n] (sparse; one entry every IndexInterval records)
+	//          uint64 index offset, uint64 record count, uint32 entry count, uint32 interval, "NEOIRCIX"
+	//
+	// The footer is only present once the file has been sealed; a file that was not sealed (e.g. crash) is
+	// recovered by hopping over the length prefixes.
+	class scrollback_file
+	{
+	public:
+		// types
+		typedef uint64_t ordinal;
+		typedef uint64_t offset;
+		struct record
+		{
+			ordinal iOrdinal;
+			time_t iTime;
+			std::string iText;
+		};
+		typedef std::deque<record> records;
+		struct index_entry
+		{
+			ordinal iOrdinal;
+			uint64_t iTime;
+			offset iOffset;
+		};
+		typedef std::vector<index_entry> index;
+		enum { IndexInterval = 64 };
+		struct bad_file : std::runtime_error { bad_file() : std::runtime_error("irc::scrollback_file::bad_file") {} };
+
+	public:
+		// construction
+		scrollback_file(const std::string& aPath, bool aWritable = false);
+		~scrollback_file();
+
+	public:
+		// operations
+		const std::string& path() const { return iPath; }
+		bool is_open() const { return iOpen; }
+		bool was_sealed() const { return iWasSealed; }
+		ordinal count() const { return iCount; }
+		offset data_size() const { return iEnd; }
+		void append(time_t aTime, const std::string& aText);
+		void seal();
+		records tail(std::size_t aCount) const;
+		records from(time_t aTime, std::size_t aCount) const;
+		static bool is_scrollback_file(const std::string& aPath);
+		static bool convert(const std::string& aLegacyPath, const std::string& aPath);
+		static bool chop(const std::string& aPath, offset aKeep);
+
+	private:
+		// implementation
+		void load();
+		void recover();
+		offset seek_ordinal(ordinal aOrdinal, ordinal& aStartOrdinal) const;
+		offset seek_time(time_t aTime, ordinal& aStartOrdinal) const;
+		bool read_record(offset& aPosition, record& aRecord) const;
+
+	private:
+		// attributes
+		std::string iPath;
+		bool iWritable;
+		mutable std::fstream iFile;
+		bool iOpen;
+		bool iWasSealed;
+		bool iDirty;
+		ordinal iCount;
+		offset iEnd;
+		index iIndex;
+	};
+}
+
+#endif //IRC_CLIENT_SCROLLBACK_FILE
@@ -42,7 +42,13 @@
 #include <string>
 #include <neolib/random.hpp>
 #include <neolib/string_utils.hpp>
+#include <neolib/xml.hpp>
 #include <list>
+#include <map>
+#include <unordered_map>
+#include <cctype>
+#include <algorithm>
+#include <boost/functional/hash.hpp>
 
 namespace irc
 {
@@ -83,10 +89,18 @@ namespace irc
 		operator key_type() const { return key(); }
 		bool operator==(const key_type& aOther) const { return iNetwork == aOther.first && (iName == aOther.second || iName == "*" || aOther.second == "*"); }
 		bool operator!=(const key_type& aOther) const { return !operator==(aOther); }
-		bool operator<(const key_type& aOther) { return neolib::make_ci_string(iNetwork) < neolib::make_ci_string(aOther.first) || (iNetwork == aOther.first && (iName != "*" && aOther.second != "*" && neolib::make_ci_string(iName) < neolib::make_ci_string(aOther.second))); }
+		bool operator<(const key_type& aOther) const { return ci_less(iNetwork, aOther.first) || (iNetwork == aOther.first && (iName != "*" && aOther.second != "*" && ci_less(iName, aOther.second))); }
 		bool operator==(const server& aOther) const { return iNetwork == aOther.iNetwork && (iName == aOther.iName || iName == "*" || aOther.iName == "*"); }
 		bool operator!=(const server& aOther) const { return !operator==(aOther); }
-		bool operator<(const server& aOther) { return neolib::make_ci_string(iNetwork) < neolib::make_ci_string(aOther.iNetwork) || (iNetwork == aOther.iNetwork && (iName != "*" && aOther.iName != "*" && neolib::make_ci_string(iName) < neolib::make_ci_string(aOther.iName))); }
+		bool operator<(const server& aOther) const { return ci_less(iNetwork, aOther.iNetwork) || (iNetwork == aOther.iNetwork && (iName != "*" && aOther.iName != "*" && ci_less(iName, aOther.iName))); }
+
+		// implementation
+	private:
+		static bool ci_less(const std::string& aLeft, const std::string& aRight)
+		{
+			return std::lexicographical_compare(aLeft.begin(), aLeft.end(), aRight.begin(), aRight.end(), 
+				[](char aLeftChar, char aRightChar) { return std::toupper(static_cast<unsigned char>(aLeftChar)) < std::toupper(static_cast<unsigned char>(aRightChar)); });
+		}
 
 		// attributes
 	protected:
@@ -118,15 +132,115 @@ namespace irc
 		bool operator()(const server_key& aItem) const { return server_match(iToFind, aItem); }
 	};
 
-	struct server_list : std::list<server>
+	// The server catalogue: a list of servers (so iteration order and iterators are stable) with 
+	// an index by network, by (network, name) and by address.  The index is rebuilt on demand 
+	// after the list is changed; callers that modify a server in place must follow up with sort() 
+	// or invalidate() as the catalogue cannot see such changes.
+	struct server_list
+	{
+	public:
+		// types
+		typedef std::list<server> container_type;
+		typedef container_type::value_type value_type;
+		typedef container_type::size_type size_type;
+		typedef container_type::iterator iterator;
+		typedef container_type::const_iterator const_iterator;
+		typedef std::vector<iterator> servers;
+	private:
+		typedef std::unordered_map<std::string, servers> server_groups;
+		typedef std::unordered_map<server::key_type, iterator, boost::hash<server::key_type> > server_keys;
+
+	public:
+		// construction
+		server_list() : iIndexed(false) {}
+		server_list(const server_list& aOther) : iVersion(aOther.iVersion), iServers(aOther.iServers), iIndexed(false) {}
+		server_list& operator=(const server_list& aOther) { iVersion = aOther.iVersion; iServers = aOther.iServers; invalidate(); return *this; }
+
+	public:
+		// operations
+		const_iterator begin() const { return iServers.begin(); }
+		const_iterator end() const { return iServers.end(); }
+		iterator begin() { return iServers.begin(); }
+		iterator end() { return iServers.end(); }
+		size_type size() const { return iServers.size(); }
+		bool empty() const { return iServers.empty(); }
+		const server& front() const { return iServers.front(); }
+		server& front() { return iServers.front(); }
+		const server& back() const { return iServers.back(); }
+		server& back() { return iServers.back(); }
+		void push_back(const server& aServer) { add_to_index(iServers.insert(iServers.end(), aServer)); }
+		iterator insert(iterator aPosition, const server& aServer) { iterator result = iServers.insert(aPosition, aServer); invalidate(); return result; }
+		iterator erase(iterator aPosition) { iterator result = iServers.erase(aPosition); invalidate(); return result; }
+		void clear() { iServers.clear(); invalidate(); }
+		void sort() { iServers.sort(); invalidate(); }
+		void invalidate() const { iIndexed = false; }
+		iterator find(const server::key_type& aKey);
+		const_iterator find(const server::key_type& aKey) const;
+		const servers& network_servers(const std::string& aNetwork) const;
+		const servers& address_servers(const std::string& aAddress) const; // address is case insensitive
+		const_iterator random_server(const std::string& aNetwork, neolib::random& aRandom) const;
+
+	private:
+		// implementation
+		void index() const;
+		void add_to_index(iterator aServer) const;
+
+	public:
+		// attributes
+		std::string iVersion;
+	private:
+		container_type iServers;
+		mutable bool iIndexed;
+		mutable server_groups iByNetwork;
+		mutable server_groups iByAddress;
+		mutable server_keys iByKey;
+	};
+
+	// Incremental reader for the servers.xml format: the document can be fed in arbitrary pieces 
+	// and each server is appended to the output list as soon as its element is complete so the 
+	// caller can take the output away in batches.
+	class server_list_reader
 	{
+		// types
+	private:
+		typedef std::map<std::string, std::string> attributes;
+
+		// construction
+	public:
+		server_list_reader(server_list& aOutput) : iOutput(aOutput), iDepth(0), iInNetwork(false), iComplete(false), iError(false) {}
+
+		// operations
+	public:
+		bool feed(const char* aText, std::size_t aLength); // false if the input is malformed
+		bool finish() const { return !iError && iComplete; }
+		const std::string& version() const { return iVersion; }
+
+		// implementation
+	private:
+		void tag(const std::string& aTag);
+		bool parse_attributes(const std::string& aTag, std::string::size_type aPosition, attributes& aAttributes) const;
+		static std::string attribute_value(const attributes& aAttributes, const std::string& aName);
+		static bool decode(const std::string& aText, std::string::size_type aStart, std::string::size_type aEnd, std::string& aResult);
+
+		// attributes
+	private:
+		server_list& iOutput;
+		std::string iPending;
+		int iDepth;
+		bool iInNetwork;
+		std::string iNetwork;
 		std::string iVersion;
+		bool iComplete;
+		bool iError;
 	};
 
 	bool read_server_list(server_list& aServerList, std::istream& aInput);
+	bool read_server_list(server_list& aServerList, const neolib::xml& aXml);
 	void read_server_list(model& aModel, std::function<bool()> aErrorFunction = std::function<bool()>());
+	void read_server_list(model& aModel, const neolib::xml& aXml, std::function<bool()> aErrorFunction = std::function<bool()>());
 	void write_server_list(const model& aModel);
 	void merge_server_list(model& aModel, const server_list& aServerList);
+	std::size_t merge_server_list(server_list& aServerList, const server_list& aNewServers); // adds servers not already present; does not sort or save
 }
 
 #endif //IRC_CLIENT_SERVER
\ No newline at end of file
@@ -39,6 +39,7 @@
 #include <neolib/timer.hpp>
 #include <neolib/http.hpp>
 #include <neoirc/client/server.hpp>
+#include <neoirc/client/background_executor.hpp>
 
 namespace irc
 {
@@ -55,6 +56,10 @@ namespace irc
 
 	class server_list_updater : public neolib::observable<server_list_updater_observer>, private neolib::timer, private neolib::i_http_observer
 	{
+		// types
+	private:
+		class parser;
+
 		// construction
 	public:
 		server_list_updater(model& aModel);
@@ -68,6 +73,8 @@ namespace irc
 
 		// implementation
 	private:
+		void merge_batch(const server_list& aBatch); // into the staging list; the model's list is only touched once the document is valid
+		void update_completed(const std::string& aVersion, bool aOk);
 		// from neolib::observable<server_list_updater_observer>
 		virtual void notify_observer(server_list_updater_observer& aObserver, server_list_updater_observer::notify_type aType, const void* aParameter, const void* aParameter2);
 		// from neolib::timer
@@ -83,6 +90,8 @@ namespace irc
 		neolib::optional<neolib::http> iChecker;
 		neolib::optional<neolib::http> iDownloader;
 		bool iDownloading;
+		background_job_pointer iUpdateJob;
+		server_list iStaging;
 	};
 }
 
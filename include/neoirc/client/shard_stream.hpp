@@ -0,0 +1,156 @@
+// shard_stream.h
+/*
+ *  Copyright (c) 2010 Leigh Johnston.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ *     * Neither the name of Leigh Johnston nor the names of any
+ *       other contributors to this software may be used to endorse or
+ *       promote products derived from this software without specific prior
+ *       written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ *  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef IRC_CLIENT_SHARD_STREAM
+#define IRC_CLIENT_SHARD_STREAM
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <neolib/packet_stream.hpp>
+#include <neoirc/client/io_shards.hpp>
+#include <neoirc/client/spsc_queue.hpp>
+
+namespace irc
+{
+	class message;
+
+	class parsed_message_observer
+	{
+	public:
+		virtual void messages_parsed(std::vector<message>& aMessages) = 0; // owner thread; ids not yet set
+	};
+
+	// The server stream of a connection.  Without a shard it is a plain tcp_string_packet_stream on the
+	// owner thread; with one, socket I/O, TLS and line framing run on the shard's thread and observer
+	// notifications are delivered on the owner thread in the order the shard saw them.  State queries
+	// answer from a mirror that is updated as those notifications are delivered.  If a
+	// parsed_message_observer is set, a sharded stream also parses incoming lines on the shard and
+	// hands them over in batches through a lock-free queue instead of calling packet_arrived(); the 
+	// queue is drained on the owner thread by io_shards' delivery pass, so batches take no lock.
+	class shard_stream : private io_shards_drain
+	{
+	private:
+		// types
+		enum { ParsedBudget_ms = 25 };
+		typedef std::shared_ptr<neolib::tcp_string_packet_stream> stream_pointer;
+		typedef std::shared_ptr<shard_stream*> self_pointer;
+		typedef std::vector<message> message_batch;
+		typedef spsc_queue<message_batch> parsed_queue;
+		typedef std::shared_ptr<parsed_queue> parsed_queue_pointer;
+		class relay : public neolib::i_tcp_string_packet_stream_observer, public std::enable_shared_from_this<relay>
+		{
+		public:
+			relay(io_shards& aShards, io_shards::shard& aShard, self_pointer aSelf, unsigned long aSession, parsed_queue_pointer aParsed);
+		public:
+			void open_failed(neolib::tcp_string_packet_stream& aStream);
+		private:
+			void flush(); // a batch is everything parsed during one I/O round of the shard
+		private:
+			void connection_established(neolib::tcp_string_packet_stream& aStream) override;
+			void connection_failure(neolib::tcp_string_packet_stream& aStream, const boost::system::error_code& aError) override;
+			void packet_sent(neolib::tcp_string_packet_stream& aStream, const neolib::string_packet& aPacket) override;
+			void packet_arrived(neolib::tcp_string_packet_stream& aStream, const neolib::string_packet& aPacket) override;
+			void transfer_failure(neolib::tcp_string_packet_stream& aStream, const boost::system::error_code& aError) override;
+			void connection_closed(neolib::tcp_string_packet_stream& aStream) override;
+		private:
+			io_shards& iShards;
+			io_shards::shard& iShard;
+			self_pointer iSelf;
+			unsigned long iSession;
+			parsed_queue_pointer iParsed;
+			message_batch iBatch;
+			bool iFlushPosted;
+		};
+		typedef std::shared_ptr<relay> relay_pointer;
+
+	public:
+		// construction
+		shard_stream(neolib::io_task& aOwnerTask, io_shards& aShards);
+		~shard_stream();
+
+	public:
+		// operations
+		bool sharded() const { return iShard != nullptr; }
+		void add_observer(neolib::i_tcp_string_packet_stream_observer& aObserver);
+		void set_parsed_message_observer(parsed_message_observer& aObserver); // only used when sharded
+		bool open(const std::string& aHostName, unsigned short aPort, bool aSecure);
+		void close();
+		bool opened() const;
+		bool closed() const { return !opened(); }
+		bool connected() const;
+		bool has_error() const;
+		int error_code() const;
+		std::string error() const;
+		void send_packet(const neolib::string_packet& aPacket);
+		unsigned short local_port() const;
+		unsigned short remote_port() const;
+		u_long local_address() const;
+
+	private:
+		// implementation
+		void retire();
+		void drain_parsed(bool aAll);
+		void established(unsigned long aSession, unsigned short aLocalPort, unsigned short aRemotePort, u_long aLocalAddress);
+		void failed(unsigned long aSession, const boost::system::error_code& aError, int aErrorCode, const std::string& aErrorText);
+		void arrived(unsigned long aSession, const std::string& aPacket);
+		void transfer_failed(unsigned long aSession, const boost::system::error_code& aError);
+		void shard_closed(unsigned long aSession, bool aHasError, int aErrorCode, const std::string& aErrorText);
+		// from io_shards_drain
+		virtual void drain() { drain_parsed(false); }
+
+	private:
+		// attributes
+		io_shards& iShards;
+		io_shards::shard_pointer iShard;
+		stream_pointer iStream;
+		relay_pointer iRelay;
+		self_pointer iSelf;
+		neolib::i_tcp_string_packet_stream_observer* iObserver;
+		parsed_message_observer* iParsedObserver;
+		parsed_queue_pointer iParsed;
+		unsigned long iSession;
+		bool iOpened;
+		bool iConnected;
+		bool iHasError;
+		int iErrorCode;
+		std::string iError;
+		unsigned short iLocalPort;
+		unsigned short iRemotePort;
+		u_long iLocalAddress;
+	};
+}
+
+#endif //IRC_CLIENT_SHARD_STREAM
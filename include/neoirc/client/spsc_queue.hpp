@@ -0,0 +1,105 @@
+// spsc_queue.h
+/*
+ *  Copyright (c) 2010 Leigh Johnston.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ *     * Neither the name of Leigh Johnston nor the names of any
+ *       other contributors to this software may be used to endorse or
+ *       promote products derived from this software without specific prior
+ *       written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ *  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef IRC_CLIENT_SPSC_QUEUE
+#define IRC_CLIENT_SPSC_QUEUE
+
+#include <atomic>
+#include <utility>
+
+namespace irc
+{
+	// Unbounded lock-free queue for exactly one producer thread and one consumer thread.  Nodes are
+	// allocated by the producer and freed by the consumer; T must be default constructible.
+	template <typename T>
+	class spsc_queue
+	{
+	private:
+		// types
+		struct node
+		{
+			node() : iNext(nullptr) {}
+			std::atomic<node*> iNext;
+			T iValue;
+		};
+
+	public:
+		// construction
+		spsc_queue() : iHead(new node), iTail(iHead) {}
+		~spsc_queue()
+		{
+			while (iHead != nullptr)
+			{
+				node* next = iHead->iNext.load(std::memory_order_relaxed);
+				delete iHead;
+				iHead = next;
+			}
+		}
+	private:
+		spsc_queue(const spsc_queue&);
+		spsc_queue& operator=(const spsc_queue&);
+
+	public:
+		// operations
+		void push(T aValue) // producer
+		{
+			node* newNode = new node;
+			newNode->iValue = std::move(aValue);
+			iTail->iNext.store(newNode, std::memory_order_release);
+			iTail = newNode;
+		}
+		bool pop(T& aValue) // consumer
+		{
+			node* next = iHead->iNext.load(std::memory_order_acquire);
+			if (next == nullptr)
+				return false;
+			aValue = std::move(next->iValue);
+			delete iHead;
+			iHead = next;
+			return true;
+		}
+		bool empty() const // consumer
+		{
+			return iHead->iNext.load(std::memory_order_acquire) == nullptr;
+		}
+
+	private:
+		// attributes
+		node* iHead; // consumer only; a spent node whose successor is the front
+		node* iTail; // producer only
+	};
+}
+
+#endif //IRC_CLIENT_SPSC_QUEUE
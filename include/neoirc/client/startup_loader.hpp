@@ -0,0 +1,119 @@
+// startup_loader.h
+/*
+ *  Copyright (c) 2010 Leigh Johnston.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ *     * Neither the name of Leigh Johnston nor the names of any
+ *       other contributors to this software may be used to endorse or
+ *       promote products derived from this software without specific prior
+ *       written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ *  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef IRC_CLIENT_STARTUP_LOADER
+#define IRC_CLIENT_STARTUP_LOADER
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <neolib/xml.hpp>
+#include <neoirc/client/background_executor.hpp>
+
+namespace irc
+{
+	class model;
+
+	// Loads the configuration stores at startup.  The XML files are parsed concurrently on the
+	// background executor and the results applied to the model on the owner thread in dependency 
+	// order (identities and servers first as the other stores refer to them).  The time taken by
+	// each file is recorded and can be examined afterwards.
+	class startup_loader
+	{
+	public:
+		// types
+		enum store_e { Identities, ServerList, AutoJoins, ConnectionScripts, IgnoreList, NotifyList, AutoModeList, Macros, Contacts, StoreCount };
+		typedef std::function<bool(store_e)> error_function; // return true to delete a corrupt store
+		struct timing
+		{
+			store_e iStore;
+			std::string iFileName;
+			uint64_t iFileSize;
+			uint64_t iParseTime_us; // background worker
+			uint64_t iWaitTime_us; // owner thread waiting for the parse to finish
+			uint64_t iApplyTime_us; // owner thread
+		};
+		typedef std::vector<timing> profile;
+	private:
+		class parser : public background_job
+		{
+		public:
+			// construction
+			parser(const std::string& aFileName, const std::string& aFallbackFileName);
+		public:
+			// operations
+			const neolib::xml& xml() const { return iXml; }
+			const std::string& file_name() const { return iFileName; }
+			uint64_t file_size() const { return iFileSize; }
+			uint64_t parse_time_us() const { return iParseTime_us; }
+		private:
+			// implementation
+			virtual void run();
+		private:
+			// attributes
+			std::string iFileName;
+			std::string iFallbackFileName;
+			neolib::xml iXml;
+			uint64_t iFileSize;
+			uint64_t iParseTime_us;
+		};
+		typedef std::shared_ptr<parser> parser_pointer;
+
+	public:
+		// construction
+		startup_loader(model& aModel);
+
+	public:
+		// operations
+		void load(std::string& aDefaultIdentity, error_function aErrorFunction = error_function());
+		const profile& last_profile() const { return iProfile; }
+		uint64_t total_time_us() const { return iTotalTime_us; }
+		static const char* file_name(store_e aStore);
+		static const char* description(store_e aStore);
+
+	private:
+		// implementation
+		void apply(store_e aStore, const neolib::xml& aXml, std::string& aDefaultIdentity, std::function<bool()> aErrorFunction);
+
+	private:
+		// attributes
+		model& iModel;
+		profile iProfile;
+		uint64_t iTotalTime_us;
+	};
+}
+
+#endif //IRC_CLIENT_STARTUP_LOADER
@@ -0,0 +1,81 @@
+// target_packer.h
+/*
+ *  Copyright (c) 2010 Leigh Johnston.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ *     * Neither the name of Leigh Johnston nor the names of any
+ *       other contributors to this software may be used to endorse or
+ *       promote products derived from this software without specific prior
+ *       written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ *  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef IRC_CLIENT_TARGET_PACKER
+#define IRC_CLIENT_TARGET_PACKER
+
+#include <neolib/optional.hpp>
+#include <neolib/timer.hpp>
+#include <neoirc/client/message.hpp>
+#include <neoirc/client/flood_scheduler.hpp>
+
+namespace irc
+{
+	class connection;
+
+	// Combines PRIVMSG/NOTICE lines with the same text sent to several targets in a row (for 
+	// example by /all) into one PRIVMSG a,b,c :text, within TARGMAX/MAXTARGETS and the line 
+	// length.  Lines are only held until the io task next runs and any other line flushes them 
+	// first, so ordering is unchanged.
+	class target_packer : private neolib::timer
+	{
+	public:
+		// construction
+		target_packer(connection& aConnection, flood_scheduler& aScheduler, neolib::io_task& aIoTask);
+
+	public:
+		// operations
+		void send(const message& aMessage, flood_scheduler::lane aLane);
+		void flush();
+		void clear();
+
+	private:
+		// implementation
+		static bool packable(const message& aMessage);
+		bool fits(const message& aMessage, flood_scheduler::lane aLane) const;
+		// from neolib::timer
+		virtual void ready();
+
+	private:
+		// attributes
+		connection& iConnection;
+		flood_scheduler& iScheduler;
+		neolib::optional<message> iPending;
+		flood_scheduler::lane iPendingLane;
+		std::size_t iPendingTargets;
+	};
+}
+
+#endif //IRC_CLIENT_TARGET_PACKER
@@ -37,10 +37,50 @@
 #define IRC_TIMESTAMP
 
 #include <string>
+#include <map>
+#include <mutex>
 #include <ctime>
+#include <neoirc/client/codes.hpp>
 
 namespace irc
 {	
+	// Formats times for display and logging; results are cached per format string for the 
+	// current second and the broken down local time is cached for the current minute.
+	// The C library locale is set once on construction rather than on every call.
+	class timestamp_formatter
+	{
+		// types
+	private:
+		struct entry
+		{
+			entry() : iTime(-1) {}
+			time_t iTime;
+			std::string iText;
+		};
+		typedef std::map<std::string, entry> entries;
+		// construction
+	private:
+		timestamp_formatter();
+	public:
+		static timestamp_formatter& instance();
+		// operations
+	public:
+		std::string format(time_t aTime, const std::string& aFormat); // strftime format
+		std::string format_codes(time_t aTime, const std::string& aFormat); // %x% code format
+		// implementation
+	private:
+		void local_time(time_t aTime);
+		// attributes
+	private:
+		std::mutex iMutex;
+		time_t iMinute;
+		std::tm iMinuteTime;
+		std::tm iTime;
+		entries iEntries;
+		entries iCodeEntries;
+		codes iCodes;
+	};
+
 	std::string timestamp(time_t aTime, const std::string& aFormat);
 }
 
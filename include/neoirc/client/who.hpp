@@ -36,6 +36,9 @@
 #ifndef IRC_CLIENT_WHO
 #define IRC_CLIENT_WHO
 
+#include <list>
+#include <unordered_map>
+#include <vector>
 #include <neolib/variant.hpp>
 #include <neoirc/client/connection_manager.hpp>
 #include <neoirc/client/connection.hpp>
@@ -44,6 +47,9 @@
 
 namespace irc
 {
+	// Pending requests are indexed by case folded mask so that each reply is correlated without 
+	// scanning them.  When the server supports WHOX a request is also sent with a query token 
+	// which its replies carry back; such replies are passed on as ordinary RPL_WHOREPLY messages.
 	class who_requester : private neolib::timer, private connection_observer
 	{
 	public:
@@ -71,6 +77,7 @@ namespace irc
 		void cancel_request(const std::string& aMask, requester& aRequester);
 		void cancel_request(requester& aRequester);
 		bool new_message(const message& aMessage);
+		bool whox() const { return iWhox; }
 
 	private:
 		// implementation
@@ -89,7 +96,7 @@ namespace irc
 		virtual void connection_registered(connection& aConnection) {}
 		virtual void buffer_added(buffer& aBuffer) {}
 		virtual void buffer_removed(buffer& aBuffer);
-		virtual void incoming_message(connection& aConnection, const message& aMessage) {}
+		virtual void incoming_message(connection& aConnection, const message& aMessage);
 		virtual void outgoing_message(connection& aConnection, const message& aMessage) {}
 		virtual void connection_quitting(connection& aConnection) {}
 		virtual void connection_disconnected(connection& aConnection);
@@ -99,18 +106,37 @@ namespace irc
 		// types
 		struct request
 		{
-			request(const std::string& aMask, const request_type& aRequestType) : iMask(aMask), iRequestType(aRequestType), iSent(false) {}
+			request(const std::string& aMask, const std::string& aKey, const request_type& aRequestType, unsigned long aSequence) : 
+				iMask(aMask), iKey(aKey), iRequestType(aRequestType), iSent(false), iSequence(aSequence) {}
 			std::string iMask;
+			std::string iKey; // folded mask
 			request_type iRequestType;
 			bool iSent;
+			unsigned long iSequence;
+			std::string iToken; // WHOX query token, if sent with one
 		};
 		static const std::size_t kPossibleNetSplit = 10;
+		static const unsigned int kMaxToken = 999; // WHOX tokens are at most three digits
+		typedef std::list<request> request_list;
+		typedef std::unordered_map<std::string, std::vector<request_list::iterator>> mask_index;
+		typedef std::unordered_map<std::string, request_list::iterator> token_index;
+		typedef std::pair<request_list::iterator, message> reply;
+	private:
+		// implementation
+		std::string key(const std::string& aMask) const;
+		void send(request_list::iterator aRequest, buffer& aBuffer);
+		void erase(request_list::iterator aRequest);
+		bool find_sent(const std::string& aMask, request_list::iterator& aRequest) const;
 	private:
 		// attributes
 		connection& iConnection;
-		typedef std::list<request> request_list;
 		request_list iRequests;
-		typedef std::pair<request_list::iterator, message> reply;
+		mask_index iMasks;
+		token_index iTokens;
+		unsigned long iNextSequence;
+		unsigned int iNextToken;
+		bool iWhox;
+		neolib::optional<request_list::iterator> iWhoxReply;
 	};
 }
 
@@ -36,6 +36,9 @@
 #ifndef IRC_CLIENT_WHOIS
 #define IRC_CLIENT_WHOIS
 
+#include <list>
+#include <unordered_map>
+#include <vector>
 #include <neolib/variant.hpp>
 #include <neoirc/client/connection.hpp>
 #include <neoirc/client/buffer.hpp>
@@ -43,6 +46,11 @@
 
 namespace irc
 {
+	// Requests for a nick name already being WHOISed join the query in flight and each gets every 
+	// reply.  Completed replies are cached for a short while so that other subsystems asking about 
+	// the same user (DNS lookups, scripts, the GUI) are answered without a round trip; a WHOIS the 
+	// user typed always goes to the server.  A cached entry is dropped when its user changes nick 
+	// name, quits or changes away status.
 	class whois_requester : private connection_observer
 	{
 	public:
@@ -75,6 +83,9 @@ namespace irc
 		// implementation
 		typedef neolib::variant<buffer*, requester*> requester_type;
 		void new_request(const std::string& aNickName, const requester_type& aRequester);
+		std::string key(const std::string& aNickName) const;
+		static void deliver(const requester_type& aRequester, const message& aMessage);
+		void invalidate(const std::string& aNickName);
 		// from connection_observer
 		virtual void connection_connecting(connection& aConnection) {}
 		virtual void connection_registered(connection& aConnection) {}
@@ -86,14 +97,32 @@ namespace irc
 		virtual void connection_disconnected(connection& aConnection);
 		virtual void connection_giveup(connection& aConnection) {}
 
+	private:
+		// types
+		typedef std::list<message> replies;
+		typedef std::vector<requester_type> requester_list;
+		struct request
+		{
+			request(const std::string& aNickName) : iNickName(aNickName) {}
+			std::string iNickName;
+			requester_list iRequesters;
+			replies iReplies;
+		};
+		struct cached_result
+		{
+			cached_result(uint64_t aTime) : iTime(aTime) {}
+			uint64_t iTime;
+			replies iReplies;
+		};
+		typedef std::unordered_map<std::string, request> request_list; // folded nick name
+		typedef std::unordered_map<std::string, cached_result> cache; // folded nick name
+		static const uint64_t kCacheLifetime_ms = 60 * 1000;
+
 	private:
 		// attributes
 		connection& iConnection;
-		typedef std::pair<std::string, requester_type> request;
-		typedef std::list<request> request_list;
 		request_list iRequests;
-		typedef std::list<message> replies;
-		replies iReplies;
+		cache iCache;
 	};
 }
 
@@ -336,6 +336,15 @@ namespace irc
 	{
 		return string(cmt, s.begin(), s.end());
 	}
+
+	// lower case form of s suitable for use as a hash/map key
+	inline std::string fold_case(casemapping::type cmt, const std::string& s)
+	{
+		std::string ret(s);
+		for (std::string::iterator i = ret.begin(); i != ret.end(); ++i)
+			*i = casemapping::tolower<char>(cmt, static_cast<unsigned char>(*i));
+		return ret;
+	}
 	
 	template<class CharT, class Traits, class Alloc> inline
 		bool operator==(const basic_irc_string<CharT, Traits, Alloc>& left,
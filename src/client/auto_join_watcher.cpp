@@ -35,6 +35,7 @@
 
 #include <neolib/neolib.hpp>
 #include <neoirc/client/auto_join_watcher.hpp>
+#include <neoirc/client/join_scheduler.hpp>
 
 namespace irc
 {
@@ -95,29 +96,15 @@ namespace irc
 			bool found = false;
 			for (identity_list::const_iterator i = iIdentityList.begin(); !found && i != iIdentityList.end(); ++i)
 				if (i->nick_name() == theEntry.first)
-					if (theEntry.second.second != "*")
-					{
-						for (server_list::const_iterator s = iServerList.begin(); !found && s != iServerList.end(); ++s)
-							if (s->key() == theEntry.second)
-							{
-								iConnectionManager.add_connection(*s, *i);
-								found = true;
-							}
-					}
-					else
+				{
+					server_list::const_iterator s = (theEntry.second.second != "*" ? 
+						iServerList.find(theEntry.second) : iServerList.random_server(theEntry.second.first, iRandom));
+					if (s != iServerList.end())
 					{
-						int number = 0;
-						for (server_list::const_iterator s = iServerList.begin(); !found && s != iServerList.end(); ++s)
-							if (s->key().first == theEntry.second.first)
-								++number;
-						number = iRandom.get(0, number-1);
-						for (server_list::const_iterator s = iServerList.begin(); !found && s != iServerList.end(); ++s)
-							if (s->key().first == theEntry.second.first && --number < 0)
-							{
-								iConnectionManager.add_connection(*s, *i);
-								found = true;
-							}
+						iConnectionManager.add_connection(*s, *i);
+						found = true;
 					}
+				}
 		}
 	}
 
@@ -145,12 +132,7 @@ namespace irc
 				!aConnection.buffer_exists(channelName))
 			{
 				if (aConnection.registered())
-				{
-					message joinMessage(aConnection, message::OUTGOING);
-					joinMessage.set_command(message::JOIN);
-					joinMessage.parse_parameters("JOIN " + entry.channel());
-					aConnection.send_message(joinMessage);
-				}
+					aConnection.joins().join(channelName, channelKey);
 				else if (iConnectionManager.create_channel_buffer_upfront())
 				{
 					aConnection.server_buffer(true);
@@ -233,10 +215,22 @@ namespace irc
 	{
 		if (aMessage.command() != message::JOIN || aMessage.parameters().empty())
 			return;
-		if (aConnection.buffer_exists(aMessage.parameters()[0]) &&
-			aConnection.buffer_from_name(aMessage.parameters()[0]).is_ready())
-			return;
-		iPendingJoins[&aConnection].insert(irc::make_string(aConnection, aMessage.parameters()[0]));
+		std::vector<std::string> channels;
+		neolib::tokens(aMessage.parameters()[0], std::string(","), channels);
+		for (std::vector<std::string>::const_iterator i = channels.begin(); i != channels.end(); ++i)
+		{
+			if (aConnection.buffer_exists(*i) &&
+				aConnection.buffer_from_name(*i).is_ready())
+				continue;
+			iPendingJoins[&aConnection].insert(irc::make_string(aConnection, *i));
+		}
+	}
+
+	bool auto_join_watcher::is_auto_join(const buffer& aBuffer) const
+	{
+		if (iIsAutoJoin)
+			return true;
+		return aBuffer.type() == buffer::CHANNEL && aBuffer.connection().joins().scheduled(aBuffer.name());
 	}
 
 	void auto_join_watcher::connection_disconnected(connection& aConnection)
@@ -36,6 +36,7 @@
 #include <neolib/neolib.hpp>
 #include <neolib/xml.hpp>
 #include <fstream>
+#include <sstream>
 #include <neoirc/client/model.hpp>
 #include <neoirc/client/auto_joins.hpp>
 
@@ -229,13 +230,17 @@ namespace irc
 
 	void read_auto_joins(model& aModel, std::function<bool()> aErrorFunction)
 	{
-		auto_joins& theAutoJoinList = aModel.auto_joins();
-
 		neolib::xml xmlAutoJoinList(true);
 		std::ifstream input((aModel.root_path() + "auto_joins.xml").c_str());
 		xmlAutoJoinList.read(input);
+		read_auto_joins(aModel, xmlAutoJoinList, aErrorFunction);
+	}
+
+	void read_auto_joins(model& aModel, const neolib::xml& aXml, std::function<bool()> aErrorFunction)
+	{
+		auto_joins& theAutoJoinList = aModel.auto_joins();
 
-		if (xmlAutoJoinList.error() && aErrorFunction && aErrorFunction())
+		if (aXml.error() && aErrorFunction && aErrorFunction())
 		{
 			theAutoJoinList.entries().clear();
 			write_auto_joins(aModel);
@@ -244,7 +249,7 @@ namespace irc
 
 		theAutoJoinList.loading(true);
 
-		for (neolib::xml::element::const_iterator i = xmlAutoJoinList.root().begin(); i != xmlAutoJoinList.root().end(); ++i)
+		for (neolib::xml::element::const_iterator i = aXml.root().begin(); i != aXml.root().end(); ++i)
 		{
 			if (i->name() == "entry")
 			{
@@ -285,7 +290,8 @@ namespace irc
 			xmlAutoJoinList.append(xmlEntry, "channel").set_attribute("value", entry.channel());
 		}
 
-		std::ofstream output((aModel.root_path() + "auto_joins.xml").c_str());
+		std::ostringstream output;
 		xmlAutoJoinList.write(output);
+		aModel.save_config(aModel.root_path() + "auto_joins.xml", output.str());
 	}
 }
\ No newline at end of file
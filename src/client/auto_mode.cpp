@@ -35,7 +35,9 @@
 
 #include <neolib/neolib.hpp>
 #include <neolib/xml.hpp>
+#include <algorithm>
 #include <fstream>
+#include <sstream>
 #include <neoirc/client/model.hpp>
 #include <neoirc/client/auto_mode.hpp>
 
@@ -106,21 +108,99 @@ namespace irc
 		return false;
 	}
 
+	std::size_t auto_mode::matching(casemapping::type aCasemapping, const server_key& aServer, const user& aUser, const std::string& aChannel, entry_list& aEntries) const
+	{
+		const index& theIndex = compiled(aCasemapping);
+		if (theIndex.iEntries.empty())
+			return 0;
+		const entry_indices* candidates[2] = {};
+		if (aChannel == "*")
+		{
+			entry_buckets::const_iterator bucket = theIndex.iByNetwork.find(aServer.first);
+			if (bucket != theIndex.iByNetwork.end())
+				candidates[0] = &bucket->second;
+		}
+		else
+		{
+			entry_buckets::const_iterator bucket = theIndex.iByChannel.find(bucket_key(aServer.first, fold_case(aCasemapping, aChannel)));
+			if (bucket != theIndex.iByChannel.end())
+				candidates[0] = &bucket->second;
+			bucket = theIndex.iByChannel.find(bucket_key(aServer.first, "*"));
+			if (bucket != theIndex.iByChannel.end())
+				candidates[1] = &bucket->second;
+		}
+		if (candidates[0] == 0 && candidates[1] == 0)
+			return 0;
+		std::string nickName = fold_case(aCasemapping, aUser.nick_name());
+		std::string userName = fold_case(aCasemapping, aUser.user_name());
+		std::string hostName = fold_case(aCasemapping, aUser.host_name());
+		entry_indices found;
+		for (std::size_t c = 0; c < sizeof(candidates) / sizeof(candidates[0]); ++c)
+			if (candidates[c] != 0)
+				for (entry_indices::const_iterator i = candidates[c]->begin(); i != candidates[c]->end(); ++i)
+				{
+					const compiled_entry& theEntry = theIndex.iEntries[*i];
+					if ((theEntry.iEntry->server().second == aServer.second || theEntry.iEntry->server().second == "*") && 
+						matches(theEntry, nickName, userName, hostName))
+						found.push_back(*i);
+				}
+		std::sort(found.begin(), found.end());
+		for (entry_indices::const_iterator i = found.begin(); i != found.end(); ++i)
+			aEntries.push_back(theIndex.iEntries[*i].iEntry);
+		return found.size();
+	}
+
 	bool auto_mode::has_auto_mode(casemapping::type aCasemapping, const server_key& aServer, const user& aUser, const std::string& aChannel) const
 	{
-		return find(aCasemapping, aServer, aUser, aChannel) != iEntries.end();
+		entry_list result;
+		return matching(aCasemapping, aServer, aUser, aChannel, result) != 0;
 	}
 
 	bool auto_mode::has_auto_mode(casemapping::type aCasemapping, const server_key& aServer, const user& aUser, const std::string& aChannel, auto_mode_entry::type_e aType) const
 	{
-		std::vector<container_type::const_iterator> result;
-		find_impl<const auto_mode, container_type::const_iterator>(aCasemapping, *this, aServer, aUser, aChannel, result);
-		for (std::vector<container_type::const_iterator>::const_iterator i = result.begin(); i != result.end(); ++i)
+		entry_list result;
+		matching(aCasemapping, aServer, aUser, aChannel, result);
+		for (entry_list::const_iterator i = result.begin(); i != result.end(); ++i)
 			if ((**i).type() == aType)
 				return true;
 		return false;
 	}
 
+	const auto_mode::index& auto_mode::compiled(casemapping::type aCasemapping) const
+	{
+		index& theIndex = iIndex[aCasemapping];
+		if (theIndex.iGeneration == iGeneration)
+			return theIndex;
+		theIndex = index();
+		theIndex.iGeneration = iGeneration;
+		theIndex.iEntries.reserve(iEntries.size());
+		for (container_type::const_iterator i = iEntries.begin(); i != iEntries.end(); ++i)
+		{
+			compiled_entry theEntry;
+			theEntry.iEntry = i;
+			theEntry.iNickName = mask(aCasemapping, i->user().nick_name());
+			theEntry.iUserName = mask(aCasemapping, i->user().user_name());
+			theEntry.iHostName = mask(aCasemapping, i->user().host_name());
+			std::size_t entryIndex = theIndex.iEntries.size();
+			theIndex.iEntries.push_back(theEntry);
+			theIndex.iByChannel[bucket_key(i->server().first, i->channel() != "*" ? fold_case(aCasemapping, i->channel()) : i->channel())].push_back(entryIndex);
+			theIndex.iByNetwork[i->server().first].push_back(entryIndex);
+		}
+		return theIndex;
+	}
+
+	bool auto_mode::matches(const compiled_entry& aEntry, const std::string& aNickName, const std::string& aUserName, const std::string& aHostName)
+	{
+		bool anyNickName = aEntry.iNickName.any();
+		bool anyUserName = aEntry.iUserName.any();
+		bool anyHostName = aEntry.iHostName.any();
+		if (!anyNickName && aEntry.iNickName.matches(aNickName))
+			return true;
+		if ((!anyUserName || !anyHostName) && aEntry.iUserName.matches(aUserName) && aEntry.iHostName.matches(aHostName))
+			return true;
+		return anyNickName && anyUserName && anyHostName;
+	}
+
 	bool auto_mode::add(const server_key& aServer, const user& aUser, const std::string& aChannel, auto_mode_entry::type_e aType, const std::string& aData)
 	{
 		if (has_auto_mode(casemapping::ascii, aServer, aUser, aChannel, aType))
@@ -128,6 +208,7 @@ namespace irc
 			auto_mode_entry& existingEntry = *find(casemapping::ascii, aServer, aUser, aChannel);
 			existingEntry.type() = aType;
 			existingEntry.data() = aData;
+			++iGeneration;
 			if (existingEntry.user() != aUser ||
 				existingEntry.user().user_name() != aUser.user_name() ||
 				existingEntry.user().host_name() != aUser.host_name())
@@ -140,6 +221,7 @@ namespace irc
 		}
 
 		iEntries.push_back(auto_mode_entry(aServer, aUser, aChannel, aType, aData));
+		++iGeneration;
 		if (!iLoading)
 			notify_observers(auto_mode_list_observer::NotifyAdded, iEntries.back());
 
@@ -154,6 +236,7 @@ namespace irc
 	void auto_mode::update(auto_mode_entry& aExistingEntry, const auto_mode_entry& aNewEntry)
 	{
 		aExistingEntry = aNewEntry;
+		++iGeneration;
 		if (!iLoading)
 			notify_observers(auto_mode_list_observer::NotifyUpdated, aExistingEntry);
 	}
@@ -185,6 +268,7 @@ namespace irc
 
 		container_type temp;
 		temp.splice(temp.begin(), iEntries, item);
+		++iGeneration;
 		notify_observers(auto_mode_list_observer::NotifyRemoved, *temp.begin());
 	}
 
@@ -195,6 +279,7 @@ namespace irc
 			{
 				container_type temp;
 				temp.splice(temp.begin(), iEntries, i);
+				++iGeneration;
 				notify_observers(auto_mode_list_observer::NotifyRemoved, *temp.begin());
 				break;
 			}
@@ -218,22 +303,27 @@ namespace irc
 
 	void read_auto_mode_list(model& aModel, std::function<bool()> aErrorFunction)
 	{
-		auto_mode& theAutoModeList = aModel.auto_mode_list();
-
 		neolib::xml xmlAutoModeList(true);
 		std::ifstream input((aModel.root_path() + "auto_mode_list.xml").c_str());
 		xmlAutoModeList.read(input);
+		read_auto_mode_list(aModel, xmlAutoModeList, aErrorFunction);
+	}
+
+	void read_auto_mode_list(model& aModel, const neolib::xml& aXml, std::function<bool()> aErrorFunction)
+	{
+		auto_mode& theAutoModeList = aModel.auto_mode_list();
 
-		if (xmlAutoModeList.error() && aErrorFunction && aErrorFunction())
+		if (aXml.error() && aErrorFunction && aErrorFunction())
 		{
 			theAutoModeList.entries().clear();
+			theAutoModeList.invalidate();
 			write_auto_mode_list(aModel);
 			return;
 		}
 
 		theAutoModeList.loading(true);
 
-		for (neolib::xml::element::const_iterator i = xmlAutoModeList.root().begin(); i != xmlAutoModeList.root().end(); ++i)
+		for (neolib::xml::element::const_iterator i = aXml.root().begin(); i != aXml.root().end(); ++i)
 		{
 			if (i->name() == "entry")
 			{
@@ -256,6 +346,7 @@ namespace irc
 				}
 			}
 		}
+		theAutoModeList.invalidate();
 
 		theAutoModeList.loading(false);
 	}
@@ -280,7 +371,8 @@ namespace irc
 			xmlAutoModeList.append(xmlEntry, "data").set_attribute("value", entry.data());
 		}
 
-		std::ofstream output((aModel.root_path() + "auto_mode_list.xml").c_str());
+		std::ostringstream output;
 		xmlAutoModeList.write(output);
+		aModel.save_config(aModel.root_path() + "auto_mode_list.xml", output.str());
 	}
 }
\ No newline at end of file
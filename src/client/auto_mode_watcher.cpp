@@ -34,6 +34,7 @@
 */
 
 #include <neolib/neolib.hpp>
+#include <algorithm>
 #include <neoirc/client/auto_mode_watcher.hpp>
 
 namespace irc
@@ -59,52 +60,54 @@ namespace irc
 			return;
 		if (aUser.nick_name() == aConnection.nick_name())
 			return;
-		if (iConnectionManager.auto_mode_list().has_auto_mode(aConnection, aConnection.server().key(), aUser, aChannel.name()))
+		auto_mode::entry_list entries;
+		if (iAutoModeList.matching(aConnection, aConnection.server().key(), aUser, aChannel.name(), entries) != 0)
 		{
-			for (auto_mode::container_type::iterator i = iAutoModeList.entries().begin(); i != iAutoModeList.entries().end(); ++i)
-				if (iAutoModeList.matches(aConnection, *i, aConnection.server().key(), aUser, aChannel.name()))
+			for (auto_mode::entry_list::const_iterator i = entries.begin(); i != entries.end(); ++i)
+			{
+				const auto_mode_entry& entry = **i;
+				message modeMessage(aConnection, message::OUTGOING);
+				modeMessage.set_command(message::MODE);
+				modeMessage.set_background(true);
+				modeMessage.parameters().push_back(aChannel.name());
+				bool send = false;
+				switch(entry.type())
 				{
-					auto_mode_entry& entry = *i;
-					message modeMessage(aConnection, message::OUTGOING);
-					modeMessage.set_command(message::MODE);
-					modeMessage.parameters().push_back(aChannel.name());
-					bool send = false;
-					switch(entry.type())
+				case auto_mode_entry::Op:
+					if (!aUser.is_operator())
 					{
-					case auto_mode_entry::Op:
-						if (!aUser.is_operator())
-						{
-							modeMessage.parameters().push_back("+o");
-							modeMessage.parameters().push_back(aUser.nick_name());
-							send = true;
-						}
-						break;
-					case auto_mode_entry::Voice:
-						if (!aUser.is_voice() && !aUser.is_operator())
-						{
-							modeMessage.parameters().push_back("+v");
-							modeMessage.parameters().push_back(aUser.nick_name());
-							send = true;
-						}
-						break;
-					case auto_mode_entry::BanKick:
-						modeMessage.parameters().push_back("+b");
-						modeMessage.parameters().push_back(aUser.ban_mask());
+						modeMessage.parameters().push_back("+o");
+						modeMessage.parameters().push_back(aUser.nick_name());
 						send = true;
-						break;
 					}
-					if (send)
-						aConnection.send_message(modeMessage);
-					if (entry.type() == auto_mode_entry::BanKick)
+					break;
+				case auto_mode_entry::Voice:
+					if (!aUser.is_voice() && !aUser.is_operator())
 					{
-						message kickMessage(aConnection, message::OUTGOING);
-						kickMessage.set_command(message::KICK);
-						kickMessage.parameters().push_back(aChannel.name());
-						kickMessage.parameters().push_back(aUser.nick_name());
-						kickMessage.parameters().push_back(entry.data());
-						aConnection.send_message(kickMessage);
+						modeMessage.parameters().push_back("+v");
+						modeMessage.parameters().push_back(aUser.nick_name());
+						send = true;
 					}
+					break;
+				case auto_mode_entry::BanKick:
+					modeMessage.parameters().push_back("+b");
+					modeMessage.parameters().push_back(aUser.ban_mask());
+					send = true;
+					break;
+				}
+				if (send)
+					aConnection.send_message(modeMessage);
+				if (entry.type() == auto_mode_entry::BanKick)
+				{
+					message kickMessage(aConnection, message::OUTGOING);
+					kickMessage.set_command(message::KICK);
+					kickMessage.set_background(true);
+					kickMessage.parameters().push_back(aChannel.name());
+					kickMessage.parameters().push_back(aUser.nick_name());
+					kickMessage.parameters().push_back(entry.data());
+					aConnection.send_message(kickMessage);
 				}
+			}
 		}
 	}
 
@@ -131,11 +134,26 @@ namespace irc
 	void auto_mode_watcher::buffer_removed(buffer& aBuffer)
 	{
 		if (aBuffer.type() == buffer::CHANNEL)
+		{
 			iWatchedChannels.remove(static_cast<channel_buffer*>(&aBuffer));
+			iPopulatedChannels.erase(static_cast<channel_buffer*>(&aBuffer));
+		}
+	}
+
+	void auto_mode_watcher::connection_disconnected(connection& aConnection)
+	{
+		for (populated_channels::iterator i = iPopulatedChannels.begin(); i != iPopulatedChannels.end();)
+			if (&(*i)->connection() == &aConnection)
+				i = iPopulatedChannels.erase(i);
+			else
+				++i;
 	}
 
 	void auto_mode_watcher::user_added(channel_buffer& aBuffer, channel_user_list::iterator aUser)
 	{
+		// names arriving in a NAMES reply are evaluated together once the list is complete
+		if (aBuffer.updating_user_list())
+			return;
 		process_user(aBuffer.connection(), *aUser, aBuffer);
 	}
 
@@ -155,6 +173,23 @@ namespace irc
 		}
 	}
 
+	void auto_mode_watcher::user_removed(channel_buffer& aBuffer, channel_user_list::iterator aUser)
+	{
+		if (!aBuffer.updating_user_list() && aUser->nick_name() == aBuffer.connection().nick_name())
+			iPopulatedChannels.erase(&aBuffer);
+	}
+
+	void auto_mode_watcher::user_list_updated(channel_buffer& aBuffer)
+	{
+		if (std::find(iWatchedChannels.begin(), iWatchedChannels.end(), &aBuffer) == iWatchedChannels.end())
+			return;
+		// a NAMES refresh of a channel we have already evaluated only restates its membership
+		if (!iPopulatedChannels.insert(&aBuffer).second)
+			return;
+		for (channel_user_list::const_iterator i = aBuffer.users().begin(); i != aBuffer.users().end(); ++i)
+			process_user(aBuffer.connection(), *i, aBuffer);
+	}
+
 	void auto_mode_watcher::user_host_info(channel_buffer& aBuffer, channel_user_list::iterator aUser)
 	{
 		process_user(aBuffer.connection(), *aUser, aBuffer);
@@ -0,0 +1,239 @@
+// background_executor.cpp
+/*
+ *  Copyright (c) 2010 Leigh Johnston.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ *     * Neither the name of Leigh Johnston nor the names of any
+ *       other contributors to this software may be used to endorse or
+ *       promote products derived from this software without specific prior
+ *       written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ *  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <neolib/neolib.hpp>
+#include <algorithm>
+#include <neoirc/client/background_executor.hpp>
+
+namespace irc
+{
+	background_job::state_e background_job::state() const
+	{
+		std::lock_guard<std::mutex> lock(iMutex);
+		return iState;
+	}
+
+	void background_job::cancel()
+	{
+		iCancelled = true;
+		std::lock_guard<std::mutex> lock(iMutex);
+		if (iState == Queued)
+			iState = Cancelled;
+		iStateChanged.notify_all();
+	}
+
+	void background_job::wait() const
+	{
+		std::unique_lock<std::mutex> lock(iMutex);
+		iStateChanged.wait(lock, [this]() { return iState != Running; });
+	}
+
+	void background_job::wait_done() const
+	{
+		std::unique_lock<std::mutex> lock(iMutex);
+		iStateChanged.wait(lock, [this]() { return iState == Idle || iState == Finished || iState == Cancelled; });
+	}
+
+	void background_job::progress()
+	{
+		if (iExecutor != 0 && !iCancelled)
+			iExecutor->job_progressed(shared_from_this());
+	}
+
+	void background_job::set_state(state_e aState)
+	{
+		std::lock_guard<std::mutex> lock(iMutex);
+		if (iState == Cancelled)
+			return;
+		iState = aState;
+		iStateChanged.notify_all();
+	}
+
+	bool background_job::try_start()
+	{
+		std::lock_guard<std::mutex> lock(iMutex);
+		if (iCancelled || iState == Cancelled)
+		{
+			iState = Cancelled;
+			iStateChanged.notify_all();
+			return false;
+		}
+		iState = Running;
+		iStateChanged.notify_all();
+		return true;
+	}
+
+	background_executor::background_executor(neolib::io_task& aOwnerTask, std::size_t aWorkerCount) :
+		iStopping(false), iRunning(0),
+		iCompletionTimer(aOwnerTask, [this](neolib::callback_timer&) { process_completed(); if (outstanding()) iCompletionTimer.again(); }, 10, false)
+	{
+		if (aWorkerCount == 0)
+			aWorkerCount = 1;
+		for (std::size_t i = 0; i < aWorkerCount; ++i)
+			iWorkers.push_back(std::thread([this]() { worker(); }));
+	}
+
+	background_executor::~background_executor()
+	{
+		{
+			std::lock_guard<std::mutex> lock(iMutex);
+			iStopping = true;
+		}
+		iWorkAvailable.notify_all();
+		for (std::vector<std::thread>::iterator i = iWorkers.begin(); i != iWorkers.end(); ++i)
+			i->join();
+	}
+
+	void background_executor::post(background_job_pointer aJob, lane_e aLane)
+	{
+		if (aJob->cancelled())
+			return;
+		aJob->iExecutor = this;
+		aJob->set_state(background_job::Queued);
+		{
+			std::lock_guard<std::mutex> lock(iMutex);
+			iLanes[aLane].push_back(aJob);
+		}
+		iWorkAvailable.notify_one();
+		if (!iCompletionTimer.waiting())
+			iCompletionTimer.again();
+	}
+
+	background_job_pointer background_executor::post(const std::function<void()>& aWork, const std::function<void()>& aCompletion, lane_e aLane)
+	{
+		background_job_pointer newJob(new function_job(aWork, aCompletion));
+		post(newJob, aLane);
+		return newJob;
+	}
+
+	void background_executor::prioritise(background_job& aJob, lane_e aLane)
+	{
+		std::lock_guard<std::mutex> lock(iMutex);
+		for (std::size_t l = 0; l < LaneCount; ++l)
+		{
+			for (lane::iterator i = iLanes[l].begin(); i != iLanes[l].end(); ++i)
+			{
+				if (&**i == &aJob)
+				{
+					if (l == static_cast<std::size_t>(aLane))
+						return;
+					background_job_pointer theJob = *i;
+					iLanes[l].erase(i);
+					iLanes[aLane].push_front(theJob);
+					return;
+				}
+			}
+		}
+	}
+
+	std::size_t background_executor::pending() const
+	{
+		std::lock_guard<std::mutex> lock(iMutex);
+		std::size_t ret = 0;
+		for (std::size_t l = 0; l < LaneCount; ++l)
+			ret += iLanes[l].size();
+		return ret;
+	}
+
+	void background_executor::worker()
+	{
+		std::unique_lock<std::mutex> lock(iMutex);
+		for (;;)
+		{
+			iWorkAvailable.wait(lock, [this]() { return iStopping || !iLanes[High].empty() || !iLanes[Normal].empty() || !iLanes[Low].empty(); });
+			background_job_pointer theJob;
+			for (std::size_t l = 0; !theJob && l < LaneCount; ++l)
+				if (!iLanes[l].empty())
+				{
+					theJob = iLanes[l].front();
+					iLanes[l].pop_front();
+				}
+			if (!theJob)
+				return; // stopping and nothing left to do
+			++iRunning;
+			lock.unlock();
+			if (theJob->try_start())
+			{
+				try
+				{
+					theJob->run();
+				}
+				catch (...)
+				{
+				}
+				theJob->set_state(theJob->cancelled() ? background_job::Cancelled : background_job::Finished);
+			}
+			lock.lock();
+			--iRunning;
+			if (theJob->state() == background_job::Finished)
+				iCompleted.push_back(theJob);
+		}
+	}
+
+	void background_executor::job_progressed(background_job_pointer aJob)
+	{
+		std::lock_guard<std::mutex> lock(iMutex);
+		if (std::find(iProgressed.begin(), iProgressed.end(), aJob) == iProgressed.end())
+			iProgressed.push_back(aJob);
+	}
+
+	bool background_executor::outstanding() const
+	{
+		std::lock_guard<std::mutex> lock(iMutex);
+		if (iRunning != 0 || !iProgressed.empty() || !iCompleted.empty())
+			return true;
+		for (std::size_t l = 0; l < LaneCount; ++l)
+			if (!iLanes[l].empty())
+				return true;
+		return false;
+	}
+
+	void background_executor::process_completed()
+	{
+		std::vector<background_job_pointer> progressed;
+		std::vector<background_job_pointer> completed;
+		{
+			std::lock_guard<std::mutex> lock(iMutex);
+			progressed.swap(iProgressed);
+			completed.swap(iCompleted);
+		}
+		for (std::vector<background_job_pointer>::iterator i = progressed.begin(); i != progressed.end(); ++i)
+			if (!(*i)->cancelled())
+				(*i)->progressed();
+		for (std::vector<background_job_pointer>::iterator i = completed.begin(); i != completed.end(); ++i)
+			if (!(*i)->cancelled())
+				(*i)->completed();
+	}
+}
@@ -0,0 +1,387 @@
+// ban_evaluator.cpp
+/*
+ *  Copyright (c) 2010 Leigh Johnston.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ *     * Neither the name of Leigh Johnston nor the names of any
+ *       other contributors to this software may be used to endorse or
+ *       promote products derived from this software without specific prior
+ *       written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ *  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <neolib/neolib.hpp>
+#include <algorithm>
+#include <neoirc/client/ban_evaluator.hpp>
+
+namespace irc
+{
+	ban_evaluator::compiled_mask::compiled_mask(casemapping::type aCasemapping, const std::string& aMask) : 
+		iMask(aMask), iExtended(false), iCount(1)
+	{
+		if (!aMask.empty() && (aMask[0] == '$' || (aMask[0] == '~' && aMask.size() >= 3 && aMask[2] == ':')))
+		{
+			iExtended = true;
+			return;
+		}
+		std::string::size_type at = aMask.rfind('@');
+		std::string nickUser = (at == std::string::npos ? aMask : aMask.substr(0, at));
+		std::string hostName = (at == std::string::npos ? std::string() : aMask.substr(at + 1));
+		std::string::size_type bang = nickUser.find('!');
+		std::string nickName;
+		std::string userName;
+		if (bang != std::string::npos)
+		{
+			nickName = nickUser.substr(0, bang);
+			userName = nickUser.substr(bang + 1);
+		}
+		else if (at != std::string::npos)
+			userName = nickUser; // "user@host"
+		else
+			nickName = nickUser; // "nick"
+		iNickName = mask(aCasemapping, nickName.empty() ? std::string("*") : nickName);
+		iUserName = mask(aCasemapping, userName.empty() ? std::string("*") : userName);
+		iHostName = mask(aCasemapping, hostName.empty() ? std::string("*") : hostName);
+	}
+
+	bool ban_evaluator::compiled_mask::matches(const user_state& aUser) const
+	{
+		if (iExtended)
+			return false;
+		// a user whose user or host name is not yet known is only matched by a mask that does not care about it
+		return iNickName.matches(aUser.iNickName) &&
+			(aUser.iUserName.empty() ? iUserName.any() : iUserName.matches(aUser.iUserName)) &&
+			(aUser.iHostName.empty() ? iHostName.any() : iHostName.matches(aUser.iHostName));
+	}
+
+	ban_evaluator::ban_evaluator(channel_modes& aModes) : 
+		iModes(aModes), iChannel(aModes.channel())
+	{
+		for (channel_user_list::const_iterator i = iChannel.users().begin(); i != iChannel.users().end(); ++i)
+			add_user(*i);
+		load(Bans, iModes.ban_list());
+		load(Excepts, iModes.except_list());
+		iModes.add_observer(*this);
+		iChannel.neolib::observable<channel_buffer_observer>::add_observer(*this);
+	}
+
+	ban_evaluator::~ban_evaluator()
+	{
+		iChannel.neolib::observable<channel_buffer_observer>::remove_observer(*this);
+		iModes.remove_observer(*this);
+	}
+
+	bool ban_evaluator::is_banned(const channel_user& aUser) const
+	{
+		user_states::const_iterator i = iUsers.find(&aUser);
+		return i != iUsers.end() && i->second.banned();
+	}
+
+	std::size_t ban_evaluator::banned_users(user_list& aUsers) const
+	{
+		for (user_states::const_iterator i = iUsers.begin(); i != iUsers.end(); ++i)
+			if (i->second.banned())
+				aUsers.push_back(i->first);
+		return aUsers.size();
+	}
+
+	std::size_t ban_evaluator::affected_users(const std::string& aMask, user_list& aUsers) const
+	{
+		matching(compiled_mask(casemapping(), aMask), aUsers);
+		return aUsers.size();
+	}
+
+	std::size_t ban_evaluator::covering_bans(const user& aUser, mask_list& aBans) const
+	{
+		user_state theUser;
+		fold_user(aUser, theUser);
+		for (compiled_masks::const_iterator i = iBans.begin(); i != iBans.end(); ++i)
+			if (i->second.matches(theUser))
+				aBans.push_back(i->second.iMask);
+		return aBans.size();
+	}
+
+	casemapping::type ban_evaluator::casemapping() const
+	{
+		return iChannel.connection().casemapping();
+	}
+
+	void ban_evaluator::fold_user(const user& aUser, user_state& aState) const
+	{
+		aState.iNickName = fold_case(casemapping(), aUser.nick_name());
+		if (aUser.has_user_name())
+			aState.iUserName = fold_case(casemapping(), aUser.user_name());
+		if (aUser.has_host_name())
+			aState.iHostName = fold_case(casemapping(), aUser.host_name());
+	}
+
+	void ban_evaluator::matching(const compiled_mask& aMask, user_list& aUsers) const
+	{
+		if (aMask.iExtended)
+			return;
+		if (aMask.iHostName.kind() == mask::Literal)
+		{
+			host_index::const_iterator theHost = iHosts.find(aMask.iHostName.literal());
+			if (theHost == iHosts.end())
+				return;
+			for (user_list::const_iterator i = theHost->second.begin(); i != theHost->second.end(); ++i)
+				if (aMask.matches(iUsers.find(*i)->second))
+					aUsers.push_back(*i);
+		}
+		else
+		{
+			for (user_states::const_iterator i = iUsers.begin(); i != iUsers.end(); ++i)
+				if (aMask.matches(i->second))
+					aUsers.push_back(i->first);
+		}
+	}
+
+	void ban_evaluator::adjust(list_e aList, const user_list& aUsers, bool aIncrement)
+	{
+		for (user_list::const_iterator i = aUsers.begin(); i != aUsers.end(); ++i)
+		{
+			user_state& theUser = iUsers.find(*i)->second;
+			std::size_t& theCount = (aList == Bans ? theUser.iBans : theUser.iExcepts);
+			if (aIncrement)
+				++theCount;
+			else if (theCount != 0)
+				--theCount;
+		}
+	}
+
+	const ban_evaluator::user_state& ban_evaluator::add_user(const channel_user& aUser)
+	{
+		user_state& theUser = iUsers[&aUser];
+		theUser = user_state();
+		fold_user(aUser, theUser);
+		for (compiled_masks::const_iterator i = iBans.begin(); i != iBans.end(); ++i)
+			if (i->second.matches(theUser))
+				++theUser.iBans;
+		for (compiled_masks::const_iterator i = iExcepts.begin(); i != iExcepts.end(); ++i)
+			if (i->second.matches(theUser))
+				++theUser.iExcepts;
+		if (!theUser.iHostName.empty())
+			iHosts[theUser.iHostName].push_back(&aUser);
+		return theUser;
+	}
+
+	void ban_evaluator::remove_user(const channel_user& aUser)
+	{
+		user_states::iterator theUser = iUsers.find(&aUser);
+		if (theUser == iUsers.end())
+			return;
+		host_index::iterator theHost = iHosts.find(theUser->second.iHostName);
+		if (theHost != iHosts.end())
+		{
+			user_list::iterator i = std::find(theHost->second.begin(), theHost->second.end(), &aUser);
+			if (i != theHost->second.end())
+			{
+				*i = theHost->second.back();
+				theHost->second.pop_back();
+			}
+			if (theHost->second.empty())
+				iHosts.erase(theHost);
+		}
+		iUsers.erase(theUser);
+	}
+
+	const ban_evaluator::compiled_mask* ban_evaluator::insert_mask(list_e aList, const std::string& aMask)
+	{
+		std::string theKey = fold_case(casemapping(), aMask);
+		compiled_masks::iterator existing = masks(aList).find(theKey);
+		if (existing != masks(aList).end())
+		{
+			++existing->second.iCount;
+			return 0;
+		}
+		return &masks(aList).insert(std::make_pair(theKey, compiled_mask(casemapping(), aMask))).first->second;
+	}
+
+	void ban_evaluator::add_mask(list_e aList, const std::string& aMask)
+	{
+		const compiled_mask* theMask = insert_mask(aList, aMask);
+		if (theMask == 0)
+			return;
+		user_list theUsers;
+		matching(*theMask, theUsers);
+		std::vector<bool> wasBanned;
+		for (user_list::const_iterator i = theUsers.begin(); i != theUsers.end(); ++i)
+			wasBanned.push_back(iUsers.find(*i)->second.banned());
+		adjust(aList, theUsers, true);
+		changed(theUsers, wasBanned);
+	}
+
+	void ban_evaluator::remove_mask(list_e aList, const std::string& aMask)
+	{
+		compiled_masks::iterator theMask = masks(aList).find(fold_case(casemapping(), aMask));
+		if (theMask == masks(aList).end())
+			return;
+		if (--theMask->second.iCount != 0)
+			return;
+		user_list theUsers;
+		matching(theMask->second, theUsers);
+		masks(aList).erase(theMask);
+		std::vector<bool> wasBanned;
+		for (user_list::const_iterator i = theUsers.begin(); i != theUsers.end(); ++i)
+			wasBanned.push_back(iUsers.find(*i)->second.banned());
+		adjust(aList, theUsers, false);
+		changed(theUsers, wasBanned);
+	}
+
+	void ban_evaluator::load(list_e aList, const channel_modes::container_type& aEntries)
+	{
+		user_list everyone;
+		std::vector<bool> wasBanned;
+		everyone.reserve(iUsers.size());
+		wasBanned.reserve(iUsers.size());
+		for (user_states::iterator i = iUsers.begin(); i != iUsers.end(); ++i)
+		{
+			everyone.push_back(i->first);
+			wasBanned.push_back(i->second.banned());
+			(aList == Bans ? i->second.iBans : i->second.iExcepts) = 0;
+		}
+		masks(aList).clear();
+		user_list theUsers;
+		for (channel_modes::container_type::const_iterator i = aEntries.begin(); i != aEntries.end(); ++i)
+		{
+			const compiled_mask* theMask = insert_mask(aList, std::string(i->iUser.c_str()));
+			if (theMask == 0)
+				continue;
+			theUsers.clear();
+			matching(*theMask, theUsers);
+			adjust(aList, theUsers, true);
+		}
+		changed(everyone, wasBanned);
+	}
+
+	void ban_evaluator::changed(const user_list& aUsers, const std::vector<bool>& aWasBanned)
+	{
+		user_list banned;
+		user_list unbanned;
+		for (std::size_t i = 0; i != aUsers.size(); ++i)
+		{
+			bool isBanned = iUsers.find(aUsers[i])->second.banned();
+			if (isBanned && !aWasBanned[i])
+				banned.push_back(aUsers[i]);
+			else if (!isBanned && aWasBanned[i])
+				unbanned.push_back(aUsers[i]);
+		}
+		if (!banned.empty())
+			notify_observers(ban_evaluator_observer::NotifyUsersBanned, banned);
+		if (!unbanned.empty())
+			notify_observers(ban_evaluator_observer::NotifyUsersUnbanned, unbanned);
+	}
+
+	void ban_evaluator::notify_observer(ban_evaluator_observer& aObserver, ban_evaluator_observer::notify_type aType, const void* aParameter, const void* aParameter2)
+	{
+		switch(aType)
+		{
+		case ban_evaluator_observer::NotifyUsersBanned:
+			aObserver.users_banned(*this, *static_cast<const user_list*>(aParameter));
+			break;
+		case ban_evaluator_observer::NotifyUsersUnbanned:
+			aObserver.users_unbanned(*this, *static_cast<const user_list*>(aParameter));
+			break;
+		}
+	}
+
+	void ban_evaluator::channel_modes_ban_list_entry_added(const channel_modes& aModes, const channel_modes_entry& aEntry)
+	{
+		add_mask(Bans, std::string(aEntry.iUser.c_str()));
+	}
+
+	void ban_evaluator::channel_modes_ban_list_entry_removed(const channel_modes& aModes, const channel_modes_entry& aEntry)
+	{
+		remove_mask(Bans, std::string(aEntry.iUser.c_str()));
+	}
+
+	void ban_evaluator::channel_modes_except_list_entry_added(const channel_modes& aModes, const channel_modes_entry& aEntry)
+	{
+		add_mask(Excepts, std::string(aEntry.iUser.c_str()));
+	}
+
+	void ban_evaluator::channel_modes_except_list_entry_removed(const channel_modes& aModes, const channel_modes_entry& aEntry)
+	{
+		remove_mask(Excepts, std::string(aEntry.iUser.c_str()));
+	}
+
+	void ban_evaluator::user_added(channel_buffer& aBuffer, channel_user_list::iterator aUser)
+	{
+		const user_state& theUser = add_user(*aUser);
+		if (aBuffer.updating_user_list() || !theUser.banned())
+			return; // a new NAMES list is reported as a whole when it ends
+		user_list theUsers(1, &*aUser);
+		notify_observers(ban_evaluator_observer::NotifyUsersBanned, theUsers);
+	}
+
+	void ban_evaluator::user_updated(channel_buffer& aBuffer, channel_user_list::iterator aOldUser, channel_user_list::iterator aNewUser)
+	{
+		bool wasBanned = is_banned(*aOldUser);
+		remove_user(*aOldUser);
+		add_user(*aNewUser);
+		changed(user_list(1, &*aNewUser), std::vector<bool>(1, wasBanned));
+	}
+
+	void ban_evaluator::user_removed(channel_buffer& aBuffer, channel_user_list::iterator aUser)
+	{
+		remove_user(*aUser);
+	}
+
+	void ban_evaluator::user_host_info(channel_buffer& aBuffer, channel_user_list::iterator aUser)
+	{
+		bool wasBanned = is_banned(*aUser);
+		remove_user(*aUser);
+		add_user(*aUser);
+		changed(user_list(1, &*aUser), std::vector<bool>(1, wasBanned));
+	}
+
+	void ban_evaluator::user_list_updating(channel_buffer& aBuffer)
+	{
+		iBannedBeforeUpdate.clear();
+		for (user_states::const_iterator i = iUsers.begin(); i != iUsers.end(); ++i)
+			if (i->second.banned())
+				iBannedBeforeUpdate.insert(i->second.iNickName);
+	}
+
+	void ban_evaluator::user_list_updated(channel_buffer& aBuffer)
+	{
+		user_list banned;
+		user_list unbanned;
+		for (user_states::const_iterator i = iUsers.begin(); i != iUsers.end(); ++i)
+		{
+			bool wasBanned = iBannedBeforeUpdate.find(i->second.iNickName) != iBannedBeforeUpdate.end();
+			if (i->second.banned() && !wasBanned)
+				banned.push_back(i->first);
+			else if (!i->second.banned() && wasBanned)
+				unbanned.push_back(i->first);
+		}
+		iBannedBeforeUpdate.clear();
+		if (!banned.empty())
+			notify_observers(ban_evaluator_observer::NotifyUsersBanned, banned);
+		if (!unbanned.empty())
+			notify_observers(ban_evaluator_observer::NotifyUsersUnbanned, unbanned);
+	}
+}
@@ -35,6 +35,8 @@
 
 #include <neolib/neolib.hpp>
 #include <ctime>
+#include <sstream>
+#include <iomanip>
 #include <neoirc/client/buffer.hpp>
 #include <neoirc/client/connection.hpp>
 #include <neoirc/client/connection_manager.hpp>
@@ -45,6 +47,7 @@
 #include <neoirc/client/ignore.hpp>
 #include <neoirc/client/macros.hpp>
 #include <neoirc/client/auto_joins.hpp>
+#include <neoirc/client/logger.hpp>
 
 namespace irc
 {
@@ -312,7 +315,8 @@ namespace irc
 		{"ECHO", internal_command::ECHO},
 		{"XYZZY", internal_command::XYZZY},
 		{"FINDUSER", internal_command::FINDUSER},
-		{"TIMER", internal_command::TIMER}
+		{"TIMER", internal_command::TIMER},
+		{"SCROLLBACK", internal_command::SCROLLBACK}
 	};
 
 	std::pair<internal_command::command_e, std::string> get_internal_command(const std::string& aCommand)
@@ -740,6 +744,32 @@ namespace irc
 							}
 						}
 						break;
+					case internal_command::SCROLLBACK:
+						{
+							const char* const usage = "Usage: /scrollback <yyyy-mm-dd> [hh:mm]";
+							std::tm tmTime = {};
+							std::istringstream when(command.size() > 1 ? std::string(command[1].first, strMessage.end()) : std::string());
+							when >> std::get_time(&tmTime, "%Y-%m-%d");
+							if (when.fail())
+							{
+								echo(usage);
+								break;
+							}
+							when >> std::ws;
+							if (!when.eof())
+							{
+								when >> std::get_time(&tmTime, "%H:%M");
+								if (when.fail())
+								{
+									echo(usage);
+									break;
+								}
+							}
+							tmTime.tm_isdst = -1;
+							if (!iModel.logger().scrollback_from(*this, std::mktime(&tmTime)))
+								echo("Scrollback logging is off or scrollback is still loading.");
+						}
+						break;
 					case internal_command::TIMER:
 						{
 							const char* const addUsage = "Usage: /timer name=<name> interval=<interval in seconds> [repeat=<repeat count>] <command>";
@@ -0,0 +1,195 @@
+// capabilities.cpp
+/*
+ *  Copyright (c) 2010 Leigh Johnston.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ *     * Neither the name of Leigh Johnston nor the names of any
+ *       other contributors to this software may be used to endorse or
+ *       promote products derived from this software without specific prior
+ *       written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ *  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <neolib/neolib.hpp>
+#include <neolib/string_utils.hpp>
+#include <neoirc/client/capabilities.hpp>
+
+namespace irc
+{
+	capabilities::capabilities(connection& aConnection) : iConnection(aConnection), iNegotiating(false)
+	{
+		iConnection.add_observer(*this);
+	}
+
+	capabilities::~capabilities()
+	{
+		iConnection.remove_observer(*this);
+	}
+
+	void capabilities::want(const std::string& aCapability)
+	{
+		if (!iWanted.insert(aCapability).second)
+			return;
+		if (!iNegotiating && offered(aCapability))
+			request();
+	}
+
+	const std::string& capabilities::value(const std::string& aCapability) const
+	{
+		static const std::string sNone;
+		capability_values::const_iterator i = iOffered.find(aCapability);
+		return i != iOffered.end() ? i->second : sNone;
+	}
+
+	void capabilities::begin()
+	{
+		iOffered.clear();
+		iRequested.clear();
+		iEnabled.clear();
+		iNegotiating = true;
+		send("LS", "302");
+	}
+
+	bool capabilities::new_message(const message& aMessage)
+	{
+		// <target> <subcommand> [*] :<capabilities>; a "*" marks a reply continued on further lines
+		if (aMessage.parameters().size() < 3)
+			return false;
+		const std::string& subcommand = aMessage.parameters()[1];
+		bool more = (aMessage.parameters().size() >= 4 && aMessage.parameters()[2] == "*");
+		capability_values theCapabilities;
+		parse(aMessage.parameters().back(), theCapabilities);
+		if (subcommand == "LS" || subcommand == "NEW")
+		{
+			for (capability_values::const_iterator i = theCapabilities.begin(); i != theCapabilities.end(); ++i)
+				iOffered[i->first] = i->second;
+			if (more)
+				return true;
+			request();
+			if (iRequested.empty())
+				end();
+		}
+		else if (subcommand == "ACK" || subcommand == "NAK")
+		{
+			for (capability_values::const_iterator i = theCapabilities.begin(); i != theCapabilities.end(); ++i)
+			{
+				iRequested.erase(i->first);
+				if (subcommand == "NAK" || i->first.empty())
+					continue;
+				if (i->first[0] == '-')
+				{
+					if (iEnabled.erase(i->first.substr(1)) != 0)
+						notify_observers(capabilities_observer::NotifyCapabilityDisabled, i->first.substr(1));
+				}
+				else if (iEnabled.insert(i->first).second)
+					notify_observers(capabilities_observer::NotifyCapabilityEnabled, i->first);
+			}
+			if (iRequested.empty())
+				end();
+		}
+		else if (subcommand == "DEL")
+		{
+			for (capability_values::const_iterator i = theCapabilities.begin(); i != theCapabilities.end(); ++i)
+			{
+				iOffered.erase(i->first);
+				iRequested.erase(i->first);
+				if (iEnabled.erase(i->first) != 0)
+					notify_observers(capabilities_observer::NotifyCapabilityDisabled, i->first);
+			}
+		}
+		else
+			return false;
+		return true;
+	}
+
+	void capabilities::request()
+	{
+		std::string request;
+		for (capability_list::const_iterator i = iWanted.begin(); i != iWanted.end(); ++i)
+			if (offered(*i) && !enabled(*i) && iRequested.find(*i) == iRequested.end())
+			{
+				if (!request.empty() && request.size() + 1 + i->size() > message::MaxMessageSize - 16)
+				{
+					send("REQ", request);
+					request.clear();
+				}
+				iRequested.insert(*i);
+				request += (request.empty() ? "" : " ") + *i;
+			}
+		if (!request.empty())
+			send("REQ", request);
+	}
+
+	void capabilities::send(const std::string& aSubcommand, const std::string& aParameter)
+	{
+		message capMessage(iConnection, message::OUTGOING);
+		capMessage.set_command(message::CAP);
+		capMessage.parameters().push_back(aSubcommand);
+		if (!aParameter.empty())
+			capMessage.parameters().push_back(aParameter);
+		iConnection.send_message(capMessage);
+	}
+
+	void capabilities::end()
+	{
+		if (!iNegotiating)
+			return;
+		iNegotiating = false;
+		send("END");
+	}
+
+	void capabilities::parse(const std::string& aList, capability_values& aCapabilities)
+	{
+		std::vector<std::string> theCapabilities;
+		neolib::tokens(aList, std::string(" "), theCapabilities);
+		for (std::vector<std::string>::const_iterator i = theCapabilities.begin(); i != theCapabilities.end(); ++i)
+		{
+			std::string::size_type equals = i->find('=');
+			aCapabilities[i->substr(0, equals)] = (equals != std::string::npos ? i->substr(equals + 1) : std::string());
+		}
+	}
+
+	void capabilities::notify_observer(capabilities_observer& aObserver, capabilities_observer::notify_type aType, const void* aParameter, const void* aParameter2)
+	{
+		switch(aType)
+		{
+		case capabilities_observer::NotifyCapabilityEnabled:
+			aObserver.capability_enabled(iConnection, *static_cast<const std::string*>(aParameter));
+			break;
+		case capabilities_observer::NotifyCapabilityDisabled:
+			aObserver.capability_disabled(iConnection, *static_cast<const std::string*>(aParameter));
+			break;
+		}
+	}
+
+	void capabilities::connection_disconnected(connection& aConnection)
+	{
+		iOffered.clear();
+		iRequested.clear();
+		iEnabled.clear();
+		iNegotiating = false;
+	}
+}
@@ -36,6 +36,7 @@
 #include <neolib/neolib.hpp>
 #include <neoirc/client/channel_modes.hpp>
 #include <neoirc/client/mode.hpp>
+#include <neoirc/client/ban_evaluator.hpp>
 
 namespace irc
 {
@@ -46,11 +47,14 @@ namespace irc
 		message modeMessage(iParent, message::OUTGOING);
 		modeMessage.set_command(message::MODE);
 		modeMessage.parameters().push_back(aChannel.name());
+		modeMessage.set_background(true);
 		iParent.send_message(modeMessage);
+		iBanEvaluator.reset(new ban_evaluator(*this));
 	}
 
 	channel_modes::~channel_modes()
 	{
+		iBanEvaluator.reset();
 		iParent.connection().remove_observer(*this);
 	}
 
@@ -67,6 +71,9 @@ namespace irc
 		case channel_modes_observer::NotifyBanListReset:
 			aObserver.channel_modes_ban_list_reset(*this);
 			break;
+		case channel_modes_observer::NotifyBanListLoaded:
+			aObserver.channel_modes_ban_list_loaded(*this);
+			break;
 		case channel_modes_observer::NotifyExceptListEntryAdded:
 			aObserver.channel_modes_except_list_entry_added(*this, *static_cast<const channel_modes_entry*>(aParameter));
 			break;
@@ -76,6 +83,9 @@ namespace irc
 		case channel_modes_observer::NotifyExceptListReset:
 			aObserver.channel_modes_except_list_reset(*this);
 			break;
+		case channel_modes_observer::NotifyExceptListLoaded:
+			aObserver.channel_modes_except_list_loaded(*this);
+			break;
 		case channel_modes_observer::NotifyInviteListEntryAdded:
 			aObserver.channel_modes_invite_list_entry_added(*this, *static_cast<const channel_modes_entry*>(aParameter));
 			break;
@@ -85,6 +95,9 @@ namespace irc
 		case channel_modes_observer::NotifyInviteListReset:
 			aObserver.channel_modes_invite_list_reset(*this);
 			break;
+		case channel_modes_observer::NotifyInviteListLoaded:
+			aObserver.channel_modes_invite_list_loaded(*this);
+			break;
 		case channel_modes_observer::NotifyListDone:
 			aObserver.channel_modes_list_done(*this);
 			break;
@@ -109,63 +122,84 @@ namespace irc
 		switch(aMessage.command())
 		{
 		case message::RPL_BANLIST:
+			if (aMessage.parameters().size() < 2)
+				break;
+			if (irc::make_string(aConnection, aMessage.parameters()[0]) != iParent.name())
+				break;
 			if (iGotBanList)
 			{
 				iGotBanList = false;
 				iBanList.clear();
 				notify_observers(channel_modes_observer::NotifyBanListReset);
 			}
-			if (aMessage.parameters().size() < 2)
-				break;
-			if (irc::make_string(aConnection, aMessage.parameters()[0]) != iParent.name())
-				break;
 			iBanList.push_back(channel_modes_entry(irc::make_string(aConnection, aMessage.parameters()[1]), 
 				aMessage.parameters().size() >= 3 ? irc::make_string(aConnection, aMessage.parameters()[2]) : irc::make_string(aConnection, std::string("")),
 				aMessage.parameters().size() >= 4 ? channel_modes_entry::date(neolib::string_to_integer(aMessage.parameters()[3])) : channel_modes_entry::date()));
-			notify_observers(channel_modes_observer::NotifyBanListEntryAdded, iBanList.back());
 			break;
 		case message::RPL_ENDOFBANLIST:
+			if (!aMessage.parameters().empty() && irc::make_string(aConnection, aMessage.parameters()[0]) != iParent.name())
+				break;
+			if (iGotBanList && !iBanList.empty())
+			{
+				iBanList.clear();
+				notify_observers(channel_modes_observer::NotifyBanListReset);
+			}
 			iGotBanList = true;
+			notify_observers(channel_modes_observer::NotifyBanListLoaded);
 			notify_observers(channel_modes_observer::NotifyListDone);
 			break;
 		case message::RPL_EXCEPTLIST:
+			if (aMessage.parameters().size() < 2)
+				break;
+			if (irc::make_string(aConnection, aMessage.parameters()[0]) != iParent.name())
+				break;
 			if (iGotExceptList)
 			{
 				iGotExceptList = false;
 				iExceptList.clear();
 				notify_observers(channel_modes_observer::NotifyExceptListReset);
 			}
-			if (aMessage.parameters().size() < 2)
-				break;
-			if (irc::make_string(aConnection, aMessage.parameters()[0]) != iParent.name())
-				break;
 			iExceptList.push_back(channel_modes_entry(irc::make_string(aConnection, aMessage.parameters()[1]), 
 				aMessage.parameters().size() >= 3 ? irc::make_string(aConnection, aMessage.parameters()[2]) : irc::make_string(aConnection, std::string("")),
 				aMessage.parameters().size() >= 4 ? channel_modes_entry::date(neolib::string_to_integer(aMessage.parameters()[3])) : channel_modes_entry::date()));
-			notify_observers(channel_modes_observer::NotifyExceptListEntryAdded, iExceptList.back());
 			break;
 		case message::RPL_ENDOFEXCEPTLIST:
+			if (!aMessage.parameters().empty() && irc::make_string(aConnection, aMessage.parameters()[0]) != iParent.name())
+				break;
+			if (iGotExceptList && !iExceptList.empty())
+			{
+				iExceptList.clear();
+				notify_observers(channel_modes_observer::NotifyExceptListReset);
+			}
 			iGotExceptList = true;
+			notify_observers(channel_modes_observer::NotifyExceptListLoaded);
 			notify_observers(channel_modes_observer::NotifyListDone);
 			break;
 		case message::RPL_INVITELIST:
+			if (aMessage.parameters().size() < 2)
+				break;
+			if (irc::make_string(aConnection, aMessage.parameters()[0]) != iParent.name())
+				break;
 			if (iGotInviteList)
 			{
 				iGotInviteList = false;
 				iInviteList.clear();
 				notify_observers(channel_modes_observer::NotifyInviteListReset);
 			}
-			if (aMessage.parameters().size() < 2)
-				break;
-			if (irc::make_string(aConnection, aMessage.parameters()[0]) != iParent.name())
-				break;
 			iInviteList.push_back(channel_modes_entry(irc::make_string(aConnection, aMessage.parameters()[1]), 
 				aMessage.parameters().size() >= 3 ? irc::make_string(aConnection, aMessage.parameters()[2]) : irc::make_string(aConnection, std::string("")),
 				aMessage.parameters().size() >= 4 ? channel_modes_entry::date(neolib::string_to_integer(aMessage.parameters()[3])) : channel_modes_entry::date()));
-			notify_observers(channel_modes_observer::NotifyInviteListEntryAdded, iInviteList.back());
 			break;
 		case message::RPL_ENDOFINVITELIST:
+			if (!aMessage.parameters().empty() && irc::make_string(aConnection, aMessage.parameters()[0]) != iParent.name())
+				break;
+			if (iGotInviteList && !iInviteList.empty())
+			{
+				iInviteList.clear();
+				notify_observers(channel_modes_observer::NotifyInviteListReset);
+			}
 			iGotInviteList = true;
+			notify_observers(channel_modes_observer::NotifyInviteListLoaded);
 			notify_observers(channel_modes_observer::NotifyListDone);
 			break;
 		case message::RPL_CHANNELMODEIS:
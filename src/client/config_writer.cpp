@@ -0,0 +1,131 @@
+// config_writer.cpp
+/*
+ *  Copyright (c) 2010 Leigh Johnston.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ *     * Neither the name of Leigh Johnston nor the names of any
+ *       other contributors to this software may be used to endorse or
+ *       promote products derived from this software without specific prior
+ *       written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ *  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <neolib/neolib.hpp>
+#include <fstream>
+#include <boost/filesystem.hpp>
+#include <neoirc/client/config_writer.hpp>
+
+namespace irc
+{
+	config_writer::config_writer(neolib::io_task& aOwnerTask, background_executor& aExecutor, uint32_t aWindow_ms) : 
+		iOwnerTask(aOwnerTask), iExecutor(aExecutor), iWindow_ms(aWindow_ms)
+	{
+		set_window(aWindow_ms);
+	}
+
+	config_writer::~config_writer()
+	{
+		// serialisers refer to their owner so dirty stores must be flushed by the owner before this point
+		wait();
+	}
+
+	void config_writer::save(const std::string& aFileName, const std::string& aContents)
+	{
+		std::lock_guard<std::mutex> lock(iMutex);
+		iPending[aFileName] = aContents;
+		if (iInFlight.insert(aFileName).second)
+			iExecutor.post([this, aFileName]() { write_pending(aFileName); }, std::function<void()>(), background_executor::Low);
+	}
+
+	void config_writer::mark_dirty(const std::string& aStore, const serialiser& aSerialiser)
+	{
+		iDirty[aStore] = aSerialiser;
+		if (!iWindowTimer->waiting())
+			iWindowTimer->reset();
+	}
+
+	void config_writer::set_window(uint32_t aWindow_ms)
+	{
+		iWindow_ms = aWindow_ms;
+		iWindowTimer.reset(new neolib::callback_timer(iOwnerTask, [this](neolib::callback_timer&) { serialise_dirty(); }, iWindow_ms, false));
+		if (!iDirty.empty())
+			iWindowTimer->reset();
+	}
+
+	void config_writer::flush()
+	{
+		iWindowTimer->cancel();
+		serialise_dirty();
+		wait();
+	}
+
+	void config_writer::wait()
+	{
+		std::unique_lock<std::mutex> lock(iMutex);
+		iIdle.wait(lock, [this]() { return iInFlight.empty(); });
+	}
+
+	void config_writer::serialise_dirty()
+	{
+		std::map<std::string, serialiser> dirty;
+		dirty.swap(iDirty);
+		for (std::map<std::string, serialiser>::iterator i = dirty.begin(); i != dirty.end(); ++i)
+			i->second();
+	}
+
+	void config_writer::write_pending(const std::string& aFileName)
+	{
+		for (;;)
+		{
+			std::string contents;
+			{
+				std::lock_guard<std::mutex> lock(iMutex);
+				std::map<std::string, std::string>::iterator pending = iPending.find(aFileName);
+				if (pending == iPending.end())
+				{
+					iInFlight.erase(aFileName);
+					iIdle.notify_all();
+					return;
+				}
+				contents.swap(pending->second);
+				iPending.erase(pending);
+			}
+			std::string tempFileName = aFileName + ".tmp";
+			bool ok;
+			{
+				std::ofstream output(tempFileName.c_str());
+				output.write(contents.data(), contents.size());
+				output.close();
+				ok = !output.fail();
+			}
+			boost::system::error_code ec;
+			if (ok)
+				boost::filesystem::rename(tempFileName, aFileName, ec);
+			if (!ok || ec)
+				boost::filesystem::remove(tempFileName, ec);
+		}
+	}
+}
@@ -35,6 +35,7 @@
 
 #include <neolib/neolib.hpp>
 #include <ctime>
+#include <algorithm>
 #include <neoirc/client/connection.hpp>
 #include <neoirc/client/connection_manager.hpp>
 #include <neoirc/client/whois.hpp>
@@ -44,6 +45,12 @@
 #include <neoirc/client/notify.hpp>
 #include <neoirc/client/auto_mode.hpp>
 #include <neoirc/client/channel_list.hpp>
+#include <neoirc/client/capabilities.hpp>
+#include <neoirc/client/flood_scheduler.hpp>
+#include <neoirc/client/mode_aggregator.hpp>
+#include <neoirc/client/target_packer.hpp>
+#include <neoirc/client/join_scheduler.hpp>
+#include <neoirc/client/timestamp.hpp>
 
 namespace irc
 {
@@ -60,12 +67,13 @@ namespace irc
 			iEntries.push_back(entry(*aNewServer, 0));
 		if (theConnectionManager.reconnect_any_server())
 		{
-			for (server_list::iterator i = theConnectionManager.server_list().begin(); i != theConnectionManager.server_list().end(); ++i)
+			const server_list::servers& networkServers = theConnectionManager.server_list().network_servers(aConnection.server().network());
+			for (server_list::servers::const_iterator s = networkServers.begin(); s != networkServers.end(); ++s)
 			{
+				server_list::iterator i = *s;
 				if (aNewServer.valid() && *i == *aNewServer)
 					continue;
-				if (i->network() == aConnection.server().network() &&
-					i->secure() == aConnection.server().secure())
+				if (i->secure() == aConnection.server().secure())
 				{
 					bool isCurrentServer = (i->name() == aConnection.server().name());
 					iEntries.push_back(entry(*i, isCurrentServer ? 1 : 0));
@@ -139,16 +147,23 @@ namespace irc
 		iServer{ aServer }, iIdentity{ aIdentity },
 		iNickName{ aIdentity.nick_name() }, iPassword{ aPassword },
 		iUser{ aIdentity.nick_name(), casemapping::rfc1459, false },
-		iPacketStream{ aModel.io_task() },
+		iPacketStream{ aModel.io_task(), aConnectionManager.io_shards() },
 		iResolver{ aModel.io_task() },
 		iGotConnection{ false }, iConsole{ false }, iRegistered{ false }, iPreviouslyRegistered{ false }, iClosing{ false }, iQuitting{ false }, iChangingServer{ false },
-		iTimeLastMessageSent{ 0 },
+		iFloodScheduler{ std::make_unique<flood_scheduler>(*this, aModel.io_task()) },
+		iModeAggregator{ std::make_unique<mode_aggregator>(*this, aModel.io_task()) },
+		iTargetPacker{ std::make_unique<target_packer>(*this, *iFloodScheduler, aModel.io_task()) },
+		iBackgroundOutput{ false },
+		iCorked{ false },
 		iCasemapping{ casemapping::rfc1459 },
 		iWhoisRequester{ std::make_unique<whois_requester>(*this) },
 		iWhoRequester{ std::make_unique<who_requester>(*this) },
 		iDnsRequester{ std::make_unique<dns_requester>(*this) },
 		iChannelList{ std::make_unique<irc::channel_list>(*this) },
+		iCapabilities{ std::make_unique<irc::capabilities>(*this) },
+		iJoinScheduler{ std::make_unique<join_scheduler>(*this, aModel.io_task()) },
 		iPrefixes{ std::make_pair(std::string("ov"), std::string("@+")) },
+		iMaxModes{ 3 },
 		iChantypes{ "&#+!" },
 		iPinger{ aModel.io_task(), [this](neolib::callback_timer& aTimer)
 		{
@@ -164,8 +179,16 @@ namespace irc
 		iAwayUpdater{ aModel, *this }
 	{
 		iPacketStream.add_observer(*this);
+		iPacketStream.set_parsed_message_observer(*this);
 		iConnectionManager.add_observer(*this);
 		iConnectionManager.ignore_list().add_observer(*this);
+		iCapabilities->want("multi-prefix");
+		iCapabilities->want("userhost-in-names");
+		iCapabilities->want("away-notify");
+		iCapabilities->want("extended-join");
+		iCapabilities->want("batch");
+		iCapabilities->want("server-time");
+		iCapabilities->want("message-tags");
 		iConnectionManager.object_created(*this);
 	}
 
@@ -226,7 +249,7 @@ namespace irc
 				return false;
 		}
 
-		if (!iPacketStream.open(iServer.address().c_str(), iServer.port(iRandom), iServer.secure()))
+		if (!iPacketStream.open(iServer.address(), iServer.port(iRandom), iServer.secure()))
 		{
 			if (!iConnectionManager.auto_reconnect())
 				return false;
@@ -287,8 +310,7 @@ namespace irc
 			iMessageBuffer = iMessageBuffer.substr(messageEnd+1);
 			messageEnd = iMessageBuffer.find("\n");
 			message newMessage(*this, message::INCOMING);
-			newMessage.parse_command(messagePart);
-			newMessage.parse_parameters(messagePart, false, true);
+			newMessage.parse_incoming(messagePart);
 			receive_message(newMessage);
 		}
 	}
@@ -301,6 +323,10 @@ namespace irc
 		iGotConnection = false;
 		iRegistered = false;
 		iAlternateNickNames.reset();
+		iCorked = false;
+		iCorkedMessages.clear();
+		iMaxModes = 3;
+		iTargetLimits.clear();
 	}
 
 	bool connection::reconnect(const neolib::optional<irc::server>& aNewServer, bool aUserChangeServer)
@@ -379,7 +405,9 @@ namespace irc
 			reason.parameters().push_back(iConnectionManager.disconnected_message(iServer));
 
 		iMessageBuffer = "";
-		iFloodPreventionBuffer.clear();
+		iFloodScheduler->clear();
+		iModeAggregator->clear();
+		iTargetPacker->clear();
 
 		iHostQuery = false;
 		iHostName = "";
@@ -618,17 +646,9 @@ namespace irc
 			for (channel_buffer_list::iterator i = iChannelBuffers.begin(); i != iChannelBuffers.end(); ++i)
 				if (&*(*i).second == &aBuffer)
 				{
-					for (flood_prevention_buffer::iterator i = iFloodPreventionBuffer.begin(); i != iFloodPreventionBuffer.end();)
-					{
-						if (i->command() == message::PRIVMSG &&
-							i->parameters().size() > 0 &&
-							irc::make_string(*this, i->parameters()[0]) == aBuffer.name())
-								i = iFloodPreventionBuffer.erase(i);
-						else
-							++i;
-					}
-					if (iAwayUpdater.iNextChannel == i)
-						++iAwayUpdater.iNextChannel;
+					iFloodScheduler->remove_messages_to(aBuffer);
+					iModeAggregator->discard(aBuffer.name());
+					iAwayUpdater.channel_removed(static_cast<channel_buffer&>(aBuffer));
 					erase_object(iChannelBuffers, i);
 					break;
 				}
@@ -637,15 +657,7 @@ namespace irc
 			for (user_buffer_list::iterator i = iUserBuffers.begin(); i != iUserBuffers.end(); ++i)
 				if (&*((*i).second) == &aBuffer)
 				{
-					for (flood_prevention_buffer::iterator i = iFloodPreventionBuffer.begin(); i != iFloodPreventionBuffer.end();)
-					{
-						if (i->command() == message::PRIVMSG &&
-							i->parameters().size() > 0 &&
-							irc::make_string(*this, i->parameters()[0]) == aBuffer.name())
-								i = iFloodPreventionBuffer.erase(i);
-						else
-							++i;
-					}
+					iFloodScheduler->remove_messages_to(aBuffer);
 					erase_object(iUserBuffers, i);
 					break;
 				}
@@ -669,7 +681,7 @@ namespace irc
 		{
 			try
 			{
-				return iPacketStream.connection().local_end_point().address().to_v4().to_ulong();
+				return iPacketStream.local_address();
 			}
 			catch(...)
 			{
@@ -700,8 +712,12 @@ namespace irc
 			return false;
 		if (aMessage[aMessage.size()-1] != '\n')
 			throw bad_message();
+		if (iCorked)
+		{
+			iCorkedMessages += aMessage;
+			return true;
+		}
 		iPacketStream.send_packet(neolib::string_packet(aMessage.data(), aMessage.size()));
-		iTimeLastMessageSent = iModel.owner_thread().elapsed_ms();
 		return true;
 	}
 
@@ -714,12 +730,17 @@ namespace irc
 			if (filtered)
 				return true;
 		}
+		if (connected() && iModeAggregator->add(aMessage))
+			return true;
+		if (aMessage.command() == message::QUIT)
+			iModeAggregator->flush(); // before the buffers they are sent through go
+		else if (!aMessage.parameters().empty())
+			iModeAggregator->flush(aMessage.parameters()[0]); // keep pending mode changes ahead of anything else for the channel
 		if (!connected() && aMessage.command() != message::QUIT)
 		{
 			aBuffer.notify_observers(buffer_observer::NotifyMessageFailure, aMessage);
 			return false;
 		}
-		bool sendNow = !iConnectionManager.flood_prevention() || (iFloodPreventionBuffer.empty() && iModel.owner_thread().elapsed_ms() - iTimeLastMessageSent > iConnectionManager.flood_prevention_delay());
 		if (aMessage.command() == message::QUIT)
 		{
 			iQuitting = true;
@@ -729,16 +750,11 @@ namespace irc
 				close();
 				return true;
 			}
-			iAwayUpdater.iNextChannel = iChannelBuffers.end();
+			iAwayUpdater.clear();
 			erase_objects(iChannelBuffers, iChannelBuffers.begin(), iChannelBuffers.end());
 			erase_objects(iUserBuffers, iUserBuffers.begin(), iUserBuffers.end());
 			erase_object(iNoticeBuffer, iNoticeBuffer.begin());
 			erase_object(iServerBuffer, iServerBuffer.begin());
-			sendNow = true;
-		}
-		else if (aMessage.command() == message::PART)
-		{
-			sendNow = true;
 		}
 		notify_observers(connection_observer::NotifyOutgoingMessage, aMessage);
 		if (aMessage.command() == message::JOIN)
@@ -774,14 +790,10 @@ namespace irc
 				}
 			}
 		}
-		if (sendNow)
-		{
-			send_message(aMessage.to_string(iModel.message_strings()));
-			if (aMessage.command() == message::AWAY)
-				iWhoRequester->new_request(iNickName);
-		}
-		else
-			iFloodPreventionBuffer.push_back(aMessage);
+		flood_scheduler::lane theLane = flood_scheduler::classify(aMessage);
+		if (theLane == flood_scheduler::Interactive && iBackgroundOutput)
+			theLane = flood_scheduler::Bulk;
+		iTargetPacker->send(aMessage, theLane);
 		return true;
 	}
 
@@ -925,6 +937,7 @@ namespace irc
 			}
 			// fall through...
 		case message::RPL_ENDOFWHO:
+		case message::RPL_WHOSPCRPL:
 			if (!iWhoRequester->new_message(aMessage))
 				server_buffer().new_message(aMessage);
 			break;
@@ -997,7 +1010,6 @@ namespace irc
 				}
 				if (!iNoticeBuffer.empty())
 					notice_buffer().set_ready(true);
-				std::vector<message> rejoins;
 				for (channel_buffer_list::iterator i = iChannelBuffers.begin(); i != iChannelBuffers.end(); ++i)
 				{
 					channel_buffer& theBuffer = static_cast<channel_buffer&>(*(*i).second);
@@ -1007,17 +1019,10 @@ namespace irc
 						reconnected.parameters().push_back(iConnectionManager.reconnected_message(iServer));
 						theBuffer.new_message(reconnected);
 					}
-					message joinMessage(*this, message::OUTGOING);
-					joinMessage.set_command(message::JOIN);
-					joinMessage.parameters().push_back(theBuffer.name());
-					if (iConnectionManager.has_key(*this, theBuffer.name()))
-						joinMessage.parameters().push_back(iConnectionManager.key(*this, theBuffer.name()));
-					rejoins.push_back(joinMessage);
+					iJoinScheduler->join(theBuffer.name(), iConnectionManager.has_key(*this, theBuffer.name()) ? iConnectionManager.key(*this, theBuffer.name()) : std::string());
 				}
 				query_host();
 				notify_observers(connection_observer::NotifyConnectionRegistered);
-				for (std::vector<message>::const_iterator i = rejoins.begin(); i != rejoins.end(); ++i)
-					send_message(*i);
 				iPreviouslyRegistered = true;
 			}
 			server_buffer().new_message(aMessage);
@@ -1049,6 +1054,35 @@ namespace irc
 						iPrefixes.second = bits[1];
 					}
 				}
+				if (!param.empty() && param[0] == "MODES")
+				{
+					if (param.size() == 2 && !param[1].empty())
+						iMaxModes = std::max<std::size_t>(neolib::string_to_unsigned_integer(neolib::make_string(param[1])), 1);
+					else if (i->find('=') != std::string::npos)
+						iMaxModes = 3; // "MODES=": the RFC 2811 default
+					else
+						iMaxModes = static_cast<std::size_t>(-1); // "MODES": no limit
+				}
+				if (param.size() == 2 && param[0] == "TARGMAX")
+				{
+					std::vector<std::string> limits;
+					neolib::tokens(neolib::make_string(param[1]), std::string(","), limits);
+					for (std::vector<std::string>::const_iterator j = limits.begin(); j != limits.end(); ++j)
+					{
+						std::string::size_type colon = j->find(':');
+						if (colon == std::string::npos)
+							continue;
+						std::string limit = j->substr(colon + 1);
+						iTargetLimits[neolib::to_upper(j->substr(0, colon))] = limit.empty() ? static_cast<std::size_t>(-1) : 
+							std::max<std::size_t>(neolib::string_to_unsigned_integer(limit), 1);
+					}
+				}
+				if (param.size() == 2 && param[0] == "MAXTARGETS")
+				{
+					std::size_t limit = std::max<std::size_t>(neolib::string_to_unsigned_integer(neolib::make_string(param[1])), 1);
+					iTargetLimits.insert(std::make_pair(std::string("PRIVMSG"), limit)); // TARGMAX takes precedence
+					iTargetLimits.insert(std::make_pair(std::string("NOTICE"), limit));
+				}
 				if (param.size() == 2 && param[0] == "CHANTYPES")
 				{
 					iChantypes = neolib::make_string(param[1]);
@@ -1173,16 +1207,7 @@ namespace irc
 					std::string result = "\001TIME %T%\001";
 					std::string::size_type i = result.find("%T%");
 					if (i != std::string::npos)
-					{
-						std::tm *tmNow;
-						std::time_t timeNow;
-						std::time(&timeNow);
-						tmNow = std::localtime(&timeNow);
-						std::string strNow(asctime(tmNow));
-						if (strNow[strNow.size() - 1] == '\n')
-							strNow.erase(strNow.end() - 1);
-						result.replace(i, 3, strNow);
-					}
+						result.replace(i, 3, timestamp_formatter::instance().format(std::time(0), "%a %b %e %H:%M:%S %Y")); // asctime() layout, day space-padded
 					response.parameters().push_back(result);
 					send_message(response);
 					return;
@@ -1270,12 +1295,42 @@ namespace irc
 				if (!channel.empty())
 				{
 					buffer_from_name(channel, false).new_message(aMessage);
-					if ((iConnectionManager.auto_who() || iConnectionManager.away_update()) && 
+					// with userhost-in-names NAMES has already given us everyone's user@host
+					if (((iConnectionManager.auto_who() && !iCapabilities->enabled("userhost-in-names")) || iConnectionManager.away_update()) && 
 						aMessage.command() == message::RPL_ENDOFNAMES)
 						iWhoRequester->new_request(channel);
 				}
 			}
 			break;
+		case message::AWAY:
+			{
+				// away-notify
+				bool away = !aMessage.parameters().empty() && !aMessage.parameters()[0].empty();
+				std::string nickName = irc::user(aMessage.origin(), *this).nick_name();
+				buffer_list theBuffers;
+				buffers(theBuffers);
+				for (buffer_list::iterator i = theBuffers.begin(); i != theBuffers.end(); ++i)
+				{
+					if ((*i)->has_user(nickName))
+					{
+						irc::user& ourUser = (*i)->user(nickName);
+						if (ourUser.away() != away)
+						{
+							ourUser.set_away(away);
+							(*i)->user_away_status_changed(ourUser);
+						}
+					}
+				}
+			}
+			break;
+		case message::CAP:
+			if (!iCapabilities->new_message(aMessage))
+				server_buffer().new_message(aMessage);
+			break;
+		case message::BATCH:
+		case message::TAGMSG:
+			// batched messages are handled as they arrive; client-only tags are not used
+			break;
 		case message::QUIT:
 			for (channel_buffer_list::iterator i = iChannelBuffers.begin(); i != iChannelBuffers.end(); ++i)
 				if ((*i).second->has_user(aMessage.origin()))
@@ -1350,7 +1405,16 @@ namespace irc
 						}
 						buffer_from_name(target).set_ready(true);
 						buffer_from_name(target).new_message(aMessage);
-						if ((!selfJoin && iConnectionManager.auto_who()) || iConnectionManager.away_update())
+						// extended-join: <channel> <account> :<real name>
+						bool extendedJoin = iCapabilities->enabled("extended-join") && aMessage.parameters().size() >= 3;
+						if (extendedJoin && buffer_from_name(target).has_user(irc::user(aMessage.origin(), *this).nick_name()))
+						{
+							irc::user& ourUser = buffer_from_name(target).user(irc::user(aMessage.origin(), *this).nick_name());
+							ourUser.full_name() = aMessage.parameters()[2];
+							buffer_from_name(target).user_new_host_info(ourUser);
+						}
+						if ((!selfJoin && iConnectionManager.auto_who() && !extendedJoin) || 
+							(iConnectionManager.away_update() && !iCapabilities->enabled("away-notify")))
 							iWhoRequester->new_request(static_cast<channel_buffer&>(buffer_from_name(target)), 
 								irc::user(aMessage.origin(), *this).nick_name());
 					}
@@ -1616,18 +1680,33 @@ namespace irc
 			iPacketStream.close();
 	}
 
-	void connection::bump_flood_buffer()
+	std::size_t connection::max_targets(const std::string& aCommand, std::size_t aDefault) const
+	{
+		target_limits::const_iterator limit = iTargetLimits.find(neolib::to_upper(aCommand));
+		return limit != iTargetLimits.end() ? limit->second : aDefault;
+	}
+
+	void connection::write_message(const message& aMessage)
+	{
+		send_message(aMessage.to_string(iModel.message_strings()));
+		if (aMessage.command() == message::AWAY)
+			iWhoRequester->new_request(iNickName);
+	}
+
+	void connection::cork()
+	{
+		iCorked = true;
+	}
+
+	void connection::uncork()
 	{
-		while(!iFloodPreventionBuffer.empty())
+		iCorked = false;
+		if (!iCorkedMessages.empty())
 		{
-			message nextMessage = iFloodPreventionBuffer.front();
-			iFloodPreventionBuffer.pop_front();
-			send_message(nextMessage.to_string(iModel.message_strings()));
-			if (nextMessage.command() == message::AWAY)
-				iWhoRequester->new_request(iNickName);
-			if (iConnectionManager.flood_prevention())
-				break; // if flood prevention has not been disabled we don't need to bump until empty
-		} 
+			std::string corkedMessages;
+			corkedMessages.swap(iCorkedMessages);
+			send_message(corkedMessages);
+		}
 	}
 
 	bool connection::any_buffers() const
@@ -1721,6 +1800,11 @@ namespace irc
 		connected.parameters().push_back(iConnectionManager.connected_message(iServer));
 		server_buffer(true).new_message(connected);
 
+		// registration is written in one go: CAP LS, PASS, NICK and USER
+		cork();
+
+		iCapabilities->begin();
+
 		if (!iPassword.empty())
 		{
 			message passMessage(*this, message::OUTGOING);
@@ -1751,6 +1835,8 @@ namespace irc
 		if (userMessage.parameters().back().empty())
 			userMessage.parameters().back() = nick_name();
 		send_message(userMessage);
+
+		uncork();
 	}
 
 	void connection::connection_failure(neolib::tcp_string_packet_stream& aStream, const boost::system::error_code& aError)
@@ -1776,6 +1862,16 @@ namespace irc
 		handle_data();
 	}
 
+	void connection::messages_parsed(std::vector<message>& aMessages)
+	{
+		for (std::vector<message>::iterator i = aMessages.begin(); i != aMessages.end() && !iQuitting; ++i)
+		{
+			iWaitingForPong = false;
+			i->set_id(next_message_id());
+			receive_message(*i);
+		}
+	}
+
 	void connection::transfer_failure(neolib::tcp_string_packet_stream& aStream, const boost::system::error_code& aError)
 	{
 		/* do nothing */
@@ -1803,7 +1899,7 @@ namespace irc
 		if (giveup)
 		{
 			notify_observers(connection_observer::NotifyConnectionGiveup);
-			iAwayUpdater.iNextChannel = iChannelBuffers.end();
+			iAwayUpdater.clear();
 			erase_objects(iChannelBuffers, iChannelBuffers.begin(), iChannelBuffers.end());
 			erase_objects(iUserBuffers, iUserBuffers.begin(), iUserBuffers.end());
 			erase_object(iNoticeBuffer, iNoticeBuffer.begin());
@@ -1896,15 +1992,44 @@ namespace irc
 	void connection::away_updater::ready()
 	{
 		reset();
-		if (iNextChannel == iParent.iChannelBuffers.end())
-			iNextChannel = iParent.iChannelBuffers.begin();
-		if (iNextChannel == iParent.iChannelBuffers.end())
+		if (!iParent.connection_manager().away_update() || iParent.iCapabilities->enabled("away-notify"))
 			return;
-		if (iParent.connection_manager().away_update())
+		uint64_t now = neolib::thread::elapsed_ms();
+		const buffer* activeBuffer = iParent.connection_manager().active_buffer();
+		if (activeBuffer != 0 && activeBuffer->type() == buffer::CHANNEL && &activeBuffer->connection() == &iParent)
+			iLastViewed[static_cast<const channel_buffer*>(activeBuffer)] = now;
+		const channel_buffer* next = 0;
+		uint64_t nextOverdue = 0;
+		for (channel_buffer_list::iterator i = iParent.iChannelBuffers.begin(); i != iParent.iChannelBuffers.end(); ++i)
+		{
+			const channel_buffer& theChannel = static_cast<const channel_buffer&>(*i->second);
+			if (!theChannel.is_ready() || theChannel.users().size() > MaxPolledChannelSize)
+				continue;
+			channel_times::iterator lastUpdated = iLastUpdated.find(&theChannel);
+			if (lastUpdated == iLastUpdated.end())
+			{
+				iLastUpdated[&theChannel] = now; // the WHO following its NAMES list has just been done
+				continue;
+			}
+			uint64_t interval = IdleInterval;
+			channel_times::const_iterator lastViewed = iLastViewed.find(&theChannel);
+			if (&theChannel == activeBuffer)
+				interval = ActiveInterval;
+			else if (lastViewed != iLastViewed.end() && now - lastViewed->second < RecentlyViewedPeriod)
+				interval = RecentInterval;
+			if (now - lastUpdated->second < interval)
+				continue;
+			uint64_t overdue = now - lastUpdated->second - interval;
+			if (next == 0 || overdue > nextOverdue)
+			{
+				next = &theChannel;
+				nextOverdue = overdue;
+			}
+		}
+		if (next != 0)
 		{
-			if (iNextChannel->second->is_ready())
-				iParent.iWhoRequester->new_request(iNextChannel->second->name());
-			++iNextChannel;
+			iLastUpdated[next] = now;
+			iParent.iWhoRequester->new_request(next->name());
 		}
 	}
 }
\ No newline at end of file
@@ -35,6 +35,7 @@
 
 #include <neolib/neolib.hpp>
 #include <neoirc/client/connection_manager.hpp>
+#include <neoirc/client/flood_scheduler.hpp>
 
 namespace irc
 {
@@ -61,7 +62,7 @@ namespace irc
 		iIdentd(aIdentd),  
 		iAutoJoinList(aAutoJoinList), iConnectionScripts(aConnectionScripts),
 		iIgnoreList(aIgnoreList), iNotifyList(aNotifyList), iAutoModeList(aAutoModeList), 
-		iResolver(aModel.io_task()),
+		iResolver(aModel.io_task()), iResolverCache(iResolver), iIoShards(aModel.io_task()),
 		iAutoReconnect(false), iReconnectAnyServer(true), iRetryCount(3), iRetryNetworkDelay(10), iDisconnectTimeout(120),
 		iActiveBuffer(0), iFloodPrevention(false), iFloodPreventionDelay(500), iUseNoticeBuffer(false), iAutoWho(false), iAwayUpdate(false), iCreateChannelBufferUpfront(false), iAutoRejoinOnKick(false), iNextConnectionId(0), iNextBufferId(0), iNextMessageId(0)
 	{
@@ -141,20 +142,20 @@ namespace irc
 	void connection_manager::set_flood_prevention(bool aFloodPrevention)
 	{
 		iFloodPrevention = aFloodPrevention;
-		if (iFloodPrevention && !iFloodPreventor)
-			iFloodPreventor = flood_preventor(iModel.io_task(), iFloodPreventionDelay, iModel.connection_manager());
-		else if (!iFloodPrevention && iFloodPreventor)
-			iFloodPreventor.reset();
-		if (iFloodPreventor)
-			iFloodPreventor->set_duration(iFloodPreventionDelay, true);
-		if (!iFloodPrevention)
-			bump_flood_buffers();
+		for (connection_list::iterator i = iConnections.begin(); i != iConnections.end(); ++i)
+			(*i)->iFloodScheduler->settings_changed();
+	}
+
+	void connection_manager::set_network_threads(std::size_t aNetworkThreads)
+	{
+		iIoShards.set_worker_count(aNetworkThreads);
 	}
 
 	void connection_manager::set_flood_prevention_delay(long aFloodPreventionDelay)
 	{
 		iFloodPreventionDelay = aFloodPreventionDelay;
-		set_flood_prevention(iFloodPrevention);
+		for (connection_list::iterator i = iConnections.begin(); i != iConnections.end(); ++i)
+			(*i)->iFloodScheduler->settings_changed();
 	}
 
 	void connection_manager::add_key(const connection& aConnection, const std::string& aChannelName, const std::string& aChannelKey)
@@ -187,12 +188,6 @@ namespace irc
 		}
 	}
 
-	void connection_manager::bump_flood_buffers()
-	{
-		for (connection_list::iterator i = iConnections.begin(); i != iConnections.end(); ++i)
-			(*i)->bump_flood_buffer();
-	}
-
 	bool connection_manager::any_buffers() const
 	{
 		for (connection_list::const_iterator i = iConnections.begin(); i != iConnections.end(); ++i)
@@ -357,8 +352,8 @@ namespace irc
 		{
 			connection& theConnection = (**i++);
 			if (theConnection.connected() &&
-				theConnection.stream().connection().local_port() == aLocalPort &&
-				theConnection.stream().connection().remote_port() == aRemotePort)
+				theConnection.stream().local_port() == aLocalPort &&
+				theConnection.stream().remote_port() == aRemotePort)
 				return &theConnection;
 		}
 		return 0;
@@ -423,8 +418,10 @@ namespace irc
 		if (parts.empty())
 			return neolib::optional<server>();
 		std::string network;
-		for (server_list::iterator i = iServerList.begin(); i != iServerList.end(); ++i)
+		const server_list::servers& addressServers = iServerList.address_servers(parts[0]);
+		for (server_list::servers::const_iterator s = addressServers.begin(); s != addressServers.end(); ++s)
 		{
+			server_list::iterator i = *s;
 			if (i->address() == parts[0])
 			{
 				network = i->network();
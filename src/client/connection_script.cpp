@@ -36,6 +36,7 @@
 #include <neolib/neolib.hpp>
 #include <neolib/xml.hpp>
 #include <fstream>
+#include <sstream>
 #include <neoirc/client/model.hpp>
 #include <neoirc/client/connection_script.hpp>
 
@@ -210,13 +211,17 @@ namespace irc
 
 	void read_connection_scripts(model& aModel, std::function<bool()> aErrorFunction)
 	{
-		connection_scripts& theConnectionScripts = aModel.connection_scripts();
-
 		neolib::xml xmlConnectionScripts(true);
 		std::ifstream input((aModel.root_path() + "connection_scripts.xml").c_str());
 		xmlConnectionScripts.read(input);
+		read_connection_scripts(aModel, xmlConnectionScripts, aErrorFunction);
+	}
+
+	void read_connection_scripts(model& aModel, const neolib::xml& aXml, std::function<bool()> aErrorFunction)
+	{
+		connection_scripts& theConnectionScripts = aModel.connection_scripts();
 
-		if (xmlConnectionScripts.error() && aErrorFunction && aErrorFunction())
+		if (aXml.error() && aErrorFunction && aErrorFunction())
 		{
 			theConnectionScripts.entries().clear();
 			write_connection_scripts(aModel);
@@ -225,7 +230,7 @@ namespace irc
 
 		theConnectionScripts.loading(true);
 
-		for (neolib::xml::element::const_iterator i = xmlConnectionScripts.root().begin(); i != xmlConnectionScripts.root().end(); ++i)
+		for (neolib::xml::element::const_iterator i = aXml.root().begin(); i != aXml.root().end(); ++i)
 		{
 			if (i->name() == "entry")
 			{
@@ -284,7 +289,8 @@ namespace irc
 			}
 		}
 
-		std::ofstream output((aModel.root_path() + "connection_scripts.xml").c_str());
+		std::ostringstream output;
 		xmlConnectionScripts.write(output);
+		aModel.save_config(aModel.root_path() + "connection_scripts.xml", output.str());
 	}
 }
\ No newline at end of file
@@ -35,6 +35,7 @@
 
 #include <neolib/neolib.hpp>
 #include <fstream>
+#include <sstream>
 #include <tuple>
 #include <neolib/xml.hpp>
 #include <neoirc/client/model.hpp>
@@ -249,8 +250,6 @@ namespace irc
 
 	void read_contacts_list(model& aModel, std::function<bool()> aErrorFunction)
 	{
-		contacts& theList = aModel.contacts();
-
 		neolib::xml xmlGroupList(true);
 		std::ifstream input((aModel.root_path() + "contacts.xml").c_str());
 		if (input)
@@ -260,8 +259,14 @@ namespace irc
 			std::ifstream input((aModel.root_path() + "group_list.xml").c_str());
 			xmlGroupList.read(input);
 		}
+		read_contacts_list(aModel, xmlGroupList, aErrorFunction);
+	}
+
+	void read_contacts_list(model& aModel, const neolib::xml& aXml, std::function<bool()> aErrorFunction)
+	{
+		contacts& theList = aModel.contacts();
 
-		if (xmlGroupList.error() && aErrorFunction && aErrorFunction())
+		if (aXml.error() && aErrorFunction && aErrorFunction())
 		{
 			theList.entries().clear();
 			write_contacts_list(aModel);
@@ -270,7 +275,7 @@ namespace irc
 
 		theList.loading(true);
 
-		for (neolib::xml::element::const_iterator i = xmlGroupList.root().begin(); i != xmlGroupList.root().end(); ++i)
+		for (neolib::xml::element::const_iterator i = aXml.root().begin(); i != aXml.root().end(); ++i)
 		{
 			if (i->name() == "entry")
 			{
@@ -316,8 +321,9 @@ namespace irc
 			xmlGroupList.append(xmlEntry, "server_name").set_attribute("value", entry.server().second);
 		}
 
-		std::ofstream output((aModel.root_path() + "contacts.xml").c_str());
+		std::ostringstream output;
 		xmlGroupList.write(output);
+		aModel.save_config(aModel.root_path() + "contacts.xml", output.str());
 		remove((aModel.root_path() + "group_list.xml").c_str());
 	}
 }
\ No newline at end of file
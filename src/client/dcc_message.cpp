@@ -71,16 +71,6 @@ namespace irc
 		return ret;
 	}
 
-	namespace
-	{
-		std::string timestamp_bit(const char* aParameter, const tm* aTime)
-		{
-			std::tr1::array<char, 256> tempBit;
-			strftime(&tempBit[0], tempBit.size(), aParameter, aTime);
-			return std::string(&tempBit[0]);
-		}
-	}
-
 	std::string dcc_message::to_nice_string(const message_strings& aMessageStrings, const dcc_chat_connection& aConnection, const std::string& aAppendToContent, const void* aParameter, bool aAddTimeStamp, bool aAppendCRLF) const
 	{
 		std::string theContent = iContent;
@@ -39,7 +39,7 @@
 
 namespace irc
 {
-	dns_requester::dns_requester(connection& aConnection) : whois_requester::requester(aConnection.whois()), iResolver(aConnection.connection_manager().resolver()), iConnection(aConnection)
+	dns_requester::dns_requester(connection& aConnection) : whois_requester::requester(aConnection.whois()), iResolver(aConnection.connection_manager().resolver_cache()), iConnection(aConnection)
 	{
 		iConnection.add_observer(*this);
 	}
@@ -90,28 +90,34 @@ namespace irc
 		{
 		case message::RPL_WHOISUSER:
 		case message::ERR_NOSUCHNICK:
-			for (request_list::iterator i = iRequests.begin(); i != iRequests.end();)
 			{
-				if (irc::make_string(iConnection, i->first.nick_name()) == aMessage.parameters()[0])
+				std::vector<std::string> hosts;
+				for (request_list::iterator i = iRequests.begin(); i != iRequests.end();)
 				{
-					if (aMessage.command() == message::RPL_WHOISUSER)
+					if (irc::make_string(iConnection, i->first.nick_name()) == aMessage.parameters()[0])
 					{
-						if (aMessage.parameters().size() >= 3)
+						if (aMessage.command() == message::RPL_WHOISUSER)
 						{
-							i->first.user_name() = aMessage.parameters()[1];
-							i->first.host_name() = aMessage.parameters()[2];
-							iResolver.resolve(*this, i->first.host_name());
+							if (aMessage.parameters().size() >= 3)
+							{
+								i->first.user_name() = aMessage.parameters()[1];
+								i->first.host_name() = aMessage.parameters()[2];
+								hosts.push_back(i->first.host_name());
+							}
+							++i;
+						}
+						else
+						{
+							i->second->new_message(aMessage);
+							iRequests.erase(i++);
 						}
-						++i;
 					}
 					else
-					{
-						i->second->new_message(aMessage);
-						iRequests.erase(i++);
-					}
+						++i;
 				}
-				else
-					++i;
+				// resolve after the loop as cached answers arrive synchronously and erase requests
+				for (std::vector<std::string>::const_iterator i = hosts.begin(); i != hosts.end(); ++i)
+					iResolver.resolve(*this, *i);
 			}
 			break;
 		default:
@@ -120,12 +126,22 @@ namespace irc
 	}
 
 	void dns_requester::host_resolved(const std::string& aHostName, neolib::tcp_resolver::iterator aHost)
+	{
+		report(aHostName, "hostname=" + aHost->host_name() + ", IP address=" + aHost->endpoint().address().to_string());
+	}
+
+	void dns_requester::host_not_resolved(const std::string& aHostName, const boost::system::error_code& aError)
+	{
+		report(aHostName, "unable to resolve " + aHostName + " (" + aError.message() + ")");
+	}
+
+	void dns_requester::report(const std::string& aHostName, const std::string& aResult)
 	{
 		for (request_list::iterator i = iRequests.begin(); i != iRequests.end();)
 		{
 			if (i->first.host_name() == aHostName)
 			{
-				std::string result = i->first.nick_name() + ": hostname=" + aHost->host_name() + ", IP address=" + aHost->endpoint().address().to_string();
+				std::string result = i->first.nick_name() + ": " + aResult;
 				message newMessage(*i->second, message::INCOMING);
 				newMessage.set_command("");
 				newMessage.parameters().clear();
@@ -0,0 +1,235 @@
+// flood_scheduler.cpp
+/*
+ *  Copyright (c) 2010 Leigh Johnston.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ *     * Neither the name of Leigh Johnston nor the names of any
+ *       other contributors to this software may be used to endorse or
+ *       promote products derived from this software without specific prior
+ *       written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ *  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <neolib/neolib.hpp>
+#include <algorithm>
+#include <neolib/thread.hpp>
+#include <neoirc/client/flood_scheduler.hpp>
+#include <neoirc/client/connection.hpp>
+#include <neoirc/client/connection_manager.hpp>
+
+namespace irc
+{
+	flood_scheduler::flood_scheduler(connection& aConnection, neolib::io_task& aIoTask) :
+		neolib::timer(aIoTask, 0, false), iConnection(aConnection), iPenaltyClock_ms(0), iChargedDelay_ms(0)
+	{
+	}
+
+	flood_scheduler::lane flood_scheduler::classify(const message& aMessage)
+	{
+		switch (aMessage.command())
+		{
+		case message::PING:
+		case message::PONG:
+		case message::PART:
+		case message::QUIT:
+			return Urgent;
+		case message::NOTICE:
+			if (aMessage.is_ctcp())
+				return Reply;
+			break;
+		case message::ISON:
+		case message::WHO:
+			// replies are matched to requests in the order they were sent (presence_watcher, who_requester) 
+			// so typed and automatic requests must share one FIFO lane
+			return Bulk;
+		default:
+			break;
+		}
+		return aMessage.background() ? Bulk : Interactive;
+	}
+
+	void flood_scheduler::send(const message& aMessage, lane aLane)
+	{
+		const connection_manager& theManager = iConnection.connection_manager();
+		if (!theManager.flood_prevention() || iConnection.iCorked)
+		{
+			iConnection.write_message(aMessage);
+			return;
+		}
+		uint64_t now = neolib::thread::elapsed_ms();
+		uint64_t theCost = cost(aMessage);
+		bool waiting = false;
+		for (int i = Urgent; i <= aLane && !waiting; ++i)
+			waiting = !iLanes[i].empty();
+		if (aLane == Urgent || (!waiting && affordable(theCost, now)))
+		{
+			charge(theCost, now);
+			iConnection.write_message(aMessage);
+		}
+		else
+			iLanes[aLane].push_back(aMessage);
+		schedule();
+	}
+
+	bool flood_scheduler::empty() const
+	{
+		for (int i = Urgent; i != LaneCount; ++i)
+			if (!iLanes[i].empty())
+				return false;
+		return true;
+	}
+
+	void flood_scheduler::remove_messages_to(const buffer& aBuffer)
+	{
+		for (int i = Urgent; i != LaneCount; ++i)
+			for (std::deque<message>::iterator j = iLanes[i].begin(); j != iLanes[i].end();)
+			{
+				if (j->command() != message::PRIVMSG || j->parameters().empty())
+				{
+					++j;
+					continue;
+				}
+				// the target packer may have put several targets in one line
+				std::vector<std::string> targets;
+				neolib::tokens(j->parameters()[0], std::string(","), targets);
+				std::string remaining;
+				for (std::vector<std::string>::const_iterator k = targets.begin(); k != targets.end(); ++k)
+					if (irc::make_string(iConnection, *k) != aBuffer.name())
+						remaining += (remaining.empty() ? "" : ",") + *k;
+				if (remaining.empty())
+					j = iLanes[i].erase(j);
+				else
+				{
+					j->parameters()[0] = remaining;
+					++j;
+				}
+			}
+	}
+
+	void flood_scheduler::settings_changed()
+	{
+		if (iConnection.connection_manager().flood_prevention())
+		{
+			// penalty already owed is re-priced at the new delay so the change applies to queued lines too
+			uint64_t delay = iConnection.connection_manager().flood_prevention_delay();
+			uint64_t now = neolib::thread::elapsed_ms();
+			if (iChargedDelay_ms != 0 && delay != iChargedDelay_ms && iPenaltyClock_ms > now)
+				iPenaltyClock_ms = now + (iPenaltyClock_ms - now) * delay / iChargedDelay_ms;
+			iChargedDelay_ms = delay;
+			cancel();
+			pump();
+			return;
+		}
+		cancel();
+		for (int i = Urgent; i != LaneCount; ++i)
+			while (!iLanes[i].empty())
+			{
+				message nextMessage = iLanes[i].front();
+				iLanes[i].pop_front();
+				iConnection.write_message(nextMessage);
+			}
+	}
+
+	void flood_scheduler::clear()
+	{
+		cancel();
+		for (int i = Urgent; i != LaneCount; ++i)
+			iLanes[i].clear();
+		iPenaltyClock_ms = 0;
+	}
+
+	uint64_t flood_scheduler::cost(const message& aMessage) const
+	{
+		uint64_t delay = iConnection.connection_manager().flood_prevention_delay();
+		std::size_t length = 0;
+		for (message::parameters_t::const_iterator i = aMessage.parameters().begin(); i != aMessage.parameters().end(); ++i)
+			length += i->size() + 1;
+		if (length > message::MaxMessageSize)
+			length = message::MaxMessageSize;
+		return delay + delay * length / BytesPerPenalty;
+	}
+
+	bool flood_scheduler::affordable(uint64_t aCost, uint64_t aNow) const
+	{
+		uint64_t window = iConnection.connection_manager().flood_prevention_delay() * BurstLines;
+		if (iPenaltyClock_ms <= aNow)
+			return true; // an idle connection may always send one line
+		return iPenaltyClock_ms + aCost - aNow <= window;
+	}
+
+	void flood_scheduler::charge(uint64_t aCost, uint64_t aNow)
+	{
+		iPenaltyClock_ms = std::max(iPenaltyClock_ms, aNow) + aCost;
+		iChargedDelay_ms = iConnection.connection_manager().flood_prevention_delay();
+	}
+
+	void flood_scheduler::pump()
+	{
+		for (;;)
+		{
+			std::deque<message>* next = 0;
+			for (int i = Urgent; i != LaneCount && next == 0; ++i)
+				if (!iLanes[i].empty())
+					next = &iLanes[i];
+			if (next == 0)
+				break;
+			uint64_t now = neolib::thread::elapsed_ms();
+			uint64_t theCost = cost(next->front());
+			if (!affordable(theCost, now))
+				break;
+			message nextMessage = next->front();
+			next->pop_front();
+			charge(theCost, now);
+			iConnection.write_message(nextMessage);
+		}
+		schedule();
+	}
+
+	void flood_scheduler::schedule()
+	{
+		std::deque<message>* next = 0;
+		for (int i = Urgent; i != LaneCount && next == 0; ++i)
+			if (!iLanes[i].empty())
+				next = &iLanes[i];
+		if (next == 0)
+		{
+			cancel();
+			return;
+		}
+		uint64_t now = neolib::thread::elapsed_ms();
+		uint64_t window = iConnection.connection_manager().flood_prevention_delay() * BurstLines;
+		uint64_t due = iPenaltyClock_ms + cost(next->front());
+		uint64_t wait = due > now + window ? due - now - window : 0;
+		set_duration(static_cast<unsigned long>(std::max<uint64_t>(wait, 1)), true);
+		if (!waiting())
+			reset();
+	}
+
+	void flood_scheduler::ready()
+	{
+		pump();
+	}
+}
@@ -36,6 +36,7 @@
 #include <neolib/neolib.hpp>
 #include <neolib/xml.hpp>
 #include <fstream>
+#include <sstream>
 #include <neoirc/client/identity.hpp>
 #include <neoirc/client/model.hpp>
 
@@ -140,21 +141,25 @@ namespace irc
 
 	void identities::read(const model& aModel, std::string& aDefaultIdentity, std::function<bool()> aErrorFunction)
 	{
-		iIdentities.clear();
-
 		neolib::xml xmlIdentities(true);
 		
 		std::ifstream input((aModel.root_path() + "identities.xml").c_str());
 		xmlIdentities.read(input);
+		read(aModel, xmlIdentities, aDefaultIdentity, aErrorFunction);
+	}
 
-		if (xmlIdentities.error() && aErrorFunction && aErrorFunction())
+	void identities::read(const model& aModel, const neolib::xml& aXml, std::string& aDefaultIdentity, std::function<bool()> aErrorFunction)
+	{
+		iIdentities.clear();
+
+		if (aXml.error() && aErrorFunction && aErrorFunction())
 		{
 			iIdentities.clear();
 			write(aModel, aDefaultIdentity);
 			return;
 		}
 
-		for (neolib::xml::element::const_iterator i = xmlIdentities.root().begin(); i != xmlIdentities.root().end(); ++i)
+		for (neolib::xml::element::const_iterator i = aXml.root().begin(); i != aXml.root().end(); ++i)
 		{
 			const neolib::xml::element& idElement = *i;
 			if (idElement.name() == "identity")
@@ -224,8 +229,9 @@ namespace irc
 
 		xmlIdentities.append(xmlIdentities.root(), "default").set_attribute("value", aModel.default_identity().nick_name());
 		
-		std::ofstream output((aModel.root_path() + "identities.xml").c_str());
+		std::ostringstream output;
 		xmlIdentities.write(output);
+		aModel.save_config(aModel.root_path() + "identities.xml", output.str());
 	}
 
 	void read_identity_list(model& aModel, std::string& aDefaultIdentity, std::function<bool()> aErrorFunction)
@@ -233,6 +239,11 @@ namespace irc
 		aModel.identities().read(aModel, aDefaultIdentity, aErrorFunction);
 	}
 
+	void read_identity_list(model& aModel, const neolib::xml& aXml, std::string& aDefaultIdentity, std::function<bool()> aErrorFunction)
+	{
+		aModel.identities().read(aModel, aXml, aDefaultIdentity, aErrorFunction);
+	}
+
 	void write_identity_list(const model& aModel, const std::string& aDefaultIdentity)
 	{
 		aModel.identities().write(aModel, aDefaultIdentity);
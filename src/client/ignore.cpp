@@ -36,7 +36,9 @@
 #include <neolib/neolib.hpp>
 #include <neolib/xml.hpp>
 #include <fstream>
+#include <sstream>
 #include <neoirc/client/model.hpp>
+#include <neoirc/client/connection.hpp>
 #include <neoirc/client/ignore.hpp>
 
 namespace irc
@@ -73,6 +75,28 @@ namespace irc
 		}
 	}
 
+	const bool* ignore_cache::find(const std::string& aPrefix)
+	{
+		decision_lookup::iterator i = iLookup.find(aPrefix);
+		if (i == iLookup.end())
+			return 0;
+		iDecisions.splice(iDecisions.begin(), iDecisions, i->second);
+		return &i->second->second;
+	}
+
+	void ignore_cache::insert(const std::string& aPrefix, bool aIgnored)
+	{
+		if (iCapacity == 0)
+			return;
+		while (iDecisions.size() >= iCapacity)
+		{
+			iLookup.erase(iDecisions.back().first);
+			iDecisions.pop_back();
+		}
+		iDecisions.push_front(std::make_pair(aPrefix, aIgnored));
+		iLookup[aPrefix] = iDecisions.begin();
+	}
+
 	ignore_list::container_type::const_iterator ignore_list::find(casemapping::type aCasemapping, const server_key& aServer, const user& aUser) const
 	{
 		std::vector<container_type::const_iterator> result;
@@ -99,7 +123,140 @@ namespace irc
 
 	bool ignore_list::ignored(casemapping::type aCasemapping, const server_key& aServer, const user& aUser) const
 	{
-		return find(aCasemapping, aServer, aUser) != iEntries.end();
+		const index& theIndex = compiled(aCasemapping);
+		if (theIndex.iEntries.empty())
+			return false;
+		std::string nickName = fold_case(aCasemapping, aUser.nick_name());
+		std::string userName = fold_case(aCasemapping, aUser.user_name());
+		std::string hostName = fold_case(aCasemapping, aUser.host_name());
+		entry_buckets::const_iterator bucket = theIndex.iByNickName.find(nickName);
+		if (bucket != theIndex.iByNickName.end())
+			for (entry_indices::const_iterator i = bucket->second.begin(); i != bucket->second.end(); ++i)
+				if (matches(theIndex.iEntries[*i], aServer, nickName, userName, hostName))
+					return true;
+		bucket = theIndex.iByHostName.find(hostName);
+		if (bucket != theIndex.iByHostName.end())
+			for (entry_indices::const_iterator i = bucket->second.begin(); i != bucket->second.end(); ++i)
+				if (matches(theIndex.iEntries[*i], aServer, nickName, userName, hostName))
+					return true;
+		if (!theIndex.iHostNameSuffixes.empty())
+		{
+			std::size_t node = 0;
+			for (std::string::const_reverse_iterator c = hostName.rbegin(); c != hostName.rend(); ++c)
+			{
+				std::map<char, std::size_t>::const_iterator child = theIndex.iHostNameSuffixes[node].iChildren.find(*c);
+				if (child == theIndex.iHostNameSuffixes[node].iChildren.end())
+					break;
+				node = child->second;
+				const entry_indices& suffixEntries = theIndex.iHostNameSuffixes[node].iEntries;
+				for (entry_indices::const_iterator i = suffixEntries.begin(); i != suffixEntries.end(); ++i)
+					if (matches(theIndex.iEntries[*i], aServer, nickName, userName, hostName))
+						return true;
+			}
+		}
+		const entry_indices* const residuals[] = { &theIndex.iNickNameGlobs, &theIndex.iHostNameGlobs, &theIndex.iEveryone };
+		for (std::size_t r = 0; r < sizeof(residuals) / sizeof(residuals[0]); ++r)
+			for (entry_indices::const_iterator i = residuals[r]->begin(); i != residuals[r]->end(); ++i)
+				if (matches(theIndex.iEntries[*i], aServer, nickName, userName, hostName))
+					return true;
+		return false;
+	}
+
+	bool ignore_list::ignored(const connection& aConnection, const server_key& aServer, const user& aUser) const
+	{
+		ignore_cache& theCache = aConnection.ignore_cache();
+		if (theCache.iGeneration != iGeneration || theCache.iCasemapping != aConnection.casemapping() || theCache.iServer != aServer)
+		{
+			theCache.clear();
+			theCache.iGeneration = iGeneration;
+			theCache.iCasemapping = aConnection.casemapping();
+			theCache.iServer = aServer;
+		}
+		if (iEntries.empty())
+			return false;
+		std::string prefix = aUser.nick_name() + "!" + aUser.user_name() + "@" + aUser.host_name();
+		const bool* decision = theCache.find(prefix);
+		if (decision != 0)
+			return *decision;
+		bool result = ignored(aConnection.casemapping(), aServer, aUser);
+		theCache.insert(prefix, result);
+		return result;
+	}
+
+	const ignore_list::index& ignore_list::compiled(casemapping::type aCasemapping) const
+	{
+		index& theIndex = iIndex[aCasemapping];
+		if (theIndex.iGeneration == iGeneration)
+			return theIndex;
+		theIndex = index();
+		theIndex.iGeneration = iGeneration;
+		theIndex.iEntries.reserve(iEntries.size());
+		for (container_type::const_iterator i = iEntries.begin(); i != iEntries.end(); ++i)
+		{
+			compiled_entry theEntry;
+			theEntry.iEntry = i;
+			theEntry.iNickName = mask(aCasemapping, i->user().nick_name());
+			theEntry.iUserName = mask(aCasemapping, i->user().user_name());
+			theEntry.iHostName = mask(aCasemapping, i->user().host_name());
+			std::size_t entryIndex = theIndex.iEntries.size();
+			theIndex.iEntries.push_back(theEntry);
+			if (theEntry.iNickName.any() && theEntry.iUserName.any() && theEntry.iHostName.any())
+			{
+				theIndex.iEveryone.push_back(entryIndex);
+				continue;
+			}
+			// an entry can match by nick name or by user@host so it may need to be reachable both ways
+			if (theEntry.iNickName.kind() == mask::Literal)
+				theIndex.iByNickName[theEntry.iNickName.literal()].push_back(entryIndex);
+			else if (!theEntry.iNickName.any())
+				theIndex.iNickNameGlobs.push_back(entryIndex);
+			if (theEntry.iUserName.any() && theEntry.iHostName.any())
+				continue;
+			if (theEntry.iHostName.kind() == mask::Literal)
+				theIndex.iByHostName[theEntry.iHostName.literal()].push_back(entryIndex);
+			else if (theEntry.iHostName.kind() == mask::Empty)
+				theIndex.iByHostName[std::string()].push_back(entryIndex);
+			else if (theEntry.iHostName.kind() == mask::Suffix)
+			{
+				if (theIndex.iHostNameSuffixes.empty())
+					theIndex.iHostNameSuffixes.push_back(suffix_node());
+				std::size_t node = 0;
+				const std::string& suffix = theEntry.iHostName.literal();
+				for (std::string::const_reverse_iterator c = suffix.rbegin(); c != suffix.rend(); ++c)
+				{
+					std::map<char, std::size_t>::const_iterator child = theIndex.iHostNameSuffixes[node].iChildren.find(*c);
+					if (child != theIndex.iHostNameSuffixes[node].iChildren.end())
+						node = child->second;
+					else
+					{
+						std::size_t newNode = theIndex.iHostNameSuffixes.size();
+						theIndex.iHostNameSuffixes[node].iChildren[*c] = newNode;
+						theIndex.iHostNameSuffixes.push_back(suffix_node());
+						node = newNode;
+					}
+				}
+				theIndex.iHostNameSuffixes[node].iEntries.push_back(entryIndex);
+			}
+			else
+				theIndex.iHostNameGlobs.push_back(entryIndex);
+		}
+		return theIndex;
+	}
+
+	bool ignore_list::matches(const compiled_entry& aEntry, const server_key& aServer, const std::string& aNickName, const std::string& aUserName, const std::string& aHostName)
+	{
+		const server_key& entryServer = aEntry.iEntry->server();
+		if (entryServer.first != aServer.first ||
+			(entryServer.second != aServer.second && entryServer.second != "*" && aServer.second != "*"))
+			return false;
+		bool anyNickName = aEntry.iNickName.any();
+		bool anyUserName = aEntry.iUserName.any();
+		bool anyHostName = aEntry.iHostName.any();
+		if (!anyNickName && aEntry.iNickName.matches(aNickName))
+			return true;
+		if ((!anyUserName || !anyHostName) && aEntry.iUserName.matches(aUserName) && aEntry.iHostName.matches(aHostName))
+			return true;
+		return anyNickName && anyUserName && anyHostName;
 	}
 
 	bool ignore_list::add(const server_key& aServer, const user& aUser)
@@ -112,6 +269,7 @@ namespace irc
 				existingEntry.user().host_name() != aUser.host_name())
 			{
 				existingEntry.user() = aUser;
+				++iGeneration;
 				if (!iLoading)
 					notify_observers(ignore_list_observer::NotifyUpdated, existingEntry);
 			}
@@ -119,6 +277,7 @@ namespace irc
 		}
 
 		iEntries.push_back(ignore_entry(aServer, aUser));
+		++iGeneration;
 		if (!iLoading)
 			notify_observers(ignore_list_observer::NotifyAdded, iEntries.back());
 
@@ -133,6 +292,7 @@ namespace irc
 	void ignore_list::update(ignore_entry& aExistingEntry, const ignore_entry& aNewEntry)
 	{
 		aExistingEntry = aNewEntry;
+		++iGeneration;
 		if (!iLoading)
 			notify_observers(ignore_list_observer::NotifyUpdated, aExistingEntry);
 	}
@@ -164,6 +324,7 @@ namespace irc
 
 		container_type temp;
 		temp.splice(temp.begin(), iEntries, item);
+		++iGeneration;
 		notify_observers(ignore_list_observer::NotifyRemoved, *temp.begin());
 	}
 
@@ -174,6 +335,7 @@ namespace irc
 			{
 				container_type temp;
 				temp.splice(temp.begin(), iEntries, i);
+				++iGeneration;
 				notify_observers(ignore_list_observer::NotifyRemoved, *temp.begin());
 				break;
 			}
@@ -197,22 +359,27 @@ namespace irc
 
 	void read_ignore_list(model& aModel, std::function<bool()> aErrorFunction)
 	{
-		ignore_list& theIgnoreList = aModel.ignore_list();
-
 		neolib::xml xmlIgnoreList(true);
 		std::ifstream input((aModel.root_path() + "ignore_list.xml").c_str());
 		xmlIgnoreList.read(input);
+		read_ignore_list(aModel, xmlIgnoreList, aErrorFunction);
+	}
+
+	void read_ignore_list(model& aModel, const neolib::xml& aXml, std::function<bool()> aErrorFunction)
+	{
+		ignore_list& theIgnoreList = aModel.ignore_list();
 
-		if (xmlIgnoreList.error() && aErrorFunction && aErrorFunction())
+		if (aXml.error() && aErrorFunction && aErrorFunction())
 		{
 			theIgnoreList.entries().clear();
+			theIgnoreList.invalidate();
 			write_ignore_list(aModel);
 			return;
 		}
 
 		theIgnoreList.loading(true);
 
-		for (neolib::xml::element::const_iterator i = xmlIgnoreList.root().begin(); i != xmlIgnoreList.root().end(); ++i)
+		for (neolib::xml::element::const_iterator i = aXml.root().begin(); i != aXml.root().end(); ++i)
 		{
 			if (i->name() == "entry")
 			{
@@ -229,6 +396,7 @@ namespace irc
 				theIgnoreList.entries().push_back(e);
 			}
 		}
+		theIgnoreList.invalidate();
 
 		theIgnoreList.loading(false);
 	}
@@ -250,7 +418,8 @@ namespace irc
 			xmlIgnoreList.append(xmlEntry, "server_name").set_attribute("value", entry.server().second);
 		}
 
-		std::ofstream output((aModel.root_path() + "ignore_list.xml").c_str());
+		std::ostringstream output;
 		xmlIgnoreList.write(output);
+		aModel.save_config(aModel.root_path() + "ignore_list.xml", output.str());
 	}
 }
\ No newline at end of file
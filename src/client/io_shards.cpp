@@ -0,0 +1,178 @@
+// io_shards.cpp
+/*
+ *  Copyright (c) 2010 Leigh Johnston.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ *     * Neither the name of Leigh Johnston nor the names of any
+ *       other contributors to this software may be used to endorse or
+ *       promote products derived from this software without specific prior
+ *       written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ *  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <neolib/neolib.hpp>
+#include <algorithm>
+#include <neoirc/client/io_shards.hpp>
+
+namespace irc
+{
+	io_shards::shard::shard(const std::string& aName) :
+		iStopping(false), iLoad(0)
+	{
+		std::unique_lock<std::mutex> lock(iMutex);
+		iWorker = std::thread([this, aName]() { run(aName); });
+		iStarted.wait(lock, [this]() { return iIoTask != nullptr; });
+	}
+
+	io_shards::shard::~shard()
+	{
+		iStopping = true;
+		iWorker.join();
+	}
+
+	void io_shards::shard::post(std::function<void()> aWork)
+	{
+		std::lock_guard<std::mutex> lock(iMutex);
+		iPosted.push_back(std::move(aWork));
+	}
+
+	void io_shards::shard::run(const std::string& aName)
+	{
+		{
+			std::lock_guard<std::mutex> lock(iMutex);
+			iThread.reset(new worker_thread(aName));
+			iIoTask.reset(new neolib::io_task(*iThread));
+		}
+		iStarted.notify_all();
+		while (!iStopping)
+		{
+			bool didSome = run_posted();
+			iIoTask->do_io(didSome ? neolib::yield_type::NoYield : neolib::yield_type::Sleep);
+		}
+		// streams post their own destruction so finish anything still queued before the task goes
+		while (run_posted())
+			iIoTask->do_io(neolib::yield_type::NoYield);
+		iIoTask.reset();
+		iThread.reset();
+	}
+
+	bool io_shards::shard::run_posted()
+	{
+		std::vector<std::function<void()>> work;
+		{
+			std::lock_guard<std::mutex> lock(iMutex);
+			work.swap(iPosted);
+		}
+		for (std::vector<std::function<void()>>::iterator i = work.begin(); i != work.end(); ++i)
+			(*i)();
+		return !work.empty();
+	}
+
+	io_shards::io_shards(neolib::io_task& aOwnerTask) :
+		iNextShardId(0),
+		iAssigned(0),
+		iDeliveryTimer(aOwnerTask, [this](neolib::callback_timer&) { process_delivered(); if (delivering()) iDeliveryTimer.again(); }, DeliveryInterval_ms, false)
+	{
+	}
+
+	io_shards::~io_shards()
+	{
+		iShards.clear();
+	}
+
+	void io_shards::set_worker_count(std::size_t aWorkerCount)
+	{
+		while (iShards.size() > aWorkerCount)
+			iShards.pop_back(); // connections still assigned to it keep it alive
+		while (iShards.size() < aWorkerCount)
+			iShards.push_back(shard_pointer(new shard("irc_io_shard_" + neolib::unsigned_integer_to_string<char>(static_cast<unsigned long>(++iNextShardId)))));
+	}
+
+	io_shards::shard_pointer io_shards::assign()
+	{
+		if (iShards.empty())
+			return shard_pointer();
+		shard_pointer leastLoaded = iShards[0];
+		for (std::vector<shard_pointer>::iterator i = iShards.begin(); i != iShards.end(); ++i)
+			if ((*i)->load() < leastLoaded->load())
+				leastLoaded = *i;
+		++leastLoaded->iLoad;
+		++iAssigned;
+		if (!iDeliveryTimer.waiting())
+			iDeliveryTimer.again(); // only polled while a connection is on a shard
+		return leastLoaded;
+	}
+
+	void io_shards::release(shard& aShard)
+	{
+		if (aShard.iLoad > 0)
+			--aShard.iLoad;
+		if (iAssigned > 0)
+			--iAssigned;
+	}
+
+	void io_shards::deliver(std::function<void()> aWork)
+	{
+		std::lock_guard<std::mutex> lock(iMutex);
+		iDelivered.push_back(std::move(aWork));
+	}
+
+	void io_shards::add_drain(io_shards_drain& aDrain)
+	{
+		iDrains.push_back(&aDrain);
+	}
+
+	void io_shards::remove_drain(io_shards_drain& aDrain)
+	{
+		std::vector<io_shards_drain*>::iterator i = std::find(iDrains.begin(), iDrains.end(), &aDrain);
+		if (i != iDrains.end())
+			iDrains.erase(i);
+	}
+
+	void io_shards::process_delivered()
+	{
+		std::vector<std::function<void()>> work;
+		{
+			std::lock_guard<std::mutex> lock(iMutex);
+			work.swap(iDelivered);
+		}
+		for (std::vector<std::function<void()>>::iterator i = work.begin(); i != work.end(); ++i)
+			(*i)();
+		// a drain can lead to another being removed (a connection closed by what it handed over)
+		std::vector<io_shards_drain*> drains = iDrains;
+		for (std::vector<io_shards_drain*>::iterator i = drains.begin(); i != drains.end(); ++i)
+			if (std::find(iDrains.begin(), iDrains.end(), *i) != iDrains.end())
+				(*i)->drain();
+	}
+
+	bool io_shards::delivering() const
+	{
+		if (iAssigned > 0)
+			return true;
+		std::lock_guard<std::mutex> lock(iMutex);
+		return !iDelivered.empty();
+	}
+}
@@ -0,0 +1,261 @@
+// join_scheduler.cpp
+/*
+ *  Copyright (c) 2010 Leigh Johnston.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ *     * Neither the name of Leigh Johnston nor the names of any
+ *       other contributors to this software may be used to endorse or
+ *       promote products derived from this software without specific prior
+ *       written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ *  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <neolib/neolib.hpp>
+#include <algorithm>
+#include <neolib/thread.hpp>
+#include <neoirc/client/join_scheduler.hpp>
+#include <neoirc/client/mask.hpp>
+
+namespace irc
+{
+	join_scheduler::join_scheduler(connection& aConnection, neolib::io_task& aIoTask) :
+		neolib::timer(aIoTask, 0, false), iConnection(aConnection), iLastAnswer_ms(0), iBatchAnswered(false), iMaxBatch(static_cast<std::size_t>(-1))
+	{
+		iConnection.add_observer(*this);
+	}
+
+	join_scheduler::~join_scheduler()
+	{
+		iConnection.remove_observer(*this);
+	}
+
+	void join_scheduler::join(const std::string& aChannel, const std::string& aKey)
+	{
+		if (pending(aChannel))
+			return;
+		entry newEntry;
+		newEntry.iChannel = aChannel;
+		newEntry.iKey = aKey;
+		iQueue.push_back(newEntry);
+		if (!blocked())
+		{
+			cancel();
+			set_duration(0, true); // collect the channels asked for together into one batch
+			reset();
+		}
+	}
+
+	bool join_scheduler::pending(const std::string& aChannel) const
+	{
+		if (iInFlight.find(fold_case(iConnection.casemapping(), aChannel)) != iInFlight.end())
+			return true;
+		for (entry_queue::const_iterator i = iQueue.begin(); i != iQueue.end(); ++i)
+			if (mask::equivalent(iConnection.casemapping(), i->iChannel, aChannel))
+				return true;
+		return false;
+	}
+
+	bool join_scheduler::scheduled(const std::string& aChannel) const
+	{
+		return pending(aChannel) || (!iJustJoined.empty() && iJustJoined == fold_case(iConnection.casemapping(), aChannel));
+	}
+
+	void join_scheduler::clear()
+	{
+		cancel();
+		iQueue.clear();
+		iInFlight.clear();
+		iJustJoined.clear();
+		iMaxBatch = static_cast<std::size_t>(-1);
+	}
+
+	void join_scheduler::send_batch()
+	{
+		if (iQueue.empty() || blocked() || !iConnection.registered())
+			return;
+		std::size_t maxBatch = std::min(iMaxBatch, iConnection.max_targets("JOIN", static_cast<std::size_t>(-1)));
+		std::vector<entry> keyed;
+		std::vector<entry> unkeyed;
+		std::size_t length = std::string("JOIN  \r\n").size();
+		while (!iQueue.empty() && keyed.size() + unkeyed.size() < maxBatch)
+		{
+			const entry& next = iQueue.front();
+			std::size_t extra = next.iChannel.size() + 1 + (next.iKey.empty() ? 0 : next.iKey.size() + 1);
+			if (!keyed.empty() || !unkeyed.empty())
+				if (length + extra > message::MaxMessageSize)
+					break;
+			(next.iKey.empty() ? unkeyed : keyed).push_back(next);
+			length += extra;
+			iQueue.pop_front();
+		}
+		std::string channels;
+		std::string keys;
+		uint64_t now = neolib::thread::elapsed_ms();
+		iLastAnswer_ms = now;
+		iBatchAnswered = false;
+		keyed.insert(keyed.end(), unkeyed.begin(), unkeyed.end());
+		for (std::vector<entry>::const_iterator i = keyed.begin(); i != keyed.end(); ++i)
+		{
+			channels += (channels.empty() ? "" : ",") + i->iChannel;
+			if (!i->iKey.empty())
+				keys += (keys.empty() ? "" : ",") + i->iKey;
+			in_flight& newEntry = iInFlight[fold_case(iConnection.casemapping(), i->iChannel)];
+			newEntry.iEntry = *i;
+			newEntry.iSent_ms = now;
+			newEntry.iBlocking = true;
+		}
+		message joinMessage(iConnection, message::OUTGOING);
+		joinMessage.set_command(message::JOIN);
+		joinMessage.set_background(true);
+		joinMessage.parameters().push_back(channels);
+		if (!keys.empty())
+			joinMessage.parameters().push_back(keys);
+		iConnection.send_message(joinMessage);
+	}
+
+	void join_scheduler::answered(const std::string& aChannel, bool aJoined)
+	{
+		in_flight_list::iterator theEntry = iInFlight.find(fold_case(iConnection.casemapping(), aChannel));
+		if (theEntry == iInFlight.end())
+			return;
+		uint64_t now = neolib::thread::elapsed_ms();
+		uint64_t latency = now - theEntry->second.iSent_ms;
+		if (theEntry->second.iBlocking)
+		{
+			iLastAnswer_ms = now;
+			iBatchAnswered = true;
+		}
+		iInFlight.erase(theEntry);
+		if (aJoined)
+		{
+			iJustJoined = fold_case(iConnection.casemapping(), aChannel);
+			notify_observers(join_scheduler_observer::NotifyChannelJoined, aChannel, latency);
+		}
+		send_batch();
+		schedule();
+	}
+
+	void join_scheduler::forwarded(const std::string& aChannel, const std::string& aTarget)
+	{
+		in_flight_list::iterator theEntry = iInFlight.find(fold_case(iConnection.casemapping(), aChannel));
+		if (theEntry == iInFlight.end())
+			return;
+		in_flight forwardedEntry = theEntry->second;
+		iInFlight.erase(theEntry);
+		forwardedEntry.iEntry.iChannel = aTarget;
+		iInFlight[fold_case(iConnection.casemapping(), aTarget)] = forwardedEntry; // answered by the JOIN for the channel we end up in
+	}
+
+	bool join_scheduler::blocked() const
+	{
+		for (in_flight_list::const_iterator i = iInFlight.begin(); i != iInFlight.end(); ++i)
+			if (i->second.iBlocking)
+				return true;
+		return false;
+	}
+
+	void join_scheduler::schedule()
+	{
+		cancel();
+		if (iInFlight.empty())
+			return;
+		uint64_t next = static_cast<uint64_t>(-1);
+		for (in_flight_list::const_iterator i = iInFlight.begin(); i != iInFlight.end(); ++i)
+			next = std::min<uint64_t>(next, i->second.iSent_ms + ChannelTimeout_ms);
+		if (iBatchAnswered && blocked())
+			next = std::min<uint64_t>(next, iLastAnswer_ms + StragglerTimeout_ms);
+		uint64_t now = neolib::thread::elapsed_ms();
+		set_duration(static_cast<uint32_t>(next > now ? next - now : 0), true);
+		reset();
+	}
+
+	void join_scheduler::notify_observer(join_scheduler_observer& aObserver, join_scheduler_observer::notify_type aType, const void* aParameter, const void* aParameter2)
+	{
+		switch(aType)
+		{
+		case join_scheduler_observer::NotifyChannelJoined:
+			aObserver.channel_joined(iConnection, *static_cast<const std::string*>(aParameter), *static_cast<const uint64_t*>(aParameter2));
+			break;
+		}
+	}
+
+	void join_scheduler::incoming_message(connection& aConnection, const message& aMessage)
+	{
+		iJustJoined.clear();
+		if (iInFlight.empty() || aMessage.parameters().empty())
+			return;
+		switch(aMessage.command())
+		{
+		case message::JOIN:
+			if (irc::make_string(aConnection, user(aMessage.origin(), aConnection).nick_name()) == aConnection.nick_name())
+				answered(aMessage.parameters()[0], true);
+			break;
+		case message::ERR_TOOMANYTARGETS:
+			{
+				in_flight_list::iterator theEntry = iInFlight.find(fold_case(iConnection.casemapping(), aMessage.parameters()[0]));
+				if (theEntry != iInFlight.end())
+				{
+					iMaxBatch = std::max<std::size_t>(std::min(iMaxBatch, iInFlight.size()) / 2, 1);
+					iQueue.push_front(theEntry->second.iEntry);
+				}
+				answered(aMessage.parameters()[0], false);
+			}
+			break;
+		case message::ERR_LINKCHANNEL:
+			if (aMessage.parameters().size() >= 2)
+				forwarded(aMessage.parameters()[0], aMessage.parameters()[1]);
+			break;
+		default:
+			if (aMessage.is_numeric_reply())
+			{
+				// any error naming the channel (banned, +i, +k, full, needs a registered nick (477) and 
+				// so on) means the server has finished with it
+				long numeric = neolib::string_to_integer(aMessage.command_string());
+				if (numeric >= 400 && numeric < 600)
+					answered(aMessage.parameters()[0], false);
+			}
+			break;
+		}
+	}
+
+	void join_scheduler::ready()
+	{
+		uint64_t now = neolib::thread::elapsed_ms();
+		for (in_flight_list::iterator i = iInFlight.begin(); i != iInFlight.end();)
+		{
+			if (now - i->second.iSent_ms >= ChannelTimeout_ms)
+				i = iInFlight.erase(i); // the server never answered for this one
+			else
+			{
+				if (i->second.iBlocking && iBatchAnswered && now - iLastAnswer_ms >= StragglerTimeout_ms)
+					i->second.iBlocking = false; // still matched if it is answered late but no longer holds up the rest
+				++i;
+			}
+		}
+		send_batch();
+		schedule();
+	}
+}
@@ -0,0 +1,416 @@
+// log_index.cpp
+/*
+ *  Copyright (c) 2010 Leigh Johnston.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ *     * Neither the name of Leigh Johnston nor the names of any
+ *       other contributors to this software may be used to endorse or
+ *       promote products derived from this software without specific prior
+ *       written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ *  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <neolib/neolib.hpp>
+#include <cstdio>
+#include <cstring>
+#include <cctype>
+#include <algorithm>
+#include <iterator>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <boost/filesystem.hpp>
+#include <neolib/file.hpp>
+#include <neoirc/client/log_index.hpp>
+
+namespace irc
+{
+	namespace
+	{
+		const char sTrailerMagic[] = "NEOIRCFT";
+		enum { MagicSize = 8, TrailerSize = 8 + 8 + 4 + 4 + 8 + 8 + MagicSize, MinTermLength = 2, MaxTermLength = 64 };
+
+		void put_u32(std::string& aBuffer, uint32_t aValue)
+		{
+			for (int i = 0; i < 4; ++i)
+				aBuffer += static_cast<char>((aValue >> (i * 8)) & 0xFF);
+		}
+
+		void put_u64(std::string& aBuffer, uint64_t aValue)
+		{
+			for (int i = 0; i < 8; ++i)
+				aBuffer += static_cast<char>((aValue >> (i * 8)) & 0xFF);
+		}
+
+		uint32_t get_u32(const char* aBuffer)
+		{
+			uint32_t ret = 0;
+			for (int i = 3; i >= 0; --i)
+				ret = (ret << 8) | static_cast<unsigned char>(aBuffer[i]);
+			return ret;
+		}
+
+		uint64_t get_u64(const char* aBuffer)
+		{
+			uint64_t ret = 0;
+			for (int i = 7; i >= 0; --i)
+				ret = (ret << 8) | static_cast<unsigned char>(aBuffer[i]);
+			return ret;
+		}
+
+		struct dictionary_entry
+		{
+			std::string iTerm;
+			uint32_t iCount;
+			uint64_t iOffset;
+			bool operator<(const dictionary_entry& aOther) const { return iTerm < aOther.iTerm; }
+		};
+
+		// guess the nick from a plain text log line, e.g. "[12:34] <nick> hello"
+		std::string guess_nick(const std::string& aLine)
+		{
+			std::string::size_type start = aLine.find('<');
+			if (start == std::string::npos || start > 32)
+				return std::string();
+			std::string::size_type end = aLine.find('>', start);
+			if (end == std::string::npos || end == start + 1 || aLine.find(' ', start) < end)
+				return std::string();
+			std::string nick = aLine.substr(start + 1, end - start - 1);
+			if (!nick.empty() && (nick[0] == '@' || nick[0] == '+' || nick[0] == '%'))
+				nick.erase(0, 1);
+			return nick;
+		}
+	}
+
+	log_index::log_index(const std::string& aLogFileName, casemapping::type aCasemapping) :
+		iLogFileName(aLogFileName), iCasemapping(aCasemapping)
+	{
+	}
+
+	log_index::~log_index()
+	{
+		try
+		{
+			flush();
+		}
+		catch(...)
+		{
+		}
+	}
+
+	void log_index::add(uint64_t aOffset, time_t aTime, const std::string& aNick, const std::string& aContent)
+	{
+		std::vector<std::string> terms;
+		tokenise(aContent, terms);
+		uint32_t documentNumber = static_cast<uint32_t>(iDocuments.size());
+		document newDocument = { aOffset, static_cast<uint64_t>(aTime), fold_case(iCasemapping, aNick) };
+		iDocuments.push_back(newDocument);
+		for (std::vector<std::string>::const_iterator i = terms.begin(); i != terms.end(); ++i)
+		{
+			std::vector<uint32_t>& thePostings = iPostings[*i];
+			if (thePostings.empty() || thePostings.back() != documentNumber)
+				thePostings.push_back(documentNumber);
+		}
+		if (iDocuments.size() >= SegmentSize)
+			flush();
+	}
+
+	void log_index::flush()
+	{
+		if (iDocuments.empty())
+			return;
+		std::string segment;
+		for (documents::const_iterator i = iDocuments.begin(); i != iDocuments.end(); ++i)
+		{
+			put_u64(segment, i->iOffset);
+			put_u64(segment, i->iTime);
+			std::string::size_type nickLength = std::min<std::string::size_type>(i->iNick.size(), 255);
+			segment += static_cast<char>(nickLength);
+			segment.append(i->iNick, 0, nickLength);
+		}
+		std::vector<uint64_t> postingsOffsets;
+		postingsOffsets.reserve(iPostings.size());
+		for (postings::const_iterator i = iPostings.begin(); i != iPostings.end(); ++i)
+		{
+			postingsOffsets.push_back(segment.size());
+			for (std::vector<uint32_t>::const_iterator j = i->second.begin(); j != i->second.end(); ++j)
+				put_u32(segment, *j);
+		}
+		uint64_t dictionaryOffset = segment.size();
+		std::vector<uint64_t>::const_iterator postingsOffset = postingsOffsets.begin();
+		for (postings::const_iterator i = iPostings.begin(); i != iPostings.end(); ++i, ++postingsOffset)
+		{
+			segment += static_cast<char>(i->first.size());
+			segment += i->first;
+			put_u32(segment, static_cast<uint32_t>(i->second.size()));
+			put_u64(segment, *postingsOffset);
+		}
+		put_u64(segment, segment.size() + TrailerSize);
+		put_u64(segment, dictionaryOffset);
+		put_u32(segment, static_cast<uint32_t>(iDocuments.size()));
+		put_u32(segment, static_cast<uint32_t>(iPostings.size()));
+		put_u64(segment, iDocuments.front().iTime);
+		put_u64(segment, iDocuments.back().iTime);
+		segment.append(sTrailerMagic, MagicSize);
+		std::ofstream indexFile(index_file_name().c_str(), std::ios::out|std::ios::app|std::ios::binary);
+		indexFile.write(segment.data(), segment.size());
+		iDocuments.clear();
+		iPostings.clear();
+	}
+
+	void log_index::search(const log_query& aQuery, log_hits& aHits) const
+	{
+		std::vector<std::string> terms;
+		for (std::vector<std::string>::const_iterator i = aQuery.iTerms.begin(); i != aQuery.iTerms.end(); ++i)
+			tokenise(*i, terms);
+		std::sort(terms.begin(), terms.end());
+		terms.erase(std::unique(terms.begin(), terms.end()), terms.end());
+		log_hits hits;
+		search_segment(iDocuments, iPostings, terms, aQuery, hits);
+		std::ifstream indexFile(index_file_name().c_str(), std::ios::in|std::ios::binary);
+		if (indexFile)
+		{
+			indexFile.seekg(0, std::ios_base::end);
+			uint64_t segmentEnd = static_cast<uint64_t>(indexFile.tellg());
+			while (segmentEnd >= TrailerSize && hits.size() < aQuery.iMaxResults)
+			{
+				char trailer[TrailerSize];
+				indexFile.seekg(static_cast<std::streamoff>(segmentEnd - TrailerSize));
+				indexFile.read(trailer, TrailerSize);
+				if (!indexFile || std::memcmp(trailer + TrailerSize - MagicSize, sTrailerMagic, MagicSize) != 0)
+					break;
+				uint64_t segmentSize = get_u64(trailer);
+				uint64_t dictionaryOffset = get_u64(trailer + 8);
+				uint32_t documentCount = get_u32(trailer + 16);
+				uint32_t termCount = get_u32(trailer + 20);
+				time_t firstTime = static_cast<time_t>(get_u64(trailer + 24));
+				time_t lastTime = static_cast<time_t>(get_u64(trailer + 32));
+				if (segmentSize > segmentEnd || dictionaryOffset > segmentSize - TrailerSize)
+					break;
+				uint64_t segmentStart = segmentEnd - segmentSize;
+				segmentEnd = segmentStart;
+				if (lastTime < aQuery.iFrom)
+					break;
+				if (firstTime > aQuery.iTo)
+					continue;
+				postings segmentPostings;
+				if (!terms.empty())
+				{
+					std::vector<char> dictionaryData(static_cast<std::size_t>(segmentSize - TrailerSize - dictionaryOffset));
+					indexFile.seekg(static_cast<std::streamoff>(segmentStart + dictionaryOffset));
+					if (!dictionaryData.empty())
+						indexFile.read(&dictionaryData[0], dictionaryData.size());
+					std::vector<dictionary_entry> dictionary;
+					dictionary.reserve(termCount);
+					for (std::size_t position = 0; position < dictionaryData.size() && dictionary.size() < termCount;)
+					{
+						dictionary_entry entry;
+						std::size_t termLength = static_cast<unsigned char>(dictionaryData[position++]);
+						if (position + termLength + 12 > dictionaryData.size())
+							break;
+						entry.iTerm.assign(&dictionaryData[position], termLength);
+						position += termLength;
+						entry.iCount = get_u32(&dictionaryData[position]);
+						entry.iOffset = get_u64(&dictionaryData[position + 4]);
+						position += 12;
+						dictionary.push_back(entry);
+					}
+					bool missingTerm = false;
+					for (std::vector<std::string>::const_iterator i = terms.begin(); !missingTerm && i != terms.end(); ++i)
+					{
+						dictionary_entry key;
+						key.iTerm = *i;
+						std::vector<dictionary_entry>::const_iterator entry = std::lower_bound(dictionary.begin(), dictionary.end(), key);
+						if (entry == dictionary.end() || entry->iTerm != *i)
+						{
+							missingTerm = true;
+							break;
+						}
+						std::vector<char> postingsData(entry->iCount * 4);
+						indexFile.seekg(static_cast<std::streamoff>(segmentStart + entry->iOffset));
+						if (!postingsData.empty())
+							indexFile.read(&postingsData[0], postingsData.size());
+						std::vector<uint32_t>& thePostings = segmentPostings[*i];
+						thePostings.reserve(entry->iCount);
+						for (uint32_t j = 0; j < entry->iCount; ++j)
+							thePostings.push_back(get_u32(&postingsData[j * 4]));
+					}
+					if (missingTerm)
+						continue;
+				}
+				documents segmentDocuments;
+				segmentDocuments.reserve(documentCount);
+				std::vector<char> documentData(static_cast<std::size_t>(dictionaryOffset));
+				indexFile.seekg(static_cast<std::streamoff>(segmentStart));
+				if (!documentData.empty())
+					indexFile.read(&documentData[0], documentData.size());
+				for (std::size_t position = 0; position + 17 <= documentData.size() && segmentDocuments.size() < documentCount;)
+				{
+					document theDocument;
+					theDocument.iOffset = get_u64(&documentData[position]);
+					theDocument.iTime = get_u64(&documentData[position + 8]);
+					std::size_t nickLength = static_cast<unsigned char>(documentData[position + 16]);
+					position += 17;
+					if (position + nickLength > documentData.size())
+						break;
+					theDocument.iNick.assign(documentData.begin() + position, documentData.begin() + position + nickLength);
+					position += nickLength;
+					segmentDocuments.push_back(theDocument);
+				}
+				search_segment(segmentDocuments, segmentPostings, terms, aQuery, hits);
+			}
+		}
+		// hits were gathered newest first
+		aHits.insert(aHits.end(), hits.rbegin(), hits.rend());
+	}
+
+	void log_index::tokenise(const std::string& aText, std::vector<std::string>& aTerms)
+	{
+		std::string term;
+		for (std::string::const_iterator i = aText.begin(); ; ++i)
+		{
+			unsigned char ch = (i != aText.end() ? static_cast<unsigned char>(*i) : ' ');
+			if (ch >= 0x80 || std::isalnum(ch))
+			{
+				if (term.size() < MaxTermLength)
+					term += static_cast<char>(ch < 0x80 ? std::tolower(ch) : ch);
+			}
+			else
+			{
+				if (term.size() >= MinTermLength)
+					aTerms.push_back(term);
+				term.clear();
+			}
+			if (i == aText.end())
+				break;
+		}
+	}
+
+	bool log_index::stale(const std::string& aLogFileName)
+	{
+		boost::system::error_code ec;
+		std::time_t logTime = boost::filesystem::last_write_time(aLogFileName, ec);
+		if (ec)
+			return false;
+		std::time_t indexTime = boost::filesystem::last_write_time(aLogFileName + ".idx", ec);
+		return ec || indexTime < logTime;
+	}
+
+	bool log_index::build(const std::string& aLogFileName, casemapping::type aCasemapping)
+	{
+		std::ifstream logFile(aLogFileName.c_str(), std::ios::in|std::ios::binary);
+		if (!logFile)
+			return false;
+		log_index theIndex(aLogFileName, aCasemapping);
+		std::remove(theIndex.index_file_name().c_str());
+		// plain text logs only carry a full date in the session timestamps so entries get the time of the preceding one
+		time_t sessionTime = 0;
+		uint64_t offset = 0;
+		std::string line;
+		while (std::getline(logFile, line))
+		{
+			uint64_t lineOffset = offset;
+			offset += line.size() + 1;
+			if (!line.empty() && line[line.size() - 1] == '\r')
+				line.erase(line.size() - 1);
+			if (line.empty())
+				continue;
+			if (line.size() > 6 && (line.compare(0, 3, "-- ") == 0 || line.compare(0, 3, "++ ") == 0))
+			{
+				std::tm tmTime = {};
+				std::istringstream timestamp(line.substr(3, line.size() - 6));
+				timestamp >> std::get_time(&tmTime, "%a %b %d %H:%M:%S %Y");
+				if (!timestamp.fail())
+				{
+					tmTime.tm_isdst = -1;
+					sessionTime = std::mktime(&tmTime);
+				}
+				continue;
+			}
+			theIndex.add(lineOffset, sessionTime, guess_nick(line), line);
+		}
+		theIndex.flush();
+		return true;
+	}
+
+	std::size_t log_index::build_directory(const std::string& aDirectory, casemapping::type aCasemapping)
+	{
+		std::size_t count = 0;
+		boost::system::error_code ec;
+		for (boost::filesystem::recursive_directory_iterator i(aDirectory, ec), end; !ec && i != end; i.increment(ec))
+		{
+			if (boost::filesystem::is_regular_file(i->status()) && i->path().extension() == ".txt" && stale(i->path().string()))
+				if (build(i->path().string(), aCasemapping))
+					++count;
+		}
+		return count;
+	}
+
+	void log_index::search_segment(const documents& aDocuments, const postings& aPostings, const std::vector<std::string>& aTerms, const log_query& aQuery, log_hits& aHits) const
+	{
+		std::vector<uint32_t> matches;
+		if (aTerms.empty())
+		{
+			matches.reserve(aDocuments.size());
+			for (uint32_t i = 0; i < aDocuments.size(); ++i)
+				matches.push_back(i);
+		}
+		else
+		{
+			std::vector<const std::vector<uint32_t>*> lists;
+			for (std::vector<std::string>::const_iterator i = aTerms.begin(); i != aTerms.end(); ++i)
+			{
+				postings::const_iterator thePostings = aPostings.find(*i);
+				if (thePostings == aPostings.end())
+					return;
+				lists.push_back(&thePostings->second);
+			}
+			std::sort(lists.begin(), lists.end(), 
+				[](const std::vector<uint32_t>* aLeft, const std::vector<uint32_t>* aRight) { return aLeft->size() < aRight->size(); });
+			matches = *lists[0];
+			for (std::size_t i = 1; i < lists.size() && !matches.empty(); ++i)
+			{
+				std::vector<uint32_t> intersection;
+				std::set_intersection(matches.begin(), matches.end(), lists[i]->begin(), lists[i]->end(), std::back_inserter(intersection));
+				matches.swap(intersection);
+			}
+		}
+		std::string nick = fold_case(iCasemapping, aQuery.iNick);
+		for (std::vector<uint32_t>::const_reverse_iterator i = matches.rbegin(); i != matches.rend() && aHits.size() < aQuery.iMaxResults; ++i)
+		{
+			if (*i >= aDocuments.size())
+				continue;
+			const document& theDocument = aDocuments[*i];
+			time_t theTime = static_cast<time_t>(theDocument.iTime);
+			if (theTime < aQuery.iFrom || theTime > aQuery.iTo)
+				continue;
+			if (!nick.empty() && theDocument.iNick != nick)
+				continue;
+			log_hit newHit = { iLogFileName, theDocument.iOffset, theTime, theDocument.iNick };
+			aHits.push_back(newHit);
+		}
+	}
+}
@@ -36,18 +36,16 @@
 #include <neolib/neolib.hpp>
 #include <fstream>
 #include <ctime>
-#include <clocale>
+#include <boost/filesystem.hpp>
+#include <zlib.h>
 #include <neolib/file.hpp>
 #include <neoirc/client/logger.hpp>
 #include <neoirc/client/model.hpp>
+#include <neoirc/client/scrollback_file.hpp>
+#include <neoirc/client/timestamp.hpp>
 
 namespace irc
 {
-	namespace
-	{
-		enum { LoggerBufferSize = 4096 };
-	}
-
 	bool logger::scrollbacker::is(irc::buffer& aBuffer) const
 	{
 		if (iBuffer.is<irc::buffer*>() && static_cast<irc::buffer*>(iBuffer) == &aBuffer)
@@ -64,10 +62,9 @@ namespace irc
 			return false;
 	}
 
-	void logger::scrollbacker::task()
+	void logger::scrollbacker::run()
 	{
 		std::string filename;
-		std::string sep = "\r\n";
 		bool isIRC = true;
 		if (iBuffer.is<irc::buffer*>())
 		{
@@ -81,100 +78,50 @@ namespace irc
 			isIRC = false;
 		}
 
-		std::ifstream scrollbackerFile(filename.c_str(), std::ios::in|std::ios::binary);
-		if (scrollbackerFile)
+		if (!scrollback_file::is_scrollback_file(filename))
 		{
-			scrollbackerFile.seekg(0, std::ios_base::end);
-			std::ifstream::pos_type pos = scrollbackerFile.tellg();
-			bool chopFile = (static_cast<std::size_t>(pos) > iParent.iScrollbackSize * 1024);
-			std::string text;
-			bool finished = false;
-			while(pos > 0 && running() && !finished)
-			{
-				std::ifstream::off_type offset = (pos < LoggerBufferSize ? pos : LoggerBufferSize);
-				scrollbackerFile.seekg(-offset, std::ios_base::cur);
-				char more[LoggerBufferSize];
-				scrollbackerFile.read(more, offset);
-				scrollbackerFile.seekg(-offset, std::ios_base::cur);
-				pos = scrollbackerFile.tellg();
-				text = std::string(more, static_cast<std::size_t>(offset)) + text;
-				typedef std::pair<std::string::iterator, std::string::iterator> line_t;
-				typedef std::vector<line_t> lines_t;
-				lines_t lines;
-				neolib::tokens(text.begin(), text.end(), sep.begin(), sep.end(), lines, 0, true, true);
-				for (lines_t::reverse_iterator i = lines.rbegin(); i != lines.rend() && !finished;)
-				{
-					line_t line = *i++;
-					if (i != lines.rend() || pos == std::ifstream::pos_type(0))
-					{
-						if (line.first != line.second)
-						{
-							if (isIRC)
-							{
-								message theMessage(*static_cast<irc::buffer*>(iBuffer), message::INCOMING, true);
-								if (theMessage.parse_log(std::string(line.first, line.second)))
-									static_cast<buffer_messages&>(iMessages).push_front(theMessage);
-								if (static_cast<buffer_messages&>(iMessages).size() == iBufferSize)
-									finished = true;
-							}
-							else
-							{
-								dcc_message theMessage(*static_cast<dcc_buffer*>(iBuffer), dcc_message::INCOMING, dcc_message::NORMAL, true);
-								if (theMessage.parse_log(std::string(line.first, line.second)))
-									static_cast<dcc_messages&>(iMessages).push_front(theMessage);
-								if (static_cast<dcc_messages&>(iMessages).size() == iBufferSize)
-									finished = true;
-							}
-						}
-					}
-					else
-						text = std::string(line.first, line.second) + sep;
-				}
-			}
-			if (chopFile)
+			// one-time conversion of the old plain text scrollback file
+			std::string legacyFilename = filename.substr(0, filename.size() - 4) + ".irc";
+			if (neolib::file_exists(legacyFilename) && scrollback_file::convert(legacyFilename, filename))
+				remove(legacyFilename.c_str());
+		}
+
+		bool chopFile = false;
+		try
+		{
+			scrollback_file scrollbackerFile(filename);
+			if (scrollbackerFile.is_open())
 			{
-				scrollbackerFile.seekg(-(static_cast<std::ifstream::off_type>(iParent.iScrollbackSize) * 1024 / 2), std::ios_base::end);
-				std::ofstream choppedScrollbackerFile((filename + ".tmp").c_str(), std::ios::out|std::ios::app|std::ios::binary);
-				char buffer[LoggerBufferSize];
-				long count = iParent.iScrollbackSize * 1024 / 2;
-				bool hadNewline = false;
-				while(count > 0 && running())
+				chopFile = (scrollbackerFile.data_size() > iParent.iScrollbackSize * 1024);
+				scrollback_file::records records = (iFrom != 0 ? scrollbackerFile.from(iFrom, iBufferSize) : scrollbackerFile.tail(iBufferSize));
+				for (scrollback_file::records::const_iterator i = records.begin(); i != records.end() && !cancelled(); ++i)
 				{
-					long readLength = count > LoggerBufferSize ? LoggerBufferSize : count;
-					scrollbackerFile.read(buffer, readLength);
-					if (!hadNewline)
+					if (isIRC)
 					{
-						char* newLine = std::find(buffer, buffer+readLength, '\n');
-						if (newLine != buffer+readLength)
-						{
-							hadNewline = true;
-							if (newLine != buffer+readLength-1)
-								choppedScrollbackerFile.write(newLine+1, (buffer+readLength) - (newLine+1));
-						}
+						message theMessage(*static_cast<irc::buffer*>(iBuffer), message::INCOMING, true);
+						if (theMessage.parse_log(i->iText))
+							static_cast<buffer_messages&>(iMessages).push_back(theMessage);
 					}
 					else
 					{
-						choppedScrollbackerFile.write(buffer, readLength);
+						dcc_message theMessage(*static_cast<dcc_buffer*>(iBuffer), dcc_message::INCOMING, dcc_message::NORMAL, true);
+						if (theMessage.parse_log(i->iText))
+							static_cast<dcc_messages&>(iMessages).push_back(theMessage);
 					}
-					count -= LoggerBufferSize;
-				}
-				if (running())
-				{
-					scrollbackerFile.close();
-					choppedScrollbackerFile.close();
-					remove(filename.c_str());
-					rename((filename + ".tmp").c_str(), filename.c_str());
 				}
 			}
 		}
-		if (!running())
-			remove((filename + ".tmp").c_str());
+		catch(scrollback_file::bad_file&)
+		{
+		}
+		if (chopFile && !cancelled())
+			scrollback_file::chop(filename, static_cast<scrollback_file::offset>(iParent.iScrollbackSize) * 1024 / 2);
 	}
 
 	logger::logger(model& aModel, connection_manager& aConnectionManager, dcc_connection_manager& aDccConnectionManager) :
 		iModel{ aModel }, iConnectionManager{ aConnectionManager }, iDccConnectionManager{ aDccConnectionManager },
 		iEnabled{ false }, iEvents{ Message }, iServerLog{ false },
-		iScrollbackLogs{ false }, iScrollbackSize{ 1000 }, iArchive{ false }, iArchiveSize{ 1000 },
+		iScrollbackLogs{ false }, iScrollbackSize{ 1000 }, iArchive{ false }, iArchiveSize{ 1000 }, iCompressArchives{ false }, iSearchIndex{ false },
 		iUpdateTimer{ aModel.io_task(), [this](neolib::callback_timer&) { process_pending(); iUpdateTimer.again(); }, 10 }
 	{
 		iConnectionManager.add_observer(*this);
@@ -183,7 +130,10 @@ namespace irc
 
 	logger::~logger()
 	{
-		iScrollbackers.clear();
+		while (!iScrollbackers.empty())
+			remove_scrollbacker(iScrollbackers.begin());
+		iScrollbackFiles.clear();
+		iSearchIndices.clear();
 		for (logged_connections::iterator i = iLoggedConnections.begin(); i != iLoggedConnections.end(); ++i)
 			(*i)->remove_observer(*this);
 		for (logged_buffers::iterator i = iLoggedBuffers.begin(); i != iLoggedBuffers.end(); ++i)
@@ -201,6 +151,7 @@ namespace irc
 		iEnabled = aEnable;
 		if (iEnabled)
 		{
+			iLogSizes.clear();
 			create_directories();
 			timestamp_all();
 		}
@@ -237,6 +188,17 @@ namespace irc
 		return true;
 	}
 	 
+	void logger::set_search_index(bool aSearchIndex)
+	{
+		if (iSearchIndex == aSearchIndex)
+			return;
+		iSearchIndex = aSearchIndex;
+		iSearchIndices.clear();
+		// logs written while indexing was off are not in their index
+		if (iSearchIndex && !iDirectory.empty())
+			log_index::build_directory(iDirectory);
+	}
+
 	std::string logger::directory(buffer::type_e aBufferType) const
 	{
 		std::string ret;
@@ -281,12 +243,14 @@ namespace irc
 		for (scrollbackers::iterator i = iScrollbackers.begin(); i != iScrollbackers.end();)
 		{
 			scrollbacker& theScrollbacker = **i;
-			if (!theScrollbacker.running())
+			if (theScrollbacker.finished())
 			{
 				if (theScrollbacker.buffer().is<buffer*>())
 				{
 					buffer& theBuffer = static_cast<buffer&>(*static_cast<buffer*>(theScrollbacker.buffer()));
 					scrollbacker::messages_t& theMessages = theScrollbacker.messages();
+					if (theScrollbacker.from() != 0)
+						theBuffer.clear();
 					theBuffer.scrollback(static_cast<scrollbacker::buffer_messages&>(theMessages));
 					scrollbacker::messages_t& theNewMessages = theScrollbacker.new_messages();
 					for (scrollbacker::buffer_messages::iterator j = static_cast<scrollbacker::buffer_messages&>(theNewMessages).begin(); 
@@ -296,7 +260,7 @@ namespace irc
 						std::string line = neolib::unsigned_integer_to_string<char>(static_cast<unsigned long>(theMessage.time()));
 						line += (theMessage.direction() == message::INCOMING ? " < " : " > ");
 						line += theMessage.to_string(iModel.message_strings(), true, true);
-						new_entry(filename(theBuffer, Scrollback), line, Scrollback);
+						new_scrollback_entry(filename(theBuffer, Scrollback), theMessage.time(), line);
 					}
 				}
 				else
@@ -312,7 +276,7 @@ namespace irc
 						std::string line = neolib::unsigned_integer_to_string<char>(static_cast<unsigned long>(theMessage.time()));
 						line += (theMessage.direction() == dcc_message::INCOMING ? " < " : " > ");
 						line += theMessage.to_string();
-						new_entry(filename(theBuffer, Scrollback), line, Scrollback);
+						new_scrollback_entry(filename(theBuffer, Scrollback), theMessage.time(), line);
 					}
 				}
 				i = iScrollbackers.erase(i);
@@ -324,16 +288,9 @@ namespace irc
 
 	void logger::get_timestamp(std::string& aTimeStamp, bool aContinuation)
 	{
-		std::time_t ttTime = std::time(0);
-		std::tm* tmTime = std::localtime(&ttTime);
-		std::setlocale(LC_TIME, "");
-		std::vector<char> strTime;
-		strTime.resize(LoggerBufferSize);
-		if (!aContinuation)
-			std::strftime(&*strTime.begin(), LoggerBufferSize, "-- %a %b %#d %H:%M:%S %Y --\r\n", tmTime);
-		else
-			std::strftime(&*strTime.begin(), LoggerBufferSize, "++ %a %b %#d %H:%M:%S %Y ++\r\n", tmTime);
-		aTimeStamp = std::string(&*strTime.begin());
+		static const std::string sTimeStampFormat = "-- %a %b %#d %H:%M:%S %Y --\r\n";
+		static const std::string sContinuationFormat = "++ %a %b %#d %H:%M:%S %Y ++\r\n";
+		aTimeStamp = timestamp_formatter::instance().format(std::time(0), aContinuation ? sContinuationFormat : sTimeStampFormat);
 	}
 
 	std::string logger::filename(const buffer& aBuffer, filename_type_e aType)
@@ -343,7 +300,7 @@ namespace irc
 			fileName = aBuffer.name();
 		else
 			fileName = "Server";
-		fileName = fileName + " (" + aBuffer.connection().server().network()/* + " - " + aBuffer.connection().server().name()*/ + (aType == Scrollback ? ").irc" : ").txt");
+		fileName = fileName + " (" + aBuffer.connection().server().network()/* + " - " + aBuffer.connection().server().name()*/ + (aType == Scrollback ? ").irb" : ").txt");
 		for (std::string::iterator i = fileName.begin(); i != fileName.end(); ++i)
 		{
 			switch(*i)
@@ -365,17 +322,17 @@ namespace irc
 		return neolib::create_file(directory(aBuffer.type()) + fileName);
 	}
 
-	void logger::new_entry(buffer& aBuffer, const std::string& aText)
+	void logger::new_entry(buffer& aBuffer, const std::string& aText, const search_entry* aSearchEntry)
 	{
 		if (aBuffer.type() == buffer::SERVER && !iServerLog)
 			return;
 
-		new_entry(filename(aBuffer), aText);
+		new_entry(filename(aBuffer), aText, Normal, aSearchEntry);
 	}
 
 	std::string logger::filename(const dcc_buffer& aBuffer, filename_type_e aType)
 	{
-		std::string fileName = aBuffer.name() + (aType == Scrollback ? ".irc" : ".txt");
+		std::string fileName = aBuffer.name() + (aType == Scrollback ? ".irb" : ".txt");
 		for (std::string::iterator i = fileName.begin(); i != fileName.end(); ++i)
 		{
 			switch(*i)
@@ -402,49 +359,239 @@ namespace irc
 		new_entry(filename(aBuffer), aText);
 	}
 
-	void logger::new_entry(const std::string& aFileName, const std::string& aText, filename_type_e aType)
+	void logger::new_entry(const std::string& aFileName, const std::string& aText, filename_type_e aType, const search_entry* aSearchEntry)
 	{
 		if (!iEnabled)
 			return;
-		if (aType == Normal)
+		// log file sizes are tracked in memory; the file is only examined the first time it is written to
+		log_sizes::iterator size = iLogSizes.find(aFileName);
+		if (size == iLogSizes.end())
 		{
-			std::ifstream logfile(aFileName.c_str(), std::ios::in|std::ios::binary);
-			wchar_t BOM;
-			logfile.read(reinterpret_cast<char*>(&BOM), 2);
-			if (logfile && (BOM == 0xFEFF || BOM == 0xFFFE))
+			if (aType == Normal)
 			{
-				throw utf16_logfile_unsupported();
+				std::ifstream logfile(aFileName.c_str(), std::ios::in|std::ios::binary);
+				wchar_t BOM;
+				logfile.read(reinterpret_cast<char*>(&BOM), 2);
+				if (logfile && (BOM == 0xFEFF || BOM == 0xFFFE))
+				{
+					throw utf16_logfile_unsupported();
+				}
 			}
+			boost::system::error_code ec;
+			uint64_t existingSize = boost::filesystem::file_size(aFileName, ec);
+			size = iLogSizes.insert(std::make_pair(aFileName, ec ? 0 : existingSize)).first;
 		}
-		std::ofstream::pos_type length;
+		bool written;
 		{
 			std::ofstream logfile(aFileName.c_str(), std::ios::out|std::ios::app|std::ios::binary);
 			logfile.write(aText.c_str(), aText.size());
-			length = logfile.tellp();
+			written = !logfile.fail();
+		}
+		if (!written)
+		{
+			iLogSizes.erase(size);
+			return;
 		}
-		if (aType == Normal && iArchive && length > static_cast<std::ofstream::pos_type>(iArchiveSize * 1024))
+		uint64_t offset = size->second;
+		size->second += aText.size();
+		if (aSearchEntry != 0 && iSearchIndex)
+			search_index_for(aFileName, aSearchEntry->iCasemapping).add(offset, aSearchEntry->iTime, aSearchEntry->iNick, aSearchEntry->iContent);
+		if (aType == Normal && iArchive && size->second > static_cast<uint64_t>(iArchiveSize) * 1024)
 		{
-			int n = 1;
-			std::string archiveFileName = aFileName;
-			std::string::size_type sep = archiveFileName.find_last_of(model::sPathSeparator);
-			archiveFileName.insert(sep, std::string(1, model::sPathSeparator) + "archive");
-			neolib::replace_string(archiveFileName, std::string(".txt"), std::string(" (%n%).txt"));
-			for (std::size_t tryNumber = 1; tryNumber < 10000; ++tryNumber)
+			log_sizes::const_iterator retry = iArchiveRetrySizes.find(aFileName);
+			if (retry == iArchiveRetrySizes.end() || size->second >= retry->second)
+				archive(aFileName);
+		}
+	}
+
+	void logger::archive(const std::string& aFileName)
+	{
+		std::size_t& counter = archive_counter(aFileName);
+		// numbers can be taken behind our back (another instance, a copied-in archive) so skip to a free one
+		while (neolib::file_exists(archive_file_name(aFileName, counter + 1)) || neolib::file_exists(archive_file_name(aFileName, counter + 1) + ".gz"))
+			++counter;
+		std::string archiveFileName = archive_file_name(aFileName, counter + 1);
+		if (!neolib::move_file(aFileName, archiveFileName))
+		{
+			// leave the log and its index as they are and try again once it has grown by another archive size
+			iArchiveRetrySizes[aFileName] = iLogSizes[aFileName] + static_cast<uint64_t>(iArchiveSize) * 1024;
+			return;
+		}
+		++counter;
+		iArchiveRetrySizes.erase(aFileName);
+		iLogSizes.erase(aFileName);
+		close_search_index(aFileName);
+		if (neolib::file_exists(aFileName + ".idx"))
+			neolib::move_file(aFileName + ".idx", archiveFileName + ".idx");
+		if (iCompressArchives)
+			iModel.background_executor().post([archiveFileName]() { compress_archive(archiveFileName); }, std::function<void()>(), background_executor::Low);
+		std::string timestamp;
+		get_timestamp(timestamp, true);
+		new_entry(aFileName, timestamp);
+	}
+
+	std::size_t& logger::archive_counter(const std::string& aFileName)
+	{
+		archive_counters::iterator existing = iArchiveCounters.find(aFileName);
+		if (existing != iArchiveCounters.end())
+			return existing->second;
+		// the first archive of any log in a directory scans that directory's archives once for the highest numbers in use
+		std::string::size_type sep = aFileName.find_last_of(model::sPathSeparator);
+		std::string logDirectory = (sep != std::string::npos ? aFileName.substr(0, sep + 1) : std::string());
+		if (iArchiveDirectories.insert(logDirectory).second)
+		{
+			boost::system::error_code ec;
+			for (boost::filesystem::directory_iterator i(logDirectory + "archive", ec), end; !ec && i != end; i.increment(ec))
 			{
-				std::string tryFileName = archiveFileName;
-				neolib::replace_string(tryFileName, std::string("%n%"), neolib::unsigned_integer_to_string<char>(tryNumber));
-				if (!neolib::file_exists(tryFileName))
-				{
-					if (neolib::move_file(aFileName, tryFileName))
-					{
-						std::string timestamp;
-						get_timestamp(timestamp, true);
-						new_entry(aFileName, timestamp, aType);
-					}
-					break;
-				}
+				std::string name = i->path().filename().string();
+				if (name.size() > 3 && name.compare(name.size() - 3, 3, ".gz") == 0)
+					name.erase(name.size() - 3);
+				if (name.size() < 5 || name.compare(name.size() - 5, 5, ").txt") != 0)
+					continue;
+				std::string::size_type open = name.rfind(" (");
+				if (open == std::string::npos)
+					continue;
+				std::string number = name.substr(open + 2, name.size() - 5 - (open + 2));
+				if (number.empty() || number.find_first_not_of("0123456789") != std::string::npos)
+					continue;
+				std::size_t& counter = iArchiveCounters[logDirectory + name.substr(0, open) + ".txt"];
+				counter = std::max<std::size_t>(counter, neolib::string_to_unsigned_integer(number));
 			}
 		}
+		return iArchiveCounters[aFileName];
+	}
+
+	std::string logger::archive_file_name(const std::string& aFileName, std::size_t aNumber)
+	{
+		std::string archiveFileName = aFileName;
+		std::string::size_type sep = archiveFileName.find_last_of(model::sPathSeparator);
+		archiveFileName.insert(sep, std::string(1, model::sPathSeparator) + "archive");
+		neolib::replace_string(archiveFileName, std::string(".txt"), std::string(" (") + neolib::unsigned_integer_to_string<char>(aNumber) + ").txt");
+		return archiveFileName;
+	}
+
+	bool logger::compress_archive(const std::string& aArchiveFileName)
+	{
+		// the archive's search index stays alongside under the uncompressed name; its offsets are into the uncompressed text
+		std::string compressedFileName = aArchiveFileName + ".gz";
+		std::ifstream input(aArchiveFileName.c_str(), std::ios::in|std::ios::binary);
+		if (!input)
+			return false;
+		gzFile output = gzopen(compressedFileName.c_str(), "wb");
+		if (output == 0)
+			return false;
+		bool ok = true;
+		std::vector<char> buffer(64 * 1024);
+		while (ok && input)
+		{
+			input.read(&buffer[0], buffer.size());
+			std::streamsize count = input.gcount();
+			if (count > 0 && gzwrite(output, &buffer[0], static_cast<unsigned>(count)) != count)
+				ok = false;
+		}
+		if (input.bad())
+			ok = false;
+		if (gzclose(output) != Z_OK)
+			ok = false;
+		input.close();
+		boost::system::error_code ec;
+		boost::filesystem::remove(ok ? aArchiveFileName : compressedFileName, ec);
+		return ok;
+	}
+
+	void logger::new_scrollback_entry(const std::string& aFileName, time_t aTime, const std::string& aLine)
+	{
+		if (!iEnabled)
+			return;
+		scrollback_files::iterator i = iScrollbackFiles.find(aFileName);
+		if (i == iScrollbackFiles.end())
+		{
+			try
+			{
+				i = iScrollbackFiles.insert(std::make_pair(aFileName, scrollback_file_pointer(new scrollback_file(aFileName, true)))).first;
+			}
+			catch(scrollback_file::bad_file&)
+			{
+				return;
+			}
+		}
+		i->second->append(aTime, aLine);
+	}
+
+	void logger::close_scrollback_file(const std::string& aFileName)
+	{
+		iScrollbackFiles.erase(aFileName);
+	}
+
+	log_index& logger::search_index_for(const std::string& aFileName, casemapping::type aCasemapping)
+	{
+		log_indices::iterator i = iSearchIndices.find(aFileName);
+		if (i == iSearchIndices.end())
+			i = iSearchIndices.insert(std::make_pair(aFileName, log_index_pointer(new log_index(aFileName, aCasemapping)))).first;
+		return *i->second;
+	}
+
+	void logger::close_search_index(const std::string& aFileName)
+	{
+		iSearchIndices.erase(aFileName);
+	}
+
+	bool logger::scrollback_from(buffer& aBuffer, time_t aTime)
+	{
+		if (!iScrollbackLogs || scrollbacker_for_buffer(aBuffer) != iScrollbackers.end())
+			return false;
+		iScrollbackers.push_back(scrollbacker_pointer(new scrollbacker(*this, aBuffer, aTime)));
+		iModel.background_executor().post(iScrollbackers.back(), background_executor::High); // the user asked for it
+		return true;
+	}
+
+	void logger::search(const buffer& aBuffer, const log_query& aQuery, log_hits& aHits)
+	{
+		search(filename(aBuffer), aQuery, aHits, aBuffer.casemapping());
+	}
+
+	void logger::search(const std::string& aLogFileName, const log_query& aQuery, log_hits& aHits, casemapping::type aCasemapping)
+	{
+		log_hits hits;
+		log_indices::iterator current = iSearchIndices.find(aLogFileName);
+		if (current != iSearchIndices.end())
+			current->second->search(aQuery, hits);
+		else
+		{
+			if (iSearchIndex && log_index::stale(aLogFileName))
+				log_index::build(aLogFileName, aCasemapping);
+			log_index(aLogFileName, aCasemapping).search(aQuery, hits);
+		}
+		// then the archived logs, newest first
+		for (std::size_t n = archive_counter(aLogFileName); n > 0 && hits.size() < aQuery.iMaxResults; --n)
+		{
+			std::string archiveFileName = archive_file_name(aLogFileName, n);
+			std::string actualFileName = archiveFileName;
+			if (!neolib::file_exists(actualFileName))
+			{
+				actualFileName += ".gz";
+				if (!neolib::file_exists(actualFileName))
+					continue;
+			}
+			log_query remaining = aQuery;
+			remaining.iMaxResults = aQuery.iMaxResults - hits.size();
+			log_hits archiveHits;
+			if (iSearchIndex && log_index::stale(archiveFileName))
+				log_index::build(archiveFileName, aCasemapping);
+			log_index(archiveFileName, aCasemapping).search(remaining, archiveHits);
+			for (log_hits::iterator i = archiveHits.begin(); i != archiveHits.end(); ++i)
+				i->iFileName = actualFileName;
+			hits.insert(hits.begin(), archiveHits.begin(), archiveHits.end());
+		}
+		aHits.insert(aHits.end(), hits.begin(), hits.end());
+	}
+
+	void logger::remove_scrollbacker(scrollbackers::iterator aScrollbacker)
+	{
+		// the scrollbacker refers to its buffer so wait for it to stop before letting go
+		(*aScrollbacker)->cancel();
+		(*aScrollbacker)->wait();
+		iScrollbackers.erase(aScrollbacker);
 	}
 
 	logger::scrollbackers::iterator logger::scrollbacker_for_buffer(buffer& aBuffer)
@@ -474,6 +621,14 @@ namespace irc
 		iLoggedConnections.remove(&aConnection);
 	}
 
+	void logger::buffer_activated(buffer& aActiveBuffer)
+	{
+		// load the scrollback of the buffer the user is looking at first
+		scrollbackers::iterator i = scrollbacker_for_buffer(aActiveBuffer);
+		if (i != iScrollbackers.end())
+			iModel.background_executor().prioritise(**i, background_executor::High);
+	}
+
 	void logger::buffer_added(buffer& aBuffer)
 	{
 		iLoggedBuffers.push_back(&aBuffer);
@@ -484,19 +639,19 @@ namespace irc
 		if (iScrollbackLogs && (aBuffer.type() != buffer::SERVER || iServerLog))
 		{
 			iScrollbackers.push_back(scrollbacker_pointer(new scrollbacker(*this, aBuffer)));
-			iScrollbackers.back()->start();
+			iModel.background_executor().post(iScrollbackers.back());
 		}
 	}
 
 	void logger::buffer_removed(buffer& aBuffer)
 	{
 		iLoggedBuffers.remove(&aBuffer);
-		for (scrollbackers::iterator i = iScrollbackers.begin(); i != iScrollbackers.end(); ++i)
-			if ((*i)->is(aBuffer))
-			{
-				iScrollbackers.erase(i);
-				break;
-			}
+		close_scrollback_file(filename(aBuffer, Scrollback));
+		close_search_index(filename(aBuffer));
+		iLogSizes.erase(filename(aBuffer));
+		scrollbackers::iterator i = scrollbacker_for_buffer(aBuffer);
+		if (i != iScrollbackers.end())
+			remove_scrollbacker(i);
 	}
 
 	void logger::buffer_message(buffer& aBuffer, const message& aMessage)
@@ -511,7 +666,7 @@ namespace irc
 				std::string line = neolib::unsigned_integer_to_string<char>(static_cast<unsigned long>(aMessage.time()));
 				line += (aMessage.direction() == message::INCOMING ? " < " : " > ");
 				line += aMessage.to_string(iModel.message_strings(), true, true);
-				new_entry(filename(aBuffer, Scrollback), line, Scrollback);
+				new_scrollback_entry(filename(aBuffer, Scrollback), aMessage.time(), line);
 			}
 			else
 			{
@@ -554,7 +709,15 @@ namespace irc
 				return;
 			break;
 		}
-		new_entry(aBuffer, aMessage.to_nice_string(iModel.message_strings(), &aBuffer));
+		if (!iSearchIndex)
+		{
+			new_entry(aBuffer, aMessage.to_nice_string(iModel.message_strings(), &aBuffer));
+			return;
+		}
+		search_entry searchEntry = { aMessage.time(), 
+			aMessage.direction() == message::INCOMING ? irc::user(aMessage.origin(), aBuffer).nick_name() : aBuffer.connection().nick_name(), 
+			aMessage.content(), aBuffer.casemapping() };
+		new_entry(aBuffer, aMessage.to_nice_string(iModel.message_strings(), &aBuffer), &searchEntry);
 	}
 
 	void logger::dcc_connection_added(dcc_connection& aConnection)
@@ -571,7 +734,7 @@ namespace irc
 		if (iScrollbackLogs)
 		{
 			iScrollbackers.push_back(scrollbacker_pointer(new scrollbacker(*this, static_cast<dcc_buffer&>(aConnection))));
-			iScrollbackers.back()->start();
+			iModel.background_executor().post(iScrollbackers.back());
 		}
 	}
 
@@ -580,12 +743,11 @@ namespace irc
 		if (aConnection.type() != dcc_connection::CHAT)
 			return;
 		iLoggedDccChatConnections.remove(static_cast<dcc_buffer*>(&aConnection));
-		for (scrollbackers::iterator i = iScrollbackers.begin(); i != iScrollbackers.end(); ++i)
-			if ((*i)->is(static_cast<dcc_buffer&>(aConnection)))
-			{
-				iScrollbackers.erase(i);
-				break;
-			}
+		close_scrollback_file(filename(static_cast<dcc_buffer&>(aConnection), Scrollback));
+		iLogSizes.erase(filename(static_cast<dcc_buffer&>(aConnection)));
+		scrollbackers::iterator i = scrollbacker_for_buffer(static_cast<dcc_buffer&>(aConnection));
+		if (i != iScrollbackers.end())
+			remove_scrollbacker(i);
 	}
 
 	void logger::dcc_chat_message(dcc_buffer& aBuffer, const dcc_message& aMessage)
@@ -600,7 +762,7 @@ namespace irc
 				std::string line = neolib::unsigned_integer_to_string<char>(static_cast<unsigned long>(aMessage.time()));
 				line += (aMessage.direction() == dcc_message::INCOMING ? " < " : " > ");
 				line += aMessage.to_string();
-				new_entry(filename(aBuffer, Scrollback), line, Scrollback);
+				new_scrollback_entry(filename(aBuffer, Scrollback), aMessage.time(), line);
 			}
 			else
 			{
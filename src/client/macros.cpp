@@ -37,6 +37,7 @@
 #include <neolib/xml.hpp>
 #include <neolib/vecarray.hpp>
 #include <fstream>
+#include <sstream>
 #include <neoirc/client/model.hpp>
 #include <neoirc/client/buffer.hpp>
 #include <neoirc/client/channel_buffer.hpp>
@@ -335,13 +336,17 @@ namespace irc
 
 	void read_macros(model& aModel, std::function<bool()> aErrorFunction)
 	{
-		macros& theMacros = aModel.macros();
-
 		neolib::xml xmlMacros(true);
 		std::ifstream input((aModel.root_path() + "macros.xml").c_str());
 		xmlMacros.read(input);
+		read_macros(aModel, xmlMacros, aErrorFunction);
+	}
+
+	void read_macros(model& aModel, const neolib::xml& aXml, std::function<bool()> aErrorFunction)
+	{
+		macros& theMacros = aModel.macros();
 
-		if (xmlMacros.error() && aErrorFunction && aErrorFunction())
+		if (aXml.error() && aErrorFunction && aErrorFunction())
 		{
 			theMacros.entries().clear();
 			write_macros(aModel);
@@ -350,7 +355,7 @@ namespace irc
 
 		theMacros.loading(true);
 
-		for (neolib::xml::element::const_iterator i = xmlMacros.root().begin(); i != xmlMacros.root().end(); ++i)
+		for (neolib::xml::element::const_iterator i = aXml.root().begin(); i != aXml.root().end(); ++i)
 		{
 			if (i->name() == "entry")
 			{
@@ -407,7 +412,8 @@ namespace irc
 				xmlMacros.append(xmlEntryScript, "line").append_text(*i);
 		}
 
-		std::ofstream output((aModel.root_path() + "macros.xml").c_str());
+		std::ostringstream output;
 		xmlMacros.write(output);
+		aModel.save_config(aModel.root_path() + "macros.xml", output.str());
 	}
 }
\ No newline at end of file
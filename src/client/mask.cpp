@@ -0,0 +1,140 @@
+// mask.cpp
+/*
+ *  Copyright (c) 2010 Leigh Johnston.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ *     * Neither the name of Leigh Johnston nor the names of any
+ *       other contributors to this software may be used to endorse or
+ *       promote products derived from this software without specific prior
+ *       written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ *  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <neolib/neolib.hpp>
+#include <neoirc/client/mask.hpp>
+
+namespace irc
+{
+	mask::mask(casemapping::type aCasemapping, const std::string& aPattern) : 
+		iKind(Glob), iPattern(fold_case(aCasemapping, aPattern)), iMinimumLength(0)
+	{
+		std::string::size_type firstWild = iPattern.find_first_of("*?");
+		std::string::size_type lastWild = iPattern.find_last_of("*?");
+		if (iPattern.empty())
+			iKind = Empty;
+		else if (iPattern.find_first_not_of('*') == std::string::npos)
+			iKind = Any;
+		else if (firstWild == std::string::npos)
+		{
+			iKind = Literal;
+			iLiteral = iPattern;
+		}
+		else if (firstWild == lastWild && iPattern[firstWild] == '*' && firstWild == 0)
+		{
+			iKind = Suffix;
+			iLiteral = iPattern.substr(1);
+		}
+		else if (firstWild == lastWild && iPattern[firstWild] == '*' && firstWild == iPattern.size() - 1)
+		{
+			iKind = Prefix;
+			iLiteral = iPattern.substr(0, firstWild);
+		}
+		else
+		{
+			iHead = iPattern.substr(0, firstWild);
+			iTail = iPattern.substr(lastWild + 1);
+			for (std::string::const_iterator i = iPattern.begin(); i != iPattern.end(); ++i)
+				if (*i != '*')
+					++iMinimumLength;
+		}
+	}
+
+	bool mask::matches(const std::string& aFoldedText) const
+	{
+		switch(iKind)
+		{
+		case Empty:
+			return aFoldedText.empty();
+		case Any:
+			return true;
+		case Literal:
+			return aFoldedText == iLiteral;
+		case Prefix:
+			return aFoldedText.compare(0, iLiteral.size(), iLiteral) == 0;
+		case Suffix:
+			return aFoldedText.size() >= iLiteral.size() && 
+				aFoldedText.compare(aFoldedText.size() - iLiteral.size(), iLiteral.size(), iLiteral) == 0;
+		default:
+		case Glob:
+			if (aFoldedText.size() < iMinimumLength ||
+				aFoldedText.compare(0, iHead.size(), iHead) != 0 ||
+				aFoldedText.compare(aFoldedText.size() - iTail.size(), iTail.size(), iTail) != 0)
+				return false;
+			return wildcard_match(aFoldedText.data(), aFoldedText.size(), iPattern.data(), iPattern.size());
+		}
+	}
+
+	bool mask::equivalent(casemapping::type aCasemapping, const std::string& aLeft, const std::string& aRight)
+	{
+		if (aLeft.size() != aRight.size())
+			return false;
+		for (std::string::size_type i = 0; i < aLeft.size(); ++i)
+			if (aLeft[i] != aRight[i] && 
+				casemapping::tolower<char>(aCasemapping, static_cast<unsigned char>(aLeft[i])) != casemapping::tolower<char>(aCasemapping, static_cast<unsigned char>(aRight[i])))
+				return false;
+		return true;
+	}
+
+	bool mask::wildcard_match(const char* aText, std::size_t aTextLength, const char* aPattern, std::size_t aPatternLength)
+	{
+		// single backtrack point: on a mismatch resume just after the most recent '*', consuming one more character of text
+		std::size_t text = 0, pattern = 0;
+		std::size_t starPattern = std::string::npos, starText = 0;
+		while (text < aTextLength)
+		{
+			if (pattern < aPatternLength && (aPattern[pattern] == '?' || aPattern[pattern] == aText[text]))
+			{
+				++text;
+				++pattern;
+			}
+			else if (pattern < aPatternLength && aPattern[pattern] == '*')
+			{
+				starPattern = pattern++;
+				starText = text;
+			}
+			else if (starPattern != std::string::npos)
+			{
+				pattern = starPattern + 1;
+				text = ++starText;
+			}
+			else
+				return false;
+		}
+		while (pattern < aPatternLength && aPattern[pattern] == '*')
+			++pattern;
+		return pattern == aPatternLength;
+	}
+}
@@ -48,17 +48,22 @@
 namespace irc
 {
 	message::message(connection_manager& aConnectionManager, direction_e aDirection, bool aFromLog) : 
-		iId(aConnectionManager.next_message_id()), iFromLog(aFromLog), iBufferRequired(true), iTime(::time(0)), iDirection(aDirection), iCommand(UNKNOWN) 
+		iId(aConnectionManager.next_message_id()), iFromLog(aFromLog), iBufferRequired(true), iBackground(false), iTime(::time(0)), iDirection(aDirection), iCommand(UNKNOWN) 
 	{
 	}
 
 	message::message(connection& aConnection, direction_e aDirection, bool aFromLog) : 
-		iId(aConnection.next_message_id()), iFromLog(aFromLog), iBufferRequired(true), iTime(::time(0)), iDirection(aDirection), iCommand(UNKNOWN) 
+		iId(aConnection.next_message_id()), iFromLog(aFromLog), iBufferRequired(true), iBackground(false), iTime(::time(0)), iDirection(aDirection), iCommand(UNKNOWN) 
 	{
 	}
 
 	message::message(buffer& aBuffer, direction_e aDirection, bool aFromLog) :
-		iId(aBuffer.next_message_id()), iFromLog(aFromLog), iBufferRequired(true), iTime(::time(0)), iDirection(aDirection), iCommand(UNKNOWN) 
+		iId(aBuffer.next_message_id()), iFromLog(aFromLog), iBufferRequired(true), iBackground(false), iTime(::time(0)), iDirection(aDirection), iCommand(UNKNOWN) 
+	{
+	}
+
+	message::message(direction_e aDirection) :
+		iId(0), iFromLog(false), iBufferRequired(true), iBackground(false), iTime(::time(0)), iDirection(aDirection), iCommand(UNKNOWN) 
 	{
 	}
 
@@ -86,6 +91,11 @@ namespace irc
 		{"LIST", message::LIST},
 		{"INVITE", message::INVITE},
 		{"AWAY", message::AWAY},
+		{"ISON", message::ISON},
+		{"MONITOR", message::MONITOR},
+		{"CAP", message::CAP},
+		{"BATCH", message::BATCH},
+		{"TAGMSG", message::TAGMSG},
 	};
 
 	const struct numeric_reply
@@ -261,9 +271,59 @@ namespace irc
 		{246, message::RPL_STATSPING},
 		{247, message::RPL_STATSBLINE},
 		{250, message::RPL_STATSDLINE},
-		{492, message::ERR_NOSERVICEHOST}
+		{492, message::ERR_NOSERVICEHOST},
+		{354, message::RPL_WHOSPCRPL},
+		{730, message::RPL_MONONLINE},
+		{731, message::RPL_MONOFFLINE},
+		{732, message::RPL_MONLIST},
+		{733, message::RPL_ENDOFMONLIST},
+		{734, message::ERR_MONLISTFULL},
+		{470, message::ERR_LINKCHANNEL}
 	};
 
+	namespace
+	{
+		// "YYYY-MM-DDThh:mm:ss[.sss]Z" (IRCv3 server-time) to a UTC time_t
+		bool parse_server_time(const std::string& aTime, time_t& aResult)
+		{
+			if (aTime.size() < 19 || aTime[4] != '-' || aTime[7] != '-' || aTime[10] != 'T' || aTime[13] != ':' || aTime[16] != ':')
+				return false;
+			long year = neolib::string_to_integer(aTime.substr(0, 4));
+			long month = neolib::string_to_integer(aTime.substr(5, 2));
+			long day = neolib::string_to_integer(aTime.substr(8, 2));
+			if (month < 1 || month > 12 || day < 1 || day > 31)
+				return false;
+			// days since the epoch of a proleptic Gregorian date
+			year -= (month <= 2 ? 1 : 0);
+			long era = (year >= 0 ? year : year - 399) / 400;
+			long yearOfEra = year - era * 400;
+			long dayOfYear = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+			long dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+			long days = era * 146097 + dayOfEra - 719468;
+			aResult = static_cast<time_t>(days) * 86400 + 
+				neolib::string_to_integer(aTime.substr(11, 2)) * 3600 + 
+				neolib::string_to_integer(aTime.substr(14, 2)) * 60 + 
+				neolib::string_to_integer(aTime.substr(17, 2));
+			return true;
+		}
+	}
+
+	void message::parse_tags(const std::string& aTags)
+	{
+		// only server-time is of use so tags are not kept
+		std::vector<std::string> tags;
+		neolib::tokens(aTags, std::string(";"), tags);
+		for (std::vector<std::string>::const_iterator i = tags.begin(); i != tags.end(); ++i)
+		{
+			if (i->compare(0, 5, "time=") == 0)
+			{
+				time_t serverTime;
+				if (parse_server_time(i->substr(5), serverTime))
+					iTime = serverTime;
+			}
+		}
+	}
+
 	void message::parse_command(const std::string& aMessage)
 	{
 		iTarget = "";
@@ -351,6 +411,21 @@ namespace irc
 		return true;
 	}
 
+	void message::parse_incoming(const std::string& aLine)
+	{
+		std::string line = aLine;
+		if (!line.empty() && line[0] == '@')
+		{
+			// IRCv3 message tags: @tag[=value][;tag...] <message>
+			std::string::size_type tagsEnd = line.find(' ');
+			parse_tags(line.substr(1, tagsEnd == std::string::npos ? std::string::npos : tagsEnd - 1));
+			std::string::size_type messageStart = (tagsEnd == std::string::npos ? std::string::npos : line.find_first_not_of(' ', tagsEnd));
+			line = (messageStart == std::string::npos ? std::string() : line.substr(messageStart));
+		}
+		parse_command(line);
+		parse_parameters(line, false, true);
+	}
+
 	std::size_t message::content_param() const
 	{
 		switch(iCommand)
@@ -426,16 +501,6 @@ namespace irc
 		return ret;
 	}
 
-	namespace
-	{
-		std::string timestamp_bit(const char* aParameter, const tm* aTime)
-		{
-			std::tr1::array<char, 256> tempBit;
-			strftime(&tempBit[0], tempBit.size(), aParameter, aTime);
-			return std::string(&tempBit[0]);
-		}
-	}
-
 	std::string message::to_nice_string(const message_strings& aMessageStrings, const buffer* aBuffer, const std::string& aAppendToContent, bool aIsSelf, bool aAddTimeStamp, bool aAppendCRLF, neolib::string_spans* aStringSpans) const
 	{
 		std::string ret;
@@ -687,11 +752,7 @@ namespace irc
 						else
 						{
 							time_t ttTime = neolib::string_to_integer(iParameters[2]);
-							tm* tmTime = localtime(&ttTime);
-							std::tr1::array<char, 256> strTime;
-							setlocale(LC_TIME, "");
-							strftime(&strTime[0], strTime.size(), "%a %b %#d %H:%M:%S %Y", tmTime);
-							theCodes["%D%"].first = std::string(&strTime[0]);
+							theCodes["%D%"].first = timestamp_formatter::instance().format(ttTime, "%a %b %#d %H:%M:%S %Y");
 						}
 						break;
 					}
@@ -796,11 +857,7 @@ namespace irc
 							theCodes["%N%"].first = iParameters[0];
 							theCodes["%I%"].first = idleTime;
 							time_t ttTime = neolib::string_to_integer(iParameters[2]);
-							tm* tmTime = localtime(&ttTime);
-							std::tr1::array<char, 256> strTime;
-							setlocale(LC_TIME, "");
-							strftime(&strTime[0], strTime.size(), "%a %b %#d %H:%M:%S %Y", tmTime);
-							theCodes["%S%"].first = std::string(&strTime[0]);
+							theCodes["%S%"].first = timestamp_formatter::instance().format(ttTime, "%a %b %#d %H:%M:%S %Y");
 						}
 						else
 						{
@@ -945,18 +1002,23 @@ namespace irc
 
 	message::command_e message::string_to_command(const std::string& aCommand)
 	{
+		// built on first use and only read afterwards; network threads parse too
 		typedef std::map<neolib::ci_string, message::command_e> string_commands;
-		static string_commands sStringCommands;
-		typedef std::map<unsigned int, message::command_e> numeric_replies;
-		static numeric_replies sNumericReplies;
-
-		if (sStringCommands.empty())
+		static const string_commands sStringCommands = []()
 		{
+			string_commands ret;
 			for (int i = 0; i < sizeof(sStringCommandList) / sizeof(sStringCommandList[0]); ++i)
-				sStringCommands[sStringCommandList[i].iString] = sStringCommandList[i].iCommand;
+				ret[sStringCommandList[i].iString] = sStringCommandList[i].iCommand;
+			return ret;
+		}();
+		typedef std::map<unsigned int, message::command_e> numeric_replies;
+		static const numeric_replies sNumericReplies = []()
+		{
+			numeric_replies ret;
 			for (int i = 0; i < sizeof(sNumericReplyList) / sizeof(sNumericReplyList[0]); ++i)
-				sNumericReplies[sNumericReplyList[i].iNumber] = sNumericReplyList[i].iCommand;
-		}
+				ret[sNumericReplyList[i].iNumber] = sNumericReplyList[i].iCommand;
+			return ret;
+		}();
 
 		long n = neolib::string_to_integer(aCommand);
 
@@ -975,18 +1037,19 @@ namespace irc
 	const std::string& message::command_to_string(command_e aCommand)
 	{
 		typedef std::map<command_e, std::string> command_strings;
-		static command_strings sCommandStrings;
-
-		if (sCommandStrings.empty())
+		static const command_strings sCommandStrings = []()
 		{
+			command_strings ret;
 			for (int i = 0; i < sizeof(sStringCommandList) / sizeof(sStringCommandList[0]); ++i)
-				sCommandStrings[sStringCommandList[i].iCommand] = sStringCommandList[i].iString;
+				ret[sStringCommandList[i].iCommand] = sStringCommandList[i].iString;
 			for (int i = 0; i < sizeof(sNumericReplyList) / sizeof(sNumericReplyList[0]); ++i)
-				sCommandStrings[sNumericReplyList[i].iCommand] = neolib::integer_to_string<char>(sNumericReplyList[i].iNumber, 10, 3);
-		}
+				ret[sNumericReplyList[i].iCommand] = neolib::integer_to_string<char>(sNumericReplyList[i].iNumber, 10, 3);
+			return ret;
+		}();
 
 		static const std::string unknownCommand;
-		return aCommand != UNKNOWN && aCommand != RPL_UNKNOWN ? sCommandStrings[aCommand] : unknownCommand;
+		command_strings::const_iterator it = sCommandStrings.find(aCommand);
+		return aCommand != UNKNOWN && aCommand != RPL_UNKNOWN && it != sCommandStrings.end() ? it->second : unknownCommand;
 	}
 
 	void message::set_command(command_e aCommand)
@@ -0,0 +1,178 @@
+// mode_aggregator.cpp
+/*
+ *  Copyright (c) 2010 Leigh Johnston.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ *     * Neither the name of Leigh Johnston nor the names of any
+ *       other contributors to this software may be used to endorse or
+ *       promote products derived from this software without specific prior
+ *       written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ *  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <neolib/neolib.hpp>
+#include <neoirc/client/mode_aggregator.hpp>
+#include <neoirc/client/connection.hpp>
+#include <neoirc/client/mask.hpp>
+
+namespace irc
+{
+	mode_aggregator::mode_aggregator(connection& aConnection, neolib::io_task& aIoTask) :
+		neolib::timer(aIoTask, Window_ms, false), iConnection(aConnection), iSending(false)
+	{
+	}
+
+	bool mode_aggregator::add(const message& aMessage)
+	{
+		if (iSending || aMessage.command() != message::MODE || aMessage.parameters().size() != 3)
+			return false;
+		const std::string& theChannel = aMessage.parameters()[0];
+		const std::string& theMode = aMessage.parameters()[1];
+		if (!iConnection.is_channel(theChannel) || theMode.size() != 2 || (theMode[0] != '+' && theMode[0] != '-') ||
+			iConnection.prefixes().first.find(theMode[1]) == std::string::npos || aMessage.parameters()[2].empty())
+			return false;
+		change newChange;
+		newChange.iAdd = (theMode[0] == '+');
+		newChange.iMode = theMode[1];
+		newChange.iNickName = aMessage.parameters()[2];
+		pending& thePending = iPending[fold_case(iConnection.casemapping(), theChannel)];
+		thePending.iChannel = theChannel;
+		for (std::vector<change>::iterator i = thePending.iChanges.begin(); i != thePending.iChanges.end(); ++i)
+			if (i->iMode == newChange.iMode && mask::equivalent(iConnection.casemapping(), i->iNickName, newChange.iNickName))
+			{
+				thePending.iChanges.erase(i);
+				break;
+			}
+		if (!redundant(theChannel, newChange))
+		{
+			thePending.iChanges.push_back(newChange);
+			if (!aMessage.background())
+				thePending.iBackground = false;
+		}
+		if (thePending.iChanges.empty())
+			iPending.erase(fold_case(iConnection.casemapping(), theChannel));
+		else if (thePending.iChanges.size() >= iConnection.max_modes())
+			flush(theChannel);
+		else if (!waiting())
+			reset();
+		return true;
+	}
+
+	void mode_aggregator::flush()
+	{
+		cancel();
+		while (!iPending.empty())
+			send(iPending.begin());
+	}
+
+	void mode_aggregator::flush(const std::string& aChannel)
+	{
+		if (iPending.empty())
+			return;
+		pending_list::iterator thePending = iPending.find(fold_case(iConnection.casemapping(), aChannel));
+		if (thePending != iPending.end())
+			send(thePending);
+		if (iPending.empty())
+			cancel();
+	}
+
+	void mode_aggregator::discard(const std::string& aChannel)
+	{
+		iPending.erase(fold_case(iConnection.casemapping(), aChannel));
+		if (iPending.empty())
+			cancel();
+	}
+
+	void mode_aggregator::clear()
+	{
+		cancel();
+		iPending.clear();
+	}
+
+	bool mode_aggregator::redundant(const std::string& aChannel, const change& aChange) const
+	{
+		if (!iConnection.buffer_exists(aChannel))
+			return false;
+		const buffer& theBuffer = iConnection.buffer_from_name(aChannel);
+		if (theBuffer.type() != buffer::CHANNEL)
+			return false;
+		const channel_buffer& theChannel = static_cast<const channel_buffer&>(theBuffer);
+		channel_buffer::list::const_iterator theUser = theChannel.find_user(aChange.iNickName);
+		if (theUser == theChannel.users().end())
+			return false;
+		bool hasMode = theUser->modes().find(aChange.iMode) != std::string::npos;
+		return hasMode == aChange.iAdd;
+	}
+
+	void mode_aggregator::send(pending_list::iterator aPending)
+	{
+		pending thePending = aPending->second;
+		iPending.erase(aPending);
+		// sent through the channel's buffer; once that has gone (parted, kicked, quitting) the changes 
+		// no longer apply
+		if (!iConnection.buffer_exists(thePending.iChannel))
+			return;
+		buffer& theBuffer = iConnection.buffer_from_name(thePending.iChannel, false);
+		std::size_t maxModes = iConnection.max_modes();
+		std::size_t fixedLength = std::string("MODE  \r\n").size() + thePending.iChannel.size();
+		std::vector<change>::const_iterator next = thePending.iChanges.begin();
+		while (next != thePending.iChanges.end())
+		{
+			std::string modes;
+			std::vector<std::string> nickNames;
+			std::size_t length = fixedLength;
+			bool adding = !next->iAdd;
+			for (; next != thePending.iChanges.end() && nickNames.size() < maxModes; ++next)
+			{
+				std::size_t extra = 1 + next->iNickName.size() + 1 + (next->iAdd != adding ? 1 : 0);
+				if (!nickNames.empty() && length + extra > message::MaxMessageSize)
+					break;
+				if (modes.empty() || next->iAdd != adding)
+				{
+					adding = next->iAdd;
+					modes += (adding ? '+' : '-');
+				}
+				modes += next->iMode;
+				nickNames.push_back(next->iNickName);
+				length += extra;
+			}
+			message modeMessage(iConnection, message::OUTGOING);
+			modeMessage.set_command(message::MODE);
+			modeMessage.set_background(thePending.iBackground);
+			modeMessage.parameters().push_back(thePending.iChannel);
+			modeMessage.parameters().push_back(modes);
+			modeMessage.parameters().insert(modeMessage.parameters().end(), nickNames.begin(), nickNames.end());
+			iSending = true;
+			iConnection.send_message(theBuffer, modeMessage, true); // the lines it merges have already been filtered
+			iSending = false;
+		}
+	}
+
+	void mode_aggregator::ready()
+	{
+		flush();
+	}
+}
@@ -34,11 +34,16 @@
 */
 
 #include <neolib/neolib.hpp>
+#include <algorithm>
 
 #include <boost/chrono.hpp>
 
 #include <neoirc/client/Model.hpp>
 
+#include <neoirc/client/background_executor.hpp>
+#include <neoirc/client/config_writer.hpp>
+#include <neoirc/client/startup_loader.hpp>
+
 #include <neoirc/client/connection_manager.hpp>
 #include <neoirc/client/dcc_connection_manager.hpp>
 #include <neoirc/client/logger.hpp>
@@ -57,6 +62,7 @@
 #include <neoirc/client/notify_watcher.hpp>
 #include <neoirc/client/auto_mode.hpp>
 #include <neoirc/client/auto_mode_watcher.hpp>
+#include <neoirc/client/presence_watcher.hpp>
 #include <neoirc/client/macros.hpp>
 #include <neoirc/client/gui_data.hpp>
 
@@ -140,11 +146,18 @@ namespace irc
 		void macro_updated(const macro& aEntry) override;
 		void macro_removed(const macro& aEntry) override;
 		void macro_syntax_error(const macro& aEntry, std::size_t aLineNumber, macro::error aError) override;
+		// config persistence
+		enum config_file_e { IdentitiesFile, AutoJoinsFile, ConnectionScriptsFile, IgnoreListFile, NotifyListFile, AutoModeListFile, ContactsFile, MacrosFile };
+		void config_changed(config_file_e aFile);
+		void write_config(config_file_e aFile);
 
 	private:
 		// attributes
 		model& iModel;
 		neolib::random iRandom;
+		background_executor iBackgroundExecutor;
+		config_writer iConfigWriter;
+		irc::startup_loader iStartupLoader;
 		identities iIdentities;
 		identity iDefaultIdentity;
 		server_list iServerList;
@@ -163,12 +176,16 @@ namespace irc
 		auto_join_watcher iAutoJoinWatcher;
 		notify_watcher iNotifyWatcher;
 		auto_mode_watcher iAutoModeWatcher;
+		presence_watcher iPresenceWatcher;
 		macros iMacros;
 	};
 
 	model_impl::model_impl(model& aModel) :
 		iModel(aModel),
 		iRandom(static_cast<uint32_t>(aModel.owner_thread().elapsed_ms())),
+		iBackgroundExecutor(aModel.io_task(), std::max<std::size_t>(2, std::min<std::size_t>(4, std::thread::hardware_concurrency()))),
+		iConfigWriter(aModel.io_task(), iBackgroundExecutor),
+		iStartupLoader(iModel),
 		iServerListUpdater(iModel),
 		iIdentd(iModel),
 		iConnectionScripts(iIdentities),
@@ -181,7 +198,8 @@ namespace irc
 		iConnectionScriptWatcher(iRandom, iConnectionManager, iIdentities.identity_list(), iServerList), 
 		iAutoJoinWatcher(iRandom, iConnectionManager, iIdentities.identity_list(), iServerList), 
 		iNotifyWatcher(iConnectionManager), 
-		iAutoModeWatcher(iConnectionManager)
+		iAutoModeWatcher(iConnectionManager), 
+		iPresenceWatcher(iConnectionManager, iContacts)
 	{
 		iIdentities.add_observer(*this);
 		iConnectionManager.add_observer(*this);
@@ -213,17 +231,17 @@ namespace irc
 
 	void model_impl::identity_added(const identity& aEntry)
 	{
-		write_identity_list(iModel, iDefaultIdentity.nick_name());	
+		config_changed(IdentitiesFile);
 	}
 
 	void model_impl::identity_updated(const identity& aEntry, const identity& aOldEntry)
 	{
-		write_identity_list(iModel, iDefaultIdentity.nick_name());	
+		config_changed(IdentitiesFile);
 	}
 
 	void model_impl::identity_removed(const identity& aEntry)
 	{
-		write_identity_list(iModel, iDefaultIdentity.nick_name());	
+		config_changed(IdentitiesFile);
 	}
 
 	void model_impl::connection_added(connection& aConnection)
@@ -338,117 +356,154 @@ namespace irc
 
 	void model_impl::auto_join_added(const auto_join& aEntry)
 	{
-		write_auto_joins(iModel);
+		config_changed(AutoJoinsFile);
 	}
 
 	void model_impl::auto_join_updated(const auto_join& aEntry)
 	{
-		write_auto_joins(iModel);
+		config_changed(AutoJoinsFile);
 	}
 
 	void model_impl::auto_join_removed(const auto_join& aEntry)
 	{
-		write_auto_joins(iModel);
+		config_changed(AutoJoinsFile);
 	}
 
 	void model_impl::auto_join_cleared()
 	{
-		write_auto_joins(iModel);
+		config_changed(AutoJoinsFile);
 	}
 
 	void model_impl::auto_join_reset()
 	{
-		write_auto_joins(iModel);
+		config_changed(AutoJoinsFile);
 	}
 
 	void model_impl::connection_script_added(const connection_script& aEntry)
 	{
-		write_connection_scripts(iModel);
+		config_changed(ConnectionScriptsFile);
 	}
 
 	void model_impl::connection_script_updated(const connection_script& aEntry)
 	{
-		write_connection_scripts(iModel);
+		config_changed(ConnectionScriptsFile);
 	}
 
 	void model_impl::connection_script_removed(const connection_script& aEntry)
 	{
-		write_connection_scripts(iModel);
+		config_changed(ConnectionScriptsFile);
 	}
 
 	void model_impl::ignore_added(const ignore_entry& aEntry)
 	{
-		write_ignore_list(iModel);
+		config_changed(IgnoreListFile);
 	}
 
 	void model_impl::ignore_updated(const ignore_entry& aEntry)
 	{
-		write_ignore_list(iModel);
+		config_changed(IgnoreListFile);
 	}
 
 	void model_impl::ignore_removed(const ignore_entry& aEntry)
 	{
-		write_ignore_list(iModel);
+		config_changed(IgnoreListFile);
 	}
 
 	void model_impl::notify_added(const notify_entry& aEntry)
 	{
-		write_notify_list(iModel);
+		config_changed(NotifyListFile);
 	}
 
 	void model_impl::notify_updated(const notify_entry& aEntry)
 	{
-		write_notify_list(iModel);
+		config_changed(NotifyListFile);
 	}
 
 	void model_impl::notify_removed(const notify_entry& aEntry)
 	{
-		write_notify_list(iModel);
+		config_changed(NotifyListFile);
 	}
 
 	void model_impl::auto_mode_added(const auto_mode_entry& aEntry)
 	{
-		write_auto_mode_list(iModel);
+		config_changed(AutoModeListFile);
 	}
 
 	void model_impl::auto_mode_updated(const auto_mode_entry& aEntry)
 	{
-		write_auto_mode_list(iModel);
+		config_changed(AutoModeListFile);
 	}
 
 	void model_impl::auto_mode_removed(const auto_mode_entry& aEntry)
 	{
-		write_auto_mode_list(iModel);
+		config_changed(AutoModeListFile);
 	}
 
 	void model_impl::contact_added(const contact& aEntry)
 	{
-		write_contacts_list(iModel);
+		config_changed(ContactsFile);
 	}
 
 	void model_impl::contact_updated(const contact& aEntry, const contact& aOldEntry)
 	{
-		write_contacts_list(iModel);
+		config_changed(ContactsFile);
 	}
 
 	void model_impl::contact_removed(const contact& aEntry)
 	{
-		write_contacts_list(iModel);
+		config_changed(ContactsFile);
 	}
 
 	void model_impl::macro_added(const macro& aEntry)
 	{
-		write_macros(iModel);
+		config_changed(MacrosFile);
 	}
 
 	void model_impl::macro_updated(const macro& aEntry)
 	{
-		write_macros(iModel);
+		config_changed(MacrosFile);
 	}
 
 	void model_impl::macro_removed(const macro& aEntry)
 	{
-		write_macros(iModel);
+		config_changed(MacrosFile);
+	}
+
+	void model_impl::config_changed(config_file_e aFile)
+	{
+		static const char* const sStores[] = { "identities", "auto_joins", "connection_scripts", "ignore_list", "notify_list", "auto_mode_list", "contacts", "macros" };
+		iConfigWriter.mark_dirty(sStores[aFile], [this, aFile]() { write_config(aFile); });
+	}
+
+	void model_impl::write_config(config_file_e aFile)
+	{
+		switch(aFile)
+		{
+		case IdentitiesFile:
+			write_identity_list(iModel, iDefaultIdentity.nick_name());
+			break;
+		case AutoJoinsFile:
+			write_auto_joins(iModel);
+			break;
+		case ConnectionScriptsFile:
+			write_connection_scripts(iModel);
+			break;
+		case IgnoreListFile:
+			write_ignore_list(iModel);
+			break;
+		case NotifyListFile:
+			write_notify_list(iModel);
+			break;
+		case AutoModeListFile:
+			write_auto_mode_list(iModel);
+			break;
+		case ContactsFile:
+			write_contacts_list(iModel);
+			break;
+		case MacrosFile:
+			write_macros(iModel);
+			break;
+		}
 	}
 
 	void model_impl::macro_syntax_error(const macro& aEntry, std::size_t aLineNumber, macro::error aError)
@@ -471,6 +526,7 @@ namespace irc
 
 	model::~model()
 	{
+		flush_config();
 	}
 
 	neolib::random& model::random()
@@ -478,6 +534,41 @@ namespace irc
 		return iModelImpl->iRandom;
 	}
 
+	background_executor& model::background_executor() const
+	{
+		return iModelImpl->iBackgroundExecutor;
+	}
+
+	void model::save_config(const std::string& aFileName, const std::string& aContents) const
+	{
+		iModelImpl->iConfigWriter.save(aFileName, aContents);
+	}
+
+	uint32_t model::config_save_window() const
+	{
+		return iModelImpl->iConfigWriter.window();
+	}
+
+	void model::set_config_save_window(uint32_t aWindow_ms)
+	{
+		iModelImpl->iConfigWriter.set_window(aWindow_ms);
+	}
+
+	void model::flush_config()
+	{
+		iModelImpl->iConfigWriter.flush();
+	}
+
+	startup_loader& model::startup_loader()
+	{
+		return iModelImpl->iStartupLoader;
+	}
+
+	const startup_loader& model::startup_loader() const
+	{
+		return iModelImpl->iStartupLoader;
+	}
+
 	identities& model::identities()
 	{
 		return iModelImpl->iIdentities;
@@ -593,6 +684,11 @@ namespace irc
 		return iModelImpl->iNotifyWatcher;
 	}
 
+	presence_watcher& model::presence_watcher()
+	{
+		return iModelImpl->iPresenceWatcher;
+	}
+
 	auto_mode& model::auto_mode_list()
 	{
 		return iModelImpl->iAutoModeList;
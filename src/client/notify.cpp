@@ -35,7 +35,9 @@
 
 #include <neolib/neolib.hpp>
 #include <neolib/xml.hpp>
+#include <algorithm>
 #include <fstream>
+#include <sstream>
 #include <neoirc/client/model.hpp>
 #include <neoirc/client/notify.hpp>
 
@@ -123,29 +125,118 @@ namespace irc
 
 	bool notify::notified(const connection& aConnection, const server_key& aServer, const user& aUser, const std::string& aChannel, message::command_e aCommand) const
 	{
-		std::vector<container_type::const_iterator> result;
-		find_impl<const notify, container_type::const_iterator>(aConnection, *this, aServer, aUser, aChannel, result);
-		if (result.empty())
-			return false;
-		for (std::vector<container_type::const_iterator>::const_iterator i = result.begin(); i != result.end(); ++i)
+		entry_list result;
+		return matching(aConnection, aServer, aUser, aChannel, aCommand, result) != 0;
+	}
+
+	std::size_t notify::matching(const connection& aConnection, const server_key& aServer, const user& aUser, const std::string& aChannel, message::command_e aCommand, entry_list& aEntries) const
+	{
+		uint32_t theEvents = events(aCommand);
+		const index& theIndex = compiled(aConnection.casemapping());
+		if ((theIndex.iEvents & theEvents) == 0)
+			return 0;
+		std::string nickName = fold_case(aConnection.casemapping(), aUser.nick_name());
+		std::string userName = fold_case(aConnection.casemapping(), aUser.user_name());
+		std::string hostName = fold_case(aConnection.casemapping(), aUser.host_name());
+		std::string channel = fold_case(aConnection.casemapping(), aChannel);
+		entry_indices found;
+		const entry_indices* candidates[4] = {};
+		entry_buckets::const_iterator bucket = theIndex.iByNickName.find(bucket_key(aServer.first, nickName));
+		if (bucket != theIndex.iByNickName.end())
+			candidates[0] = &bucket->second;
+		if (aServer.first != "*" && (bucket = theIndex.iByNickName.find(bucket_key("*", nickName))) != theIndex.iByNickName.end())
+			candidates[1] = &bucket->second;
+		if ((bucket = theIndex.iByHostName.find(hostName)) != theIndex.iByHostName.end())
+			candidates[2] = &bucket->second;
+		candidates[3] = &theIndex.iWildcards;
+		for (std::size_t c = 0; c < sizeof(candidates) / sizeof(candidates[0]); ++c)
+			if (candidates[c] != 0)
+				for (entry_indices::const_iterator i = candidates[c]->begin(); i != candidates[c]->end(); ++i)
+				{
+					const compiled_entry& theEntry = theIndex.iEntries[*i];
+					if ((theEntry.iEntry->event() & theEvents) != 0 && matches(aConnection, theEntry, aServer, nickName, userName, hostName, aChannel, channel))
+						found.push_back(*i);
+				}
+		std::sort(found.begin(), found.end());
+		found.erase(std::unique(found.begin(), found.end()), found.end());
+		for (entry_indices::const_iterator i = found.begin(); i != found.end(); ++i)
+			aEntries.push_back(theIndex.iEntries[*i].iEntry);
+		return found.size();
+	}
+
+	uint32_t notify::events(message::command_e aCommand)
+	{
+		switch(aCommand)
+		{
+		case message::PRIVMSG:
+		case message::NOTICE:
+			return notify_entry::Message;
+		case message::JOIN:
+			return notify_entry::Join;
+		case message::PART:
+		case message::QUIT:
+			return notify_entry::PartQuit;
+		default:
+			return 0;
+		}
+	}
+
+	const notify::index& notify::compiled(casemapping::type aCasemapping) const
+	{
+		index& theIndex = iIndex[aCasemapping];
+		if (theIndex.iGeneration == iGeneration)
+			return theIndex;
+		theIndex = index();
+		theIndex.iGeneration = iGeneration;
+		theIndex.iEntries.reserve(iEntries.size());
+		for (container_type::const_iterator i = iEntries.begin(); i != iEntries.end(); ++i)
 		{
-			const notify_entry& entry = ***i;
-			switch(aCommand)
+			compiled_entry theEntry;
+			theEntry.iEntry = *i;
+			theEntry.iNickName = mask(aCasemapping, (*i)->user().nick_name());
+			theEntry.iUserName = mask(aCasemapping, (*i)->user().user_name());
+			theEntry.iHostName = mask(aCasemapping, (*i)->user().host_name());
+			theEntry.iChannel = fold_case(aCasemapping, (*i)->channel());
+			std::size_t entryIndex = theIndex.iEntries.size();
+			theIndex.iEntries.push_back(theEntry);
+			theIndex.iEvents |= (*i)->event();
+			bool byUserAndHost = !theEntry.iUserName.any() || !theEntry.iHostName.any();
+			if (theEntry.iNickName.kind() == mask::Literal)
 			{
-			case message::PRIVMSG:
-			case message::NOTICE:
-				if (entry.event() & notify_entry::Message)
-					return true;
-			case message::JOIN:
-				if (entry.event() & notify_entry::Join)
-					return true;
-			case message::PART:
-			case message::QUIT:
-				if (entry.event() & notify_entry::PartQuit)
-					return true;
+				theIndex.iByNickName[bucket_key((*i)->server().first, theEntry.iNickName.literal())].push_back(entryIndex);
+				if (!byUserAndHost)
+					continue;
 			}
+			else if (!theEntry.iNickName.any())
+			{
+				theIndex.iWildcards.push_back(entryIndex);
+				continue;
+			}
+			if (byUserAndHost && theEntry.iHostName.kind() == mask::Literal)
+				theIndex.iByHostName[theEntry.iHostName.literal()].push_back(entryIndex);
+			else
+				theIndex.iWildcards.push_back(entryIndex);
 		}
-		return false;
+		return theIndex;
+	}
+
+	bool notify::matches(const connection& aConnection, const compiled_entry& aEntry, const server_key& aServer, const std::string& aNickName, const std::string& aUserName, const std::string& aHostName, const std::string& aChannel, const std::string& aFoldedChannel)
+	{
+		const notify_entry& theEntry = *aEntry.iEntry;
+		if ((theEntry.server().first != aServer.first && theEntry.server().first != "*") ||
+			(theEntry.server().second != aServer.second && theEntry.server().second != "*"))
+			return false;
+		if (aEntry.iChannel != aFoldedChannel && theEntry.channel() != "*" && aChannel != "*"
+			&& (theEntry.channel() != "~" || aConnection.is_channel(aChannel)))
+			return false;
+		bool anyNickName = aEntry.iNickName.any();
+		bool anyUserName = aEntry.iUserName.any();
+		bool anyHostName = aEntry.iHostName.any();
+		if (!anyNickName && aEntry.iNickName.matches(aNickName))
+			return true;
+		if ((!anyUserName || !anyHostName) && aEntry.iUserName.matches(aUserName) && aEntry.iHostName.matches(aHostName))
+			return true;
+		return anyNickName && anyUserName && anyHostName;
 	}
 
 	bool notify::add(const notify_entry& aEntry)
@@ -154,6 +245,7 @@ namespace irc
 			if (**i == aEntry)
 				return false;
 		iEntries.push_back(notify_entry_ptr(new notify_entry(aEntry)));
+		++iGeneration;
 		if (!iLoading)
 			notify_observers(notify_list_observer::NotifyAdded, *iEntries.back());
 		return true;
@@ -162,6 +254,7 @@ namespace irc
 	void notify::update(notify_entry& aExistingEntry, const notify_entry& aNewEntry)
 	{
 		aExistingEntry = aNewEntry;
+		++iGeneration;
 		if (!iLoading)
 			notify_observers(notify_list_observer::NotifyUpdated, aExistingEntry);
 	}
@@ -192,6 +285,7 @@ namespace irc
 			{
 				notify_entry_ptr temp = *i;
 				iEntries.erase(i);
+				++iGeneration;
 				notify_observers(notify_list_observer::NotifyRemoved, *temp);
 				break;
 			}
@@ -215,22 +309,27 @@ namespace irc
 
 	void read_notify_list(model& aModel, std::function<bool()> aErrorFunction)
 	{
-		notify& theNotifyList = aModel.notify_list();
-
 		neolib::xml xmlNotifyList(true);
 		std::ifstream input((aModel.root_path() + "notify_list.xml").c_str());
 		xmlNotifyList.read(input);
+		read_notify_list(aModel, xmlNotifyList, aErrorFunction);
+	}
+
+	void read_notify_list(model& aModel, const neolib::xml& aXml, std::function<bool()> aErrorFunction)
+	{
+		notify& theNotifyList = aModel.notify_list();
 
-		if (xmlNotifyList.error() && aErrorFunction && aErrorFunction())
+		if (aXml.error() && aErrorFunction && aErrorFunction())
 		{
 			theNotifyList.entries().clear();
+			theNotifyList.invalidate();
 			write_notify_list(aModel);
 			return;
 		}
 
 		theNotifyList.loading(true);
 
-		for (neolib::xml::element::const_iterator i = xmlNotifyList.root().begin(); i != xmlNotifyList.root().end(); ++i)
+		for (neolib::xml::element::const_iterator i = aXml.root().begin(); i != aXml.root().end(); ++i)
 		{
 			if (i->name() == "entry")
 			{
@@ -259,6 +358,7 @@ namespace irc
 				theNotifyList.entries().push_back(e);
 			}
 		}
+		theNotifyList.invalidate();
 
 		theNotifyList.loading(false);
 	}
@@ -284,7 +384,8 @@ namespace irc
 			xmlNotifyList.append(xmlEntry, "data").set_attribute("value", entry.data());
 		}
 
-		std::ofstream output((aModel.root_path() + "notify_list.xml").c_str());
+		std::ostringstream output;
 		xmlNotifyList.write(output);
+		aModel.save_config(aModel.root_path() + "notify_list.xml", output.str());
 	}
 }
\ No newline at end of file
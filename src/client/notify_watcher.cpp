@@ -71,13 +71,16 @@ namespace irc
 
 	bool notify_watcher::action_pending(connection& aConnection, const user& aUser, const std::string& aChannel, message::command_e aCommand) const
 	{
+		if (iActions.empty())
+			return false;
 		const server_key& theServer = aConnection.server().key();
 		for (action_list::const_iterator i = iActions.begin(); i != iActions.end(); ++i)
 		{
 			const notify_action& action = **i;
-			if (server_match(action.entry().server(), theServer) && 
-				(irc::make_string(aConnection, action.nick_name()) == aUser.nick_name()) &&
-				(irc::make_string(aConnection, action.entry().channel()) == aChannel || action.entry().channel() == "*") && action.command() == aCommand)
+			if (action.command() == aCommand && 
+				server_match(action.entry().server(), theServer) && 
+				mask::equivalent(aConnection.casemapping(), action.nick_name(), aUser.nick_name()) &&
+				(action.entry().channel() == "*" || mask::equivalent(aConnection.casemapping(), action.entry().channel(), aChannel)))
 				return true;
 		}
 		return false;
@@ -108,11 +111,11 @@ namespace irc
 		case message::PRIVMSG:
 			if (!aMessage.parameters().empty())
 				target = aMessage.parameters()[0];
-			if (iConnectionManager.ignore_list().ignored(aBuffer, theConnection.server(), theUser))
+			if (iConnectionManager.ignore_list().ignored(theConnection, theConnection.server(), theUser))
 				return;
 			break;
 		case message::NOTICE:
-			if (iConnectionManager.ignore_list().ignored(aBuffer, theConnection.server(), theUser))
+			if (iConnectionManager.ignore_list().ignored(theConnection, theConnection.server(), theUser))
 				return;
 			break;
 		case message::JOIN:
@@ -138,34 +141,10 @@ namespace irc
 		if (action_pending(theConnection, theUser, target, aMessage.command()))
 			return;
 
-		if (iNotifyList.notified(theConnection, theConnection.server().key(), theUser, target, aMessage.command()))
-		{
-			for (notify::container_type::iterator i = iNotifyList.entries().begin(); i != iNotifyList.entries().end(); ++i)
-				if (iNotifyList.matches(theConnection, **i, theConnection.server().key(), theUser, target))
-				{
-					notify_entry& entry = **i;
-					bool gotMatch = false;
-					switch(aMessage.command())
-					{
-					case message::PRIVMSG:
-					case message::NOTICE:
-						if (entry.event() & notify_entry::Message)
-							gotMatch = true;
-						break;
-					case message::JOIN:
-						if (entry.event() & notify_entry::Join)
-							gotMatch = true;
-						break;
-					case message::PART:
-					case message::QUIT:
-						if (entry.event() & notify_entry::PartQuit)
-							gotMatch = true;
-						break;
-					}
-					if (gotMatch)
-						notify_observers(notify_watcher_observer::NotifyAction, std::make_pair(&aBuffer, &entry), std::make_pair(theUser.nick_name(), &aMessage));
-				}
-		}
+		notify::entry_list matchingEntries;
+		iNotifyList.matching(theConnection, theConnection.server().key(), theUser, target, aMessage.command(), matchingEntries);
+		for (notify::entry_list::const_iterator i = matchingEntries.begin(); i != matchingEntries.end(); ++i)
+			notify_observers(notify_watcher_observer::NotifyAction, std::make_pair(&aBuffer, i->get()), std::make_pair(theUser.nick_name(), &aMessage));
 	}
 
 	void notify_watcher::notify_observer(notify_watcher_observer& aObserver, notify_watcher_observer::notify_type aType, const void* aParameter, const void* aParameter2)
@@ -0,0 +1,385 @@
+// presence_watcher.cpp
+/*
+ *  Copyright (c) 2010 Leigh Johnston.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ *     * Neither the name of Leigh Johnston nor the names of any
+ *       other contributors to this software may be used to endorse or
+ *       promote products derived from this software without specific prior
+ *       written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ *  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <neolib/neolib.hpp>
+#include <algorithm>
+#include <neolib/string_utils.hpp>
+#include <neoirc/client/model.hpp>
+#include <neoirc/client/mask.hpp>
+#include <neoirc/client/presence_watcher.hpp>
+
+namespace irc
+{
+	presence_watcher::tracker::tracker(presence_watcher& aParent, connection& aConnection) : 
+		neolib::timer(aConnection.connection_manager().model().io_task(), IsonPollInterval), 
+		iParent(aParent), iConnection(aConnection)
+	{
+		reset();
+	}
+
+	void presence_watcher::tracker::reset()
+	{
+		iStarted = false;
+		iMonitor = false;
+		iMonitorLimit = 0;
+		iSending = false;
+		iWatched.clear();
+		iMonitored.clear();
+		iOnline.clear();
+		iIsonBatches.clear();
+	}
+
+	void presence_watcher::tracker::ready()
+	{
+		if (iStarted && iConnection.connected())
+			iParent.poll(*this);
+		again();
+	}
+
+	presence_watcher::presence_watcher(connection_manager& aConnectionManager, contacts& aContacts) : 
+		iConnectionManager(aConnectionManager), iContacts(aContacts), iNotifyList(aConnectionManager.notify_list())
+	{
+		iConnectionManager.add_observer(*this);
+		iContacts.add_observer(*this);
+		iNotifyList.add_observer(*this);
+	}
+
+	presence_watcher::~presence_watcher()
+	{
+		for (trackers::iterator i = iTrackers.begin(); i != iTrackers.end(); ++i)
+			i->second->iConnection.remove_observer(*this);
+		iNotifyList.remove_observer(*this);
+		iContacts.remove_observer(*this);
+		iConnectionManager.remove_observer(*this);
+	}
+
+	bool presence_watcher::is_online(const connection& aConnection, const std::string& aNickName) const
+	{
+		const tracker* theTracker = find_tracker(aConnection);
+		return theTracker != 0 && theTracker->iOnline.find(fold_case(aConnection, aNickName)) != theTracker->iOnline.end();
+	}
+
+	bool presence_watcher::is_watched(const connection& aConnection, const std::string& aNickName) const
+	{
+		const tracker* theTracker = find_tracker(aConnection);
+		return theTracker != 0 && theTracker->iWatched.find(fold_case(aConnection, aNickName)) != theTracker->iWatched.end();
+	}
+
+	presence_watcher::tracker* presence_watcher::find_tracker(const connection& aConnection) const
+	{
+		trackers::const_iterator theTracker = iTrackers.find(&aConnection);
+		if (theTracker == iTrackers.end())
+			return 0;
+		return theTracker->second.get();
+	}
+
+	void presence_watcher::refresh()
+	{
+		for (trackers::iterator i = iTrackers.begin(); i != iTrackers.end(); ++i)
+			if (i->second->iStarted)
+				refresh(*i->second);
+	}
+
+	void presence_watcher::refresh(tracker& aTracker)
+	{
+		casemapping::type theCasemapping = aTracker.iConnection.casemapping();
+		const server_key& theServer = aTracker.iConnection.server().key();
+		nick_names wanted;
+		for (contacts::container_type::const_iterator i = iContacts.entries().begin(); i != iContacts.entries().end(); ++i)
+			if (server_match(i->server(), theServer) && mask(theCasemapping, i->user().nick_name()).kind() == mask::Literal)
+				wanted[fold_case(theCasemapping, i->user().nick_name())] = i->user().nick_name();
+		for (notify::container_type::const_iterator i = iNotifyList.entries().begin(); i != iNotifyList.entries().end(); ++i)
+			if (server_match((*i)->server(), theServer) && mask(theCasemapping, (*i)->user().nick_name()).kind() == mask::Literal)
+				wanted[fold_case(theCasemapping, (*i)->user().nick_name())] = (*i)->user().nick_name();
+
+		nick_name_list unsubscribe;
+		for (std::set<std::string>::iterator i = aTracker.iMonitored.begin(); i != aTracker.iMonitored.end();)
+			if (wanted.find(*i) == wanted.end())
+			{
+				unsubscribe.push_back(aTracker.iWatched[*i]);
+				aTracker.iMonitored.erase(i++);
+			}
+			else
+				++i;
+		for (std::set<std::string>::iterator i = aTracker.iOnline.begin(); i != aTracker.iOnline.end();)
+			if (wanted.find(*i) == wanted.end())
+				aTracker.iOnline.erase(i++);
+			else
+				++i;
+		aTracker.iWatched.swap(wanted);
+		send(aTracker, message::MONITOR, "-", unsubscribe, ',');
+
+		if (aTracker.iMonitor)
+		{
+			nick_name_list subscribe;
+			for (nick_names::const_iterator i = aTracker.iWatched.begin(); i != aTracker.iWatched.end(); ++i)
+				if (aTracker.iMonitorLimit == 0 || aTracker.iMonitored.size() < aTracker.iMonitorLimit)
+				{
+					if (aTracker.iMonitored.insert(i->first).second)
+						subscribe.push_back(i->second);
+				}
+			send(aTracker, message::MONITOR, "+", subscribe, ',');
+		}
+
+		poll(aTracker);
+	}
+
+	void presence_watcher::poll(tracker& aTracker)
+	{
+		for (std::deque<ison_batch>::const_iterator i = aTracker.iIsonBatches.begin(); i != aTracker.iIsonBatches.end(); ++i)
+			if (i->iOurs)
+				return;
+		nick_name_list unmonitored;
+		for (nick_names::const_iterator i = aTracker.iWatched.begin(); i != aTracker.iWatched.end(); ++i)
+			if (aTracker.iMonitored.find(i->first) == aTracker.iMonitored.end())
+				unmonitored.push_back(i->second);
+		send(aTracker, message::ISON, "", unmonitored, ' ');
+	}
+
+	void presence_watcher::send(tracker& aTracker, message::command_e aCommand, const std::string& aOperation, const nick_name_list& aNickNames, char aSeparator)
+	{
+		if (aNickNames.empty() || !aTracker.iConnection.connected())
+			return;
+		message theMessage(aTracker.iConnection, message::OUTGOING);
+		theMessage.set_command(aCommand);
+		std::size_t leadLength = theMessage.command_string().size() + 1 + (aOperation.empty() ? 0 : aOperation.size() + 1);
+		std::vector<nick_name_list> lines;
+		pack(leadLength, aNickNames, lines);
+		for (std::vector<nick_name_list>::const_iterator i = lines.begin(); i != lines.end(); ++i)
+		{
+			message lineMessage(aTracker.iConnection, message::OUTGOING);
+			lineMessage.set_command(aCommand);
+			lineMessage.set_background(true);
+			if (!aOperation.empty())
+				lineMessage.parameters().push_back(aOperation);
+			if (aSeparator == ' ')
+				lineMessage.parameters().insert(lineMessage.parameters().end(), i->begin(), i->end());
+			else
+			{
+				std::string targets;
+				for (nick_name_list::const_iterator j = i->begin(); j != i->end(); ++j)
+				{
+					if (!targets.empty())
+						targets += aSeparator;
+					targets += *j;
+				}
+				lineMessage.parameters().push_back(targets);
+			}
+			if (aCommand == message::ISON)
+			{
+				aTracker.iIsonBatches.push_back(ison_batch(true));
+				for (nick_name_list::const_iterator j = i->begin(); j != i->end(); ++j)
+					aTracker.iIsonBatches.back().iNickNames.push_back(fold_case(aTracker.iConnection, *j));
+			}
+			aTracker.iSending = true;
+			aTracker.iConnection.send_message(lineMessage);
+			aTracker.iSending = false;
+		}
+	}
+
+	void presence_watcher::pack(std::size_t aLeadLength, const nick_name_list& aNickNames, std::vector<nick_name_list>& aLines)
+	{
+		const std::size_t available = message::max_size() - 2 - aLeadLength; // less CRLF
+		std::size_t lineLength = 0;
+		for (nick_name_list::const_iterator i = aNickNames.begin(); i != aNickNames.end(); ++i)
+		{
+			if (aLines.empty() || lineLength + 1 + i->size() > available)
+			{
+				aLines.push_back(nick_name_list());
+				lineLength = i->size();
+			}
+			else
+				lineLength += 1 + i->size();
+			aLines.back().push_back(*i);
+		}
+	}
+
+	bool presence_watcher::set_online(tracker& aTracker, const user& aUser)
+	{
+		std::string nickName = fold_case(aTracker.iConnection, aUser.nick_name());
+		if (aTracker.iWatched.find(nickName) == aTracker.iWatched.end())
+			return false;
+		if (aTracker.iOnline.insert(nickName).second)
+			notify_observers(presence_watcher_observer::NotifyOnline, aTracker.iConnection, aUser);
+		return true;
+	}
+
+	bool presence_watcher::set_offline(tracker& aTracker, const std::string& aNickName)
+	{
+		std::string nickName = fold_case(aTracker.iConnection, aNickName);
+		if (aTracker.iWatched.find(nickName) == aTracker.iWatched.end())
+			return false;
+		if (aTracker.iOnline.erase(nickName) != 0)
+			notify_observers(presence_watcher_observer::NotifyOffline, aTracker.iConnection, user(aNickName, aTracker.iConnection));
+		return true;
+	}
+
+	void presence_watcher::notify_observer(presence_watcher_observer& aObserver, presence_watcher_observer::notify_type aType, const void* aParameter, const void* aParameter2)
+	{
+		connection& theConnection = *const_cast<connection*>(static_cast<const connection*>(aParameter));
+		const user& theUser = *static_cast<const user*>(aParameter2);
+		switch(aType)
+		{
+		case presence_watcher_observer::NotifyOnline:
+			aObserver.user_online(theConnection, theUser);
+			break;
+		case presence_watcher_observer::NotifyOffline:
+			aObserver.user_offline(theConnection, theUser);
+			break;
+		}
+	}
+
+	void presence_watcher::connection_added(connection& aConnection)
+	{
+		iTrackers[&aConnection] = tracker_ptr(new tracker(*this, aConnection));
+		aConnection.add_observer(*this);
+	}
+
+	void presence_watcher::connection_removed(connection& aConnection)
+	{
+		iTrackers.erase(&aConnection);
+	}
+
+	void presence_watcher::filter_message(connection& aConnection, const message& aMessage, bool& aFiltered)
+	{
+		if (aMessage.direction() != message::INCOMING)
+			return;
+		tracker* theTracker = find_tracker(aConnection);
+		if (theTracker == 0)
+			return;
+		switch(aMessage.command())
+		{
+		case message::RPL_ISUPPORT:
+			for (message::parameters_t::const_iterator i = aMessage.parameters().begin(); i != aMessage.parameters().end(); ++i)
+				if (*i == "MONITOR" || i->compare(0, 8, "MONITOR=") == 0)
+				{
+					theTracker->iMonitor = true;
+					theTracker->iMonitorLimit = i->size() > 8 ? neolib::string_to_integer(i->substr(8)) : 0;
+				}
+			break;
+		case message::RPL_ENDOFMOTD:
+		case message::ERR_NOMOTD:
+			if (!theTracker->iStarted)
+			{
+				theTracker->iStarted = true;
+				refresh(*theTracker);
+			}
+			break;
+		case message::RPL_MONONLINE:
+		case message::RPL_MONOFFLINE:
+			if (!aMessage.parameters().empty())
+			{
+				std::vector<std::string> targets;
+				neolib::tokens(aMessage.parameters()[0], std::string(","), targets);
+				bool ours = !targets.empty();
+				for (std::vector<std::string>::const_iterator i = targets.begin(); i != targets.end(); ++i)
+				{
+					user theUser(*i, aConnection);
+					if (aMessage.command() == message::RPL_MONONLINE)
+						ours = set_online(*theTracker, theUser) && ours;
+					else
+						ours = set_offline(*theTracker, theUser.nick_name()) && ours;
+				}
+				aFiltered = aFiltered || ours;
+			}
+			break;
+		case message::ERR_MONLISTFULL:
+			if (aMessage.parameters().size() >= 2)
+			{
+				std::vector<std::string> targets;
+				neolib::tokens(aMessage.parameters()[1], std::string(","), targets);
+				bool ours = false;
+				for (std::vector<std::string>::const_iterator i = targets.begin(); i != targets.end(); ++i)
+					if (theTracker->iMonitored.erase(fold_case(aConnection, *i)) != 0)
+						ours = true;
+				if (ours)
+				{
+					// what the server could not take is polled instead
+					theTracker->iMonitorLimit = std::max<std::size_t>(theTracker->iMonitored.size(), 1);
+					aFiltered = true;
+					poll(*theTracker);
+				}
+			}
+			break;
+		case message::RPL_ISON:
+			if (!theTracker->iIsonBatches.empty())
+			{
+				ison_batch theBatch = theTracker->iIsonBatches.front();
+				theTracker->iIsonBatches.pop_front();
+				if (!theBatch.iOurs)
+					break;
+				std::vector<std::string> online;
+				if (!aMessage.parameters().empty())
+					neolib::tokens(aMessage.parameters().back(), std::string(" "), online);
+				std::set<std::string> onlineNickNames;
+				for (std::vector<std::string>::const_iterator i = online.begin(); i != online.end(); ++i)
+				{
+					onlineNickNames.insert(fold_case(aConnection, *i));
+					set_online(*theTracker, user(*i, aConnection));
+				}
+				for (nick_name_list::const_iterator i = theBatch.iNickNames.begin(); i != theBatch.iNickNames.end(); ++i)
+				{
+					nick_names::const_iterator watched = theTracker->iWatched.find(*i);
+					if (onlineNickNames.find(*i) == onlineNickNames.end() && watched != theTracker->iWatched.end())
+						set_offline(*theTracker, watched->second);
+				}
+				aFiltered = true;
+			}
+			break;
+		default:
+			break;
+		}
+	}
+
+	void presence_watcher::outgoing_message(connection& aConnection, const message& aMessage)
+	{
+		if (aMessage.command() != message::ISON)
+			return;
+		tracker* theTracker = find_tracker(aConnection);
+		if (theTracker != 0 && !theTracker->iSending)
+			theTracker->iIsonBatches.push_back(ison_batch(false)); // someone else's, so leave its reply alone
+	}
+
+	void presence_watcher::connection_disconnected(connection& aConnection)
+	{
+		tracker* theTracker = find_tracker(aConnection);
+		if (theTracker == 0)
+			return;
+		std::set<std::string> online = theTracker->iOnline;
+		for (std::set<std::string>::const_iterator i = online.begin(); i != online.end(); ++i)
+			set_offline(*theTracker, theTracker->iWatched[*i]);
+		theTracker->reset();
+	}
+}
@@ -0,0 +1,169 @@
+// resolver_cache.cpp
+/*
+ *  Copyright (c) 2010 Leigh Johnston.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ *     * Neither the name of Leigh Johnston nor the names of any
+ *       other contributors to this software may be used to endorse or
+ *       promote products derived from this software without specific prior
+ *       written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ *  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <neolib/neolib.hpp>
+#include <cctype>
+#include <neolib/thread.hpp>
+#include <neoirc/client/resolver_cache.hpp>
+
+namespace irc
+{
+	resolver_cache::resolver_cache(neolib::tcp_resolver& aResolver) : iResolver(aResolver)
+	{
+	}
+
+	resolver_cache::~resolver_cache()
+	{
+		iResolver.remove_requester(*this);
+	}
+
+	void resolver_cache::resolve(requester& aRequester, const std::string& aHostName)
+	{
+		std::string theKey = key(aHostName);
+		entries::iterator cached = iEntries.find(theKey);
+		if (cached != iEntries.end())
+		{
+			if (neolib::thread::elapsed_ms() < cached->second.iExpiry_ms)
+			{
+				iUses.splice(iUses.begin(), iUses, cached->second.iUse);
+				if (cached->second.iResolved)
+				{
+					++iStatistics.iHits;
+					aRequester.host_resolved(aHostName, cached->second.iHost);
+				}
+				else
+				{
+					++iStatistics.iNegativeHits;
+					aRequester.host_not_resolved(aHostName, cached->second.iError);
+				}
+				return;
+			}
+			iUses.erase(cached->second.iUse);
+			iEntries.erase(cached);
+		}
+		pending_list::iterator pending = iPending.find(theKey);
+		if (pending != iPending.end())
+		{
+			++iStatistics.iCoalesced;
+			pending->second.push_back(std::make_pair(&aRequester, aHostName));
+			return;
+		}
+		++iStatistics.iMisses;
+		iPending[theKey].push_back(std::make_pair(&aRequester, aHostName));
+		iResolver.resolve(*this, aHostName);
+	}
+
+	void resolver_cache::remove_requester(requester& aRequester)
+	{
+		for (pending_list::iterator i = iPending.begin(); i != iPending.end(); ++i)
+			for (waiters::iterator j = i->second.begin(); j != i->second.end();)
+			{
+				if (j->first == &aRequester)
+					j = i->second.erase(j);
+				else
+					++j;
+			}
+	}
+
+	void resolver_cache::clear()
+	{
+		iEntries.clear();
+		iUses.clear();
+	}
+
+	std::string resolver_cache::key(const std::string& aHostName)
+	{
+		std::string result(aHostName);
+		for (std::string::iterator i = result.begin(); i != result.end(); ++i)
+			*i = static_cast<char>(std::tolower(static_cast<unsigned char>(*i)));
+		return result;
+	}
+
+	resolver_cache::entry& resolver_cache::store(const std::string& aKey)
+	{
+		entries::iterator existing = iEntries.find(aKey);
+		if (existing != iEntries.end())
+		{
+			iUses.splice(iUses.begin(), iUses, existing->second.iUse);
+			return existing->second;
+		}
+		while (iEntries.size() >= MaxEntries && !iUses.empty())
+		{
+			iEntries.erase(iUses.back());
+			iUses.pop_back();
+			++iStatistics.iEvictions;
+		}
+		iUses.push_front(aKey);
+		entry& newEntry = iEntries[aKey];
+		newEntry.iUse = iUses.begin();
+		return newEntry;
+	}
+
+	void resolver_cache::host_resolved(const std::string& aHostName, neolib::tcp_resolver::iterator aHost)
+	{
+		std::string theKey = key(aHostName);
+		entry& theEntry = store(theKey);
+		theEntry.iResolved = true;
+		theEntry.iHost = aHost;
+		theEntry.iError = boost::system::error_code();
+		theEntry.iExpiry_ms = neolib::thread::elapsed_ms() + PositiveLifetime_ms;
+		pending_list::iterator pending = iPending.find(theKey);
+		if (pending == iPending.end())
+			return;
+		waiters theWaiters;
+		theWaiters.swap(pending->second);
+		iPending.erase(pending);
+		for (waiters::const_iterator i = theWaiters.begin(); i != theWaiters.end(); ++i)
+			i->first->host_resolved(i->second, aHost);
+	}
+
+	void resolver_cache::host_not_resolved(const std::string& aHostName, const boost::system::error_code& aError)
+	{
+		std::string theKey = key(aHostName);
+		entry& theEntry = store(theKey);
+		theEntry.iResolved = false;
+		theEntry.iHost = neolib::tcp_resolver::iterator();
+		theEntry.iError = aError;
+		theEntry.iExpiry_ms = neolib::thread::elapsed_ms() + NegativeLifetime_ms;
+		pending_list::iterator pending = iPending.find(theKey);
+		if (pending == iPending.end())
+			return;
+		waiters theWaiters;
+		theWaiters.swap(pending->second);
+		iPending.erase(pending);
+		for (waiters::const_iterator i = theWaiters.begin(); i != theWaiters.end(); ++i)
+			i->first->host_not_resolved(i->second, aError);
+	}
+}
@@ -0,0 +1,427 @@
+// scrollback_file.cpp
+/*
+ *  Copyright (c) 2010 Leigh Johnston.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ *     * Neither the name of Leigh Johnston nor the names of any
+ *       other contributors to this software may be used to endorse or
+ *       promote products derived from this software without specific prior
+ *       written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ *  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <neolib/neolib.hpp>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <boost/filesystem.hpp>
+#include <neolib/file.hpp>
+#include <neolib/string_utils.hpp>
+#include <neoirc/client/scrollback_file.hpp>
+
+namespace irc
+{
+	namespace
+	{
+		const char sHeaderMagic[] = "NEOIRCSB";
+		const char sFooterMagic[] = "NEOIRCIX";
+		enum { MagicSize = 8, Version = 1, HeaderSize = MagicSize + 4, RecordHeaderSize = 4 + 8, IndexEntrySize = 8 + 8 + 8, TrailerSize = 8 + 8 + 4 + 4 + MagicSize };
+		enum { MaxRecordSize = 64 * 1024 };
+
+		void put_u32(std::string& aBuffer, uint32_t aValue)
+		{
+			for (int i = 0; i < 4; ++i)
+				aBuffer += static_cast<char>((aValue >> (i * 8)) & 0xFF);
+		}
+
+		void put_u64(std::string& aBuffer, uint64_t aValue)
+		{
+			for (int i = 0; i < 8; ++i)
+				aBuffer += static_cast<char>((aValue >> (i * 8)) & 0xFF);
+		}
+
+		uint32_t get_u32(const char* aBuffer)
+		{
+			uint32_t ret = 0;
+			for (int i = 3; i >= 0; --i)
+				ret = (ret << 8) | static_cast<unsigned char>(aBuffer[i]);
+			return ret;
+		}
+
+		uint64_t get_u64(const char* aBuffer)
+		{
+			uint64_t ret = 0;
+			for (int i = 7; i >= 0; --i)
+				ret = (ret << 8) | static_cast<unsigned char>(aBuffer[i]);
+			return ret;
+		}
+
+		uint64_t file_size(std::fstream& aFile)
+		{
+			aFile.clear();
+			aFile.seekg(0, std::ios_base::end);
+			return static_cast<uint64_t>(aFile.tellg());
+		}
+	}
+
+	scrollback_file::scrollback_file(const std::string& aPath, bool aWritable) : 
+		iPath(aPath), iWritable(aWritable), iOpen(false), iWasSealed(false), iDirty(false), iCount(0), iEnd(HeaderSize)
+	{
+		if (iWritable && (!neolib::file_exists(iPath) || boost::filesystem::file_size(iPath) == 0))
+		{
+			std::ofstream newFile(iPath.c_str(), std::ios::out|std::ios::trunc|std::ios::binary);
+			std::string header(sHeaderMagic, MagicSize);
+			put_u32(header, Version);
+			newFile.write(header.data(), header.size());
+			if (!newFile)
+				return;
+		}
+		iFile.open(iPath.c_str(), iWritable ? std::ios::in|std::ios::out|std::ios::binary : std::ios::in|std::ios::binary);
+		if (!iFile || file_size(iFile) == 0)
+			return;
+		load();
+		iOpen = true;
+		if (iWritable && file_size(iFile) != iEnd)
+		{
+			// drop the footer (or a torn record) so that new records can be appended in place
+			iFile.close();
+			boost::system::error_code ec;
+			boost::filesystem::resize_file(iPath, iEnd, ec);
+			iFile.open(iPath.c_str(), std::ios::in|std::ios::out|std::ios::binary);
+			if (ec || !iFile)
+				iOpen = false;
+			iDirty = true;
+		}
+	}
+
+	scrollback_file::~scrollback_file()
+	{
+		try
+		{
+			seal();
+		}
+		catch(...)
+		{
+		}
+	}
+
+	void scrollback_file::append(time_t aTime, const std::string& aText)
+	{
+		if (!iOpen || !iWritable)
+			return;
+		std::string::size_type length = aText.size();
+		while (length > 0 && (aText[length - 1] == '\r' || aText[length - 1] == '\n'))
+			--length;
+		if (length > MaxRecordSize)
+			length = MaxRecordSize;
+		if (!iDirty)
+		{
+			// file was sealed by us; remove the footer before appending
+			iFile.close();
+			boost::system::error_code ec;
+			boost::filesystem::resize_file(iPath, iEnd, ec);
+			iFile.open(iPath.c_str(), std::ios::in|std::ios::out|std::ios::binary);
+			if (ec || !iFile)
+			{
+				iOpen = false;
+				return;
+			}
+			iDirty = true;
+		}
+		if (iCount % IndexInterval == 0)
+		{
+			index_entry newEntry = { iCount, static_cast<uint64_t>(aTime), iEnd };
+			iIndex.push_back(newEntry);
+		}
+		std::string theRecord;
+		theRecord.reserve(RecordHeaderSize + length);
+		put_u32(theRecord, static_cast<uint32_t>(length));
+		put_u64(theRecord, static_cast<uint64_t>(aTime));
+		theRecord.append(aText, 0, length);
+		iFile.clear();
+		iFile.seekp(static_cast<std::streamoff>(iEnd));
+		iFile.write(theRecord.data(), theRecord.size());
+		iFile.flush();
+		iEnd += theRecord.size();
+		++iCount;
+	}
+
+	void scrollback_file::seal()
+	{
+		if (!iOpen || !iWritable || !iDirty)
+			return;
+		std::string footer;
+		footer.reserve(iIndex.size() * IndexEntrySize + TrailerSize);
+		for (index::const_iterator i = iIndex.begin(); i != iIndex.end(); ++i)
+		{
+			put_u64(footer, i->iOrdinal);
+			put_u64(footer, i->iTime);
+			put_u64(footer, i->iOffset);
+		}
+		put_u64(footer, iEnd);
+		put_u64(footer, iCount);
+		put_u32(footer, static_cast<uint32_t>(iIndex.size()));
+		put_u32(footer, IndexInterval);
+		footer.append(sFooterMagic, MagicSize);
+		iFile.clear();
+		iFile.seekp(static_cast<std::streamoff>(iEnd));
+		iFile.write(footer.data(), footer.size());
+		iFile.flush();
+		iDirty = false;
+	}
+
+	scrollback_file::records scrollback_file::tail(std::size_t aCount) const
+	{
+		records ret;
+		if (!iOpen || aCount == 0 || iCount == 0)
+			return ret;
+		ordinal first = (iCount > aCount ? iCount - aCount : 0);
+		ordinal current;
+		offset position = seek_ordinal(first, current);
+		record theRecord;
+		while (current < iCount && read_record(position, theRecord))
+		{
+			if (current >= first)
+			{
+				theRecord.iOrdinal = current;
+				ret.push_back(theRecord);
+			}
+			++current;
+		}
+		return ret;
+	}
+
+	scrollback_file::records scrollback_file::from(time_t aTime, std::size_t aCount) const
+	{
+		records ret;
+		if (!iOpen || aCount == 0 || iCount == 0)
+			return ret;
+		ordinal current;
+		offset position = seek_time(aTime, current);
+		record theRecord;
+		while (ret.size() < aCount && current < iCount && read_record(position, theRecord))
+		{
+			if (theRecord.iTime >= aTime)
+			{
+				theRecord.iOrdinal = current;
+				ret.push_back(theRecord);
+			}
+			++current;
+		}
+		return ret;
+	}
+
+	bool scrollback_file::is_scrollback_file(const std::string& aPath)
+	{
+		std::ifstream theFile(aPath.c_str(), std::ios::in|std::ios::binary);
+		char magic[MagicSize];
+		theFile.read(magic, MagicSize);
+		return theFile && std::memcmp(magic, sHeaderMagic, MagicSize) == 0;
+	}
+
+	bool scrollback_file::convert(const std::string& aLegacyPath, const std::string& aPath)
+	{
+		std::ifstream legacyFile(aLegacyPath.c_str(), std::ios::in|std::ios::binary);
+		if (!legacyFile)
+			return false;
+		std::string tempPath = aPath + ".tmp";
+		std::remove(tempPath.c_str());
+		{
+			scrollback_file newFile(tempPath, true);
+			if (!newFile.is_open())
+				return false;
+			std::string line;
+			while (std::getline(legacyFile, line))
+			{
+				if (!line.empty() && line[line.size() - 1] == '\r')
+					line.erase(line.size() - 1);
+				if (line.empty())
+					continue;
+				std::string::size_type space = line.find(' ');
+				if (space == std::string::npos || space == 0)
+					continue;
+				newFile.append(static_cast<time_t>(neolib::string_to_unsigned_integer(line.substr(0, space))), line);
+			}
+			newFile.seal();
+		}
+		std::remove(aPath.c_str());
+		return std::rename(tempPath.c_str(), aPath.c_str()) == 0;
+	}
+
+	bool scrollback_file::chop(const std::string& aPath, offset aKeep)
+	{
+		std::string tempPath = aPath + ".tmp";
+		{
+			scrollback_file oldFile(aPath);
+			if (!oldFile.is_open() || oldFile.data_size() - HeaderSize <= aKeep)
+				return false;
+			offset threshold = oldFile.data_size() - aKeep;
+			offset position = HeaderSize;
+			ordinal current = 0;
+			for (index::const_iterator i = oldFile.iIndex.begin(); i != oldFile.iIndex.end() && i->iOffset <= threshold; ++i)
+			{
+				position = i->iOffset;
+				current = i->iOrdinal;
+			}
+			std::remove(tempPath.c_str());
+			scrollback_file newFile(tempPath, true);
+			if (!newFile.is_open())
+				return false;
+			record theRecord;
+			for (offset recordPosition = position; current < oldFile.count() && oldFile.read_record(position, theRecord); recordPosition = position, ++current)
+				if (recordPosition >= threshold)
+					newFile.append(theRecord.iTime, theRecord.iText);
+			newFile.seal();
+		}
+		std::remove(aPath.c_str());
+		return std::rename(tempPath.c_str(), aPath.c_str()) == 0;
+	}
+
+	void scrollback_file::load()
+	{
+		uint64_t size = file_size(iFile);
+		char header[HeaderSize];
+		iFile.seekg(0);
+		iFile.read(header, HeaderSize);
+		if (!iFile || std::memcmp(header, sHeaderMagic, MagicSize) != 0 || get_u32(header + MagicSize) != Version)
+			throw bad_file();
+		if (size >= HeaderSize + TrailerSize)
+		{
+			char trailer[TrailerSize];
+			iFile.seekg(static_cast<std::streamoff>(size - TrailerSize));
+			iFile.read(trailer, TrailerSize);
+			if (iFile && std::memcmp(trailer + TrailerSize - MagicSize, sFooterMagic, MagicSize) == 0)
+			{
+				offset indexOffset = get_u64(trailer);
+				ordinal count = get_u64(trailer + 8);
+				uint32_t entries = get_u32(trailer + 16);
+				if (indexOffset >= HeaderSize && indexOffset + static_cast<uint64_t>(entries) * IndexEntrySize + TrailerSize == size)
+				{
+					std::vector<char> entryData(static_cast<std::size_t>(entries) * IndexEntrySize);
+					iFile.seekg(static_cast<std::streamoff>(indexOffset));
+					if (!entryData.empty())
+						iFile.read(&entryData[0], entryData.size());
+					if (iFile)
+					{
+						iIndex.clear();
+						iIndex.reserve(entries);
+						for (uint32_t i = 0; i < entries; ++i)
+						{
+							const char* entry = &entryData[i * IndexEntrySize];
+							index_entry newEntry = { get_u64(entry), get_u64(entry + 8), get_u64(entry + 16) };
+							iIndex.push_back(newEntry);
+						}
+						iCount = count;
+						iEnd = indexOffset;
+						iWasSealed = true;
+						return;
+					}
+				}
+			}
+		}
+		recover();
+	}
+
+	void scrollback_file::recover()
+	{
+		uint64_t size = file_size(iFile);
+		iIndex.clear();
+		iCount = 0;
+		iEnd = HeaderSize;
+		char recordHeader[RecordHeaderSize];
+		while (iEnd + RecordHeaderSize <= size)
+		{
+			iFile.seekg(static_cast<std::streamoff>(iEnd));
+			iFile.read(recordHeader, RecordHeaderSize);
+			if (!iFile)
+				break;
+			uint32_t length = get_u32(recordHeader);
+			if (length > MaxRecordSize || iEnd + RecordHeaderSize + length > size)
+				break;
+			if (iCount % IndexInterval == 0)
+			{
+				index_entry newEntry = { iCount, get_u64(recordHeader + 4), iEnd };
+				iIndex.push_back(newEntry);
+			}
+			iEnd += RecordHeaderSize + length;
+			++iCount;
+		}
+		iFile.clear();
+	}
+
+	scrollback_file::offset scrollback_file::seek_ordinal(ordinal aOrdinal, ordinal& aStartOrdinal) const
+	{
+		aStartOrdinal = 0;
+		offset ret = HeaderSize;
+		index::const_iterator i = std::upper_bound(iIndex.begin(), iIndex.end(), aOrdinal, 
+			[](ordinal aValue, const index_entry& aEntry) { return aValue < aEntry.iOrdinal; });
+		if (i != iIndex.begin())
+		{
+			--i;
+			aStartOrdinal = i->iOrdinal;
+			ret = i->iOffset;
+		}
+		return ret;
+	}
+
+	scrollback_file::offset scrollback_file::seek_time(time_t aTime, ordinal& aStartOrdinal) const
+	{
+		aStartOrdinal = 0;
+		offset ret = HeaderSize;
+		index::const_iterator i = std::lower_bound(iIndex.begin(), iIndex.end(), static_cast<uint64_t>(aTime), 
+			[](const index_entry& aEntry, uint64_t aValue) { return aEntry.iTime < aValue; });
+		if (i != iIndex.begin())
+		{
+			--i;
+			aStartOrdinal = i->iOrdinal;
+			ret = i->iOffset;
+		}
+		return ret;
+	}
+
+	bool scrollback_file::read_record(offset& aPosition, record& aRecord) const
+	{
+		if (aPosition + RecordHeaderSize > iEnd)
+			return false;
+		char recordHeader[RecordHeaderSize];
+		iFile.clear();
+		iFile.seekg(static_cast<std::streamoff>(aPosition));
+		iFile.read(recordHeader, RecordHeaderSize);
+		if (!iFile)
+			return false;
+		uint32_t length = get_u32(recordHeader);
+		if (aPosition + RecordHeaderSize + length > iEnd)
+			return false;
+		aRecord.iTime = static_cast<time_t>(get_u64(recordHeader + 4));
+		aRecord.iText.resize(length);
+		if (length > 0)
+			iFile.read(&aRecord.iText[0], length);
+		if (!iFile)
+			return false;
+		aPosition += RecordHeaderSize + length;
+		return true;
+	}
+}
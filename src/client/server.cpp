@@ -37,6 +37,7 @@
 #include <cstdlib>
 #include <neolib/xml.hpp>
 #include <fstream>
+#include <sstream>
 #include <neoirc/client/server.hpp>
 #include <neoirc/client/model.hpp>
 
@@ -127,18 +128,293 @@ namespace irc
 		}
 	}
 
-	bool read_server_list(server_list& aServerList, std::istream& aInput)
+	server_list::iterator server_list::find(const server::key_type& aKey)
 	{
-		aServerList.clear();
+		index();
+		server_keys::const_iterator i = iByKey.find(aKey);
+		return i != iByKey.end() ? i->second : iServers.end();
+	}
+
+	server_list::const_iterator server_list::find(const server::key_type& aKey) const
+	{
+		index();
+		server_keys::const_iterator i = iByKey.find(aKey);
+		return i != iByKey.end() ? const_iterator(i->second) : iServers.end();
+	}
+
+	const server_list::servers& server_list::network_servers(const std::string& aNetwork) const
+	{
+		static const servers sNone;
+		index();
+		server_groups::const_iterator i = iByNetwork.find(aNetwork);
+		return i != iByNetwork.end() ? i->second : sNone;
+	}
+
+	const server_list::servers& server_list::address_servers(const std::string& aAddress) const
+	{
+		static const servers sNone;
+		index();
+		server_groups::const_iterator i = iByAddress.find(neolib::to_upper(aAddress));
+		return i != iByAddress.end() ? i->second : sNone;
+	}
+
+	server_list::const_iterator server_list::random_server(const std::string& aNetwork, neolib::random& aRandom) const
+	{
+		const servers& networkServers = network_servers(aNetwork);
+		if (networkServers.empty())
+			return iServers.end();
+		return networkServers[aRandom.get(0, static_cast<int>(networkServers.size()) - 1)];
+	}
+
+	void server_list::index() const
+	{
+		if (iIndexed)
+			return;
+		iByNetwork.clear();
+		iByAddress.clear();
+		iByKey.clear();
+		iIndexed = true;
+		container_type& theServers = const_cast<container_type&>(iServers);
+		for (iterator i = theServers.begin(); i != theServers.end(); ++i)
+			add_to_index(i);
+	}
+
+	void server_list::add_to_index(iterator aServer) const
+	{
+		if (!iIndexed)
+			return;
+		iByNetwork[aServer->network()].push_back(aServer);
+		iByAddress[neolib::to_upper(aServer->address())].push_back(aServer);
+		iByKey.insert(std::make_pair(aServer->key(), aServer)); // first wins, as with a linear search
+	}
+
+	bool server_list_reader::feed(const char* aText, std::size_t aLength)
+	{
+		if (iError)
+			return false;
+		iPending.append(aText, aLength);
+		std::string::size_type next = 0;
+		for (;;)
+		{
+			std::string::size_type start = iPending.find('<', next);
+			if (start == std::string::npos)
+			{
+				next = iPending.size();
+				break;
+			}
+			if (iPending.compare(start, 2, "<!") == 0 && iPending.size() - start < 4)
+			{
+				next = start;
+				break;
+			}
+			std::string::size_type end = std::string::npos;
+			if (iPending.compare(start, 4, "<!--") == 0)
+			{
+				end = iPending.find("-->", start + 4);
+				if (end == std::string::npos)
+				{
+					next = start;
+					break;
+				}
+				next = end + 3;
+				continue;
+			}
+			char quote = '\0';
+			for (std::string::size_type i = start + 1; end == std::string::npos && i < iPending.size(); ++i)
+			{
+				if (quote != '\0')
+				{
+					if (iPending[i] == quote)
+						quote = '\0';
+				}
+				else if (iPending[i] == '"' || iPending[i] == '\'')
+					quote = iPending[i];
+				else if (iPending[i] == '>')
+					end = i;
+			}
+			if (end == std::string::npos)
+			{
+				next = start;
+				break;
+			}
+			tag(iPending.substr(start + 1, end - start - 1));
+			if (iError)
+				return false;
+			next = end + 1;
+		}
+		iPending.erase(0, next);
+		return true;
+	}
+
+	void server_list_reader::tag(const std::string& aTag)
+	{
+		if (aTag.empty())
+		{
+			iError = true;
+			return;
+		}
+		if (aTag[0] == '?' || aTag[0] == '!')
+			return;
+		if (aTag[0] == '/')
+		{
+			if (iDepth == 0 || iComplete)
+			{
+				iError = true;
+				return;
+			}
+			if (--iDepth == 0)
+				iComplete = true;
+			else if (iDepth == 1)
+				iInNetwork = false;
+			return;
+		}
+		if (iComplete)
+		{
+			iError = true;
+			return;
+		}
+		bool empty = aTag[aTag.size() - 1] == '/';
+		std::string::size_type nameEnd = aTag.find_first_of(" \t\r\n/");
+		std::string name = aTag.substr(0, nameEnd);
+		attributes theAttributes;
+		if (nameEnd != std::string::npos && !parse_attributes(aTag.substr(0, empty ? aTag.size() - 1 : aTag.size()), nameEnd, theAttributes))
+		{
+			iError = true;
+			return;
+		}
+		if (iDepth == 1 && name == "version")
+			iVersion = attribute_value(theAttributes, "value");
+		else if (iDepth == 1 && name == "network")
+		{
+			iNetwork = attribute_value(theAttributes, "name");
+			iInNetwork = !empty;
+		}
+		else if (iDepth == 2 && iInNetwork && name == "server")
+		{
+			server theServer;
+			theServer.set_network(iNetwork);
+			theServer.set_name(attribute_value(theAttributes, "name"));
+			theServer.set_address(attribute_value(theAttributes, "address"));
+			irc::server::port_list portList;
+			parse_ports(attribute_value(theAttributes, "ports"), portList);
+			theServer.set_ports(portList);
+			theServer.set_password(attribute_value(theAttributes, "password") == "1" ? true : false);
+			theServer.set_secure(attribute_value(theAttributes, "secure") == "1" ? true : false);
+			iOutput.push_back(theServer);
+		}
+		if (!empty)
+			++iDepth;
+		else if (iDepth == 0)
+			iComplete = true;
+	}
+
+	bool server_list_reader::parse_attributes(const std::string& aTag, std::string::size_type aPosition, attributes& aAttributes) const
+	{
+		static const std::string sWhitespace = " \t\r\n";
+		for (;;)
+		{
+			std::string::size_type nameStart = aTag.find_first_not_of(sWhitespace, aPosition);
+			if (nameStart == std::string::npos)
+				return true;
+			std::string::size_type equals = aTag.find('=', nameStart);
+			if (equals == std::string::npos)
+				return false;
+			std::string::size_type nameEnd = aTag.find_last_not_of(sWhitespace, equals - 1);
+			std::string::size_type valueStart = aTag.find_first_not_of(sWhitespace, equals + 1);
+			if (nameEnd == std::string::npos || nameEnd < nameStart || valueStart == std::string::npos || (aTag[valueStart] != '"' && aTag[valueStart] != '\''))
+				return false;
+			std::string::size_type valueEnd = aTag.find(aTag[valueStart], valueStart + 1);
+			if (valueEnd == std::string::npos)
+				return false;
+			std::string value;
+			if (!decode(aTag, valueStart + 1, valueEnd, value))
+				return false;
+			aAttributes[aTag.substr(nameStart, nameEnd - nameStart + 1)] = value;
+			aPosition = valueEnd + 1;
+		}
+	}
+
+	std::string server_list_reader::attribute_value(const attributes& aAttributes, const std::string& aName)
+	{
+		attributes::const_iterator i = aAttributes.find(aName);
+		return i != aAttributes.end() ? i->second : std::string();
+	}
+
+	bool server_list_reader::decode(const std::string& aText, std::string::size_type aStart, std::string::size_type aEnd, std::string& aResult)
+	{
+		aResult.reserve(aEnd - aStart);
+		for (std::string::size_type i = aStart; i < aEnd; ++i)
+		{
+			if (aText[i] != '&')
+			{
+				aResult += aText[i];
+				continue;
+			}
+			std::string::size_type semicolon = aText.find(';', i);
+			if (semicolon == std::string::npos || semicolon >= aEnd)
+				return false;
+			std::string entity = aText.substr(i + 1, semicolon - i - 1);
+			if (entity == "amp")
+				aResult += '&';
+			else if (entity == "lt")
+				aResult += '<';
+			else if (entity == "gt")
+				aResult += '>';
+			else if (entity == "quot")
+				aResult += '"';
+			else if (entity == "apos")
+				aResult += '\'';
+			else if (entity.size() > 1 && entity[0] == '#')
+			{
+				unsigned long codePoint = entity[1] == 'x' || entity[1] == 'X' ? 
+					std::strtoul(entity.c_str() + 2, 0, 16) : std::strtoul(entity.c_str() + 1, 0, 10);
+				if (codePoint == 0 || codePoint > 0x10FFFF)
+					return false;
+				if (codePoint < 0x80)
+					aResult += static_cast<char>(codePoint);
+				else if (codePoint < 0x800)
+				{
+					aResult += static_cast<char>(0xC0 | (codePoint >> 6));
+					aResult += static_cast<char>(0x80 | (codePoint & 0x3F));
+				}
+				else if (codePoint < 0x10000)
+				{
+					aResult += static_cast<char>(0xE0 | (codePoint >> 12));
+					aResult += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+					aResult += static_cast<char>(0x80 | (codePoint & 0x3F));
+				}
+				else
+				{
+					aResult += static_cast<char>(0xF0 | (codePoint >> 18));
+					aResult += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+					aResult += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+					aResult += static_cast<char>(0x80 | (codePoint & 0x3F));
+				}
+			}
+			else
+				return false;
+			i = semicolon;
+		}
+		return true;
+	}
 
+	bool read_server_list(server_list& aServerList, std::istream& aInput)
+	{
 		neolib::xml xmlServers(true);
 		
 		xmlServers.read(aInput);
 
-		if (xmlServers.error())
+		return read_server_list(aServerList, xmlServers);
+	}
+
+	bool read_server_list(server_list& aServerList, const neolib::xml& aXml)
+	{
+		aServerList.clear();
+
+		if (aXml.error())
 			return false;
 
-		for (neolib::xml::element::const_iterator i = xmlServers.root().begin(); i != xmlServers.root().end(); ++i)
+		for (neolib::xml::element::const_iterator i = aXml.root().begin(); i != aXml.root().end(); ++i)
 		{
 			const neolib::xml::element& networkElement = *i;
 			if (networkElement.name() == "version")
@@ -171,11 +447,17 @@ namespace irc
 
 	void read_server_list(model& aModel, std::function<bool()> aErrorFunction)
 	{
-		server_list& theServers = aModel.server_list();
-
+		neolib::xml xmlServers(true);
 		std::ifstream input((aModel.root_path() + "servers.xml").c_str());
+		xmlServers.read(input);
+		read_server_list(aModel, xmlServers, aErrorFunction);
+	}
+
+	void read_server_list(model& aModel, const neolib::xml& aXml, std::function<bool()> aErrorFunction)
+	{
+		server_list& theServers = aModel.server_list();
 
-		if (!read_server_list(theServers, input) && aErrorFunction && aErrorFunction())
+		if (!read_server_list(theServers, aXml) && aErrorFunction && aErrorFunction())
 		{
 			theServers.clear();
 			write_server_list(aModel);
@@ -236,8 +518,9 @@ namespace irc
 			}
 		}
 
-		std::ofstream output((aModel.root_path() + "servers.xml").c_str());
+		std::ostringstream output;
 		xmlServers.write(output);
+		aModel.save_config(aModel.root_path() + "servers.xml", output.str());
 	}
 
 	void merge_server_list(model& aModel, const server_list& aServerList)
@@ -278,4 +561,23 @@ namespace irc
 		aModel.server_list().sort();
 		write_server_list(aModel);
 	}
+
+	std::size_t merge_server_list(server_list& aServerList, const server_list& aNewServers)
+	{
+		std::size_t added = 0;
+		for (server_list::const_iterator i = aNewServers.begin(); i != aNewServers.end(); ++i)
+		{
+			bool found = false;
+			const server_list::servers& sameAddress = aServerList.address_servers(i->address());
+			for (server_list::servers::const_iterator j = sameAddress.begin(); !found && j != sameAddress.end(); ++j)
+				if ((*j)->address() == i->address() && (*j)->secure() == i->secure())
+					found = true;
+			if (!found)
+			{
+				aServerList.push_back(*i);
+				++added;
+			}
+		}
+		return added;
+	}
 }
@@ -35,21 +35,123 @@
 
 #include <neolib/neolib.hpp>
 #include <cstdlib>
+#include <deque>
+#include <mutex>
+#include <zlib.h>
 #include <neolib/timer.hpp>
-#include <neolib/gunzip.hpp>
 #include <neolib/version.hpp>
-#include <strstream>
 #include <neoirc/client/server_updater.hpp>
 #include <neoirc/client/model.hpp>
 
 namespace irc
 {
+	// Inflates the downloaded body a chunk at a time and feeds the text straight into a 
+	// server_list_reader; complete batches of servers are handed to the owner thread to be 
+	// staged while the rest of the list is still being parsed.
+	class server_list_updater::parser : public background_job
+	{
+		// types
+	public:
+		typedef std::decay<decltype(std::declval<neolib::http&>().body())>::type body_type;
+	private:
+		static const std::size_t InputChunkSize = 16 * 1024;
+		static const std::size_t OutputChunkSize = 64 * 1024;
+		static const std::size_t BatchSize = 512;
+
+		// construction
+	public:
+		parser(server_list_updater& aOwner, const body_type& aBody) : iOwner(aOwner), iBody(aBody), iOk(false) {}
+
+		// implementation
+	private:
+		virtual void run()
+		{
+			if (iBody.empty())
+				return;
+			z_stream stream = {};
+			if (inflateInit2(&stream, 32 + MAX_WBITS) != Z_OK) // gzip or zlib header
+				return;
+			server_list parsed;
+			server_list_reader reader(parsed);
+			const Bytef* nextInput = reinterpret_cast<const Bytef*>(&iBody[0]);
+			std::size_t remainingInput = iBody.size();
+			std::vector<char> output(OutputChunkSize);
+			int result = Z_OK;
+			while (result != Z_STREAM_END && !cancelled())
+			{
+				if (stream.avail_in == 0)
+				{
+					if (remainingInput == 0)
+						break;
+					stream.next_in = const_cast<Bytef*>(nextInput);
+					stream.avail_in = static_cast<uInt>(remainingInput < InputChunkSize ? remainingInput : InputChunkSize);
+					nextInput += stream.avail_in;
+					remainingInput -= stream.avail_in;
+				}
+				stream.next_out = reinterpret_cast<Bytef*>(&output[0]);
+				stream.avail_out = static_cast<uInt>(output.size());
+				result = inflate(&stream, Z_NO_FLUSH);
+				if (result != Z_OK && result != Z_STREAM_END && result != Z_BUF_ERROR)
+					break;
+				if (!reader.feed(&output[0], output.size() - stream.avail_out))
+					break;
+				if (parsed.size() >= BatchSize)
+				{
+					hand_over(parsed);
+					parsed.clear();
+				}
+			}
+			inflateEnd(&stream);
+			if (!parsed.empty())
+				hand_over(parsed);
+			iVersion = reader.version();
+			iOk = result == Z_STREAM_END && reader.finish();
+		}
+		virtual void progressed()
+		{
+			std::deque<server_list> batches;
+			{
+				std::lock_guard<std::mutex> lock(iBatchesMutex);
+				batches.swap(iBatches);
+			}
+			for (std::deque<server_list>::const_iterator i = batches.begin(); i != batches.end(); ++i)
+				iOwner.merge_batch(*i);
+		}
+		virtual void completed()
+		{
+			progressed();
+			iOwner.update_completed(iVersion, iOk);
+		}
+		void hand_over(const server_list& aBatch)
+		{
+			{
+				std::lock_guard<std::mutex> lock(iBatchesMutex);
+				iBatches.push_back(aBatch);
+			}
+			progress();
+		}
+
+		// attributes
+	private:
+		server_list_updater& iOwner;
+		body_type iBody;
+		std::mutex iBatchesMutex;
+		std::deque<server_list> iBatches;
+		std::string iVersion;
+		bool iOk;
+	};
+
 	server_list_updater::server_list_updater(model& aModel) : neolib::timer(aModel.io_task(), 60 * 60 * 1000), iModel(aModel), iDownloading(false) 
 	{
 	}
 
 	server_list_updater::~server_list_updater()
 	{
+		if (iUpdateJob)
+		{
+			iUpdateJob->cancel();
+			iUpdateJob->wait();
+		}
 	}
 
 	void server_list_updater::check_for_updates(bool aEnable)
@@ -114,22 +216,40 @@ namespace irc
 		else if (iDownloader && &*iDownloader == &aRequest)
 		{
 			iDownloading = false;
-			neolib::gunzip decompressed(aRequest.body());
-			bool ok = false;
-			if (decompressed.ok() && !decompressed.uncompressed_data().empty())
+			// decompress and parse on the background executor; merge back on this thread in batches
+			if (iUpdateJob)
 			{
-				std::strstream ss(const_cast<char*>(&decompressed.uncompressed_data()[0]), decompressed.uncompressed_data().size());
-				server_list updatedList;
-				if (read_server_list(updatedList, ss))
-				{
-					merge_server_list(iModel, updatedList);
-					ok = true;
-				}
+				iUpdateJob->cancel();
+				iUpdateJob->wait();
 			}
-			if (ok)
-				notify_observers(server_list_updater_observer::NotifyDownloaded);
-			else
-				notify_observers(server_list_updater_observer::NotifyDownloadFailure);
+			iStaging.clear();
+			iUpdateJob.reset(new parser(*this, aRequest.body()));
+			iModel.background_executor().post(iUpdateJob);
+		}
+	}
+
+	void server_list_updater::merge_batch(const server_list& aBatch)
+	{
+		merge_server_list(iStaging, aBatch);
+	}
+
+	void server_list_updater::update_completed(const std::string& aVersion, bool aOk)
+	{
+		iUpdateJob.reset();
+		if (aOk)
+		{
+			server_list& theServers = iModel.server_list();
+			merge_server_list(theServers, iStaging);
+			iStaging.clear();
+			theServers.sort();
+			theServers.iVersion = aVersion;
+			write_server_list(iModel);
+			notify_observers(server_list_updater_observer::NotifyDownloaded);
+		}
+		else
+		{
+			iStaging.clear();
+			notify_observers(server_list_updater_observer::NotifyDownloadFailure);
 		}
 	}
 
@@ -0,0 +1,389 @@
+// shard_stream.cpp
+/*
+ *  Copyright (c) 2010 Leigh Johnston.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ *     * Neither the name of Leigh Johnston nor the names of any
+ *       other contributors to this software may be used to endorse or
+ *       promote products derived from this software without specific prior
+ *       written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ *  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <neolib/neolib.hpp>
+#include <neoirc/client/shard_stream.hpp>
+#include <neoirc/client/message.hpp>
+
+namespace irc
+{
+	shard_stream::relay::relay(io_shards& aShards, io_shards::shard& aShard, self_pointer aSelf, unsigned long aSession, parsed_queue_pointer aParsed) :
+		iShards(aShards), iShard(aShard), iSelf(aSelf), iSession(aSession), iParsed(aParsed), iFlushPosted(false)
+	{
+	}
+
+	void shard_stream::relay::open_failed(neolib::tcp_string_packet_stream& aStream)
+	{
+		self_pointer self = iSelf;
+		unsigned long session = iSession;
+		int errorCode = aStream.error_code();
+		std::string errorText = aStream.error();
+		iShards.deliver([self, session, errorCode, errorText]() { if (*self != 0) (*self)->failed(session, boost::system::error_code(), errorCode, errorText); });
+	}
+
+	void shard_stream::relay::connection_established(neolib::tcp_string_packet_stream& aStream)
+	{
+		self_pointer self = iSelf;
+		unsigned long session = iSession;
+		unsigned short localPort = 0;
+		unsigned short remotePort = 0;
+		u_long localAddress = INADDR_NONE;
+		try
+		{
+			localPort = aStream.connection().local_port();
+			remotePort = aStream.connection().remote_port();
+			localAddress = aStream.connection().local_end_point().address().to_v4().to_ulong();
+		}
+		catch(...)
+		{
+		}
+		iShards.deliver([self, session, localPort, remotePort, localAddress]() { if (*self != 0) (*self)->established(session, localPort, remotePort, localAddress); });
+	}
+
+	void shard_stream::relay::connection_failure(neolib::tcp_string_packet_stream& aStream, const boost::system::error_code& aError)
+	{
+		flush();
+		self_pointer self = iSelf;
+		unsigned long session = iSession;
+		boost::system::error_code error = aError;
+		int errorCode = aStream.error_code();
+		std::string errorText = aStream.error();
+		iShards.deliver([self, session, error, errorCode, errorText]() { if (*self != 0) (*self)->failed(session, error, errorCode, errorText); });
+	}
+
+	void shard_stream::relay::packet_sent(neolib::tcp_string_packet_stream& aStream, const neolib::string_packet& aPacket)
+	{
+		/* not relayed; nothing on the owner thread is interested */
+	}
+
+	void shard_stream::relay::packet_arrived(neolib::tcp_string_packet_stream& aStream, const neolib::string_packet& aPacket)
+	{
+		self_pointer self = iSelf;
+		unsigned long session = iSession;
+		std::string packet(static_cast<const char*>(aPacket.data()), aPacket.length());
+		if (iParsed == nullptr)
+		{
+			iShards.deliver([self, session, packet]() { if (*self != 0) (*self)->arrived(session, packet); });
+			return;
+		}
+		if (!packet.empty() && packet[packet.size() - 1] == '\r')
+			packet.erase(packet.size() - 1, 1);
+		iBatch.push_back(message(message::INCOMING));
+		iBatch.back().parse_incoming(packet);
+		if (!iFlushPosted)
+		{
+			// posted work runs once the shard has finished its current I/O round
+			iFlushPosted = true;
+			std::shared_ptr<relay> thisRelay = shared_from_this();
+			iShard.post([thisRelay]() { thisRelay->flush(); });
+		}
+	}
+
+	void shard_stream::relay::transfer_failure(neolib::tcp_string_packet_stream& aStream, const boost::system::error_code& aError)
+	{
+		flush();
+		self_pointer self = iSelf;
+		unsigned long session = iSession;
+		boost::system::error_code error = aError;
+		iShards.deliver([self, session, error]() { if (*self != 0) (*self)->transfer_failed(session, error); });
+	}
+
+	void shard_stream::relay::connection_closed(neolib::tcp_string_packet_stream& aStream)
+	{
+		flush();
+		self_pointer self = iSelf;
+		unsigned long session = iSession;
+		bool hasError = aStream.has_error();
+		int errorCode = aStream.error_code();
+		std::string errorText = aStream.error();
+		iShards.deliver([self, session, hasError, errorCode, errorText]() { if (*self != 0) (*self)->shard_closed(session, hasError, errorCode, errorText); });
+	}
+
+	void shard_stream::relay::flush()
+	{
+		iFlushPosted = false;
+		if (iParsed == nullptr || iBatch.empty())
+			return;
+		iParsed->push(std::move(iBatch));
+		iBatch.clear();
+	}
+
+	shard_stream::shard_stream(neolib::io_task& aOwnerTask, io_shards& aShards) :
+		iShards(aShards), iShard(aShards.assign()), iSelf(new shard_stream*(this)), iObserver(0), iParsedObserver(0), iSession(0),
+		iOpened(false), iConnected(false), iHasError(false), iErrorCode(0), iLocalPort(0), iRemotePort(0), iLocalAddress(INADDR_NONE)
+	{
+		if (!sharded())
+			iStream.reset(new neolib::tcp_string_packet_stream(aOwnerTask));
+		else
+			iShards.add_drain(*this);
+	}
+
+	shard_stream::~shard_stream()
+	{
+		*iSelf = 0;
+		if (sharded())
+		{
+			iShards.remove_drain(*this);
+			retire();
+			iShards.release(*iShard);
+		}
+	}
+
+	void shard_stream::add_observer(neolib::i_tcp_string_packet_stream_observer& aObserver)
+	{
+		if (!sharded())
+			iStream->add_observer(aObserver);
+		else
+			iObserver = &aObserver;
+	}
+
+	void shard_stream::set_parsed_message_observer(parsed_message_observer& aObserver)
+	{
+		iParsedObserver = &aObserver;
+	}
+
+	bool shard_stream::open(const std::string& aHostName, unsigned short aPort, bool aSecure)
+	{
+		if (!sharded())
+			return iStream->open(aHostName.c_str(), aPort, aSecure);
+		retire();
+		++iSession;
+		iOpened = true;
+		iConnected = false;
+		iHasError = false;
+		iErrorCode = 0;
+		iError.clear();
+		iLocalPort = 0;
+		iRemotePort = 0;
+		iLocalAddress = INADDR_NONE;
+		iParsed = (iParsedObserver != 0 ? parsed_queue_pointer(new parsed_queue) : parsed_queue_pointer());
+		iStream.reset(new neolib::tcp_string_packet_stream(iShard->io_task()));
+		iRelay.reset(new relay(iShards, *iShard, iSelf, iSession, iParsed));
+		iStream->add_observer(*iRelay);
+		iShard->post([stream = iStream, observer = iRelay, aHostName, aPort, aSecure]()
+		{
+			if (!stream->open(aHostName.c_str(), aPort, aSecure))
+				observer->open_failed(*stream);
+		});
+		return true;
+	}
+
+	void shard_stream::close()
+	{
+		if (!sharded())
+		{
+			iStream->close();
+			return;
+		}
+		if (!iOpened)
+			return;
+		// the owner side closes now, as an unsharded stream would; anything the shard still reports for
+		// this session is dropped
+		++iSession;
+		iOpened = false;
+		iConnected = false;
+		iParsed.reset();
+		iShard->post([stream = iStream]() { if (!stream->closed()) stream->close(); });
+		if (iObserver != 0)
+			iObserver->connection_closed(*iStream);
+	}
+
+	bool shard_stream::opened() const
+	{
+		if (!sharded())
+			return iStream->opened();
+		return iOpened;
+	}
+
+	bool shard_stream::connected() const
+	{
+		if (!sharded())
+			return iStream->connected();
+		return iConnected;
+	}
+
+	bool shard_stream::has_error() const
+	{
+		if (!sharded())
+			return iStream->has_error();
+		return iHasError;
+	}
+
+	int shard_stream::error_code() const
+	{
+		if (!sharded())
+			return iStream->error_code();
+		return iErrorCode;
+	}
+
+	std::string shard_stream::error() const
+	{
+		if (!sharded())
+			return iStream->error();
+		return iError;
+	}
+
+	void shard_stream::send_packet(const neolib::string_packet& aPacket)
+	{
+		if (!sharded())
+		{
+			iStream->send_packet(aPacket);
+			return;
+		}
+		if (!iOpened)
+			return;
+		std::string packet(static_cast<const char*>(aPacket.data()), aPacket.length());
+		iShard->post([stream = iStream, packet]() { if (!stream->closed()) stream->send_packet(neolib::string_packet(packet.data(), packet.size())); });
+	}
+
+	unsigned short shard_stream::local_port() const
+	{
+		if (!sharded())
+			return iStream->connection().local_port();
+		return iLocalPort;
+	}
+
+	unsigned short shard_stream::remote_port() const
+	{
+		if (!sharded())
+			return iStream->connection().remote_port();
+		return iRemotePort;
+	}
+
+	u_long shard_stream::local_address() const
+	{
+		if (!sharded())
+			return iStream->connection().local_end_point().address().to_v4().to_ulong();
+		return iLocalAddress;
+	}
+
+	void shard_stream::retire()
+	{
+		if (iStream == nullptr)
+			return;
+		// the last references go to the shard so the stream is closed and destroyed on its own thread
+		iShard->post([stream = std::move(iStream), observer = std::move(iRelay)]() mutable
+		{
+			if (!stream->closed())
+				stream->close();
+			stream.reset();
+			observer.reset();
+		});
+	}
+
+	void shard_stream::drain_parsed(bool aAll)
+	{
+		// nothing is handed over ahead of connection_established()
+		if (iParsed == nullptr || iParsedObserver == 0 || !iConnected)
+			return;
+		// the observer may close or reopen us, which replaces the queue
+		parsed_queue_pointer queue = iParsed;
+		uint64_t startTime = neolib::thread::elapsed_ms();
+		message_batch batch;
+		while (queue == iParsed && queue->pop(batch))
+		{
+			iParsedObserver->messages_parsed(batch);
+			if (!aAll && neolib::thread::elapsed_ms() - startTime > ParsedBudget_ms)
+				break; // the rest in the next delivery pass
+		}
+	}
+
+	void shard_stream::established(unsigned long aSession, unsigned short aLocalPort, unsigned short aRemotePort, u_long aLocalAddress)
+	{
+		if (aSession != iSession)
+			return;
+		iConnected = true;
+		iLocalPort = aLocalPort;
+		iRemotePort = aRemotePort;
+		iLocalAddress = aLocalAddress;
+		if (iObserver != 0)
+			iObserver->connection_established(*iStream);
+	}
+
+	void shard_stream::failed(unsigned long aSession, const boost::system::error_code& aError, int aErrorCode, const std::string& aErrorText)
+	{
+		if (aSession != iSession)
+			return;
+		drain_parsed(true);
+		if (aSession != iSession)
+			return;
+		++iSession;
+		iOpened = false;
+		iConnected = false;
+		iParsed.reset();
+		iHasError = true;
+		iErrorCode = aErrorCode;
+		iError = aErrorText;
+		if (iObserver != 0)
+			iObserver->connection_failure(*iStream, aError);
+	}
+
+	void shard_stream::arrived(unsigned long aSession, const std::string& aPacket)
+	{
+		if (aSession != iSession)
+			return;
+		if (iObserver != 0)
+			iObserver->packet_arrived(*iStream, neolib::string_packet(aPacket.data(), aPacket.size()));
+	}
+
+	void shard_stream::transfer_failed(unsigned long aSession, const boost::system::error_code& aError)
+	{
+		if (aSession != iSession)
+			return;
+		drain_parsed(true);
+		if (aSession != iSession)
+			return;
+		if (iObserver != 0)
+			iObserver->transfer_failure(*iStream, aError);
+	}
+
+	void shard_stream::shard_closed(unsigned long aSession, bool aHasError, int aErrorCode, const std::string& aErrorText)
+	{
+		if (aSession != iSession)
+			return;
+		drain_parsed(true);
+		if (aSession != iSession)
+			return;
+		++iSession;
+		iOpened = false;
+		iConnected = false;
+		iParsed.reset();
+		iHasError = aHasError;
+		iErrorCode = aErrorCode;
+		iError = aErrorText;
+		if (iObserver != 0)
+			iObserver->connection_closed(*iStream);
+	}
+}
@@ -0,0 +1,173 @@
+// startup_loader.cpp
+/*
+ *  Copyright (c) 2010 Leigh Johnston.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ *     * Neither the name of Leigh Johnston nor the names of any
+ *       other contributors to this software may be used to endorse or
+ *       promote products derived from this software without specific prior
+ *       written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ *  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <neolib/neolib.hpp>
+#include <fstream>
+#include <chrono>
+#include <boost/filesystem.hpp>
+#include <neoirc/client/model.hpp>
+#include <neoirc/client/identity.hpp>
+#include <neoirc/client/server.hpp>
+#include <neoirc/client/auto_joins.hpp>
+#include <neoirc/client/connection_script.hpp>
+#include <neoirc/client/ignore.hpp>
+#include <neoirc/client/notify.hpp>
+#include <neoirc/client/auto_mode.hpp>
+#include <neoirc/client/macros.hpp>
+#include <neoirc/client/contacts.hpp>
+#include <neoirc/client/startup_loader.hpp>
+
+namespace irc
+{
+	namespace
+	{
+		uint64_t elapsed_us(std::chrono::steady_clock::time_point aStart)
+		{
+			return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - aStart).count());
+		}
+	}
+
+	startup_loader::parser::parser(const std::string& aFileName, const std::string& aFallbackFileName) : 
+		iFileName(aFileName), iFallbackFileName(aFallbackFileName), iXml(true), iFileSize(0), iParseTime_us(0)
+	{
+	}
+
+	void startup_loader::parser::run()
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		std::ifstream input(iFileName.c_str());
+		if (!input && !iFallbackFileName.empty())
+		{
+			iFileName = iFallbackFileName;
+			input.open(iFileName.c_str());
+		}
+		boost::system::error_code ec;
+		uint64_t fileSize = boost::filesystem::file_size(iFileName, ec);
+		iFileSize = ec ? 0 : fileSize;
+		iXml.read(input);
+		iParseTime_us = elapsed_us(start);
+	}
+
+	startup_loader::startup_loader(model& aModel) : iModel(aModel), iTotalTime_us(0)
+	{
+	}
+
+	void startup_loader::load(std::string& aDefaultIdentity, error_function aErrorFunction)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		iProfile.clear();
+		std::vector<parser_pointer> parsers;
+		for (int store = 0; store != StoreCount; ++store)
+		{
+			// contacts were once called groups
+			parsers.push_back(parser_pointer(new parser(iModel.root_path() + file_name(static_cast<store_e>(store)), 
+				store == Contacts ? iModel.root_path() + "group_list.xml" : std::string())));
+			iModel.background_executor().post(parsers.back(), background_executor::High);
+		}
+		// the store order is the dependency order
+		for (int store = 0; store != StoreCount; ++store)
+		{
+			store_e theStore = static_cast<store_e>(store);
+			parser& theParser = *parsers[store];
+			std::chrono::steady_clock::time_point waitStart = std::chrono::steady_clock::now();
+			theParser.wait_done();
+			timing theTiming = { theStore, theParser.file_name(), theParser.file_size(), theParser.parse_time_us(), elapsed_us(waitStart), 0 };
+			std::function<bool()> errorFunction;
+			if (aErrorFunction)
+				errorFunction = [aErrorFunction, theStore]() { return aErrorFunction(theStore); };
+			std::chrono::steady_clock::time_point applyStart = std::chrono::steady_clock::now();
+			apply(theStore, theParser.xml(), aDefaultIdentity, errorFunction);
+			theTiming.iApplyTime_us = elapsed_us(applyStart);
+			iProfile.push_back(theTiming);
+		}
+		iTotalTime_us = elapsed_us(start);
+	}
+
+	const char* startup_loader::file_name(store_e aStore)
+	{
+		static const char* const sFileNames[StoreCount] = 
+		{
+			"identities.xml", "servers.xml", "auto_joins.xml", "connection_scripts.xml", "ignore_list.xml", 
+			"notify_list.xml", "auto_mode_list.xml", "macros.xml", "contacts.xml"
+		};
+		return sFileNames[aStore];
+	}
+
+	const char* startup_loader::description(store_e aStore)
+	{
+		static const char* const sDescriptions[StoreCount] = 
+		{
+			"identities", "server list", "auto join list", "connection scripts", "ignore list", 
+			"notify list", "auto mode list", "macros", "contacts"
+		};
+		return sDescriptions[aStore];
+	}
+
+	void startup_loader::apply(store_e aStore, const neolib::xml& aXml, std::string& aDefaultIdentity, std::function<bool()> aErrorFunction)
+	{
+		switch(aStore)
+		{
+		case Identities:
+			read_identity_list(iModel, aXml, aDefaultIdentity, aErrorFunction);
+			break;
+		case ServerList:
+			read_server_list(iModel, aXml, aErrorFunction);
+			break;
+		case AutoJoins:
+			read_auto_joins(iModel, aXml, aErrorFunction);
+			break;
+		case ConnectionScripts:
+			read_connection_scripts(iModel, aXml, aErrorFunction);
+			break;
+		case IgnoreList:
+			read_ignore_list(iModel, aXml, aErrorFunction);
+			break;
+		case NotifyList:
+			read_notify_list(iModel, aXml, aErrorFunction);
+			break;
+		case AutoModeList:
+			read_auto_mode_list(iModel, aXml, aErrorFunction);
+			break;
+		case Macros:
+			read_macros(iModel, aXml, aErrorFunction);
+			break;
+		case Contacts:
+			read_contacts_list(iModel, aXml, aErrorFunction);
+			break;
+		default:
+			break;
+		}
+	}
+}
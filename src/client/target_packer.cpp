@@ -0,0 +1,113 @@
+// target_packer.cpp
+/*
+ *  Copyright (c) 2010 Leigh Johnston.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ *     * Neither the name of Leigh Johnston nor the names of any
+ *       other contributors to this software may be used to endorse or
+ *       promote products derived from this software without specific prior
+ *       written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ *  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <neolib/neolib.hpp>
+#include <neoirc/client/target_packer.hpp>
+#include <neoirc/client/connection.hpp>
+
+namespace irc
+{
+	target_packer::target_packer(connection& aConnection, flood_scheduler& aScheduler, neolib::io_task& aIoTask) :
+		neolib::timer(aIoTask, 0, false), iConnection(aConnection), iScheduler(aScheduler), iPendingLane(flood_scheduler::Interactive), iPendingTargets(0)
+	{
+	}
+
+	void target_packer::send(const message& aMessage, flood_scheduler::lane aLane)
+	{
+		if (iPending && fits(aMessage, aLane))
+		{
+			iPending->parameters()[0] += ',';
+			iPending->parameters()[0] += aMessage.parameters()[0];
+			++iPendingTargets;
+			return;
+		}
+		flush();
+		if (!packable(aMessage) || iConnection.max_targets(aMessage.command_string()) < 2)
+		{
+			iScheduler.send(aMessage, aLane);
+			return;
+		}
+		iPending = aMessage;
+		iPendingLane = aLane;
+		iPendingTargets = 1;
+		if (!waiting())
+			reset();
+	}
+
+	void target_packer::flush()
+	{
+		if (!iPending)
+			return;
+		cancel();
+		message thePending = *iPending;
+		iPending.reset();
+		iScheduler.send(thePending, iPendingLane);
+	}
+
+	void target_packer::clear()
+	{
+		cancel();
+		iPending.reset();
+	}
+
+	bool target_packer::packable(const message& aMessage)
+	{
+		return (aMessage.command() == message::PRIVMSG || aMessage.command() == message::NOTICE) &&
+			aMessage.parameters().size() == 2 &&
+			!aMessage.parameters()[0].empty() &&
+			aMessage.parameters()[0].find(',') == std::string::npos;
+	}
+
+	bool target_packer::fits(const message& aMessage, flood_scheduler::lane aLane) const
+	{
+		if (!packable(aMessage) || aLane != iPendingLane ||
+			aMessage.command() != iPending->command() ||
+			aMessage.parameters()[1] != iPending->parameters()[1])
+			return false;
+		if (iPendingTargets >= iConnection.max_targets(aMessage.command_string()))
+			return false;
+		std::string targets = "," + iPending->parameters()[0] + ",";
+		if (targets.find("," + aMessage.parameters()[0] + ",") != std::string::npos)
+			return false; // the same target twice is two messages
+		std::size_t length = aMessage.command_string().size() + 1 + iPending->parameters()[0].size() + 1 + 
+			aMessage.parameters()[0].size() + 2 + aMessage.parameters()[1].size() + 2;
+		return length <= message::MaxMessageSize;
+	}
+
+	void target_packer::ready()
+	{
+		flush();
+	}
+}
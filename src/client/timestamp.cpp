@@ -73,70 +73,113 @@ namespace irc
 			}
 			return ret; 
 		}
-		struct timestamp_codes
+	}
+
+	timestamp_formatter::timestamp_formatter() : iMinute(-1)
+	{
+		std::setlocale(LC_TIME, "");
+		iCodes["%a%"].first = std::tr1::bind(timestamp_bit, "%a", &iTime);
+		iCodes["%A%"].first = std::tr1::bind(timestamp_bit, "%A", &iTime);
+		iCodes["%b%"].first = std::tr1::bind(timestamp_bit, "%b", &iTime);
+		iCodes["%B%"].first = std::tr1::bind(timestamp_bit, "%B", &iTime);
+		iCodes["%c%"].first = std::tr1::bind(timestamp_bit, "%c", &iTime);
+		iCodes["%d%"].first = std::tr1::bind(timestamp_bit, "%d", &iTime);
+		iCodes["%do%"].first = std::tr1::bind(month_ordinal_bit, &iTime);
+		iCodes["%H%"].first = std::tr1::bind(timestamp_bit, "%H", &iTime);
+		iCodes["%I%"].first = std::tr1::bind(timestamp_bit, "%I", &iTime);
+		iCodes["%j%"].first = std::tr1::bind(timestamp_bit, "%j", &iTime);
+		iCodes["%m%"].first = std::tr1::bind(timestamp_bit, "%m", &iTime);
+		iCodes["%M%"].first = std::tr1::bind(timestamp_bit, "%M", &iTime);
+		iCodes["%p%"].first = std::tr1::bind(timestamp_bit, "%p", &iTime);
+		iCodes["%S%"].first = std::tr1::bind(timestamp_bit, "%S", &iTime);
+		iCodes["%U%"].first = std::tr1::bind(timestamp_bit, "%U", &iTime);
+		iCodes["%w%"].first = std::tr1::bind(timestamp_bit, "%w", &iTime);
+		iCodes["%W%"].first = std::tr1::bind(timestamp_bit, "%W", &iTime);
+		iCodes["%x%"].first = std::tr1::bind(timestamp_bit, "%x", &iTime);
+		iCodes["%X%"].first = std::tr1::bind(timestamp_bit, "%X", &iTime);
+		iCodes["%y%"].first = std::tr1::bind(timestamp_bit, "%y", &iTime);
+		iCodes["%Y%"].first = std::tr1::bind(timestamp_bit, "%Y", &iTime);
+		iCodes["%z%"].first = std::tr1::bind(timestamp_bit, "%z", &iTime);
+		iCodes["%Z%"].first = std::tr1::bind(timestamp_bit, "%Z", &iTime);
+		iCodes["%#a%"].first = std::tr1::bind(timestamp_bit, "%#a", &iTime);
+		iCodes["%#A%"].first = std::tr1::bind(timestamp_bit, "%#A", &iTime);
+		iCodes["%#b%"].first = std::tr1::bind(timestamp_bit, "%#b", &iTime);
+		iCodes["%#B%"].first = std::tr1::bind(timestamp_bit, "%#B", &iTime);
+		iCodes["%#c%"].first = std::tr1::bind(timestamp_bit, "%#c", &iTime);
+		iCodes["%#d%"].first = std::tr1::bind(timestamp_bit, "%#d", &iTime);
+		iCodes["%#do%"].first = std::tr1::bind(month_ordinal_bit, &iTime);
+		iCodes["%#H%"].first = std::tr1::bind(timestamp_bit, "%#H", &iTime);
+		iCodes["%#I%"].first = std::tr1::bind(timestamp_bit, "%#I", &iTime);
+		iCodes["%#j%"].first = std::tr1::bind(timestamp_bit, "%#j", &iTime);
+		iCodes["%#m%"].first = std::tr1::bind(timestamp_bit, "%#m", &iTime);
+		iCodes["%#M%"].first = std::tr1::bind(timestamp_bit, "%#M", &iTime);
+		iCodes["%#p%"].first = std::tr1::bind(timestamp_bit, "%#p", &iTime);
+		iCodes["%#S%"].first = std::tr1::bind(timestamp_bit, "%#S", &iTime);
+		iCodes["%#U%"].first = std::tr1::bind(timestamp_bit, "%#U", &iTime);
+		iCodes["%#w%"].first = std::tr1::bind(timestamp_bit, "%#w", &iTime);
+		iCodes["%#W%"].first = std::tr1::bind(timestamp_bit, "%#W", &iTime);
+		iCodes["%#x%"].first = std::tr1::bind(timestamp_bit, "%#x", &iTime);
+		iCodes["%#X%"].first = std::tr1::bind(timestamp_bit, "%#X", &iTime);
+		iCodes["%#y%"].first = std::tr1::bind(timestamp_bit, "%#y", &iTime);
+		iCodes["%#Y%"].first = std::tr1::bind(timestamp_bit, "%#Y", &iTime);
+		iCodes["%#z%"].first = std::tr1::bind(timestamp_bit, "%#z", &iTime);
+		iCodes["%#Z%"].first = std::tr1::bind(timestamp_bit, "%#Z", &iTime);
+	}
+
+	timestamp_formatter& timestamp_formatter::instance()
+	{
+		static timestamp_formatter sInstance;
+		return sInstance;
+	}
+
+	std::string timestamp_formatter::format(time_t aTime, const std::string& aFormat)
+	{
+		std::lock_guard<std::mutex> lock(iMutex);
+		entry& theEntry = iEntries[aFormat];
+		if (theEntry.iTime != aTime)
+		{
+			local_time(aTime);
+			theEntry.iText = timestamp_bit(aFormat.c_str(), &iTime);
+			theEntry.iTime = aTime;
+		}
+		return theEntry.iText;
+	}
+
+	std::string timestamp_formatter::format_codes(time_t aTime, const std::string& aFormat)
+	{
+		std::lock_guard<std::mutex> lock(iMutex);
+		entry& theEntry = iCodeEntries[aFormat];
+		if (theEntry.iTime != aTime)
+		{
+			local_time(aTime);
+			theEntry.iText = aFormat;
+			parse_codes(theEntry.iText, iCodes);
+			theEntry.iTime = aTime;
+		}
+		return theEntry.iText;
+	}
+
+	void timestamp_formatter::local_time(time_t aTime)
+	{
+		time_t theMinute = aTime - aTime % 60;
+		if (theMinute != iMinute)
 		{
-			timestamp_codes()
+			tm* theTime = localtime(&theMinute);
+			if (theTime == 0)
 			{
-				iCodes["%a%"].first = std::tr1::bind(timestamp_bit, "%a", &iTime);
-				iCodes["%A%"].first = std::tr1::bind(timestamp_bit, "%A", &iTime);
-				iCodes["%b%"].first = std::tr1::bind(timestamp_bit, "%b", &iTime);
-				iCodes["%B%"].first = std::tr1::bind(timestamp_bit, "%B", &iTime);
-				iCodes["%c%"].first = std::tr1::bind(timestamp_bit, "%c", &iTime);
-				iCodes["%d%"].first = std::tr1::bind(timestamp_bit, "%d", &iTime);
-				iCodes["%do%"].first = std::tr1::bind(month_ordinal_bit, &iTime);
-				iCodes["%H%"].first = std::tr1::bind(timestamp_bit, "%H", &iTime);
-				iCodes["%I%"].first = std::tr1::bind(timestamp_bit, "%I", &iTime);
-				iCodes["%j%"].first = std::tr1::bind(timestamp_bit, "%j", &iTime);
-				iCodes["%m%"].first = std::tr1::bind(timestamp_bit, "%m", &iTime);
-				iCodes["%M%"].first = std::tr1::bind(timestamp_bit, "%M", &iTime);
-				iCodes["%p%"].first = std::tr1::bind(timestamp_bit, "%p", &iTime);
-				iCodes["%S%"].first = std::tr1::bind(timestamp_bit, "%S", &iTime);
-				iCodes["%U%"].first = std::tr1::bind(timestamp_bit, "%U", &iTime);
-				iCodes["%w%"].first = std::tr1::bind(timestamp_bit, "%w", &iTime);
-				iCodes["%W%"].first = std::tr1::bind(timestamp_bit, "%W", &iTime);
-				iCodes["%x%"].first = std::tr1::bind(timestamp_bit, "%x", &iTime);
-				iCodes["%X%"].first = std::tr1::bind(timestamp_bit, "%X", &iTime);
-				iCodes["%y%"].first = std::tr1::bind(timestamp_bit, "%y", &iTime);
-				iCodes["%Y%"].first = std::tr1::bind(timestamp_bit, "%Y", &iTime);
-				iCodes["%z%"].first = std::tr1::bind(timestamp_bit, "%z", &iTime);
-				iCodes["%Z%"].first = std::tr1::bind(timestamp_bit, "%Z", &iTime);
-				iCodes["%#a%"].first = std::tr1::bind(timestamp_bit, "%#a", &iTime);
-				iCodes["%#A%"].first = std::tr1::bind(timestamp_bit, "%#A", &iTime);
-				iCodes["%#b%"].first = std::tr1::bind(timestamp_bit, "%#b", &iTime);
-				iCodes["%#B%"].first = std::tr1::bind(timestamp_bit, "%#B", &iTime);
-				iCodes["%#c%"].first = std::tr1::bind(timestamp_bit, "%#c", &iTime);
-				iCodes["%#d%"].first = std::tr1::bind(timestamp_bit, "%#d", &iTime);
-				iCodes["%#do%"].first = std::tr1::bind(month_ordinal_bit, &iTime);
-				iCodes["%#H%"].first = std::tr1::bind(timestamp_bit, "%#H", &iTime);
-				iCodes["%#I%"].first = std::tr1::bind(timestamp_bit, "%#I", &iTime);
-				iCodes["%#j%"].first = std::tr1::bind(timestamp_bit, "%#j", &iTime);
-				iCodes["%#m%"].first = std::tr1::bind(timestamp_bit, "%#m", &iTime);
-				iCodes["%#M%"].first = std::tr1::bind(timestamp_bit, "%#M", &iTime);
-				iCodes["%#p%"].first = std::tr1::bind(timestamp_bit, "%#p", &iTime);
-				iCodes["%#S%"].first = std::tr1::bind(timestamp_bit, "%#S", &iTime);
-				iCodes["%#U%"].first = std::tr1::bind(timestamp_bit, "%#U", &iTime);
-				iCodes["%#w%"].first = std::tr1::bind(timestamp_bit, "%#w", &iTime);
-				iCodes["%#W%"].first = std::tr1::bind(timestamp_bit, "%#W", &iTime);
-				iCodes["%#x%"].first = std::tr1::bind(timestamp_bit, "%#x", &iTime);
-				iCodes["%#X%"].first = std::tr1::bind(timestamp_bit, "%#X", &iTime);
-				iCodes["%#y%"].first = std::tr1::bind(timestamp_bit, "%#y", &iTime);
-				iCodes["%#Y%"].first = std::tr1::bind(timestamp_bit, "%#Y", &iTime);
-				iCodes["%#z%"].first = std::tr1::bind(timestamp_bit, "%#z", &iTime);
-				iCodes["%#Z%"].first = std::tr1::bind(timestamp_bit, "%#Z", &iTime);
+				iMinute = -1;
+				iTime = std::tm();
+				return;
 			}
-			codes iCodes;
-			tm iTime;
-		};
+			iMinuteTime = *theTime;
+			iMinute = theMinute;
+		}
+		iTime = iMinuteTime;
+		iTime.tm_sec += static_cast<int>(aTime - theMinute);
 	}
 
 	std::string timestamp(time_t aTime, const std::string& aFormat)
 	{
-		tm* theTime = localtime(&aTime);
-		std::string ret = aFormat;
-		setlocale(LC_TIME, "");
-		static timestamp_codes sCodes;
-		sCodes.iTime = *theTime;
-		parse_codes(ret, sCodes.iCodes);
-		return ret;
+		return timestamp_formatter::instance().format_codes(aTime, aFormat);
 	}
 }
\ No newline at end of file
@@ -34,13 +34,15 @@
 */
 
 #include <neolib/neolib.hpp>
+#include <neolib/string_utils.hpp>
 #include <neoirc/client/who.hpp>
+#include <neoirc/client/mask.hpp>
 
 namespace irc
 {
 	who_requester::who_requester(connection& aConnection) : 
 		neolib::timer(aConnection.connection_manager().model().io_task(), 5000), 
-		iConnection(aConnection)
+		iConnection(aConnection), iNextSequence(0), iNextToken(1), iWhox(false)
 	{
 		iConnection.add_observer(*this);
 	}
@@ -78,10 +80,12 @@ namespace irc
 
 	void who_requester::cancel_request(const std::string& aMask, requester& aRequester)
 	{
-		for (request_list::iterator i = iRequests.begin(); i != iRequests.end(); ++i)
-			if (irc::make_string(iConnection, i->iMask) == aMask &&
-				i->iRequestType.is<requester*>() && static_cast<requester*>(i->iRequestType) == &aRequester)
-				i->iRequestType = static_cast<requester*>(0);
+		mask_index::iterator theRequests = iMasks.find(key(aMask));
+		if (theRequests == iMasks.end())
+			return;
+		for (std::vector<request_list::iterator>::iterator i = theRequests->second.begin(); i != theRequests->second.end(); ++i)
+			if ((*i)->iRequestType.is<requester*>() && static_cast<requester*>((*i)->iRequestType) == &aRequester)
+				(*i)->iRequestType = static_cast<requester*>(0);
 	}
 
 	void who_requester::cancel_request(requester& aRequester)
@@ -93,23 +97,16 @@ namespace irc
 
 	void who_requester::new_request(const std::string& aMask, const request_type& aRequestType)
 	{
-		request theRequest(aMask, aRequestType);
-		
-		for (request_list::const_iterator i = iRequests.begin(); i != iRequests.end(); ++i)
-			if (i->iMask == theRequest.iMask && i->iRequestType == theRequest.iRequestType)
+		std::string theKey = key(aMask);
+		std::vector<request_list::iterator>& theRequests = iMasks[theKey];
+		for (std::vector<request_list::iterator>::const_iterator i = theRequests.begin(); i != theRequests.end(); ++i)
+			if ((*i)->iMask == aMask && (*i)->iRequestType == aRequestType)
 				return;
 
-		iRequests.push_back(theRequest);
+		theRequests.push_back(iRequests.insert(iRequests.end(), request(aMask, theKey, aRequestType, iNextSequence++)));
 
 		if (!aRequestType.is<join_request>())
-		{
-			buffer& theBuffer = aRequestType.is<buffer*>() ? *static_cast<buffer*>(aRequestType) : iConnection.server_buffer();
-			message requestMessage(theBuffer, message::OUTGOING);
-			requestMessage.set_command(message::WHO);
-			requestMessage.parameters().push_back(aMask);
-			theBuffer.new_message(requestMessage);
-			iRequests.back().iSent = true;
-		}
+			send(theRequests.back(), aRequestType.is<buffer*>() ? *static_cast<buffer*>(aRequestType) : iConnection.server_buffer());
 	}
 
 	bool who_requester::new_message(const message& aMessage)
@@ -118,29 +115,51 @@ namespace irc
 
 		switch(aMessage.command())
 		{
+		case message::RPL_WHOSPCRPL:
+			{
+				// token, channel, user, host, server, nick, flags, hop count, real name; see send()
+				if (aMessage.parameters().size() < 9)
+					return false;
+				token_index::iterator theRequest = iTokens.find(aMessage.parameters()[0]);
+				if (theRequest == iTokens.end())
+					return false;
+				message whoReply(aMessage);
+				whoReply.set_command(message::RPL_WHOREPLY);
+				whoReply.parameters().assign(aMessage.parameters().begin() + 1, aMessage.parameters().begin() + 7);
+				whoReply.parameters().push_back(aMessage.parameters()[7] + " " + aMessage.parameters()[8]);
+				iWhoxReply = theRequest->second;
+				iConnection.receive_message(whoReply, true);
+				iWhoxReply.reset();
+			}
+			return true;
 		case message::RPL_WHOREPLY:
+			if (iWhoxReply)
+			{
+				theReply = reply(*iWhoxReply, aMessage);
+				break;
+			}
 			if (aMessage.parameters().size() < 5)
 				return false;
-			for (request_list::iterator i = iRequests.begin(); i != iRequests.end(); ++i)
-				if (i->iSent && 
-					((irc::make_string(iConnection, i->iMask) == aMessage.parameters()[0]) ||
-					(irc::make_string(iConnection, i->iMask) == aMessage.parameters()[4])))
-				{
-					theReply = reply(i, aMessage);
-					break;
-				}
+			else
+			{
+				request_list::iterator byChannel;
+				request_list::iterator byNickName;
+				bool foundChannel = find_sent(aMessage.parameters()[0], byChannel);
+				bool foundNickName = find_sent(aMessage.parameters()[4], byNickName);
+				if (foundChannel && (!foundNickName || byChannel->iSequence < byNickName->iSequence))
+					theReply = reply(byChannel, aMessage);
+				else if (foundNickName)
+					theReply = reply(byNickName, aMessage);
+			}
 			break;
 		case message::RPL_ENDOFWHO:
 			if (aMessage.parameters().empty())
 				return false;
 			else
 			{
-				for (request_list::iterator i = iRequests.begin(); i != iRequests.end(); ++i)
-					if (i->iSent && irc::make_string(iConnection, i->iMask) == aMessage.parameters()[0])
-					{
-						theReply = reply(i, aMessage);
-						break;
-					}
+				request_list::iterator theRequest;
+				if (find_sent(aMessage.parameters()[0], theRequest))
+					theReply = reply(theRequest, aMessage);
 			}
 			break;
 		default:
@@ -155,12 +174,70 @@ namespace irc
 				static_cast<requester*>(theReply->first->iRequestType) != 0)
 				static_cast<requester*>(theReply->first->iRequestType)->who_result(theReply->second);
 			if (aMessage.command() == message::RPL_ENDOFWHO)
-				iRequests.erase(theReply->first);
+				erase(theReply->first);
 		}
 
 		return theReply;
 	}
 
+	std::string who_requester::key(const std::string& aMask) const
+	{
+		return fold_case(iConnection.casemapping(), aMask);
+	}
+
+	void who_requester::send(request_list::iterator aRequest, buffer& aBuffer)
+	{
+		message requestMessage(aBuffer, message::OUTGOING);
+		requestMessage.set_command(message::WHO);
+		requestMessage.set_background(!aRequest->iRequestType.is<buffer*>());
+		requestMessage.parameters().push_back(aRequest->iMask);
+		if (iWhox)
+		{
+			for (unsigned int i = 0; i < kMaxToken && aRequest->iToken.empty(); ++i)
+			{
+				std::string theToken = neolib::unsigned_integer_to_string<char>(iNextToken);
+				iNextToken = iNextToken % kMaxToken + 1;
+				if (iTokens.find(theToken) == iTokens.end())
+				{
+					aRequest->iToken = theToken;
+					iTokens[theToken] = aRequest;
+				}
+			}
+			if (!aRequest->iToken.empty())
+				requestMessage.parameters().push_back("%tcuhsnfdr," + aRequest->iToken);
+		}
+		aBuffer.new_message(requestMessage);
+		aRequest->iSent = true;
+	}
+
+	void who_requester::erase(request_list::iterator aRequest)
+	{
+		mask_index::iterator theRequests = iMasks.find(aRequest->iKey);
+		if (theRequests != iMasks.end())
+		{
+			theRequests->second.erase(std::find(theRequests->second.begin(), theRequests->second.end(), aRequest));
+			if (theRequests->second.empty())
+				iMasks.erase(theRequests);
+		}
+		if (!aRequest->iToken.empty())
+			iTokens.erase(aRequest->iToken);
+		iRequests.erase(aRequest);
+	}
+
+	bool who_requester::find_sent(const std::string& aMask, request_list::iterator& aRequest) const
+	{
+		mask_index::const_iterator theRequests = iMasks.find(key(aMask));
+		if (theRequests == iMasks.end())
+			return false;
+		for (std::vector<request_list::iterator>::const_iterator i = theRequests->second.begin(); i != theRequests->second.end(); ++i)
+			if ((*i)->iSent)
+			{
+				aRequest = *i;
+				return true;
+			}
+		return false;
+	}
+
 	void who_requester::ready()
 	{
 		typedef std::vector<request_list::iterator> join_requests;
@@ -176,20 +253,13 @@ namespace irc
 			if (i->second.size() < kPossibleNetSplit)
 			{
 				for (join_requests::iterator j = i->second.begin(); j != i->second.end(); ++j)
-				{
-					buffer& theBuffer = iConnection.server_buffer();
-					message requestMessage(theBuffer, message::OUTGOING);
-					requestMessage.set_command(message::WHO);
-					requestMessage.parameters().push_back((*j)->iMask);
-					theBuffer.new_message(requestMessage);
-					(*j)->iSent = true;
-				}
+					send(*j, iConnection.server_buffer());
 			}
 			else
 			{
 				std::string channelName = i->first->name();
 				for (join_requests::iterator j = i->second.begin(); j != i->second.end(); ++j)
-					iRequests.erase(*j);
+					erase(*j);
 				new_request(channelName);
 			}
 		}
@@ -201,16 +271,28 @@ namespace irc
 		for (request_list::iterator i = iRequests.begin(); i != iRequests.end();)
 		{
 			if (i->iRequestType.is<buffer*>() && static_cast<buffer*>(i->iRequestType) == &aBuffer)
-				iRequests.erase(i++);
+				erase(i++);
 			else if (aBuffer.type() == buffer::CHANNEL && i->iRequestType.is<join_request>() && static_cast<join_request&>(i->iRequestType).iChannel == static_cast<channel_buffer*>(&aBuffer))
-				iRequests.erase(i++);
+				erase(i++);
 			else
 				++i;
 		}
 	}
 
+	void who_requester::incoming_message(connection& aConnection, const message& aMessage)
+	{
+		if (aMessage.command() != message::RPL_ISUPPORT)
+			return;
+		for (message::parameters_t::const_iterator i = aMessage.parameters().begin(); i != aMessage.parameters().end(); ++i)
+			if (neolib::make_ci_string(*i) == neolib::ci_string("WHOX"))
+				iWhox = true;
+	}
+
 	void who_requester::connection_disconnected(connection& aConnection)
 	{
 		iRequests.clear();
+		iMasks.clear();
+		iTokens.clear();
+		iWhox = false;
 	}
 }
\ No newline at end of file
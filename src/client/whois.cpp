@@ -35,6 +35,7 @@
 
 #include <neolib/neolib.hpp>
 #include <neoirc/client/whois.hpp>
+#include <neoirc/client/mask.hpp>
 
 namespace irc
 {
@@ -51,7 +52,7 @@ namespace irc
 	whois_requester& whois_requester::operator=(const whois_requester& aOther)
 	{
 		request_list iRequests = aOther.iRequests;
-		replies iReplies = aOther.iReplies;
+		cache iCache = aOther.iCache;
 		return *this;
 	}
 
@@ -72,35 +73,70 @@ namespace irc
 
 	void whois_requester::cancel_request(const std::string& aNickName, requester& aRequester)
 	{
-		for (request_list::iterator i = iRequests.begin(); i != iRequests.end(); ++i)
-			if (irc::make_string(iConnection, i->first) == aNickName &&
-				i->second.is<requester*>() && static_cast<requester*>(i->second) == &aRequester)
-				i->second = static_cast<requester*>(0);
+		request_list::iterator theRequest = iRequests.find(key(aNickName));
+		if (theRequest == iRequests.end())
+			return;
+		for (requester_list::iterator i = theRequest->second.iRequesters.begin(); i != theRequest->second.iRequesters.end(); ++i)
+			if (i->is<requester*>() && static_cast<requester*>(*i) == &aRequester)
+				*i = static_cast<requester*>(0);
 	}
 
 	void whois_requester::cancel_request(requester& aRequester)
 	{
 		for (request_list::iterator i = iRequests.begin(); i != iRequests.end(); ++i)
-			if (i->second.is<requester*>() && static_cast<requester*>(i->second) == &aRequester)
-				i->second = static_cast<requester*>(0);
+			for (requester_list::iterator j = i->second.iRequesters.begin(); j != i->second.iRequesters.end(); ++j)
+				if (j->is<requester*>() && static_cast<requester*>(*j) == &aRequester)
+					*j = static_cast<requester*>(0);
 	}
 
 	void whois_requester::new_request(const std::string& aNickName, const requester_type& aRequester)
 	{
-		iRequests.push_back(request(aNickName, aRequester));
+		std::string theKey = key(aNickName);
+
+		if (!aRequester.is<buffer*>())
+		{
+			cache::iterator cached = iCache.find(theKey);
+			if (cached != iCache.end() && neolib::thread::elapsed_ms() - cached->second.iTime < kCacheLifetime_ms)
+			{
+				replies theReplies = cached->second.iReplies; // the requester may ask again from whois_result()
+				for (replies::const_iterator i = theReplies.begin(); i != theReplies.end(); ++i)
+					deliver(aRequester, *i);
+				return;
+			}
+		}
+
+		request_list::iterator existing = iRequests.find(theKey);
+		if (existing != iRequests.end())
+		{
+			existing->second.iRequesters.push_back(aRequester);
+			return;
+		}
+
+		iRequests.insert(std::make_pair(theKey, request(aNickName))).first->second.iRequesters.push_back(aRequester);
 
 		buffer& theBuffer = aRequester.is<buffer*>() ? *static_cast<buffer*>(aRequester) : iConnection.server_buffer();
 		message requestMessage(theBuffer, message::OUTGOING);
 		requestMessage.set_command(message::WHOIS);
+		requestMessage.set_background(!aRequester.is<buffer*>());
 		requestMessage.parameters().push_back(aNickName);
 		theBuffer.new_message(requestMessage);
 	}
 
 	void whois_requester::nick_change(const std::string& aOldNickName, const std::string& aNewNickName)
 	{
-		for (request_list::iterator i = iRequests.begin(); i != iRequests.end(); ++i)
-			if (irc::make_string(iConnection, i->first) == aOldNickName)
-				i->first = aNewNickName;
+		invalidate(aOldNickName);
+		invalidate(aNewNickName);
+		std::string oldKey = key(aOldNickName);
+		std::string newKey = key(aNewNickName);
+		if (oldKey == newKey)
+			return;
+		request_list::iterator theRequest = iRequests.find(oldKey);
+		if (theRequest == iRequests.end() || iRequests.find(newKey) != iRequests.end())
+			return;
+		request renamed = theRequest->second;
+		renamed.iNickName = aNewNickName;
+		iRequests.erase(theRequest);
+		iRequests.insert(std::make_pair(newKey, renamed));
 	}
 
 	bool whois_requester::new_message(const message& aMessage)
@@ -108,7 +144,7 @@ namespace irc
 		if (aMessage.parameters().empty())
 			return false;
 
-		bool found = false;
+		request_list::iterator theRequest = iRequests.find(key(aMessage.parameters()[0]));
 
 		switch(aMessage.command())
 		{
@@ -123,67 +159,83 @@ namespace irc
 		case message::RPL_WHOISSADMIN:
 		case message::RPL_WHOISSVCMSG:
 		case message::RPL_AWAY:
-			for (request_list::iterator i = iRequests.begin(); i != iRequests.end() && !found; ++i)
-				if (irc::make_string(iConnection, i->first) == aMessage.parameters()[0])
-					found = true;
-			if (found)
-				iReplies.push_back(aMessage);
-			break;
+			if (theRequest == iRequests.end())
+				return false;
+			theRequest->second.iReplies.push_back(aMessage);
+			return true;
 		case message::RPL_ENDOFWHOIS:
-			for (request_list::iterator i = iRequests.begin(); !found && i != iRequests.end();)
+			if (theRequest == iRequests.end())
+				return false;
+			else
 			{
-				if (irc::make_string(iConnection, i->first) == aMessage.parameters()[0])
+				request completed = theRequest->second;
+				iRequests.erase(theRequest);
+				completed.iReplies.push_back(aMessage);
+				uint64_t now = neolib::thread::elapsed_ms();
+				for (cache::iterator i = iCache.begin(); i != iCache.end();)
 				{
-					found = true;
-					iReplies.push_back(aMessage);
-					for (replies::iterator j = iReplies.begin(); j != iReplies.end();)
-					{
-						if (irc::make_string(iConnection, j->parameters()[0]) == aMessage.parameters()[0])
-						{
-							if (i->second.is<buffer*>())
-								static_cast<buffer*>(i->second)->new_message(*j);
-							else if (static_cast<requester*>(i->second) != 0)
-								static_cast<requester*>(i->second)->whois_result(*j);
-							iReplies.erase(j++);
-						}
-						else
-							++j;
-					}
-					iRequests.erase(i++);
+					if (now - i->second.iTime >= kCacheLifetime_ms)
+						i = iCache.erase(i);
+					else
+						++i;
 				}
-				else
-					++i;
+				cached_result& theResult = iCache.insert(std::make_pair(key(completed.iNickName), cached_result(now))).first->second;
+				theResult.iTime = now;
+				theResult.iReplies = completed.iReplies;
+				for (requester_list::const_iterator i = completed.iRequesters.begin(); i != completed.iRequesters.end(); ++i)
+					for (replies::const_iterator j = completed.iReplies.begin(); j != completed.iReplies.end(); ++j)
+						deliver(*i, *j);
 			}
-			break;
+			return true;
 		case message::ERR_NOSUCHNICK:
-			for (request_list::iterator i = iRequests.begin(); i != iRequests.end();)
+			invalidate(aMessage.parameters()[0]);
+			if (theRequest == iRequests.end())
+				return false;
+			else
 			{
-				if (irc::make_string(iConnection, i->first) == aMessage.parameters()[0])
-				{
-					if (i->second.is<buffer*>())
-						static_cast<buffer*>(i->second)->new_message(aMessage);
-					else if (static_cast<requester*>(i->second) != 0)
-						static_cast<requester*>(i->second)->whois_result(aMessage);
-					iRequests.erase(i++);
-					found = true;
-				}
-				else
-					++i;
+				request failed = theRequest->second;
+				iRequests.erase(theRequest);
+				for (requester_list::const_iterator i = failed.iRequesters.begin(); i != failed.iRequesters.end(); ++i)
+					deliver(*i, aMessage);
 			}
-			break;
+			return true;
 		default:
-			break;
+			return false;
 		}
+	}
+
+	std::string whois_requester::key(const std::string& aNickName) const
+	{
+		return fold_case(iConnection.casemapping(), aNickName);
+	}
 
-		return found;
+	void whois_requester::deliver(const requester_type& aRequester, const message& aMessage)
+	{
+		if (aRequester.is<buffer*>())
+			static_cast<buffer*>(aRequester)->new_message(aMessage);
+		else if (static_cast<requester*>(aRequester) != 0)
+			static_cast<requester*>(aRequester)->whois_result(aMessage);
+	}
+
+	void whois_requester::invalidate(const std::string& aNickName)
+	{
+		iCache.erase(key(aNickName));
 	}
 
 	void whois_requester::buffer_removed(buffer& aBuffer)
 	{
 		for (request_list::iterator i = iRequests.begin(); i != iRequests.end();)
 		{
-			if (i->second.is<buffer*>() && static_cast<buffer*>(i->second) == &aBuffer)
-				iRequests.erase(i++);
+			requester_list& theRequesters = i->second.iRequesters;
+			for (requester_list::iterator j = theRequesters.begin(); j != theRequesters.end();)
+			{
+				if (j->is<buffer*>() && static_cast<buffer*>(*j) == &aBuffer)
+					j = theRequesters.erase(j);
+				else
+					++j;
+			}
+			if (theRequesters.empty())
+				i = iRequests.erase(i);
 			else
 				++i;
 		}
@@ -191,17 +243,29 @@ namespace irc
 
 	void whois_requester::incoming_message(connection& aConnection, const message& aMessage)
 	{
-		if (aMessage.command() != message::NICK)
-			return;
-		user oldUser(aMessage.origin(), aConnection);
-		user newUser(oldUser);
-		if (!aMessage.parameters().empty())
-			newUser.nick_name() = aMessage.parameters()[0];
-		nick_change(oldUser.nick_name(), newUser.nick_name());
+		switch(aMessage.command())
+		{
+		case message::NICK:
+			{
+				user oldUser(aMessage.origin(), aConnection);
+				user newUser(oldUser);
+				if (!aMessage.parameters().empty())
+					newUser.nick_name() = aMessage.parameters()[0];
+				nick_change(oldUser.nick_name(), newUser.nick_name());
+			}
+			break;
+		case message::QUIT:
+		case message::AWAY:
+			invalidate(user(aMessage.origin(), aConnection).nick_name());
+			break;
+		default:
+			break;
+		}
 	}
 
 	void whois_requester::connection_disconnected(connection& aConnection)
 	{
 		iRequests.clear();
+		iCache.clear();
 	}
 }
\ No newline at end of file
@@ -515,7 +515,7 @@ namespace caw_irc_plugin
 		virtual bool can_activate() const
 		{
 			irc::buffer* activeBuffer = iIrcBuffer.connection().connection_manager().active_buffer();
-			if (iIrcBuffer.model().auto_join_watcher().is_auto_join() && activeBuffer != 0 && activeBuffer->type() == irc::buffer::CHANNEL)
+			if (iIrcBuffer.model().auto_join_watcher().is_auto_join(iIrcBuffer) && activeBuffer != 0 && activeBuffer->type() == irc::buffer::CHANNEL)
 				return false;
 			bool canActivate = true;
 			observable<i_buffer::i_subscriber>::notify_observers(i_buffer::i_subscriber::NotifyCanActivateBuffer, canActivate);
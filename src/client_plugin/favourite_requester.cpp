@@ -104,48 +104,25 @@ namespace caw_irc_plugin
 		irc::connection* theConnection = 0;
 		for (irc::identity_list::const_iterator i = iIdentities.identity_list().begin(); theConnection == 0 && i != iIdentities.identity_list().end(); ++i)
 			if (i->nick_name() == aRequest.property("nick_name"))
-				if (aRequest.property("server_name") != "*")
 				{
-					for (irc::server_list::const_iterator s = iServerList.begin(); theConnection == 0 && s != iServerList.end(); ++s)
-						if (s->key() == irc::server::key_type(aRequest.property("server_network").to_std_string(), aRequest.property("server_name").to_std_string()))
-						{
-							irc::server theServer = *s;
-							if (aRequest.property_exists("server_port"))
-							{
-								irc::server::port_list ports;
-								ports.push_back(irc::server::port_range(
-									boost::lexical_cast<uint16_t>(aRequest.property("server_port")),
-									boost::lexical_cast<uint16_t>(aRequest.property("server_port"))));
-								theServer.set_ports(ports);
-							}
-							if (aRequest.property_exists("server_secure"))
-								theServer.set_secure(boost::lexical_cast<bool>(aRequest.property("server_secure")));
-							theConnection = iConnectionManager.add_connection(theServer, *i, std::string(), true);
-						}
-				}
-				else
-				{
-					int number = 0;
-					for (irc::server_list::const_iterator s = iServerList.begin(); theConnection == 0 && s != iServerList.end(); ++s)
-						if (s->key().first == aRequest.property("server_network"))
-							++number;
-					number = iRandom.get(0, number - 1);
-					for (irc::server_list::const_iterator s = iServerList.begin(); theConnection == 0 && s != iServerList.end(); ++s)
-						if (s->key().first == aRequest.property("server_network") && --number < 0)
+					irc::server_list::const_iterator s = (aRequest.property("server_name") != "*" ?
+						iServerList.find(irc::server::key_type(aRequest.property("server_network").to_std_string(), aRequest.property("server_name").to_std_string())) :
+						iServerList.random_server(aRequest.property("server_network").to_std_string(), iRandom));
+					if (s != iServerList.end())
+					{
+						irc::server theServer = *s;
+						if (aRequest.property_exists("server_port"))
 						{
-							irc::server theServer = *s;
-							if (aRequest.property_exists("server_port"))
-							{
-								irc::server::port_list ports;
-								ports.push_back(irc::server::port_range(
-									boost::lexical_cast<uint16_t>(aRequest.property("server_port")), 
-									boost::lexical_cast<uint16_t>(aRequest.property("server_port"))));
-								theServer.set_ports(ports);
-							}
-							if (aRequest.property_exists("server_secure"))
-								theServer.set_secure(boost::lexical_cast<bool>(aRequest.property("server_secure")));
-							theConnection = iConnectionManager.add_connection(theServer, *i, std::string(), true);
+							irc::server::port_list ports;
+							ports.push_back(irc::server::port_range(
+								boost::lexical_cast<uint16_t>(aRequest.property("server_port")),
+								boost::lexical_cast<uint16_t>(aRequest.property("server_port"))));
+							theServer.set_ports(ports);
 						}
+						if (aRequest.property_exists("server_secure"))
+							theServer.set_secure(boost::lexical_cast<bool>(aRequest.property("server_secure")));
+						theConnection = iConnectionManager.add_connection(theServer, *i, std::string(), true);
+					}
 				}
 
 		if (theConnection != 0)
@@ -21,6 +21,7 @@
 #include "contacts.hpp"
 #include "auto_join_watcher.hpp"
 #include "server_updater.hpp"
+#include "startup_loader.hpp"
 
 #include "buffer.hpp"
 
@@ -186,6 +187,8 @@ namespace caw_irc_plugin
 		add_setting_observer("Logging", "ScrollbackLogSize", [this](const neolib::i_setting& aSetting) { iModel->logger().reload_size() = aSetting.value().value_as_integer(); });
 		add_setting_observer("Logging", "LogArchive", [this](const neolib::i_setting& aSetting) { iModel->logger().archive() = aSetting.value().value_as_boolean(); });
 		add_setting_observer("Logging", "LogArchiveSize", [this](const neolib::i_setting& aSetting) { iModel->logger().archive_size() = aSetting.value().value_as_integer(); });
+		add_setting_observer("Logging", "LogArchiveCompress", [this](const neolib::i_setting& aSetting) { iModel->logger().compress_archives() = aSetting.value().value_as_boolean(); });
+		add_setting_observer("Logging", "LogSearchIndex", [this](const neolib::i_setting& aSetting) { iModel->logger().set_search_index(aSetting.value().value_as_boolean()); });
 		add_setting_observer("Logging", "LoggerEvents", [this](const neolib::i_setting& aSetting) { iModel->logger().events() = static_cast<irc::logger::events_e>(aSetting.value().value_as_integer()); });
 		add_setting_observer("Logging", "LoggingEnabled", [this](const neolib::i_setting& aSetting) { iModel->logger().enable(aSetting.value().value_as_boolean()); });
 
@@ -198,9 +201,10 @@ namespace caw_irc_plugin
 			boost::filesystem::path(iModel->root_path() + "themes.xml"), boost::filesystem::copy_option::fail_if_exists, ec);
 
 		std::string defaultIdentity;
-		read_identity_list(*iModel, defaultIdentity, []()->bool
+		iModel->startup_loader().load(defaultIdentity, [](irc::startup_loader::store_e aStore)->bool
 		{
-			return QMessageBox::warning(NULL, "Configuration File Error", "The identities file is corrupt. Delete it?", QMessageBox::No | QMessageBox::Yes) == QMessageBox::Yes;
+			std::string text = std::string("The ") + irc::startup_loader::description(aStore) + " file is corrupt. Delete it?";
+			return QMessageBox::warning(NULL, "Configuration File Error", text.c_str(), QMessageBox::No | QMessageBox::Yes) == QMessageBox::Yes;
 		});
 		for (irc::identity_list::iterator i = iModel->identity_list().begin(); i != iModel->identity_list().end();)
 		{
@@ -216,47 +220,8 @@ namespace caw_irc_plugin
 			}
 		}
 
-		read_server_list(*iModel, []()->bool
-		{
-			return QMessageBox::warning(NULL, "Configuration File Error", "The server list file is corrupt. Delete it?", QMessageBox::No | QMessageBox::Yes) == QMessageBox::Yes;
-		});
 		iModel->server_list().sort();
 
-		read_auto_joins(*iModel, []()->bool
-		{
-			return QMessageBox::warning(NULL, "Configuration File Error", "The auto join list file is corrupt. Delete it?", QMessageBox::No | QMessageBox::Yes) == QMessageBox::Yes;
-		});
-
-		read_connection_scripts(*iModel, []()->bool
-		{
-			return QMessageBox::warning(NULL, "Configuration File Error", "The connection scripts file is corrupt. Delete it?", QMessageBox::No | QMessageBox::Yes) == QMessageBox::Yes;
-		});
-
-		read_ignore_list(*iModel, []()->bool
-		{
-			return QMessageBox::warning(NULL, "Configuration File Error", "The ignore list file is corrupt. Delete it?", QMessageBox::No | QMessageBox::Yes) == QMessageBox::Yes;
-		});
-
-		read_notify_list(*iModel, []()->bool
-		{
-			return QMessageBox::warning(NULL, "Configuration File Error", "The notify list file is corrupt. Delete it?", QMessageBox::No | QMessageBox::Yes) == QMessageBox::Yes;
-		});
-
-		read_auto_mode_list(*iModel, []()->bool
-		{
-			return QMessageBox::warning(NULL, "Configuration File Error", "The auto mode list file is corrupt. Delete it?", QMessageBox::No | QMessageBox::Yes) == QMessageBox::Yes;
-		});
-
-		read_macros(*iModel, []()->bool
-		{
-			return QMessageBox::warning(NULL, "Configuration File Error", "The macros file is corrupt. Delete it?", QMessageBox::No | QMessageBox::Yes) == QMessageBox::Yes;
-		});
-
-		read_contacts_list(*iModel, []()->bool
-		{
-			return QMessageBox::warning(NULL, "Configuration File Error", "The contacts file is corrupt. Delete it?", QMessageBox::No | QMessageBox::Yes) == QMessageBox::Yes;
-		});
-
 		add_setting_observer("Formatting", "BufferSize", [this](const neolib::i_setting& aSetting) { iModel->set_buffer_size(aSetting.value().value_as_integer()); });
 		add_setting_observer("Formatting", "DisplayMode", [this](const neolib::i_setting& aSetting) { iModel->message_strings().set_mode(static_cast<irc::message_strings::mode_e>(aSetting.value().value_as_integer())); });
 		add_setting_observer("Miscellaneous", "QuitMessage", [this](const neolib::i_setting& aSetting) { iModel->message_strings().set_own_quit_message(aSetting.value().value_as_string().to_std_string()); });
@@ -300,6 +265,7 @@ namespace caw_irc_plugin
 		add_setting_observer("Formatting", "TimestampFormat", [this](const neolib::i_setting& aSetting) { iModel->message_strings().set_timestamp_format(aSetting.value().value_as_string().to_std_string()); });
 		add_setting_observer("Miscellaneous", "FloodPrevention", [this](const neolib::i_setting& aSetting) { iModel->connection_manager().set_flood_prevention(aSetting.value().value_as_boolean()); });
 		add_setting_observer("Miscellaneous", "FloodPreventionDelay", [this](const neolib::i_setting& aSetting) { iModel->connection_manager().set_flood_prevention_delay(aSetting.value().value_as_integer()); });
+		add_setting_observer("Miscellaneous", "NetworkThreads", [this](const neolib::i_setting& aSetting) { iModel->connection_manager().set_network_threads(static_cast<std::size_t>(aSetting.value().value_as_integer())); });
 		add_setting_observer("Miscellaneous", "UseNoticeBuffer", [this](const neolib::i_setting& aSetting) { iModel->connection_manager().set_use_notice_buffer(aSetting.value().value_as_boolean()); });
 		add_setting_observer("Miscellaneous", "UserListUpdate", [this](const neolib::i_setting& aSetting) { iModel->connection_manager().set_auto_who(aSetting.value().value_as_boolean()); });
 		add_setting_observer("Miscellaneous", "UserAwayUpdate", [this](const neolib::i_setting& aSetting) { iModel->connection_manager().set_away_update(aSetting.value().value_as_boolean()); });
@@ -391,13 +357,14 @@ namespace caw_irc_plugin
 
 		irc::server* theServer = 0;
 		std::string network;
-		for (irc::server_list::iterator i = iModel->server_list().begin(); theServer == 0 && i != iModel->server_list().end(); ++i)
-			if (neolib::make_ci_string(i->address()) == address)
-			{
-				network = i->network();
-				if (!secure || *secure == i->secure())
-					theServer = &*i;
-			}
+		const irc::server_list::servers& addressServers = iModel->server_list().address_servers(address);
+		for (irc::server_list::servers::const_iterator s = addressServers.begin(); theServer == 0 && s != addressServers.end(); ++s)
+		{
+			irc::server_list::iterator i = *s;
+			network = i->network();
+			if (!secure || *secure == i->secure())
+				theServer = &*i;
+		}
 
 		if (theServer == 0)
 		{
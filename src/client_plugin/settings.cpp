@@ -183,6 +183,10 @@ namespace caw_irc_plugin
 				{ caw::gui_setting_presentation_info::CheckBox, "", "Archiving enabled" } },
 			{ "Logging", "LogArchiveSize", neolib::i_simple_variant::Integer, 1000,
 				{ caw::gui_setting_presentation_info::LineEdit, "", "Archive when log file size is %w:width(\"0000\")% KB" } },
+			{ "Logging", "LogArchiveCompress", neolib::i_simple_variant::Boolean, false,
+				{ caw::gui_setting_presentation_info::CheckBox, "", "Compress archived log files" } },
+			{ "Logging", "LogSearchIndex", neolib::i_simple_variant::Boolean, false,
+				{ caw::gui_setting_presentation_info::CheckBox, "", "Keep a search index of log files" } },
 			{ "Logging", "LogFileDirectory", neolib::i_simple_variant::String, {},
 				{ caw::gui_setting_presentation_info::LineEdit, "", "Log file directory: %w% %browse_directory%" } },
 			{ "Logging", "LoggerEvents", neolib::i_simple_variant::Integer, irc::logger::Message,
@@ -320,6 +324,8 @@ namespace caw_irc_plugin
 				{ caw::gui_setting_presentation_info::CheckBox, "Flood Prevention", "Flood prevention enabled" } },
 			{ "Miscellaneous", "FloodPreventionDelay", neolib::i_simple_variant::Integer, 500,
 				{ caw::gui_setting_presentation_info::LineEdit, "Flood Prevention", "Flood prevention delay (ms): %w:width(\"0000\")%", {}, true, 0, 2000 } },
+			{ "Miscellaneous", "NetworkThreads", neolib::i_simple_variant::Integer, 0,
+				{ caw::gui_setting_presentation_info::LineEdit, "Connections", "Network threads (0 = none): %w:width(\"00\")%", {}, true, 0, 16 } },
 			{ "Miscellaneous", "UserListShowStatus", neolib::i_simple_variant::Boolean, true,
 				{ caw::gui_setting_presentation_info::CheckBox, "Channel User List", "Display channel status" } },
 			{ "Miscellaneous", "UserAwayUpdate", neolib::i_simple_variant::Boolean, false,